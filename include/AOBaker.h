@@ -0,0 +1,254 @@
+// RTAO - Offline AO baking of static geometry on the CPU BVH
+#pragma once
+
+#include "BVH8.h"
+#include "BVHCache.h"
+#include "TaskScheduler.h"
+
+// Texels of a lightmap are traced in square tiles, tiles are distributed over threads
+#define AO_BAKE_TILE_SIZE 16
+
+struct AOBakeInfo
+{
+	int raysCount;					//< Cosine-weighted rays per vertex or texel
+	float aoRadius;					//< Ray length, AO is the mean T / aoRadius with misses at aoRadius as in RTAORayGen
+	float tMin;						//< Start of the rays, 0.1 in RTAORayGen
+	uint32_t seed;					//< Rotation of the sample sequence of every vertex or texel
+
+	AOBakeInfo() {
+		raysCount = 64;
+		aoRadius = 1.0f;
+		tMin = 0.1f;
+		seed = 0;
+	}
+};
+
+struct AOBakeStats
+{
+	double time;					//< Wall clock time of the bake in ms (of loading the cache when loaded)
+	uint64_t pointsCount;			//< Distinct points traced from (vertices welded by position)
+	uint64_t raysCount;
+	double mraysPerSecond;
+	bool loaded;					//< AO was read from the cache file, nothing was traced
+
+	AOBakeStats() {
+		time = 0.0;
+		pointsCount = 0;
+		raysCount = 0;
+		mraysPerSecond = 0.0;
+		loaded = false;
+	}
+};
+
+#define LIGHTMAP_EMPTY_TEXEL 0xFFFFFFFF
+
+// Source of the atlas uvs of a lightmap
+enum LightmapUVs
+{
+	LIGHTMAP_UVS_AUTO = 0,			//< Model uvs when they stay within [0, 1] and no two triangles share a texel, generated ones otherwise
+	LIGHTMAP_UVS_MODEL,
+	LIGHTMAP_UVS_GENERATED,			//< Triangles sharing their longest edge get a chart per pair, the rest one each, packed into rows of the atlas
+	LIGHTMAP_UVS_COUNT
+};
+
+struct LightmapInfo
+{
+	int resolution;					//< Width and height of the atlas
+	LightmapUVs uvs;
+	int padding;					//< Texels around generated charts, baked AO is dilated as far into the empty texels
+
+	LightmapInfo() {
+		resolution = 1024;
+		uvs = LIGHTMAP_UVS_AUTO;
+		padding = 2;
+	}
+};
+
+// Surface point a texel is baked at
+struct LightmapTexel
+{
+	XMFLOAT3 position;
+	uint32_t primitiveIndex;		//< Triangle of the point, LIGHTMAP_EMPTY_TEXEL when no triangle overlaps the texel
+	XMFLOAT3 normal;				//< Face normal, wound as in GetVertexAttributes
+	float distance;					//< From the texel center to the triangle in texels, 0 when the triangle covers the center
+};
+
+struct Lightmap
+{
+	int width;
+	int height;
+	int padding;
+	bool generatedUVs;
+	vector<XMFLOAT2> uvs;			//< Atlas uv of every triangle corner, in Model index order
+	vector<LightmapTexel> texels;	//< Rows from the top, texel (x, y) is sampled at uv ((x + 0.5) / width, (y + 0.5) / height)
+	vector<float> ao;				//< Baked AO of every texel, dilated into the texels around triangles (1 farther away)
+	uint64_t coveredTexels;			//< Texel centers inside a triangle
+	uint64_t conservativeTexels;	//< Texels only partially overlapped, baked at the closest point of the triangle
+	uint64_t overlappingTexels;		//< Texel centers inside more than one triangle (model uvs only), the first triangle keeps them
+
+	Lightmap() {
+		width = 0;
+		height = 0;
+		padding = 0;
+		generatedUVs = false;
+		coveredTexels = 0;
+		conservativeTexels = 0;
+		overlappingTexels = 0;
+	}
+
+	size_t GetMemorySize() const {
+		return uvs.size() * sizeof(XMFLOAT2) + texels.size() * sizeof(LightmapTexel) + ao.size() * sizeof(float);
+	}
+};
+
+#define AO_CHECKPOINT_MAGIC 0x4B414F52		//< "ROAK"
+#define AO_CHECKPOINT_VERSION 1				//< Bump on any change of the header or LightmapTexelState layout
+
+struct AOProgressiveInfo
+{
+	int samplesPerPass;				//< Rays added to every unconverged texel by a pass, AOBakeInfo::raysCount is the most a texel gets
+	float targetError;				//< Texels converge once the standard error of their AO is at most this, with 0 once they have raysCount
+	int minSamples;					//< Rays a texel gets before its error estimate is trusted
+	int maxPasses;					//< Passes traced by one call, 0 runs until no texel is left to trace
+	string checkpointPath;			//< State is saved to and resumed from this file, empty disables checkpoints
+	int checkpointPasses;			//< Passes between checkpoints, the state is also saved when the call returns
+
+	AOProgressiveInfo() {
+		samplesPerPass = 8;
+		targetError = 0.01f;
+		minSamples = 16;
+		maxPasses = 0;
+		checkpointPasses = 4;
+	}
+};
+
+// Everything needed to continue sampling a texel, stored as is in checkpoints
+struct LightmapTexelState
+{
+	double sum;						//< Of T / aoRadius over all rays so far
+	double sumSquares;
+	uint64_t sequence;				//< Rotation of the texel's sample sequence (the RNG state, the sample index picks the next sample)
+	uint32_t samplesCount;			//< Index of the next sample
+	float error;					//< Standard error of the mean after the last pass, FLT_MAX while below minSamples
+};
+
+struct AOCheckpointHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t texelsHash;			//< Surface points of the lightmap, a checkpoint of another model, atlas or resolution is ignored
+	uint64_t samplingHash;			//< Get_AO_Bake_Hash without the rays count, settings that change the samples of a texel
+	uint32_t width;
+	uint32_t height;
+	uint32_t passesCount;			//< Passes traced before the checkpoint was written
+	uint32_t texelStateSize;
+	uint64_t fileSize;
+};
+
+// Convergence of the bake after a pass, over all baked texels
+struct AOPassReport
+{
+	int pass;						//< Counted from the start of the bake, including passes of resumed checkpoints
+	uint64_t activeTexels;			//< Texels traced by the pass
+	uint64_t convergedTexels;		//< Texels at the target error after the pass
+	uint64_t cappedTexels;			//< Texels still above the target error that got raysCount, they aren't traced any further
+	uint64_t pendingTexels;			//< Texels above the target error the next pass traces
+	uint64_t raysCount;
+	uint32_t maxSamplesCount;		//< Rays of the most sampled texel
+	double meanSamplesCount;
+	double rmsError;				//< Root mean square of the texels' standard errors
+	double maxError;
+	double time;					//< Of tracing the pass in ms
+	bool checkpointed;
+};
+
+struct AOProgressiveStats
+{
+	vector<AOPassReport> passes;	//< Passes traced by this call
+	int resumedPasses;				//< Passes restored from the checkpoint, 0 for a new bake
+	bool converged;					//< All baked texels reached the target error
+	bool finished;					//< No texel is left to trace, either converged or capped at raysCount
+	uint64_t convergedTexels;		//< State of the texels when the call returned, as in AOPassReport
+	uint64_t cappedTexels;
+	uint64_t pendingTexels;
+	double time;					//< Wall clock time of the call in ms, including checkpoints
+	double checkpointTime;
+	uint64_t checkpointBytes;
+	uint64_t raysCount;
+	double mraysPerSecond;
+
+	AOProgressiveStats() {
+		resumedPasses = 0;
+		converged = false;
+		finished = false;
+		convergedTexels = 0;
+		cappedTexels = 0;
+		pendingTexels = 0;
+		time = 0.0;
+		checkpointTime = 0.0;
+		checkpointBytes = 0;
+		raysCount = 0;
+		mraysPerSecond = 0.0;
+	}
+};
+
+namespace CPURT
+{
+	/**
+	* Area weighted sums of triangle normals, wound as in GetVertexAttributes. Vertices at the same position (split by uv seams)
+	* get the same normal. Zero for vertices of degenerate triangles only.
+	*/
+	void Compute_Vertex_Normals(const Model &model, vector<XMFLOAT3> &normals);
+
+	/**
+	* AO of every vertex of the model from rays around its normal, the R2 sequence rotated per vertex mapped to cosine-weighted
+	* directions. Vertices at the same position are traced once and share the result. Rays of a vertex depend on the seed and
+	* the vertex only, so the result is the same for any number of threads.
+	*/
+	void Bake_Vertex_AO(TaskScheduler &scheduler, const BVH8 &bvh, const Model &model, const AOBakeInfo &info, vector<float> &vertexAO,
+		AOBakeStats* stats = nullptr);
+
+	// Key of baked AO in the BVH cache, covers all settings that change the result
+	uint64_t Get_AO_Bake_Hash(const AOBakeInfo &info);
+
+	/**
+	* Load the BVH and the per-vertex AO of the model from its cache file, build and bake whatever is missing or stale and
+	* write the file again.
+	*/
+	void Bake_Vertex_AO_Cached(TaskScheduler &scheduler, const string &path, const Model &model, const BVHBuildInfo &buildInfo,
+		const AOBakeInfo &info, BVH8 &bvh, vector<float> &vertexAO, AOBakeStats* stats = nullptr);
+
+	/**
+	* Atlas uvs of the model and the surface point of every texel. Triangles are rasterized conservatively: texels whose center
+	* no triangle covers take the closest point of a triangle overlapping them, so that bilinear filtering along chart edges only
+	* reads baked texels. Throws when generated charts of all triangles don't fit the resolution.
+	*/
+	void Build_Lightmap(const Model &model, const LightmapInfo &info, Lightmap &lightmap);
+
+	/**
+	* AO of every texel of the lightmap, tiles of texels are traced in parallel with the same rays per texel as the vertex bake.
+	* Texels of no triangle then receive the mean of their baked neighbors, padding texels far.
+	*/
+	void Bake_Lightmap_AO(TaskScheduler &scheduler, const BVH8 &bvh, const AOBakeInfo &info, Lightmap &lightmap, AOBakeStats* stats = nullptr);
+
+	// Baked AO in the RGBA8 layout Utils::LoadTexture returns (AO in rgb, opaque alpha)
+	void Get_Lightmap_Texture(const Lightmap &lightmap, TextureInfo &texture);
+
+	/**
+	* Write the AO as an uncompressed TGA that Create_Texture can load as the material texture. LoadTexture reverses the order
+	* of pixels, so they are written reversed and the uploaded texture matches the lightmap uvs (the image itself shows up rotated).
+	*/
+	void Save_Lightmap_Texture(const string &path, const Lightmap &lightmap);
+
+	/**
+	* Lightmap AO accumulated in passes of samplesPerPass rays per texel, texels stop at the target error. The bake resumes from
+	* the checkpoint file when it holds the same lightmap and sampling settings, so a restarted bake continues where the last saved
+	* pass left off (raysCount and the target error may change in between). The state is saved every checkpointPasses passes, it
+	* replaces the previous checkpoint only once fully written. Texels take the same samples in the same order however the bake is
+	* split into calls, so a resumed bake gives the same AO as an uninterrupted one. progress is called after every pass, returning
+	* false stops the bake after saving the state. Returns true when every texel reached the target error (texels capped at
+	* raysCount above it don't count), the lightmap AO is set (and dilated) in any case.
+	*/
+	bool Bake_Lightmap_AO_Progressive(TaskScheduler &scheduler, const BVH8 &bvh, const AOBakeInfo &info, const AOProgressiveInfo &progressiveInfo,
+		Lightmap &lightmap, AOProgressiveStats* stats = nullptr, const function<bool(const AOPassReport&)> &progress = nullptr);
+}
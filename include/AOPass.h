@@ -0,0 +1,39 @@
+// RTAO - CPU implementation of the AO ray tracing pass
+#pragma once
+
+#include "BVH8.h"
+#include "Image.h"
+#include "TaskScheduler.h"
+
+// Pixels are shaded in square tiles, tiles are distributed over threads
+#define AO_PASS_TILE_SIZE 16
+
+struct AOPassStats
+{
+	double time;					//< Wall clock time of the pass in ms
+	uint64_t pixelsCount;			//< Pixels with a primary hit (the rest are sky)
+	uint64_t raysCount;
+	uint64_t reprojectedCount;		//< Pixels that kept their AO history
+
+	AOPassStats() {
+		time = 0.0;
+		pixelsCount = 0;
+		raysCount = 0;
+		reprojectedCount = 0;
+	}
+};
+
+namespace CPURT
+{
+	/**
+	* Same output as RTAORayGen: current AO in x, AO of the previous 3 frames in yzw (or the current AO in all 4 slots
+	* when the pixel fails to reproject). normalAndDepths images hold the face normal and primary ray T (negative for sky)
+	* as written by RayGen, samples is the AO samples table built for the interleaved sampling configuration of rtao.
+	*/
+	void Render_AO(TaskScheduler &scheduler, const BVH8 &bvh, const ViewCB &view, const RtaoCB &rtao, const vector<XMFLOAT3> &samples,
+		const Image &normalAndDepthsCurrent, const Image &normalAndDepthsPrevious, const Image &aoPrevious, Image &aoOutput, AOPassStats* stats = nullptr);
+
+	// Same pass, tiles trace the BVH8 copy of the node their thread runs on
+	void Render_AO(TaskScheduler &scheduler, const NumaReplicas<BVH8> &bvh, const ViewCB &view, const RtaoCB &rtao, const vector<XMFLOAT3> &samples,
+		const Image &normalAndDepthsCurrent, const Image &normalAndDepthsPrevious, const Image &aoPrevious, Image &aoOutput, AOPassStats* stats = nullptr);
+}
@@ -0,0 +1,94 @@
+// RTAO - CPU bounding volume hierarchy
+#pragma once
+
+#include "RayTracing.h"
+#include "TaskScheduler.h"
+
+#define BVH_STACK_SIZE 128
+
+struct BVHBuildInfo
+{
+	int leafSize;				//< Ranges of at most this many triangles become leaves
+	int binsCount;				//< Number of SAH bins per axis
+	float traversalCost;		//< Costs of the SAH metric reported in build stats, relative to each other
+	float intersectionCost;
+	float rebuildThreshold;		//< Update_BVH rebuilds once refits grow the SAH cost of the last build by this factor
+	bool spatialSplits;			//< SBVH: split by planes too, triangles straddling a plane are referenced from both children
+	float spatialSplitAlpha;	//< Spatial splits are searched where object split children overlap more than this fraction of the root area
+	float duplicationBudget;	//< Extra triangle references spatial splits may create, as a fraction of the triangle count (parallel
+								//< subtrees claim it first come first served, so SBVH trees may differ between runs)
+	bool linear;				//< LBVH: Morton ordered radix tree instead of SAH splits, much faster to build for per-frame rebuilds
+	int treeletPasses;			//< LBVH: bottom-up passes replacing treelets of 7 leaves by their SAH optimal topology (0 to skip)
+
+	BVHBuildInfo() {
+		leafSize = 4;
+		binsCount = 16;
+		traversalCost = 1.0f;
+		intersectionCost = 1.0f;
+		rebuildThreshold = 1.3f;
+		spatialSplits = false;
+		spatialSplitAlpha = 1e-5f;
+		duplicationBudget = 0.3f;
+		linear = false;
+		treeletPasses = 0;
+	}
+};
+
+struct BVHBuildStats
+{
+	double buildTime;			//< In milliseconds
+	uint32_t nodesCount;
+	uint32_t leavesCount;
+	uint32_t referencesCount;	//< Triangles in leaves, duplicates of spatial splits included
+	float sahCost;				//< Of the current tree, updated by refits
+	double refitTime;			//< Of the last refit, in milliseconds
+	float builtSahCost;			//< SAH cost right after the last full build
+
+	BVHBuildStats() {
+		buildTime = 0.0;
+		nodesCount = 0;
+		leavesCount = 0;
+		referencesCount = 0;
+		sahCost = 0.0f;
+		refitTime = 0.0;
+		builtSahCost = 0.0f;
+	}
+};
+
+struct BVHNode
+{
+	XMFLOAT3 boundsMin;
+	uint32_t leftFirst;			//< Index of the left child (inner node, right child follows it) or of the first triangle (leaf)
+	XMFLOAT3 boundsMax;
+	uint32_t count;				//< Number of triangles in a leaf, 0 for inner nodes
+
+	bool IsLeaf() const { return count > 0; }
+};
+
+struct BVH
+{
+	vector<BVHNode> nodes;				//< Root is the first node
+	vector<Triangle> triangles;			//< Triangles in leaf order
+	vector<uint32_t> primitiveIndices;	//< Index of each BVH triangle in the Model
+
+	BVHBuildStats stats;
+};
+
+namespace CPURT
+{
+	void Build_BVH(TaskScheduler &scheduler, const Model &model, const BVHBuildInfo &info, BVH &bvh);
+
+	// Binned SAH tree over arbitrary primitive bounds, order receives primitive indices in leaf order (leaves index into it)
+	void Build_BVH_Nodes(TaskScheduler &scheduler, const vector<AABB> &bounds, const BVHBuildInfo &info, vector<BVHNode> &nodes,
+		vector<uint32_t> &order, BVHBuildStats &stats);
+	float Compute_SAH_Cost(const BVH &bvh, const BVHBuildInfo &info);
+
+	// Recompute triangles and node bounds bottom-up after vertex positions of the model changed (topology must stay the same).
+	// Trees built with spatial splits are rejected, their clipped bounds can't be refitted.
+	void Refit_BVH(TaskScheduler &scheduler, const Model &model, const BVHBuildInfo &info, BVH &bvh);
+
+	// Refit, or rebuild when the refitted tree's SAH cost exceeds the built one by info.rebuildThreshold. Returns true on rebuild.
+	bool Update_BVH(TaskScheduler &scheduler, const Model &model, const BVHBuildInfo &info, BVH &bvh);
+
+	bool Intersect(const BVH &bvh, const Ray &ray, Hit &hit);
+}
@@ -0,0 +1,199 @@
+// RTAO - 8-wide bounding volume hierarchy with SIMD traversal
+#pragma once
+
+#include "BVH.h"
+
+#define BVH8_WIDTH 8
+#define BVH8_MAX_DEPTH 96		//< Inner node levels traversal supports, binary builds stay below (48 SAH levels, then median splits)
+#define BVH8_STACK_SIZE ((BVH8_WIDTH - 1) * BVH8_MAX_DEPTH)	//< Every node on the path holds at most 7 unvisited siblings
+
+#define BVH8_MAX_RAYS_IN_FLIGHT 32	//< Rays a thread interleaves at most in batch traversal
+
+#define BVH8_LEAF_FLAG 0x80000000
+#define BVH8_EMPTY_CHILD 0xFFFFFFFF
+
+struct BVH8Node
+{
+	float boundsMin[3][BVH8_WIDTH];		//< Child bounds in SoA form (x, y, z planes of all children), empty slots have inverted bounds
+	float boundsMax[3][BVH8_WIDTH];
+	uint32_t children[BVH8_WIDTH];		//< Index of an inner child node, BVH8_LEAF_FLAG | first triangle of a leaf, or BVH8_EMPTY_CHILD
+	uint32_t counts[BVH8_WIDTH];		//< Number of triangles of a leaf child
+};
+
+struct BVH8
+{
+	vector<BVH8Node> nodes;				//< Root is the first node
+	vector<Triangle> triangles;			//< Triangles in leaf order
+	vector<uint32_t> primitiveIndices;	//< Index of each BVH triangle in the Model
+	uint32_t depth;						//< Levels of inner nodes, at most BVH8_MAX_DEPTH so that traversal stacks can't overflow
+
+	BVH8() {
+		depth = 0;
+	}
+};
+
+// Order of nodes in memory after Reorder_BVH8, the root stays first in all of them
+enum BVH8Layout
+{
+	BVH8_LAYOUT_BUILD = 0,			//< Order emitted by Build_BVH8 (depth first, children in slot order), nodes are kept as they are
+	BVH8_LAYOUT_DEPTH_FIRST,		//< Depth first, larger children first so that the child most likely entered follows its parent
+	BVH8_LAYOUT_BREADTH_DEPTH,		//< Top levels breadth first (kept hot in cache by every ray), subtrees below them depth first
+	BVH8_LAYOUT_VAN_EMDE_BOAS,		//< Cache oblivious: top half of the levels laid out recursively, then each subtree below them
+	BVH8_LAYOUTS_COUNT
+};
+
+enum SIMDLevel
+{
+	SIMD_SCALAR = 0,
+	SIMD_AVX2,
+	SIMD_AVX512,
+	SIMD_LEVELS_COUNT
+};
+
+// Traversal stack entry, leaves keep their triangle count so that they can be intersected when popped
+struct BVH8StackEntry
+{
+	uint32_t child;
+	uint32_t count;
+	float t;
+};
+
+namespace CPURT
+{
+	// Collapse the binary tree, throws when the result is deeper than BVH8_MAX_DEPTH
+	void Build_BVH8(const BVH &bvh, BVH8 &bvh8);
+
+	// Levels of inner nodes below the root, measuring stops once it exceeds BVH8_MAX_DEPTH (so corrupt trees return as well)
+	uint32_t Get_BVH8_Depth(const BVH8 &bvh8);
+
+	// Bounds of the tree (union of the root's children), empty for an empty tree
+	AABB Get_Bounds(const BVH8 &bvh);
+
+	/**
+	* Permute nodes of a built tree into the layout, topology, triangles and leaves are kept. topLevels is the number of levels
+	* laid out breadth first by BVH8_LAYOUT_BREADTH_DEPTH (1 + 8 + 64 nodes of 256 bytes for 3 fit the L1 cache).
+	*/
+	void Reorder_BVH8(BVH8 &bvh8, BVH8Layout layout, int topLevels = 3);
+	const char* Get_BVH8_Layout_Name(BVH8Layout layout);
+
+	// Update triangles and child bounds in place after vertex positions of the model changed, topology is kept
+	void Refit_BVH8(TaskScheduler &scheduler, const Model &model, BVH8 &bvh8);
+
+	SIMDLevel Get_Supported_SIMD_Level();
+	const char* Get_SIMD_Level_Name(SIMDLevel level);
+
+	// Closest hit traversal, uses the widest SIMD kernel supported by the CPU unless a level is given. Traversal starts at
+	// the root, or at the given node when the caller knows the ray can't reach anything outside its subtree (see BVH8Entry.h)
+	bool Intersect(const BVH8 &bvh, const Ray &ray, Hit &hit);
+	bool Intersect(const BVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level, uint32_t root = 0);
+
+	// Any hit traversal, terminates at the first intersection found within [tMin, tMax] (which need not be the closest one)
+	bool Occluded(const BVH8 &bvh, const Ray &ray, Hit &hit);
+	bool Occluded(const BVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level, uint32_t root = 0);
+
+	// Occlusion queries of a batch of AO rays: bit (i % 32) of occludedBits[i / 32] is set when ray i hits anything
+	void Occluded(const BVH8 &bvh, const Ray* rays, size_t count, uint32_t* occludedBits, SIMDLevel level = SIMD_LEVELS_COUNT);
+	// Any-hit distance of a batch of AO rays for the T / aoRadius estimator, misses return the ray's tMax (as RTAO payload does)
+	void Occlusion_Distance(const BVH8 &bvh, const Ray* rays, size_t count, float* t, SIMDLevel level = SIMD_LEVELS_COUNT);
+
+	// Batch queries with raysInFlight rays interleaved: every ray visits one node, prefetches the next one and yields to the next ray,
+	// so cache misses of one ray overlap work on the others. Hits and results are those of one ray at a time, bit i marks ray i.
+	// Needs AVX2, otherwise rays are traced one at a time.
+	void Intersect_Interleaved(const BVH8 &bvh, const Ray* rays, size_t count, Hit* hits, uint32_t* hitBits, int raysInFlight = 8);
+	void Occluded_Interleaved(const BVH8 &bvh, const Ray* rays, size_t count, uint32_t* occludedBits, int raysInFlight = 8);
+
+	// Kernels written with the intrinsics of their instruction set - call only when supported. Their files are compiled for the
+	// baseline instruction set like all others, so inline code they instantiate (vector, DirectXMath) may be shared by the linker
+	bool Intersect_BVH8_Scalar(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root = 0);
+	bool Intersect_BVH8_AVX2(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root = 0);
+	bool Intersect_BVH8_AVX512(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root = 0);
+	bool Occluded_BVH8_Scalar(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root = 0);
+	bool Occluded_BVH8_AVX2(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root = 0);
+	bool Occluded_BVH8_AVX512(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root = 0);
+	void Intersect_BVH8_Interleaved_AVX2(const BVH8 &bvh, const Ray* rays, size_t count, Hit* hits, uint32_t* hitBits, int raysInFlight);
+	void Occluded_BVH8_Interleaved_AVX2(const BVH8 &bvh, const Ray* rays, size_t count, uint32_t* occludedBits, int raysInFlight);
+
+	// Scalar closest hit kernel handing the memory range of every node and leaf it reads to access(address, bytes, node),
+	// so cache simulations follow the traversal actually measured
+	bool Intersect_BVH8_Scalar(const BVH8 &bvh, const Ray &ray, Hit &hit, const function<void(const void*, size_t, bool)> &access);
+}
+
+//--------------------------------------------------------------------------------------
+// Traversal Helpers
+//--------------------------------------------------------------------------------------
+
+/**
+* Intersect triangles of a leaf, shortens tMax and updates the hit on every closer intersection.
+* Any hit queries return at the first intersection. Works with any tree storing triangles and primitiveIndices in leaf order.
+*/
+template <typename Tree>
+static inline bool IntersectLeaf(const Tree &bvh, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	bool found = false;
+	for (uint32_t i = first; i < first + count; i++) {
+		float t, u, v;
+		if (IntersectTriangle(bvh.triangles[i], ray.origin, ray.direction, ray.tMin, tMax, t, u, v)) {
+			tMax = t;
+			hit.t = t;
+			hit.primitiveIndex = bvh.primitiveIndices[i];
+			hit.barycentrics = XMFLOAT2(u, v);
+			found = true;
+			if (anyHit) break;
+		}
+	}
+	return found;
+}
+
+/**
+* Pop the next entry, skipping those that are now farther than the closest hit. Returns false when traversal is done.
+*/
+static inline bool PopEntry(BVH8StackEntry* stack, int &stackSize, float tMax, BVH8StackEntry &entry)
+{
+	do {
+		if (stackSize == 0) return false;
+		entry = stack[--stackSize];
+	} while (entry.t > tMax);
+
+	return true;
+}
+
+/**
+* Push intersected children on the stack and return the nearest one, which is visited next. Closest hit queries
+* push the rest ordered by distance, any hit queries skip the sort - stack order only matters once a hit shortens the ray.
+*/
+static inline BVH8StackEntry PushChildren(BVH8StackEntry* stack, int &stackSize, BVH8StackEntry* hits, int hitsCount, bool anyHit)
+{
+	if (hitsCount == 1) return hits[0];
+
+	// Holds for trees of at most BVH8_MAX_DEPTH levels, which Build_BVH8 and the cache enforce
+	assert(stackSize + hitsCount - 1 <= BVH8_STACK_SIZE);
+
+	if (anyHit) {
+		int nearest = 0;
+		for (int i = 1; i < hitsCount; i++) {
+			if (hits[i].t < hits[nearest].t) nearest = i;
+		}
+
+		for (int i = 0; i < hitsCount; i++) {
+			if (i != nearest) stack[stackSize++] = hits[i];
+		}
+
+		return hits[nearest];
+	}
+
+	// Insertion sort by decreasing distance, there are only a few hits per node
+	for (int i = 1; i < hitsCount; i++) {
+		BVH8StackEntry entry = hits[i];
+		int j = i - 1;
+		while (j >= 0 && hits[j].t < entry.t) {
+			hits[j + 1] = hits[j];
+			j--;
+		}
+		hits[j + 1] = entry;
+	}
+
+	for (int i = 0; i < hitsCount - 1; i++)
+		stack[stackSize++] = hits[i];
+
+	return hits[hitsCount - 1];
+}
@@ -0,0 +1,54 @@
+// RTAO - Traversal entry points of short rays: the smallest BVH8 subtree holding everything within reach of a ray origin
+#pragma once
+
+#include "BVH8.h"
+#include "TaskScheduler.h"
+
+#define BVH8_ENTRY_GRID_MAX_CELLS (1 << 21)
+#define BVH8_ENTRY_MAX_REACH (1.0f / 48.0f)		//< Reach, as a fraction of the tree's widest extent, up to which per-origin entries pay off
+
+/**
+* Uniform grid over the bounds of a BVH8, every cell holds the entry node of rays starting in it that reach no farther than radius.
+* Cells are as large as radius, or larger when the grid would exceed its cells budget.
+*/
+struct BVH8EntryGrid
+{
+	XMFLOAT3 origin;				//< Minimum corner of the grid
+	float cellSize;
+	float radius;					//< Largest reach (tMax * |direction|) of rays the entries hold for
+	int resolution[3];
+	vector<uint32_t> entries;		//< Entry node of every cell, x varies fastest
+
+	BVH8EntryGrid() {
+		origin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		cellSize = 0.0f;
+		radius = 0.0f;
+		resolution[0] = resolution[1] = resolution[2] = 0;
+	}
+
+	size_t GetMemorySize() const { return entries.size() * sizeof(uint32_t); }
+};
+
+namespace CPURT
+{
+	/**
+	* Root of the smallest subtree such that no node outside of it overlaps bounds, found by descending while a single inner child
+	* overlaps them. A ray that stays within bounds finds the same hits when traversal starts there as when it starts at the root.
+	*/
+	uint32_t Find_BVH8_Entry(const BVH8 &bvh, const AABB &bounds);
+
+	// Entry of rays starting at origin that reach no farther than radius
+	uint32_t Find_BVH8_Entry(const BVH8 &bvh, const XMFLOAT3 &origin, float radius);
+
+	// Whether per-origin entries are worth their lookup for rays reaching no farther than radius, longer rays mostly start at the root
+	bool Use_BVH8_Entry(const BVH8 &bvh, float radius);
+
+	void Build_BVH8_Entry_Grid(TaskScheduler &scheduler, const BVH8 &bvh, float radius, BVH8EntryGrid &grid, size_t maxCells = BVH8_ENTRY_GRID_MAX_CELLS);
+
+	// Entry node of the ray's origin cell, the root for rays starting outside the grid or reaching farther than its radius
+	uint32_t Get_BVH8_Entry(const BVH8EntryGrid &grid, const Ray &ray);
+
+	// Closest and any hit traversal starting at the entry node of the ray, with the widest SIMD kernel supported
+	bool Intersect(const BVH8 &bvh, const BVH8EntryGrid &grid, const Ray &ray, Hit &hit);
+	bool Occluded(const BVH8 &bvh, const BVH8EntryGrid &grid, const Ray &ray, Hit &hit);
+}
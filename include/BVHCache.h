@@ -0,0 +1,89 @@
+// RTAO - On-disk cache of 8-wide BVHs
+#pragma once
+
+#include "BVH8.h"
+
+#define BVH_CACHE_MAGIC 0x48564252		//< "RBVH"
+#define BVH_CACHE_VERSION 2				//< Bump on any change of the header, BVH8Node or Triangle layout
+#define BVH_CACHE_ALIGNMENT 64			//< Sections start on cache line boundaries, so mapped nodes are as aligned as allocated ones
+#define BVH_CACHE_HASH_SEED 0xcbf29ce484222325ull	//< FNV-1a offset basis, every cache key starts from it
+
+// Array stored in the file, the offset is relative to the start of the file so the file can be mapped anywhere
+struct BVHCacheSection
+{
+	uint64_t offset;
+	uint64_t count;
+};
+
+// Nodes reference children and triangles by index, all sections are stored exactly as they are in memory
+struct BVHCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t geometryHash;				//< Get_Geometry_Hash of the model the BVH was built from
+	uint64_t buildHash;					//< Build settings that change the tree (leaf size, bins, spatial splits)
+	uint32_t nodeSize;					//< sizeof(BVH8Node) and sizeof(Triangle) of the writer
+	uint32_t triangleSize;
+	uint64_t fileSize;
+	BVHCacheSection nodes;
+	BVHCacheSection triangles;
+	BVHCacheSection primitiveIndices;
+	uint64_t vertexAOHash;				//< Bake settings of the per-vertex AO, the section is empty when none was baked
+	BVHCacheSection vertexAO;
+};
+
+// Extend a cache key by a 32-bit word (FNV-1a over words). Keys of the BVH, of the per-vertex AO and of lightmap checkpoints
+// are all hashed with it
+static inline uint64_t HashWord(uint64_t hash, uint32_t word)
+{
+	return (hash ^ word) * 0x100000001b3ull;
+}
+
+struct BVHCacheStats
+{
+	bool loaded;						//< False when the cache was missing or stale and the BVH was rebuilt
+	double hashTime;					//< Hashing the model geometry, in milliseconds
+	double loadTime;					//< Mapping, validating and copying the file (also spent on a failed attempt)
+	double buildTime;					//< Build_BVH and Build_BVH8 on a cache miss
+	double saveTime;
+	size_t fileSize;					//< Size of the cache file loaded or written, with all of its sections
+
+	BVHCacheStats() {
+		loaded = false;
+		hashTime = 0.0;
+		loadTime = 0.0;
+		buildTime = 0.0;
+		saveTime = 0.0;
+		fileSize = 0;
+	}
+};
+
+namespace CPURT
+{
+	// 64-bit hash of vertex positions and indices, the cache key of BVHs built from the model
+	uint64_t Get_Geometry_Hash(const Model &model);
+
+	/**
+	* Write the BVH built from geometry with the given hash and build settings, throws when the file can't be written.
+	* Per-vertex AO of the same geometry (in Model vertex order) is stored along when given, with the hash of its bake settings.
+	* Returns the size of the file written.
+	*/
+	uint64_t Save_BVH_Cache(const string &path, uint64_t geometryHash, const BVHBuildInfo &info, const BVH8 &bvh,
+		const vector<float>* vertexAO = nullptr, uint64_t vertexAOHash = 0);
+
+	/**
+	* Map the file (one mapping, no pointer fixups) and copy its sections into the BVH. Returns false when the file is missing,
+	* of another version or layout, truncated, or was built from other geometry or with other build settings. The size of the
+	* loaded file, with sections the BVH doesn't use, is returned in fileSize when given.
+	*/
+	bool Load_BVH_Cache(const string &path, uint64_t geometryHash, const BVHBuildInfo &info, BVH8 &bvh, uint64_t* fileSize = nullptr);
+
+	// Per-vertex AO from the cache file, false when there is none for the geometry or it was baked with other settings
+	bool Load_Vertex_AO_Cache(const string &path, uint64_t geometryHash, uint64_t vertexAOHash, vector<float> &vertexAO);
+
+	/**
+	* Load the BVH of the model from the cache file, or build it and write the file when the cache can't be used.
+	*/
+	void Build_BVH8_Cached(TaskScheduler &scheduler, const string &path, const Model &model, const BVHBuildInfo &info, BVH8 &bvh,
+		BVHCacheStats* stats = nullptr);
+}
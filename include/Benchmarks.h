@@ -0,0 +1,34 @@
+// RTAO - Headless benchmarks
+#pragma once
+
+#include "Structures.h"
+
+namespace Benchmarks
+{
+	int Run(const ConfigInfo &config);
+
+	int Run_Sample_Sets(const ConfigInfo &config);
+	int Run_BVH_Build(const ConfigInfo &config);
+	int Run_BVH8_Traversal(const ConfigInfo &config);
+	int Run_Occlusion_Queries(const ConfigInfo &config);
+	int Run_Ray_Streams(const ConfigInfo &config);
+	int Run_AO_Pass(const ConfigInfo &config);
+	int Run_Primary_Pass(const ConfigInfo &config);
+	int Run_Rasterizer(const ConfigInfo &config);
+	int Run_Scheduler_Scaling(const ConfigInfo &config);
+	int Run_BVH_Refit(const ConfigInfo &config);
+	int Run_Instancing(const ConfigInfo &config);
+	int Run_Spatial_Splits(const ConfigInfo &config);
+	int Run_BVH_Cache(const ConfigInfo &config);
+	int Run_Quantized_BVH8(const ConfigInfo &config);
+	int Run_Triangle_Packets(const ConfigInfo &config);
+	int Run_Linear_BVH(const ConfigInfo &config);
+	int Run_Node_Layouts(const ConfigInfo &config);
+	int Run_Short_Rays(const ConfigInfo &config);
+	int Run_Hash_Grid(const ConfigInfo &config);
+	int Run_Interleaved_Traversal(const ConfigInfo &config);
+	int Run_NUMA_Scaling(const ConfigInfo &config);
+	int Run_Vertex_AO_Bake(const ConfigInfo &config);
+	int Run_Lightmap_AO_Bake(const ConfigInfo &config);
+	int Run_Progressive_AO_Bake(const ConfigInfo &config);
+}
@@ -0,0 +1,17 @@
+// RTAO - View constants and primary rays of the CPU passes
+#pragma once
+
+#include "RayTracing.h"
+
+namespace CPURT
+{
+	// Fill the ViewCB of a frame as Update_View_CB does. previousViewProjection holds the view-projection of the previous
+	// frame on input (motion vectors) and receives the one of this frame.
+	void Setup_View_CB(const XMFLOAT3 &eye, const XMFLOAT3 &focus, float fov, int width, int height, XMMATRIX &previousViewProjection, ViewCB &view);
+
+	// Right, up and forward axes of the camera (view[0], view[1] and view[2] in the shaders)
+	void Get_View_Axes(const ViewCB &view, XMFLOAT3 &right, XMFLOAT3 &up, XMFLOAT3 &forward);
+
+	// Primary ray of a pixel as RayGen sets it up (and RTAORayGen reconstructs it)
+	Ray Get_Primary_Ray(const ViewCB &view, int x, int y);
+}
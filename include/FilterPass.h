@@ -0,0 +1,32 @@
+// RTAO - CPU implementation of the low-pass filter passes
+#pragma once
+
+#include "RayTracing.h"
+#include "Image.h"
+#include "TaskScheduler.h"
+
+// Pixels are filtered in square tiles, tiles are distributed over threads
+#define FILTER_PASS_TILE_SIZE 32
+
+struct FilterPassStats
+{
+	double time;					//< Wall clock time of both passes in ms
+	double timeX;					//< Horizontal (temporal) pass only
+
+	FilterPassStats() {
+		time = 0.0;
+		timeX = 0.0;
+	}
+};
+
+namespace CPURT
+{
+	/**
+	* Same outputs as lowPassFilterXPassPS followed by lowPassFilterYPassPS: the horizontal pass averages the 4 AO slots
+	* written by RTAORayGen into temp, the vertical pass filters temp and mixes it with color according to outputMode.
+	* Taps fall on texel centers, so the linear clamp sampler of the shaders reduces to loads with clamped coordinates.
+	* texelSize of the constants is not used, images carry their own size.
+	*/
+	void Render_Low_Pass_Filter(TaskScheduler &scheduler, const LowPassFilerCB &filter, const Image &normalAndDepths, const Image &ao,
+		const Image &color, Image &temp, Image &output, FilterPassStats* stats = nullptr);
+}
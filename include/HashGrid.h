@@ -0,0 +1,60 @@
+// RTAO - Sparse uniform grid of triangle references, hashed by cell, for radius bounded occlusion queries
+#pragma once
+
+#include "BVH8.h"
+#include "TaskScheduler.h"
+
+#define HASH_GRID_EMPTY_KEY 0xFFFFFFFFFFFFFFFFull
+#define HASH_GRID_MAX_CELL 0xFFFFF				//< Cell coordinates are biased into 21 bits, so they must stay within +-2^20
+
+struct HashGridCell
+{
+	uint64_t key;					//< Packed cell coordinates, HASH_GRID_EMPTY_KEY for an empty slot
+	uint32_t first;					//< First reference of the cell
+	uint32_t count;
+};
+
+/**
+* Only cells overlapped by triangles are stored, in an open addressing table (linear probing, at most half full).
+* References of a cell are ordered by triangle index, so any hit queries return the same triangle on every build.
+*/
+struct HashGrid
+{
+	float cellSize;
+	int cellsMin[3];					//< Range of cells that may be occupied
+	int cellsMax[3];
+	vector<HashGridCell> cells;			//< Power of two sized table
+	vector<uint32_t> references;		//< Triangle indices of all cells
+	vector<Triangle> triangles;			//< Triangles in Model order
+	size_t occupiedCells;
+	double buildTime;					//< ms
+
+	HashGrid() {
+		cellSize = 0.0f;
+		cellsMin[0] = cellsMin[1] = cellsMin[2] = 0;
+		cellsMax[0] = cellsMax[1] = cellsMax[2] = 0;
+		occupiedCells = 0;
+		buildTime = 0.0;
+	}
+
+	size_t GetMemorySize() const {
+		return cells.size() * sizeof(HashGridCell) + references.size() * sizeof(uint32_t) + triangles.size() * sizeof(Triangle);
+	}
+};
+
+namespace CPURT
+{
+	/**
+	* Reference every triangle from the cells its bounds overlap (those it spans in more than one axis are tested against the
+	* triangle's plane). Cell size is meant to be tied to the AO radius, throws when the model spans too many cells of that size.
+	*/
+	void Build_Hash_Grid(TaskScheduler &scheduler, const Model &model, float cellSize, HashGrid &grid);
+
+	// Closest and any hit traversal, cells along the ray are walked by 3D-DDA from tMin up to the closest hit or tMax
+	bool Intersect(const HashGrid &grid, const Ray &ray, Hit &hit);
+	bool Occluded(const HashGrid &grid, const Ray &ray, Hit &hit);
+
+	// Same batch occlusion queries as the BVH8 ones
+	void Occluded(const HashGrid &grid, const Ray* rays, size_t count, uint32_t* occludedBits);
+	void Occlusion_Distance(const HashGrid &grid, const Ray* rays, size_t count, float* t);
+}
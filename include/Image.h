@@ -0,0 +1,56 @@
+// RTAO - Float images of the CPU passes
+#pragma once
+
+#include "Common.h"
+
+// RGBA32F image stored row by row, CPU counterpart of the render targets and history buffers of the GPU passes
+struct Image
+{
+	int width;
+	int height;
+	vector<XMFLOAT4> texels;
+
+	Image() {
+		width = 0;
+		height = 0;
+	}
+
+	void Resize(int w, int h, const XMFLOAT4 &value = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f)) {
+		width = w;
+		height = h;
+		texels.assign(size_t(w) * h, value);
+	}
+
+	XMFLOAT4 &At(int x, int y) { return texels[size_t(y) * width + x]; }
+	const XMFLOAT4 &Load(int x, int y) const { return texels[size_t(y) * width + x]; }
+
+	// Bilinear filtering with clamped addressing, as SampleLevel with linearClampSampler does
+	XMFLOAT4 SampleLinearClamp(const XMFLOAT2 &uv) const {
+		float u = uv.x * width - 0.5f;
+		float v = uv.y * height - 0.5f;
+		float fu = floorf(u);
+		float fv = floorf(v);
+		float wu = u - fu;
+		float wv = v - fv;
+
+		int x0 = min(max((int)fu, 0), width - 1);
+		int y0 = min(max((int)fv, 0), height - 1);
+		int x1 = min(max((int)fu + 1, 0), width - 1);
+		int y1 = min(max((int)fv + 1, 0), height - 1);
+
+		const XMFLOAT4 &a = Load(x0, y0);
+		const XMFLOAT4 &b = Load(x1, y0);
+		const XMFLOAT4 &c = Load(x0, y1);
+		const XMFLOAT4 &d = Load(x1, y1);
+
+		float wa = (1.0f - wu) * (1.0f - wv);
+		float wb = wu * (1.0f - wv);
+		float wc = (1.0f - wu) * wv;
+		float wd = wu * wv;
+
+		return XMFLOAT4(a.x * wa + b.x * wb + c.x * wc + d.x * wd,
+			a.y * wa + b.y * wb + c.y * wc + d.y * wd,
+			a.z * wa + b.z * wb + c.z * wc + d.z * wd,
+			a.w * wa + b.w * wb + c.w * wc + d.w * wd);
+	}
+};
@@ -0,0 +1,37 @@
+// RTAO - CPU implementation of the primary visibility pass
+#pragma once
+
+#include "BVH8.h"
+#include "Image.h"
+#include "TaskScheduler.h"
+
+// Pixels are traced in square tiles, tiles are distributed over threads
+#define PRIMARY_PASS_TILE_SIZE 16
+
+struct PrimaryPassStats
+{
+	double time;					//< Wall clock time of the pass in ms
+	uint64_t raysCount;
+	uint64_t hitsCount;
+
+	PrimaryPassStats() {
+		time = 0.0;
+		raysCount = 0;
+		hitsCount = 0;
+	}
+};
+
+namespace CPURT
+{
+	/**
+	* Same outputs as RayGen with ClosestHit and Miss: output receives the point sampled albedo (DXROutput), normalAndDepths
+	* the face normal and hit T (depthNormalsOutput). Albedo is an RGBA8 texture as loaded by Utils::LoadTexture, read at
+	* floor(uv * textureResolution) - texels outside of it are black, like out of bounds loads on the GPU.
+	*/
+	void Render_Primary(TaskScheduler &scheduler, const BVH8 &bvh, const Model &model, const TextureInfo &albedo, const MaterialCB &material,
+		const ViewCB &view, Image &output, Image &normalAndDepths, PrimaryPassStats* stats = nullptr);
+
+	// Same pass, tiles read the BVH8 and mesh copies of the node their thread runs on
+	void Render_Primary(TaskScheduler &scheduler, const NumaReplicas<BVH8> &bvh, const NumaReplicas<Model> &model, const TextureInfo &albedo,
+		const MaterialCB &material, const ViewCB &view, Image &output, Image &normalAndDepths, PrimaryPassStats* stats = nullptr);
+}
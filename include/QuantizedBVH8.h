@@ -0,0 +1,78 @@
+// RTAO - 8-wide BVH with 8-bit quantized child bounds
+#pragma once
+
+#include "BVH8.h"
+
+#define QBVH8_INNER_CHILD 0x80			//< Meta of an inner child: flag | rank among the node's inner children
+#define QBVH8_LEAF_OFFSET_MASK 0x1F		//< Meta of a leaf: triangle count in the top 3 bits, offset from triangleBase in the low 5 bits
+#define QBVH8_LEAF_COUNT_SHIFT 5
+#define QBVH8_MAX_LEAF_SIZE 4			//< Leaves of 4 triangles keep offsets of all 8 children within 5 bits
+
+// 80 bytes against 256 of BVH8Node. Child bounds are origin + q * 2^exponent, rounded outwards so they always contain the child.
+struct QuantizedBVH8Node
+{
+	XMFLOAT3 origin;					//< Minimum corner of the node bounds, the frame child bounds are quantized in
+	int8_t exponents[3];				//< Per axis scale of the quantized bounds
+	uint8_t innerMask;					//< Bit per child slot that holds an inner node
+	uint32_t childBase;					//< Index of the first inner child, inner children of a node are stored consecutively
+	uint32_t triangleBase;				//< Index of the first triangle, leaves of a node are stored consecutively
+	uint8_t meta[BVH8_WIDTH];			//< Inner child rank or leaf offset and count, 0 for empty slots
+	uint8_t quantizedMin[3][BVH8_WIDTH];	//< Empty slots have inverted bounds (min 255, max 0)
+	uint8_t quantizedMax[3][BVH8_WIDTH];
+};
+
+struct QuantizedBVH8
+{
+	vector<QuantizedBVH8Node> nodes;	//< Root is the first node, children follow their parents breadth first
+	vector<Triangle> triangles;			//< Triangles in leaf order (regrouped by node, so not the order of the BVH8)
+	vector<uint32_t> primitiveIndices;	//< Index of each triangle in the Model
+
+	size_t GetMemorySize() const {
+		return nodes.size() * sizeof(QuantizedBVH8Node) + triangles.size() * (sizeof(Triangle) + sizeof(uint32_t));
+	}
+};
+
+namespace CPURT
+{
+	/**
+	* Quantize the collapsed tree. Leaves may have at most QBVH8_MAX_LEAF_SIZE triangles (BVHBuildInfo::leafSize), throws otherwise.
+	*/
+	void Build_Quantized_BVH8(const BVH8 &bvh, QuantizedBVH8 &quantized);
+
+	// Closest hit and any hit traversal, same results as the BVH8 the tree was built from (quantized bounds are conservative)
+	bool Intersect(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level = SIMD_LEVELS_COUNT);
+	bool Occluded(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level = SIMD_LEVELS_COUNT);
+
+	// Kernels, AVX2 widens 8-bit bounds to floats in registers - call only when supported (AVX-512 CPUs use it too)
+	bool Intersect_QBVH8_Scalar(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit);
+	bool Intersect_QBVH8_AVX2(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit);
+	bool Occluded_QBVH8_Scalar(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit);
+	bool Occluded_QBVH8_AVX2(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit);
+}
+
+//--------------------------------------------------------------------------------------
+// Traversal Helpers
+//--------------------------------------------------------------------------------------
+
+/**
+* Stack entry of the hit child: inner children index nodes, leaves carry their first triangle and count as BVH8 entries do.
+*/
+static inline BVH8StackEntry DecodeQuantizedChild(const QuantizedBVH8Node &node, int slot, float t)
+{
+	uint8_t meta = node.meta[slot];
+
+	if (node.innerMask & (1 << slot)) {
+		return { node.childBase + (meta & ~QBVH8_INNER_CHILD), 0, t };
+	}
+
+	return { BVH8_LEAF_FLAG | (node.triangleBase + (meta & QBVH8_LEAF_OFFSET_MASK)), uint32_t(meta >> QBVH8_LEAF_COUNT_SHIFT), t };
+}
+
+// Scale of quantized coordinates along an axis (2^exponent assembled from the float bits, exponents stay within the normal range)
+static inline float QuantizedScale(int8_t exponent)
+{
+	uint32_t bits = uint32_t(exponent + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return scale;
+}
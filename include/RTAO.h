@@ -4,35 +4,10 @@
 #include "Graphics.h"
 #include "Profiler.h"
 #include "Gui.h"
+#include "SampleSets.h"
 
 #include <chrono>
 
-struct LowPassFilerCB
-{
-	XMMATRIX normalMatrix;
-	XMFLOAT2 texelSize;
-	int outputMode;
-
-	LowPassFilerCB() {
-		outputMode = 0;
-	}
-}; 
-
-struct RtaoCB
-{
-	float aoRadius;
-	int frameNumber;
-	int samplesCount;
-	int sampleStartIndex;
-
-	RtaoCB() {
-		aoRadius = 1.0f;
-		samplesCount = 4;
-		frameNumber = 0;
-		sampleStartIndex = 0;
-	}
-};
-
 class RTAO {
 public:
 
@@ -49,6 +24,7 @@ private:
 	// DX12 resources initialization
 	void createConstantBuffers(D3D12Global &d3d);
 	void createRTAOBuffers(D3D12Global &d3d);
+	void uploadAOSamples(D3D12Global &d3d);
 
 	void createRTAORayGenProgram(D3D12Global &d3d, D3D12ShaderCompilerInfo &shaderCompiler);
 	void createRTAOMissProgram(D3D12Global &d3d, D3D12ShaderCompilerInfo &shaderCompiler);
@@ -119,6 +95,11 @@ private:
 	ID3D12Resource* AOSamples;
 	ID3D12Resource* AOSamplesUploadHeap;
 
+	// Interleaved sampling configuration, AO samples table is rebuilt whenever it changes
+	SampleSetInfo sampleSetInfo;
+	SampleSetInfo uploadedSampleSetInfo;
+	int aoFrameIndex;
+
 	ID3D12Resource* rtaoCB;
 	RtaoCB rtaoCBData;
 	UINT8* rtaoCBStart;
@@ -0,0 +1,92 @@
+// RTAO - Tile-based software rasterizer of the normal and depth buffer
+#pragma once
+
+#include "BVH8.h"
+#include "Image.h"
+#include "TaskScheduler.h"
+
+#define RASTER_TILE_SIZE 32				//< Screen tiles triangles are binned into, rasterized in parallel
+#define RASTER_BLOCK_SIZE 8				//< Tiles are rasterized in blocks, rejected or accepted as a whole when possible
+#define RASTER_CHUNK_SIZE 8192			//< Triangles set up and binned by a single task
+#define RASTER_NEAR_PLANE 0.1f			//< Matches TMin of primary rays (as view space depth)
+
+// Vertex in screen space, position snapped to 1/16 of a pixel (valid only in front of the near plane)
+struct RasterVertex
+{
+	float x;
+	float y;
+	float invDepth;						//< Reciprocal of view space depth
+};
+
+// Triangle after setup, in screen space of pixel centers at (x + 0.5, y + 0.5) with vertices snapped to 1/16 of a pixel.
+// Edge functions E(x, y) = A x + B y + C are positive inside, shared edges get the same coefficients with opposite
+// signs so exactly one of the triangles owns pixels on the edge.
+struct RasterTriangle
+{
+	float edgeA[3];
+	float edgeB[3];
+	double edgeC[3];					//< Kept in double, so edge values at block origins are exact
+	float invDepthA;					//< Reciprocal of view space depth is affine in screen space
+	float invDepthB;
+	double invDepthC;
+	int boundsMin[2];					//< Pixel bounds clamped to the screen
+	int boundsMax[2];
+	uint32_t ownedEdges;				//< Bit per edge, pixels exactly on an owned edge are covered
+	uint32_t primitiveIndex;
+};
+
+// Triangle evaluated at the first pixel of an 8x8 block, input of the block kernels
+struct RasterBlock
+{
+	float edges[3];
+	float edgeA[3];
+	float edgeB[3];
+	uint32_t ownedEdges;
+	float invDepth;
+	float invDepthA;
+	float invDepthB;
+	uint32_t primitiveIndex;
+	int rowsBegin;						//< Rows of the block within the triangle's bounds
+	int rowsEnd;
+	bool covered;						//< Block is fully inside the triangle, edges need no testing
+};
+
+struct RasterizerStats
+{
+	double time;						//< Wall clock time of the pass in ms
+	uint64_t trianglesCount;			//< Triangles after culling and near plane clipping
+	uint64_t tileReferences;			//< Triangles binned into tiles (after tile rejection)
+	uint64_t blocksCount;				//< Blocks rasterized, including fully covered ones
+	uint64_t coveredBlocksCount;
+
+	RasterizerStats() {
+		time = 0.0;
+		trianglesCount = 0;
+		tileReferences = 0;
+		blocksCount = 0;
+		coveredBlocksCount = 0;
+	}
+};
+
+// Buffers reused from frame to frame
+struct RasterizerContext
+{
+	vector<XMFLOAT3> viewPositions;
+	vector<RasterVertex> vertices;
+	vector<vector<RasterTriangle>> triangles;	//< Per chunk
+	vector<vector<uint32_t>> bins;				//< Per chunk and tile, indices into triangles of the chunk
+};
+
+namespace CPURT
+{
+	/**
+	* Rasterize the model into normalAndDepths with the layout RayGen writes: face normal and primary ray T (distance
+	* from the eye, not view space depth), -1 where nothing is visible. No face culling, as with RAY_FLAG_NONE.
+	*/
+	void Rasterize_Normal_And_Depths(TaskScheduler &scheduler, const Model &model, const ViewCB &view, RasterizerContext &context,
+		Image &normalAndDepths, RasterizerStats* stats = nullptr, SIMDLevel level = SIMD_LEVELS_COUNT);
+
+	// Block kernels depth test and write one 8x8 block of a tile's reciprocal depths and primitive indices
+	void Rasterize_Block_Scalar(const RasterBlock &block, float* invDepths, uint32_t* primitives);
+	void Rasterize_Block_AVX2(const RasterBlock &block, float* invDepths, uint32_t* primitives);
+}
@@ -0,0 +1,89 @@
+// RTAO - Ray stream traversal of coherent AO ray batches
+#pragma once
+
+#include "BVH8.h"
+
+#define RAY_STREAM_MAX_SIZE 256
+
+enum RayStreamBinning
+{
+	RAY_STREAM_BINNING_NONE = 0,			//< Rays are streamed in tile order
+	RAY_STREAM_BINNING_OCTANT,				//< Rays are grouped by direction octant
+	RAY_STREAM_BINNING_OCTANT_AND_CELL,		//< Rays are grouped by direction octant and origin cell
+};
+
+struct RayStreamInfo
+{
+	int tileSize;					//< Screen tile rays are gathered from, in pixels
+	float originCellSize;			//< Size of origin binning cells in world units (AO radius is a good fit)
+	int maxStreamSize;				//< Larger bins are split into several streams
+	RayStreamBinning binning;
+
+	RayStreamInfo() {
+		tileSize = 16;
+		originCellSize = 1.0f;
+		maxStreamSize = RAY_STREAM_MAX_SIZE;
+		binning = RAY_STREAM_BINNING_OCTANT_AND_CELL;
+	}
+};
+
+struct RayStreamStats
+{
+	uint64_t raysCount;
+	uint64_t streamsCount;
+	uint64_t nodeVisits;			//< Inner node and leaf visits of whole streams
+	uint64_t activeRays;			//< Active rays summed over all stream node visits
+
+	RayStreamStats() {
+		raysCount = 0;
+		streamsCount = 0;
+		nodeVisits = 0;
+		activeRays = 0;
+	}
+
+	void Add(const RayStreamStats &stats) {
+		raysCount += stats.raysCount;
+		streamsCount += stats.streamsCount;
+		nodeVisits += stats.nodeVisits;
+		activeRays += stats.activeRays;
+	}
+};
+
+// Rays of a stream in SoA form with precomputed slab test terms. Rays may have any directions (binning only improves coherence).
+struct RayStreamRays
+{
+	float originScaled[3][RAY_STREAM_MAX_SIZE];		//< origin * inverse direction
+	float inverseDirection[3][RAY_STREAM_MAX_SIZE];
+	float tMin[RAY_STREAM_MAX_SIZE];
+	float tMax[RAY_STREAM_MAX_SIZE];				//< Shortened by hits
+};
+
+// Per-child lists of stream rays that intersected a child, filled by the node kernels
+struct RayStreamChildren
+{
+	uint16_t rays[BVH8_WIDTH][RAY_STREAM_MAX_SIZE];
+	int counts[BVH8_WIDTH];
+	float distances[BVH8_WIDTH];					//< Nearest entry distance of the child over its rays
+};
+
+// Per-thread scratch memory of stream traversal
+struct RayStreamContext
+{
+	RayStreamRays rays;
+	RayStreamChildren children;
+	vector<uint16_t> activeLists;					//< Stack of active ray lists of nodes waiting on the traversal stack
+	uint8_t terminated[RAY_STREAM_MAX_SIZE];
+};
+
+namespace CPURT
+{
+	// Sort rays of a tile into streams: order receives ray indices, streams receive [begin, end) ranges of order
+	void Bin_Ray_Streams(const RayStreamInfo &info, const Ray* rays, size_t count, vector<uint32_t> &order, vector<pair<uint32_t, uint32_t>> &streams);
+
+	// Trace a stream of rays, t receives hit distance of each ray or its tMax when missed
+	void Trace_Ray_Stream(RayStreamContext &context, const BVH8 &bvh, const Ray* rays, const uint32_t* indices, size_t count, bool anyHit, float* t, RayStreamStats &stats, SIMDLevel level = SIMD_LEVELS_COUNT);
+
+	// Node kernels test all active rays against the children of a node
+	void Test_Stream_Node_Scalar(const BVH8Node &node, const RayStreamRays &rays, const uint16_t* active, int activeCount, RayStreamChildren &children);
+	void Test_Stream_Node_AVX2(const BVH8Node &node, const RayStreamRays &rays, const uint16_t* active, int activeCount, RayStreamChildren &children);
+}
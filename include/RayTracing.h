@@ -0,0 +1,208 @@
+// RTAO - Common structures and helpers for CPU ray tracing
+#pragma once
+
+#include "Structures.h"
+
+#include <cfloat>
+
+//--------------------------------------------------------------------------------------
+// Vector Helpers
+//--------------------------------------------------------------------------------------
+
+static inline XMFLOAT3 Add(const XMFLOAT3 &a, const XMFLOAT3 &b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline XMFLOAT3 Sub(const XMFLOAT3 &a, const XMFLOAT3 &b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline XMFLOAT3 Mul(const XMFLOAT3 &a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+static inline XMFLOAT3 Min3(const XMFLOAT3 &a, const XMFLOAT3 &b) { return XMFLOAT3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z)); }
+static inline XMFLOAT3 Max3(const XMFLOAT3 &a, const XMFLOAT3 &b) { return XMFLOAT3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z)); }
+static inline float Dot(const XMFLOAT3 &a, const XMFLOAT3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline XMFLOAT3 Cross(const XMFLOAT3 &a, const XMFLOAT3 &b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+static inline float Length(const XMFLOAT3 &a) { return sqrtf(Dot(a, a)); }
+static inline XMFLOAT3 Normalize(const XMFLOAT3 &a) { return Mul(a, 1.0f / Length(a)); }
+static inline float Component(const XMFLOAT3 &a, int axis) { return axis == 0 ? a.x : (axis == 1 ? a.y : a.z); }
+
+//--------------------------------------------------------------------------------------
+// Structures
+//--------------------------------------------------------------------------------------
+
+struct AABB
+{
+	XMFLOAT3 min;
+	XMFLOAT3 max;
+
+	AABB() {
+		min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	}
+
+	void Grow(const XMFLOAT3 &p) { min = Min3(min, p); max = Max3(max, p); }
+	void Grow(const AABB &b) { min = Min3(min, b.min); max = Max3(max, b.max); }
+
+	bool IsEmpty() const { return min.x > max.x; }
+	XMFLOAT3 Center() const { return Mul(Add(min, max), 0.5f); }
+	XMFLOAT3 Extent() const { return Sub(max, min); }
+
+	float SurfaceArea() const {
+		if (IsEmpty()) return 0.0f;
+		XMFLOAT3 e = Extent();
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+};
+
+// Same ray description as DXR RayDesc
+struct Ray
+{
+	XMFLOAT3 origin;
+	float tMin;
+	XMFLOAT3 direction;
+	float tMax;
+
+	Ray() {
+		origin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		tMin = 0.0f;
+		tMax = FLT_MAX;
+	}
+
+	Ray(const XMFLOAT3 &inOrigin, const XMFLOAT3 &inDirection, float inTMin, float inTMax) :
+		origin(inOrigin), tMin(inTMin), direction(inDirection), tMax(inTMax) {}
+};
+
+struct Hit
+{
+	float t;
+	uint32_t primitiveIndex;	//< Index of the triangle in the Model (DXR PrimitiveIndex())
+	XMFLOAT2 barycentrics;		//< Weights of second and third vertex (DXR attrib.uv)
+	uint32_t instanceIndex;		//< Instance of a two-level structure (DXR InstanceIndex()), 0 for a single mesh
+
+	Hit() {
+		t = FLT_MAX;
+		primitiveIndex = UINT32_MAX;
+		barycentrics = XMFLOAT2(0.0f, 0.0f);
+		instanceIndex = 0;
+	}
+
+	bool IsHit() const { return primitiveIndex != UINT32_MAX; }
+};
+
+struct Triangle
+{
+	XMFLOAT3 v0;
+	XMFLOAT3 v1;
+	XMFLOAT3 v2;
+};
+
+//--------------------------------------------------------------------------------------
+// Intersection Helpers
+//--------------------------------------------------------------------------------------
+
+/**
+* Ray/triangle intersection (Moller-Trumbore), no face culling (matches DXR with RAY_FLAG_NONE).
+*/
+static inline bool IntersectTriangle(const Triangle &triangle, const XMFLOAT3 &origin, const XMFLOAT3 &direction, float tMin, float tMax, float &t, float &u, float &v)
+{
+	XMFLOAT3 e1 = Sub(triangle.v1, triangle.v0);
+	XMFLOAT3 e2 = Sub(triangle.v2, triangle.v0);
+	XMFLOAT3 p = Cross(direction, e2);
+	float determinant = Dot(e1, p);
+	if (fabsf(determinant) < 1e-12f) return false;
+
+	float invDeterminant = 1.0f / determinant;
+	XMFLOAT3 s = Sub(origin, triangle.v0);
+	u = Dot(s, p) * invDeterminant;
+	if (u < 0.0f || u > 1.0f) return false;
+
+	XMFLOAT3 q = Cross(s, e1);
+	v = Dot(direction, q) * invDeterminant;
+	if (v < 0.0f || u + v > 1.0f) return false;
+
+	t = Dot(e2, q) * invDeterminant;
+	return t >= tMin && t <= tMax;
+}
+
+// Ray space of the watertight test: kz is the dominant direction axis, the shear maps the direction onto it
+struct WatertightRay
+{
+	int kx, ky, kz;
+	float sx, sy, sz;
+};
+
+static inline WatertightRay GetWatertightRay(const XMFLOAT3 &direction)
+{
+	WatertightRay ray;
+	float ax = fabsf(direction.x), ay = fabsf(direction.y), az = fabsf(direction.z);
+	ray.kz = (ax > ay) ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+	ray.kx = (ray.kz + 1) % 3;
+	ray.ky = (ray.kx + 1) % 3;
+
+	// Keep the winding
+	if (Component(direction, ray.kz) < 0.0f) std::swap(ray.kx, ray.ky);
+
+	ray.sx = Component(direction, ray.kx) / Component(direction, ray.kz);
+	ray.sy = Component(direction, ray.ky) / Component(direction, ray.kz);
+	ray.sz = 1.0f / Component(direction, ray.kz);
+	return ray;
+}
+
+/**
+* Watertight ray/triangle intersection (Woop, Benthin and Wald 2013), no face culling. Vertices are sheared into ray space, so
+* triangles sharing an edge evaluate its edge function from the same values and rays can't slip between them. Edge functions
+* that come out exactly zero are recomputed in double precision.
+*/
+static inline bool IntersectTriangleWatertight(const Triangle &triangle, const XMFLOAT3 &origin, const WatertightRay &ray, float tMin, float tMax, float &t, float &u, float &v)
+{
+	XMFLOAT3 a = Sub(triangle.v0, origin);
+	XMFLOAT3 b = Sub(triangle.v1, origin);
+	XMFLOAT3 c = Sub(triangle.v2, origin);
+
+	float az = Component(a, ray.kz), bz = Component(b, ray.kz), cz = Component(c, ray.kz);
+	float ax = Component(a, ray.kx) - ray.sx * az, ay = Component(a, ray.ky) - ray.sy * az;
+	float bx = Component(b, ray.kx) - ray.sx * bz, by = Component(b, ray.ky) - ray.sy * bz;
+	float cx = Component(c, ray.kx) - ray.sx * cz, cy = Component(c, ray.ky) - ray.sy * cz;
+
+	float e0 = cx * by - cy * bx;
+	float e1 = ax * cy - ay * cx;
+	float e2 = bx * ay - by * ax;
+
+	if (e0 == 0.0f || e1 == 0.0f || e2 == 0.0f) {
+		e0 = float(double(cx) * double(by) - double(cy) * double(bx));
+		e1 = float(double(ax) * double(cy) - double(ay) * double(cx));
+		e2 = float(double(bx) * double(ay) - double(by) * double(ax));
+	}
+
+	if ((e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) && (e0 > 0.0f || e1 > 0.0f || e2 > 0.0f)) return false;
+
+	float determinant = e0 + e1 + e2;
+	if (determinant == 0.0f) return false;
+
+	float invDeterminant = 1.0f / determinant;
+	t = (e0 * az + e1 * bz + e2 * cz) * ray.sz * invDeterminant;
+	if (t < tMin || t > tMax) return false;
+
+	u = e1 * invDeterminant;
+	v = e2 * invDeterminant;
+	return true;
+}
+
+/**
+* Ray/box slab test, returns entry distance of the overlap with [tMin, tMax] or FLT_MAX when missed.
+*/
+static inline float IntersectAABB(const XMFLOAT3 &boundsMin, const XMFLOAT3 &boundsMax, const XMFLOAT3 &origin, const XMFLOAT3 &invDirection, float tMin, float tMax)
+{
+	float tx1 = (boundsMin.x - origin.x) * invDirection.x, tx2 = (boundsMax.x - origin.x) * invDirection.x;
+	float ty1 = (boundsMin.y - origin.y) * invDirection.y, ty2 = (boundsMax.y - origin.y) * invDirection.y;
+	float tz1 = (boundsMin.z - origin.z) * invDirection.z, tz2 = (boundsMax.z - origin.z) * invDirection.z;
+
+	float tNear = max(max(min(tx1, tx2), min(ty1, ty2)), max(min(tz1, tz2), tMin));
+	float tFar = min(min(max(tx1, tx2), max(ty1, ty2)), min(max(tz1, tz2), tMax));
+
+	return tNear <= tFar ? tNear : FLT_MAX;
+}
+
+static inline XMFLOAT3 SafeInverse(const XMFLOAT3 &d)
+{
+	const float tiny = 1e-20f;
+	return XMFLOAT3(
+		1.0f / (fabsf(d.x) > tiny ? d.x : copysignf(tiny, d.x)),
+		1.0f / (fabsf(d.y) > tiny ? d.y : copysignf(tiny, d.y)),
+		1.0f / (fabsf(d.z) > tiny ? d.z : copysignf(tiny, d.z)));
+}
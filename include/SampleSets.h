@@ -0,0 +1,50 @@
+// RTAO - Sample sets for interleaved AO sampling
+#pragma once
+
+#include "Common.h"
+
+// Largest supported interleaved sampling configuration (AO samples texture is allocated for it)
+#define AO_MAX_INTERLEAVE_SIZE 8
+#define AO_MAX_SAMPLES_COUNT 8
+#define AO_MAX_FRAMES_COUNT 4 //< AO history cache stores 4 previous frames (RGBA), longer sequences would not be averaged out
+#define AO_MAX_SAMPLES_TABLE_SIZE (AO_MAX_INTERLEAVE_SIZE * AO_MAX_INTERLEAVE_SIZE * AO_MAX_FRAMES_COUNT * AO_MAX_SAMPLES_COUNT)
+
+struct SampleSetInfo
+{
+	int interleaveWidth;
+	int interleaveHeight;
+	int framesCount;
+	int samplesCount;
+
+	SampleSetInfo() {
+		interleaveWidth = 3;
+		interleaveHeight = 3;
+		framesCount = 4;
+		samplesCount = 4;
+	}
+
+	bool operator==(const SampleSetInfo &other) const {
+		return interleaveWidth == other.interleaveWidth && interleaveHeight == other.interleaveHeight &&
+			framesCount == other.framesCount && samplesCount == other.samplesCount;
+	}
+
+	bool operator!=(const SampleSetInfo &other) const {
+		return !(*this == other);
+	}
+};
+
+namespace SampleSets
+{
+	int Get_Table_Size(const SampleSetInfo &info);
+
+	void Build_Table(const SampleSetInfo &info, vector<XMFLOAT3> &samples);
+
+	void Generate_R2(int count, vector<XMFLOAT3> &samples);
+	void Generate_Random(int count, uint32_t seed, vector<XMFLOAT3> &samples);
+	void Load_Sample_Set(const string &filepath, vector<XMFLOAT3> &samples);
+
+	// Cosine-weighted direction around +Z of a point in the unit square, the mapping used by all generated sets
+	XMFLOAT3 Square_To_Cosine_Hemisphere(float u, float v);
+
+	void Compute_Discrepancy(const vector<XMFLOAT3> &samples, vector<double> &discrepancy);
+}
@@ -55,11 +55,24 @@ struct ConfigInfo {
 	string		model;
 	HINSTANCE	instance;
 
+	// Headless benchmark mode (no window, no GPU)
+	string			benchmark;
+	string			benchmarkOutput;
+	vector<string>	sampleSets;
+	int				benchmarkTriangles;		//< Size of the generated model used when no -model is given
+	int				threadsCount;			//< Threads of CPU passes, 0 uses all hardware threads
+	float			aoRadius;				//< AO ray length of CPU benchmarks
+
 	ConfigInfo() {
 		width = 640;
 		height = 360;
 		model = "";
 		instance = NULL;
+		benchmark = "";
+		benchmarkOutput = "benchmark.csv";
+		benchmarkTriangles = 1000000;
+		threadsCount = 0;
+		aoRadius = 1.0f;
 	}
 };
 
@@ -130,6 +143,38 @@ struct ViewCB
 	}
 };
 
+struct RtaoCB
+{
+	float aoRadius;
+	int frameNumber; //< Frame index within the sampling sequence
+	int samplesCount;
+	int interleaveWidth;
+	int interleaveHeight;
+
+	RtaoCB() {
+		aoRadius = 1.0f;
+		samplesCount = 4;
+		frameNumber = 0;
+		interleaveWidth = 3;
+		interleaveHeight = 3;
+	}
+};
+
+struct LowPassFilerCB
+{
+	XMMATRIX normalMatrix;
+	XMFLOAT2 texelSize;
+	int outputMode;
+	int filterRadiusX; //< Filter footprint must cover whole interleave block, so the noise cancels out
+	int filterRadiusY;
+
+	LowPassFilerCB() {
+		outputMode = 0;
+		filterRadiusX = 2;
+		filterRadiusY = 2;
+	}
+};
+
 
 //--------------------------------------------------------------------------------------
 // Standard D3D12
@@ -0,0 +1,233 @@
+// RTAO - Task scheduler for CPU passes
+#pragma once
+
+#include "Common.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <chrono>
+#include <memory>
+
+struct TaskGroup
+{
+	std::atomic<int> pendingTasks;
+
+	TaskGroup() {
+		pendingTasks = 0;
+	}
+};
+
+// Work of one thread since the last ResetStats
+struct TaskThreadStats
+{
+	double busyTime;					//< Time spent executing tasks in ms
+	double utilization;					//< Busy time over wall clock time
+	uint64_t tasksCount;				//< Tasks executed, stolen ones included
+	uint64_t stealsCount;				//< Tasks taken from deques of other threads
+	uint64_t remoteStealsCount;			//< Steals from threads of another NUMA node
+	int node;							//< NUMA node the thread is pinned to (0 for all threads when the scheduler is not NUMA aware)
+
+	TaskThreadStats() {
+		busyTime = 0.0;
+		utilization = 0.0;
+		tasksCount = 0;
+		stealsCount = 0;
+		remoteStealsCount = 0;
+		node = 0;
+	}
+};
+
+// Processors of a NUMA node within their processor group
+struct NumaNodeInfo
+{
+	int node;							//< System node number
+	uint16_t group;
+	uint64_t processorsMask;
+	int processorsCount;
+
+	NumaNodeInfo() {
+		node = 0;
+		group = 0;
+		processorsMask = 0;
+		processorsCount = 0;
+	}
+};
+
+/**
+* Work-stealing scheduler. Every thread owns a Chase-Lev deque, tasks spawned on a thread go to the bottom of its deque
+* and are executed newest first, idle threads steal the oldest (largest) tasks from the top of a random victim's deque.
+* Tasks spawned from threads that do not belong to the scheduler go to a shared injection queue.
+*
+* When NUMA aware, threads are pinned to the processors of their node and every node has a queue of tasks that only its threads
+* execute. Thieves try victims of their own node before the others, so the work split from a node's tasks mostly stays on it.
+*/
+class TaskScheduler {
+public:
+
+	TaskScheduler();
+	~TaskScheduler();
+
+	/**
+	* numaNodesCount of 0 keeps threads unpinned on a single node. Otherwise the first numaNodesCount nodes of the system are
+	* used (fewer when the system or threadsCount has fewer), threads are split into equal blocks pinned to consecutive nodes
+	* and the calling thread is pinned to the first one until Destroy. threadsCount of 0 uses all processors of the nodes.
+	*/
+	void Init(int threadsCount = 0, int numaNodesCount = 0);
+
+	void Destroy();
+
+	int GetThreadsCount() const { return (int)workers.size() + 1; }
+	int GetNodesCount() const { return (int)nodes.size(); }
+
+	// Node of the calling thread, 0 for threads that do not belong to the scheduler
+	int GetCurrentNode() const;
+
+	// Nodes of the system with at least one processor, a single node holding all processors when NUMA information is unavailable
+	static void GetNumaNodes(vector<NumaNodeInfo> &numaNodes);
+
+	// Fork-join tasks, tasks may spawn more tasks into the same group. Waiting thread helps executing pending tasks.
+	void Run(TaskGroup &group, const function<void()> &task);
+	void Wait(TaskGroup &group);
+
+	// Task executed by a thread of the node, tasks it spawns may still be stolen by other nodes once their own work runs out
+	void RunOnNode(TaskGroup &group, int node, const function<void()> &task);
+
+	// Execute task(node) once on every node and wait for all of them
+	void RunOnEachNode(const function<void(int)> &task);
+
+	// Execute body(begin, end) over range [0, count) split into chunks of (at least) grainSize elements. Range is split
+	// recursively in halves, so idle threads steal big pieces of work and the owner keeps the adjacent ones.
+	void ParallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)> &body);
+
+	// Execute body(x0, y0, x1, y1) over square tiles of a width x height frame, [x0, x1) x [y0, y1) clamped to the frame.
+	// With several nodes, rows of tiles are split into a band per node (sized by its threads) queued on that node.
+	void ParallelForTiles(int width, int height, int tileSize, const function<void(int, int, int, int)> &body);
+
+	// Per-thread busy time, tasks and steals since the last reset (thread 0 is the thread that called Init)
+	void GetStats(vector<TaskThreadStats> &stats) const;
+	void ResetStats();
+
+private:
+
+	struct Task
+	{
+		function<void()> work;
+		TaskGroup* group;
+	};
+
+	// Chase-Lev deque of task pointers. Owner pushes and pops at the bottom, other threads steal from the top.
+	// Buffers are grown on demand, retired buffers are kept until the deque is destroyed as thieves may still read from them.
+	class TaskDeque {
+	public:
+		TaskDeque();
+		~TaskDeque();
+
+		void Push(Task* task);
+		Task* Pop();
+		Task* Steal();
+
+	private:
+		struct Buffer
+		{
+			int64_t capacity;						//< Power of two
+			std::atomic<Task*>* tasks;
+
+			Task* Get(int64_t i) const { return tasks[i & (capacity - 1)].load(std::memory_order_relaxed); }
+			void Put(int64_t i, Task* task) { tasks[i & (capacity - 1)].store(task, std::memory_order_relaxed); }
+		};
+
+		Buffer* createBuffer(int64_t capacity);
+
+		std::atomic<int64_t> top;
+		std::atomic<int64_t> bottom;
+		std::atomic<Buffer*> buffer;
+		vector<Buffer*> buffers;					//< Current and retired buffers, touched by the owner only
+	};
+
+	// State of one thread, allocated separately and padded so counters of different threads do not share cache lines
+	struct ThreadState
+	{
+		TaskDeque deque;
+		uint32_t random;							//< Victim selection
+		std::atomic<uint64_t> busyTime;				//< In ns
+		std::atomic<uint64_t> tasksCount;
+		std::atomic<uint64_t> stealsCount;
+		std::atomic<uint64_t> remoteStealsCount;
+		int node;
+		char padding[64];
+	};
+
+	// Threads and queued tasks of one NUMA node
+	struct NodeState
+	{
+		NumaNodeInfo info;
+		vector<int> threads;
+		std::deque<Task*> tasks;
+		std::atomic<int> tasksCount;				//< Checked before locking the queue
+		std::mutex mutex;
+		char padding[64];
+	};
+
+	void workerLoop(int threadIndex);
+	Task* findTask(int threadIndex);
+	Task* stealTask(int threadIndex, int node, uint32_t &random, int &victim);
+	void execute(Task* task, int threadIndex);
+	void measure(int threadIndex, const function<void()> &work);
+
+	vector<ThreadState*> threads;
+	vector<std::thread> workers;
+	vector<NodeState*> nodes;
+	bool pinned;
+	uint16_t initGroup;							//< Affinity of the thread that called Init, restored by Destroy
+	uint64_t initProcessorsMask;
+
+	// Tasks spawned from outside of the scheduler's threads
+	std::deque<Task*> injectedTasks;
+	std::atomic<int> injectedCount;				//< Checked before locking the queue
+	std::mutex injectedMutex;
+
+	// Idle workers sleep until there are queued tasks
+	std::atomic<int> queuedTasks;
+	std::atomic<int> sleepingCount;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+
+	std::atomic<bool> quit;
+	std::chrono::steady_clock::time_point statsStart;
+};
+
+/**
+* Copies of read-only data (BVH, mesh), one per node of a scheduler. Every copy is made by a thread of its node and pages are
+* placed on the node of the thread that first touches them, so threads read the copy in their local memory.
+*/
+template <typename T>
+class NumaReplicas {
+public:
+
+	NumaReplicas() {
+		scheduler = nullptr;
+	}
+
+	void Init(TaskScheduler &taskScheduler, const T &source) {
+		scheduler = &taskScheduler;
+		replicas.clear();
+		replicas.resize(scheduler->GetNodesCount());
+		scheduler->RunOnEachNode([&](int node) { replicas[node].reset(new T(source)); });
+	}
+
+	// Copy of the calling thread's node
+	const T& Get() const {
+		int node = scheduler->GetCurrentNode();
+		return *replicas[node < (int)replicas.size() ? node : 0];
+	}
+
+	int GetCount() const { return (int)replicas.size(); }
+
+private:
+
+	TaskScheduler* scheduler;
+	vector<unique_ptr<T>> replicas;
+};
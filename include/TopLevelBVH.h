@@ -0,0 +1,60 @@
+// RTAO - Two-level acceleration structure: BVH over instances of per-mesh BVHs
+#pragma once
+
+#include "BVH8.h"
+
+// Row-major 3x4 affine transform, column 3 is the translation
+struct InstanceTransform
+{
+	float m[3][4];
+};
+
+// CPU counterpart of D3D12_RAYTRACING_INSTANCE_DESC
+struct Instance
+{
+	float transform[3][4];				//< Object to world, row-major 3x4 matrix as in D3D12_RAYTRACING_INSTANCE_DESC
+	uint32_t instanceID;				//< 24 bits, exposed as InstanceID()
+	uint32_t mask;						//< 8 bits, instance is skipped when (mask & ray instance inclusion mask) is zero
+	uint32_t meshIndex;					//< Bottom level BVH the instance references
+
+	Instance() {
+		memset(transform, 0, sizeof(transform));
+		transform[0][0] = transform[1][1] = transform[2][2] = 1.0f;
+		instanceID = 0;
+		mask = 0xFF;
+		meshIndex = 0;
+	}
+};
+
+struct TopLevelBVH
+{
+	vector<const BVH8*> meshes;			//< Bottom levels, shared by all instances referencing them (not owned)
+	vector<Instance> instances;
+	vector<InstanceTransform> worldToObject;	//< Inverse of every instance transform
+	vector<BVHNode> nodes;				//< Binary BVH over world space bounds of instances
+	vector<uint32_t> instanceIndices;	//< Instances in leaf order
+
+	BVHBuildStats stats;
+
+	// Top level only, bottom levels are counted once per unique mesh
+	size_t GetMemorySize() const {
+		return nodes.size() * sizeof(BVHNode) + instances.size() * (sizeof(Instance) + sizeof(InstanceTransform)) + instanceIndices.size() * sizeof(uint32_t);
+	}
+};
+
+namespace CPURT
+{
+	/**
+	* Build the top level over instances of the meshes (instance.meshIndex indexes meshes). Instance transforms must be invertible.
+	*/
+	void Build_Top_Level_BVH(TaskScheduler &scheduler, const vector<const BVH8*> &meshes, const vector<Instance> &instances, TopLevelBVH &tlas);
+
+	/**
+	* Closest hit over instances whose mask passes the instance inclusion mask (TraceRay InstanceInclusionMask). Rays are
+	* transformed into object space without renormalization, so hit T is the same in both spaces. hit.instanceIndex is set.
+	*/
+	bool Intersect(const TopLevelBVH &tlas, const Ray &ray, uint32_t instanceInclusionMask, Hit &hit);
+
+	// Any hit variant of the above
+	bool Occluded(const TopLevelBVH &tlas, const Ray &ray, uint32_t instanceInclusionMask, Hit &hit);
+}
@@ -0,0 +1,62 @@
+// RTAO - BVH8 leaf triangles precomputed in SoA packets of 4, 8 or 16 with SIMD intersection kernels
+#pragma once
+
+#include "BVH8.h"
+
+#define TRIANGLE_PACKET_MAX_WIDTH 16
+
+enum TriangleTest
+{
+	TRIANGLE_TEST_MOLLER_TRUMBORE = 0,	//< Same test as IntersectTriangle, may miss rays through shared edges and vertices
+	TRIANGLE_TEST_WATERTIGHT,			//< Same test as IntersectTriangleWatertight
+	TRIANGLE_TESTS_COUNT
+};
+
+/**
+* Triangles of every leaf are packed into packets of their own, the last one padded with copies of the leaf's last triangle.
+* A packet is 9 planes of width floats: x, y, z of v0 followed by those of e1 = v1 - v0 and e2 = v2 - v0 for Moller-Trumbore,
+* or of v1 and v2 for the watertight test (which needs the exact vertices shared with neighbors).
+*/
+struct TrianglePackets
+{
+	int width;							//< 4 (SSE), 8 (AVX2) or 16 (AVX-512)
+	TriangleTest test;					//< Test the packet data is precomputed for
+	vector<float> data;
+	vector<uint32_t> primitiveIndices;	//< Index in the Model of every lane
+	vector<uint32_t> leafPackets;		//< First packet of a leaf, indexed by the leaf's first triangle in the BVH8
+
+	TrianglePackets() {
+		width = 8;
+		test = TRIANGLE_TEST_MOLLER_TRUMBORE;
+	}
+
+	size_t GetPacketsCount() const { return primitiveIndices.size() / width; }
+	size_t GetMemorySize() const { return data.size() * sizeof(float) + (primitiveIndices.size() + leafPackets.size()) * sizeof(uint32_t); }
+};
+
+namespace CPURT
+{
+	/**
+	* Pack leaf triangles of the BVH8. Throws when the CPU lacks the instruction set of the width (traversal needs AVX2 in any case).
+	*/
+	void Build_Triangle_Packets(const BVH8 &bvh, int width, TriangleTest test, TrianglePackets &packets);
+
+	const char* Get_Triangle_Test_Name(TriangleTest test);
+
+	/**
+	* Closest (or any) hit among count packets starting at first, same contract as IntersectLeaf: tMax shrinks on every closer hit.
+	*/
+	bool Intersect_Triangle_Packets(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit);
+
+	// BVH8 traversal (AVX2 node tests) with leaves intersected through the packets built from the same BVH8, watertight packets
+	// switch the node tests to conservative ones as well (a ray through a face shared by two children is otherwise lost by both)
+	bool Intersect(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit);
+	bool Occluded(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit);
+
+	// Kernels written with the intrinsics of their instruction set (see BVH8.h) - call only when supported
+	bool Intersect_Packets_SSE(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit);
+	bool Intersect_Packets_AVX2(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit);
+	bool Intersect_Packets_AVX512(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit);
+	bool Intersect_BVH8_Packets_AVX2(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit);
+	bool Occluded_BVH8_Packets_AVX2(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit);
+}
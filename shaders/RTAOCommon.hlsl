@@ -25,7 +25,8 @@ cbuffer RtaoCB : register(b1)
     float aoRadius;
     int frameNumber;
 	int samplesCount;
-    int sampleStartIndex;
+    int interleaveWidth;
+    int interleaveHeight;
 };
 
 // ---[ Resources ]---
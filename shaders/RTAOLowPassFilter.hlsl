@@ -9,6 +9,8 @@ struct LowPassFilerInfo
     float4x4 normalMatrix;
 	float2 texelSize;
     int outputMode;
+    int filterRadiusX;
+    int filterRadiusY;
 };
 
 ConstantBuffer<LowPassFilerInfo> filterInfo : register(b0);
@@ -56,11 +58,6 @@ ScreenQuadVertexOutput lowPassFilterVS(ScreenQuadVertexInput vertexIn)
 // Pixel Shaders 
 // ========================================================================
 
-static const float gauss[5] =
-{
-	0.05448868f, 0.2442013f, 0.40262f, 0.2442013f, 0.05448868f
-};
-
 inline bool isValidTap(float tapDepth, float centerDepth, float3 tapNormal, float3 centerNormal, float dotViewNormal)
 {
 
@@ -80,11 +77,14 @@ inline bool isValidTap(float tapDepth, float centerDepth, float3 tapNormal, floa
 	return true;
 }
 
-// Filter ambient occlusion using low-pass tent filter and mix it with color buffer
-float lowPassFilter(ScreenQuadVertexOutput pixelInput, float2 filterDirection, const bool doTemporalFilter)
+// Filter ambient occlusion using low-pass gaussian filter and mix it with color buffer
+float lowPassFilter(ScreenQuadVertexOutput pixelInput, float2 filterDirection, int filterRadius, const bool doTemporalFilter)
 {
     float ao = 0.0f;
-	float weight = 1.0f;
+	float weight = 0.0f;
+
+	// Gaussian with sigma of half the filter radius (radius 2 gives the original 5-tap kernel)
+	float sigma = 0.5f * float(filterRadius);
 
 	float4 centerDepthNormal = depthNormalsTexture.Sample(linearClampSampler, pixelInput.texCoords);
 	float centerDepth = centerDepthNormal.a;
@@ -93,8 +93,8 @@ float lowPassFilter(ScreenQuadVertexOutput pixelInput, float2 filterDirection, c
 
     float2 offsetScale = filterInfo.texelSize * filterDirection;
 
-	[unroll(5)]
-    for (int i = -2; i <= 2; ++i)
+	[loop]
+    for (int i = -filterRadius; i <= filterRadius; ++i)
     {
         float2 offset = float(i) * offsetScale;
 
@@ -103,14 +103,15 @@ float lowPassFilter(ScreenQuadVertexOutput pixelInput, float2 filterDirection, c
 		float tapDepth = tapDepthNormal.a;
 		float3 tapNormal = normalize(tapDepthNormal.rgb);
 
-		float tapWeight = gauss[i + 2];
+		float tapWeight = exp(-0.5f * float(i * i) / (sigma * sigma));
 
         if (isValidTap(tapDepth, centerDepth, tapNormal, centerNormal, dotViewNormal))
+        {
             ao += (doTemporalFilter
                      ? dot(tapAO, float4(0.25f, 0.25f, 0.25f, 0.25f))
                      : tapAO.r) * tapWeight;
-		else
-			weight -= tapWeight;
+            weight += tapWeight;
+        }
     }
 	
 	ao /= weight;
@@ -120,12 +121,12 @@ float lowPassFilter(ScreenQuadVertexOutput pixelInput, float2 filterDirection, c
 
 float4 lowPassFilterXPassPS(ScreenQuadVertexOutput pixelInput) : SV_Target
 {
-    return lowPassFilter(pixelInput, float2(1.0f, 0.0f), true).xxxx;
+    return lowPassFilter(pixelInput, float2(1.0f, 0.0f), filterInfo.filterRadiusX, true).xxxx;
 }
 
 float4 lowPassFilterYPassPS(ScreenQuadVertexOutput pixelInput) : SV_Target
 {
-    float ao = lowPassFilter(pixelInput, float2(0.0f, 1.0f), false);
+    float ao = lowPassFilter(pixelInput, float2(0.0f, 1.0f), filterInfo.filterRadiusY, false);
 
 	float4 color = colorTexture.Sample(linearClampSampler, pixelInput.texCoords);
 
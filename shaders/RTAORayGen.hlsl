@@ -27,9 +27,10 @@ void RayGen()
 
 	// Calculate AO
 
-	// Pick subset of samples to use based on "frame number % 4" and position on screen within a block of 3x3 pixels
-    int pixelIdx = dot(int2(fmod(float2(LaunchIndex), 3)), int2(1, 3));
-    int currentSamplesStartIndex = sampleStartIndex + (pixelIdx * samplesCount) + int(frameNumber * samplesCount * 9);
+	// Pick subset of samples to use based on frame number within the sampling sequence and position on screen within the interleave block
+    int2 interleavePosition = int2(LaunchIndex % uint2(interleaveWidth, interleaveHeight));
+    int pixelIdx = interleavePosition.x + interleavePosition.y * interleaveWidth;
+    int currentSamplesStartIndex = (pixelIdx + frameNumber * interleaveWidth * interleaveHeight) * samplesCount;
 
 	// Construct TBN matrix to orient sampling hemisphere along the surface normal
 	float3 n = normalize(normalAndDepth.xyz);
@@ -48,7 +49,7 @@ void RayGen()
 
 	float ao = 0.0f;
 
-	[unroll(4)]
+	[loop]
 	for (int i = 0; i < samplesCount; i++)
 	{
 		float3 aoSampleDirection = mul(aoSamplesTexture.Load(int2(currentSamplesStartIndex + i, 0)).rgb, tbn);
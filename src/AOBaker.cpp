@@ -0,0 +1,1166 @@
+// RTAO - Offline AO baking of static geometry on the CPU BVH
+#include "AOBaker.h"
+#include "BVH8Entry.h"
+#include "SampleSets.h"
+
+#include <atomic>
+#include <chrono>
+#include <numeric>
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Sampling
+//--------------------------------------------------------------------------------------
+
+// Steps of the R2 sequence, as in SampleSets::Generate_R2
+static const double r2AlphaX = 1.0 / 1.32471795724474602596;
+static const double r2AlphaY = 1.0 / (1.32471795724474602596 * 1.32471795724474602596);
+
+// Bumped whenever the sample directions change, so that cached bakes of the old ones are rejected
+static const uint32_t samplingVersion = 1;
+
+static inline uint64_t mixBits(uint64_t x)
+{
+	// SplitMix64 finalizer
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+* Offset of the sample sequence of a point (Cranley-Patterson rotation), so that neighboring points don't share their directions.
+*/
+static inline uint64_t sequenceState(uint32_t seed, uint64_t key)
+{
+	return mixBits(mixBits(key) ^ (uint64_t(seed) << 32));
+}
+
+static inline void sequenceRotation(uint64_t state, double &u, double &v)
+{
+	u = double(state >> 40) / double(1 << 24);
+	v = double((state >> 16) & 0xFFFFFF) / double(1 << 24);
+}
+
+static void sequenceRotation(uint32_t seed, uint64_t key, double &u, double &v)
+{
+	sequenceRotation(sequenceState(seed, key), u, v);
+}
+
+/**
+* Orthonormal tangents of a unit normal (Duff et al., Building an Orthonormal Basis, Revisited).
+*/
+static void tangentFrame(const XMFLOAT3 &n, XMFLOAT3 &b1, XMFLOAT3 &b2)
+{
+	float sign = copysignf(1.0f, n.z);
+	float a = -1.0f / (sign + n.z);
+	float b = n.x * n.y * a;
+
+	b1 = XMFLOAT3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+	b2 = XMFLOAT3(b, sign + n.y * n.y * a, -n.y);
+}
+
+/**
+* Sum of T / aoRadius over samples [first, first + count) of the point's rotated sequence, and of its squares when asked for.
+*/
+static float traceAO(const BVH8 &bvh, SIMDLevel level, const AOBakeInfo &info, const XMFLOAT3 &position, const XMFLOAT3 &normal,
+	double rotationU, double rotationV, uint32_t first, uint32_t count, float* sumSquares = nullptr)
+{
+	XMFLOAT3 b1, b2;
+	tangentFrame(normal, b1, b2);
+
+	// Rays can't leave the sphere of AO radius around the point
+	uint32_t entry = Find_BVH8_Entry(bvh, position, info.aoRadius);
+
+	float sum = 0.0f;
+
+	for (uint32_t i = first; i < first + count; i++) {
+		double u = fmod(0.5 + r2AlphaX * double(i + 1) + rotationU, 1.0);
+		double v = fmod(0.5 + r2AlphaY * double(i + 1) + rotationV, 1.0);
+
+		XMFLOAT3 s = SampleSets::Square_To_Cosine_Hemisphere(float(u), float(v));
+		XMFLOAT3 direction = Add(Add(Mul(b1, s.x), Mul(b2, s.y)), Mul(normal, s.z));
+
+		// Misses keep T at AO radius and produce no occlusion
+		Hit hit;
+		float t = Intersect(bvh, Ray(position, direction, info.tMin, info.aoRadius), hit, level, entry) ? hit.t : info.aoRadius;
+		sum += t / info.aoRadius;
+		if (sumSquares) *sumSquares += (t / info.aoRadius) * (t / info.aoRadius);
+	}
+
+	return sum;
+}
+
+//--------------------------------------------------------------------------------------
+// Vertices
+//--------------------------------------------------------------------------------------
+
+/**
+* Lowest index of a vertex at the same position, for every vertex.
+*/
+static void weldVertices(const Model &model, vector<uint32_t> &representatives)
+{
+	vector<uint32_t> order(model.vertices.size());
+	std::iota(order.begin(), order.end(), 0u);
+
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		const XMFLOAT3 &pa = model.vertices[a].position;
+		const XMFLOAT3 &pb = model.vertices[b].position;
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		if (pa.z != pb.z) return pa.z < pb.z;
+		return a < b;
+	});
+
+	representatives.resize(model.vertices.size());
+
+	for (size_t i = 0; i < order.size(); i++) {
+		const XMFLOAT3 &p = model.vertices[order[i]].position;
+		bool duplicate = i > 0 && p.x == model.vertices[order[i - 1]].position.x && p.y == model.vertices[order[i - 1]].position.y
+			&& p.z == model.vertices[order[i - 1]].position.z;
+
+		representatives[order[i]] = duplicate ? representatives[order[i - 1]] : order[i];
+	}
+}
+
+static void computeNormals(const Model &model, const vector<uint32_t> &representatives, vector<XMFLOAT3> &normals)
+{
+	normals.assign(model.vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+	for (size_t i = 0; i + 2 < model.indices.size(); i += 3) {
+		const XMFLOAT3 &v0 = model.vertices[model.indices[i + 0]].position;
+		const XMFLOAT3 &v1 = model.vertices[model.indices[i + 1]].position;
+		const XMFLOAT3 &v2 = model.vertices[model.indices[i + 2]].position;
+
+		// Twice the area along the face normal
+		XMFLOAT3 n = Cross(Sub(v1, v2), Sub(v0, v2));
+
+		for (int k = 0; k < 3; k++) {
+			XMFLOAT3 &sum = normals[representatives[model.indices[i + k]]];
+			sum = Add(sum, n);
+		}
+	}
+
+	for (size_t v = 0; v < normals.size(); v++) {
+		if (representatives[v] != v) continue;
+		float length = Length(normals[v]);
+		normals[v] = (length > 0.0f) ? Mul(normals[v], 1.0f / length) : XMFLOAT3(0.0f, 0.0f, 0.0f);
+	}
+
+	for (size_t v = 0; v < normals.size(); v++) normals[v] = normals[representatives[v]];
+}
+
+void Compute_Vertex_Normals(const Model &model, vector<XMFLOAT3> &normals)
+{
+	vector<uint32_t> representatives;
+	weldVertices(model, representatives);
+	computeNormals(model, representatives, normals);
+}
+
+/**
+* Points are split over threads in small chunks (rays of a point are few next to the points of a chunk), every point writes
+* its own AO only. Vertices without a normal keep AO of 1.
+*/
+void Bake_Vertex_AO(TaskScheduler &scheduler, const BVH8 &bvh, const Model &model, const AOBakeInfo &info, vector<float> &vertexAO,
+	AOBakeStats* stats)
+{
+	if (info.raysCount <= 0 || info.aoRadius <= 0.0f)
+	{
+		throw std::runtime_error("Error: AO bake requires a positive rays count and AO radius!");
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	vector<uint32_t> representatives;
+	weldVertices(model, representatives);
+
+	vector<XMFLOAT3> normals;
+	computeNormals(model, representatives, normals);
+
+	vector<uint32_t> points;
+	for (uint32_t v = 0; v < (uint32_t)representatives.size(); v++) {
+		if (representatives[v] == v) points.push_back(v);
+	}
+
+	vertexAO.assign(model.vertices.size(), 1.0f);
+
+	const SIMDLevel level = Get_Supported_SIMD_Level();
+	std::atomic<uint64_t> raysCount(0);
+
+	scheduler.ParallelFor(points.size(), 16, [&](size_t begin, size_t end) {
+		uint64_t chunkRays = 0;
+
+		for (size_t p = begin; p < end; p++) {
+			uint32_t vertex = points[p];
+			const XMFLOAT3 &normal = normals[vertex];
+			if (Dot(normal, normal) == 0.0f) continue;
+
+			double rotationU, rotationV;
+			sequenceRotation(info.seed, vertex, rotationU, rotationV);
+
+			vertexAO[vertex] = traceAO(bvh, level, info, model.vertices[vertex].position, normal, rotationU, rotationV, 0, info.raysCount)
+				/ float(info.raysCount);
+			chunkRays += info.raysCount;
+		}
+
+		raysCount += chunkRays;
+	});
+
+	for (size_t v = 0; v < vertexAO.size(); v++) vertexAO[v] = vertexAO[representatives[v]];
+
+	if (stats) {
+		stats->time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->pointsCount = points.size();
+		stats->raysCount = raysCount;
+		stats->mraysPerSecond = (stats->time > 0.0) ? stats->raysCount / (stats->time * 1e3) : 0.0;
+		stats->loaded = false;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Cache
+//--------------------------------------------------------------------------------------
+
+uint64_t Get_AO_Bake_Hash(const AOBakeInfo &info)
+{
+	uint32_t words[5] = { samplingVersion, (uint32_t)info.raysCount, 0, 0, info.seed };
+	memcpy(&words[2], &info.aoRadius, sizeof(float));
+	memcpy(&words[3], &info.tMin, sizeof(float));
+
+	uint64_t hash = BVH_CACHE_HASH_SEED;
+	for (uint32_t word : words) hash = HashWord(hash, word);
+
+	return hash;
+}
+
+void Bake_Vertex_AO_Cached(TaskScheduler &scheduler, const string &path, const Model &model, const BVHBuildInfo &buildInfo,
+	const AOBakeInfo &info, BVH8 &bvh, vector<float> &vertexAO, AOBakeStats* stats)
+{
+	AOBakeStats localStats;
+	if (!stats) stats = &localStats;
+	*stats = AOBakeStats();
+
+	Build_BVH8_Cached(scheduler, path, model, buildInfo, bvh);
+
+	uint64_t geometryHash = Get_Geometry_Hash(model);
+	uint64_t aoHash = Get_AO_Bake_Hash(info);
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (Load_Vertex_AO_Cache(path, geometryHash, aoHash, vertexAO)) {
+		stats->time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->loaded = true;
+		return;
+	}
+
+	Bake_Vertex_AO(scheduler, bvh, model, info, vertexAO, stats);
+	Save_BVH_Cache(path, geometryHash, buildInfo, bvh, &vertexAO, aoHash);
+}
+
+//--------------------------------------------------------------------------------------
+// Lightmaps
+//--------------------------------------------------------------------------------------
+
+// Generated charts fill this fraction of the atlas at first, the scale shrinks until they fit
+static const float chartsFill = 0.9f;
+static const int chartsAttempts = 32;
+
+// Model uvs are replaced in auto mode when more of the covered texels overlap
+static const float maxOverlappingTexels = 0.005f;
+
+static inline float cross2(const XMFLOAT2 &a, const XMFLOAT2 &b) { return a.x * b.y - a.y * b.x; }
+static inline XMFLOAT2 sub2(const XMFLOAT2 &a, const XMFLOAT2 &b) { return XMFLOAT2(a.x - b.x, a.y - b.y); }
+
+/**
+* Closest point of the triangle's edges to c, as barycentric weights of the corners, returns the distance.
+*/
+static float closestEdgePoint(const XMFLOAT2 p[3], const XMFLOAT2 &c, float weights[3])
+{
+	float best = FLT_MAX;
+
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		XMFLOAT2 edge = sub2(p[j], p[i]);
+		XMFLOAT2 toPoint = sub2(c, p[i]);
+
+		float lengthSquared = edge.x * edge.x + edge.y * edge.y;
+		float t = (lengthSquared > 0.0f) ? min(1.0f, max(0.0f, (toPoint.x * edge.x + toPoint.y * edge.y) / lengthSquared)) : 0.0f;
+		float dx = toPoint.x - edge.x * t;
+		float dy = toPoint.y - edge.y * t;
+		float distance = sqrtf(dx * dx + dy * dy);
+
+		if (distance < best) {
+			best = distance;
+			weights[i] = 1.0f - t;
+			weights[j] = t;
+			weights[(i + 2) % 3] = 0.0f;
+		}
+	}
+
+	return best;
+}
+
+/**
+* Texels overlapped by the triangle (corners p in texels), keeping the point of the triangle closest to every texel center.
+*/
+static void rasterizeTriangle(Lightmap &lightmap, uint32_t primitiveIndex, const XMFLOAT2 p[3], const XMFLOAT3 v[3])
+{
+	float area = cross2(sub2(p[1], p[0]), sub2(p[2], p[0]));
+	if (area == 0.0f) return;
+
+	XMFLOAT3 normal = Cross(Sub(v[1], v[2]), Sub(v[0], v[2]));
+	float normalLength = Length(normal);
+	if (normalLength == 0.0f) return;
+	normal = Mul(normal, 1.0f / normalLength);
+
+	int x0 = max(0, (int)floorf(min(p[0].x, min(p[1].x, p[2].x))));
+	int y0 = max(0, (int)floorf(min(p[0].y, min(p[1].y, p[2].y))));
+	int x1 = min(lightmap.width - 1, (int)floorf(max(p[0].x, max(p[1].x, p[2].x))));
+	int y1 = min(lightmap.height - 1, (int)floorf(max(p[0].y, max(p[1].y, p[2].y))));
+
+	// Edge functions are positive inside for either winding
+	float orientation = (area > 0.0f) ? 1.0f : -1.0f;
+
+	for (int y = y0; y <= y1; y++) {
+		for (int x = x0; x <= x1; x++) {
+			XMFLOAT2 c = XMFLOAT2(x + 0.5f, y + 0.5f);
+
+			float edges[3];
+			bool inside = true, overlaps = true;
+
+			for (int i = 0; i < 3; i++) {
+				XMFLOAT2 edge = sub2(p[(i + 1) % 3], p[i]);
+				edges[i] = orientation * cross2(edge, sub2(c, p[i]));
+				inside = inside && edges[i] >= 0.0f;
+
+				// The edge separates the texel square only when it doesn't reach even its farthest corner
+				overlaps = overlaps && edges[i] + 0.5f * (fabsf(edge.x) + fabsf(edge.y)) >= 0.0f;
+			}
+
+			if (!overlaps) continue;
+
+			float weights[3];
+			float distance = 0.0f;
+
+			if (inside) {
+				weights[0] = edges[1] / fabsf(area);
+				weights[1] = edges[2] / fabsf(area);
+				weights[2] = 1.0f - weights[0] - weights[1];
+			} else {
+				distance = closestEdgePoint(p, c, weights);
+			}
+
+			LightmapTexel &texel = lightmap.texels[size_t(y) * lightmap.width + x];
+
+			if (texel.primitiveIndex != LIGHTMAP_EMPTY_TEXEL && !(distance < texel.distance)) {
+				// Centers on a shared edge are inside both triangles without the charts overlapping
+				if (inside && texel.distance == 0.0f && min(weights[0], min(weights[1], weights[2])) > 1e-3f) lightmap.overlappingTexels++;
+				continue;
+			}
+
+			texel.position = Add(Add(Mul(v[0], weights[0]), Mul(v[1], weights[1])), Mul(v[2], weights[2]));
+			texel.primitiveIndex = primitiveIndex;
+			texel.normal = normal;
+			texel.distance = distance;
+		}
+	}
+}
+
+// Chart of one triangle, or of two sharing their longest edge unfolded into a quad
+struct LightmapChart
+{
+	uint32_t triangles[2];
+	uint32_t trianglesCount;
+	XMFLOAT2 corners[6];			//< Corners of the triangles in Model index order, in world units with the chart's bounds at the origin
+	XMFLOAT2 size;
+};
+
+static inline uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+	return (uint64_t(min(a, b)) << 32) | max(a, b);
+}
+
+static int longestEdge(const Model &model, uint32_t triangle)
+{
+	int longest = 0;
+	float longestLength = -1.0f;
+
+	for (int k = 0; k < 3; k++) {
+		const XMFLOAT3 &a = model.vertices[model.indices[triangle * 3 + k]].position;
+		const XMFLOAT3 &b = model.vertices[model.indices[triangle * 3 + (k + 1) % 3]].position;
+		float length = Length(Sub(b, a));
+		if (length > longestLength) {
+			longest = k;
+			longestLength = length;
+		}
+	}
+
+	return longest;
+}
+
+/**
+* Rotate the chart's corners so that its bounds are smallest, trying every edge of its outline along u, and move them to the origin.
+*/
+static void fitChart(LightmapChart &chart, const XMFLOAT2* outline, int outlineCount)
+{
+	int cornersCount = int(chart.trianglesCount) * 3;
+	float bestArea = FLT_MAX;
+	XMFLOAT2 best[6];
+
+	for (int e = 0; e < outlineCount; e++) {
+		XMFLOAT2 edge = sub2(outline[(e + 1) % outlineCount], outline[e]);
+		float length = sqrtf(edge.x * edge.x + edge.y * edge.y);
+		if (length == 0.0f) continue;
+
+		float c = edge.x / length, s = edge.y / length;
+		XMFLOAT2 rotated[6];
+		XMFLOAT2 minimum = XMFLOAT2(FLT_MAX, FLT_MAX), maximum = XMFLOAT2(-FLT_MAX, -FLT_MAX);
+
+		for (int k = 0; k < cornersCount; k++) {
+			const XMFLOAT2 &p = chart.corners[k];
+			rotated[k] = XMFLOAT2(p.x * c + p.y * s, p.y * c - p.x * s);
+			minimum = XMFLOAT2(min(minimum.x, rotated[k].x), min(minimum.y, rotated[k].y));
+			maximum = XMFLOAT2(max(maximum.x, rotated[k].x), max(maximum.y, rotated[k].y));
+		}
+
+		float area = (maximum.x - minimum.x) * (maximum.y - minimum.y);
+		if (area < bestArea) {
+			bestArea = area;
+			chart.size = sub2(maximum, minimum);
+			for (int k = 0; k < cornersCount; k++) best[k] = sub2(rotated[k], minimum);
+		}
+	}
+
+	if (bestArea == FLT_MAX) {
+		chart.size = XMFLOAT2(0.0f, 0.0f);
+		for (int k = 0; k < cornersCount; k++) best[k] = XMFLOAT2(0.0f, 0.0f);
+	}
+
+	for (int k = 0; k < cornersCount; k++) chart.corners[k] = best[k];
+}
+
+/**
+* Corners of the triangle in a frame with its edge (first, first + 1) on u from the origin, the third corner on the side of sign.
+*/
+static void flattenTriangle(const Model &model, uint32_t triangle, const XMFLOAT3 &origin, const XMFLOAT3 &axis, float sign, XMFLOAT2* corners)
+{
+	for (int k = 0; k < 3; k++) {
+		XMFLOAT3 offset = Sub(model.vertices[model.indices[triangle * 3 + k]].position, origin);
+		float along = Dot(offset, axis);
+		corners[k] = XMFLOAT2(along, sign * Length(Sub(offset, Mul(axis, along))));
+	}
+}
+
+/**
+* Triangles are paired with the neighbor across their longest edge when it is the neighbor's longest edge too (the two halves of
+* a quad), a pair is unfolded flat into one chart without a seam between them. Charts of the rest hold single triangles.
+*/
+static void buildCharts(const Model &model, vector<LightmapChart> &charts)
+{
+	uint32_t trianglesCount = uint32_t(model.indices.size() / 3);
+
+	vector<uint32_t> representatives;
+	weldVertices(model, representatives);
+
+	vector<int> longest(trianglesCount);
+	for (uint32_t t = 0; t < trianglesCount; t++) longest[t] = longestEdge(model, t);
+
+	// Triangles on every longest edge, edges shared by more than two of them aren't unfolded
+	const uint32_t noTriangle = 0xFFFFFFFF;
+	unordered_map<uint64_t, pair<uint32_t, uint32_t>> edges;
+	edges.reserve(trianglesCount);
+
+	for (uint32_t t = 0; t < trianglesCount; t++) {
+		uint32_t a = representatives[model.indices[t * 3 + longest[t]]];
+		uint32_t b = representatives[model.indices[t * 3 + (longest[t] + 1) % 3]];
+		if (a == b) continue;
+
+		auto inserted = edges.insert(make_pair(edgeKey(a, b), make_pair(t, noTriangle)));
+		if (inserted.second) continue;
+
+		pair<uint32_t, uint32_t> &triangles = inserted.first->second;
+		if (triangles.second == noTriangle && triangles.first != noTriangle) triangles.second = t;
+		else triangles = make_pair(noTriangle, noTriangle);
+	}
+
+	vector<uint32_t> partners(trianglesCount, noTriangle);
+
+	for (const auto &edge : edges) {
+		const pair<uint32_t, uint32_t> &triangles = edge.second;
+		if (triangles.first == noTriangle || triangles.second == noTriangle) continue;
+
+		partners[triangles.first] = triangles.second;
+		partners[triangles.second] = triangles.first;
+	}
+
+	vector<uint8_t> charted(trianglesCount, 0);
+
+	charts.clear();
+	charts.reserve(trianglesCount);
+
+	for (uint32_t t = 0; t < trianglesCount; t++) {
+		if (charted[t]) continue;
+
+		LightmapChart chart;
+		chart.triangles[0] = t;
+		chart.trianglesCount = 1;
+
+		int k = longest[t];
+		const XMFLOAT3 &origin = model.vertices[model.indices[t * 3 + k]].position;
+		XMFLOAT3 axis = Sub(model.vertices[model.indices[t * 3 + (k + 1) % 3]].position, origin);
+		float axisLength = Length(axis);
+		axis = (axisLength > 0.0f) ? Mul(axis, 1.0f / axisLength) : XMFLOAT3(1.0f, 0.0f, 0.0f);
+
+		flattenTriangle(model, t, origin, axis, 1.0f, chart.corners);
+		XMFLOAT2 outline[4] = { chart.corners[k], chart.corners[(k + 2) % 3], chart.corners[(k + 1) % 3] };
+		int outlineCount = 3;
+
+		uint32_t partner = partners[t];
+		if (partner != noTriangle && !charted[partner] && axisLength > 0.0f) {
+			chart.triangles[1] = partner;
+			chart.trianglesCount = 2;
+			charted[partner] = 1;
+
+			// The partner's third corner goes to the other side of the shared edge
+			flattenTriangle(model, partner, origin, axis, -1.0f, &chart.corners[3]);
+			int third = 3 + (longest[partner] + 2) % 3;
+
+			outline[3] = chart.corners[third];
+			outlineCount = 4;
+		}
+
+		charted[t] = 1;
+		fitChart(chart, outline, outlineCount);
+		charts.push_back(chart);
+	}
+}
+
+/**
+* Charts packed into shelves ordered by height. Every chart keeps padding texels free around it, the scale of world units to
+* texels shrinks until all of them fit.
+*/
+static void generateUVs(const Model &model, int resolution, int padding, vector<XMFLOAT2> &uvs)
+{
+	vector<LightmapChart> charts;
+	buildCharts(model, charts);
+
+	int reserved = 2 * padding + 2;
+
+	if (double(charts.size()) * reserved * reserved > double(resolution) * resolution)
+	{
+		throw std::runtime_error("Error: lightmap resolution is too small for a chart of every triangle!");
+	}
+
+	double chartsArea = 0.0;
+	for (const LightmapChart &chart : charts) chartsArea += double(chart.size.x) * chart.size.y;
+
+	if (!(chartsArea > 0.0))
+	{
+		throw std::runtime_error("Error: lightmap charts can't be generated for a model without area!");
+	}
+
+	vector<uint32_t> order(charts.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		if (charts[a].size.y != charts[b].size.y) return charts[a].size.y > charts[b].size.y;
+		return a < b;
+	});
+
+	uvs.resize(model.indices.size());
+	float scale = float(sqrt(chartsFill * double(resolution) * resolution / chartsArea));
+
+	for (int attempt = 0; attempt < chartsAttempts; attempt++, scale *= 0.9f) {
+		int x = 0, y = 0, shelfHeight = 0;
+		bool fits = true;
+
+		for (uint32_t c : order) {
+			const LightmapChart &chart = charts[c];
+			int width = (int)ceilf(chart.size.x * scale) + reserved - 1;
+			int height = (int)ceilf(chart.size.y * scale) + reserved - 1;
+
+			if (x + width > resolution) {
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+
+			if (width > resolution || y + height > resolution) {
+				fits = false;
+				break;
+			}
+
+			for (uint32_t t = 0; t < chart.trianglesCount; t++) {
+				for (int k = 0; k < 3; k++) {
+					const XMFLOAT2 &corner = chart.corners[t * 3 + k];
+					uvs[chart.triangles[t] * 3 + k] = XMFLOAT2((x + padding + corner.x * scale) / resolution, (y + padding + corner.y * scale) / resolution);
+				}
+			}
+
+			x += width;
+			shelfHeight = max(shelfHeight, height);
+		}
+
+		if (fits) return;
+	}
+
+	throw std::runtime_error("Error: lightmap charts don't fit the resolution!");
+}
+
+static void rasterizeLightmap(const Model &model, Lightmap &lightmap)
+{
+	LightmapTexel empty;
+	empty.position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	empty.primitiveIndex = LIGHTMAP_EMPTY_TEXEL;
+	empty.normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	empty.distance = FLT_MAX;
+
+	lightmap.texels.assign(size_t(lightmap.width) * lightmap.height, empty);
+	lightmap.coveredTexels = 0;
+	lightmap.conservativeTexels = 0;
+	lightmap.overlappingTexels = 0;
+
+	for (uint32_t t = 0; t < uint32_t(model.indices.size() / 3); t++) {
+		XMFLOAT2 p[3];
+		XMFLOAT3 v[3];
+		for (int k = 0; k < 3; k++) {
+			p[k] = XMFLOAT2(lightmap.uvs[t * 3 + k].x * lightmap.width, lightmap.uvs[t * 3 + k].y * lightmap.height);
+			v[k] = model.vertices[model.indices[t * 3 + k]].position;
+		}
+
+		rasterizeTriangle(lightmap, t, p, v);
+	}
+
+	for (const LightmapTexel &texel : lightmap.texels) {
+		if (texel.primitiveIndex == LIGHTMAP_EMPTY_TEXEL) continue;
+		if (texel.distance == 0.0f) lightmap.coveredTexels++;
+		else lightmap.conservativeTexels++;
+	}
+}
+
+/**
+* Model uvs are kept in auto mode unless one leaves [0, 1], a triangle with area has none, or too many texels overlap.
+*/
+void Build_Lightmap(const Model &model, const LightmapInfo &info, Lightmap &lightmap)
+{
+	if (info.resolution <= 0 || info.padding < 0)
+	{
+		throw std::runtime_error("Error: invalid lightmap resolution or padding!");
+	}
+
+	lightmap.width = info.resolution;
+	lightmap.height = info.resolution;
+	lightmap.padding = info.padding;
+	lightmap.ao.clear();
+
+	bool generate = (info.uvs == LIGHTMAP_UVS_GENERATED);
+
+	if (!generate) {
+		lightmap.uvs.resize(model.indices.size());
+		bool usable = true;
+
+		for (size_t i = 0; i < model.indices.size(); i++) {
+			lightmap.uvs[i] = model.vertices[model.indices[i]].uv;
+			usable = usable && lightmap.uvs[i].x >= 0.0f && lightmap.uvs[i].x <= 1.0f && lightmap.uvs[i].y >= 0.0f && lightmap.uvs[i].y <= 1.0f;
+		}
+
+		for (size_t i = 0; i + 2 < model.indices.size() && usable; i += 3) {
+			const XMFLOAT2* uv = &lightmap.uvs[i];
+			const XMFLOAT3 &v0 = model.vertices[model.indices[i + 0]].position;
+			const XMFLOAT3 &v1 = model.vertices[model.indices[i + 1]].position;
+			const XMFLOAT3 &v2 = model.vertices[model.indices[i + 2]].position;
+
+			if (cross2(sub2(uv[1], uv[0]), sub2(uv[2], uv[0])) == 0.0f && Length(Cross(Sub(v1, v0), Sub(v2, v0))) > 0.0f) usable = false;
+		}
+
+		if (usable) rasterizeLightmap(model, lightmap);
+
+		if (info.uvs == LIGHTMAP_UVS_AUTO) {
+			generate = !usable || lightmap.overlappingTexels > maxOverlappingTexels * lightmap.coveredTexels;
+		} else if (!usable) {
+			throw std::runtime_error("Error: model uvs can't be used for a lightmap!");
+		}
+	}
+
+	lightmap.generatedUVs = generate;
+
+	if (generate) {
+		generateUVs(model, info.resolution, info.padding, lightmap.uvs);
+		rasterizeLightmap(model, lightmap);
+	}
+}
+
+/**
+* Every pass averages the baked neighbors (8 connected) of empty texels next to baked ones, reading the previous pass only.
+*/
+static void dilateLightmap(TaskScheduler &scheduler, Lightmap &lightmap, vector<uint8_t> &baked)
+{
+	const int width = lightmap.width;
+	const int height = lightmap.height;
+
+	for (int pass = 0; pass < lightmap.padding; pass++) {
+		vector<float> source = lightmap.ao;
+		vector<uint8_t> sourceBaked = baked;
+
+		scheduler.ParallelFor(size_t(height), 16, [&](size_t begin, size_t end) {
+			for (int y = int(begin); y < int(end); y++) {
+				for (int x = 0; x < width; x++) {
+					size_t index = size_t(y) * width + x;
+					if (sourceBaked[index]) continue;
+
+					float sum = 0.0f;
+					int count = 0;
+
+					for (int dy = -1; dy <= 1; dy++) {
+						for (int dx = -1; dx <= 1; dx++) {
+							int nx = x + dx, ny = y + dy;
+							if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+
+							size_t neighbor = size_t(ny) * width + nx;
+							if (!sourceBaked[neighbor]) continue;
+
+							sum += source[neighbor];
+							count++;
+						}
+					}
+
+					if (count > 0) {
+						lightmap.ao[index] = sum / float(count);
+						baked[index] = 1;
+					}
+				}
+			}
+		});
+	}
+}
+
+void Bake_Lightmap_AO(TaskScheduler &scheduler, const BVH8 &bvh, const AOBakeInfo &info, Lightmap &lightmap, AOBakeStats* stats)
+{
+	if (info.raysCount <= 0 || info.aoRadius <= 0.0f)
+	{
+		throw std::runtime_error("Error: AO bake requires a positive rays count and AO radius!");
+	}
+
+	if (lightmap.texels.size() != size_t(lightmap.width) * lightmap.height)
+	{
+		throw std::runtime_error("Error: lightmap is not built!");
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	lightmap.ao.assign(lightmap.texels.size(), 1.0f);
+	vector<uint8_t> baked(lightmap.texels.size(), 0);
+
+	const SIMDLevel level = Get_Supported_SIMD_Level();
+	std::atomic<uint64_t> pointsCount(0), raysCount(0);
+
+	scheduler.ParallelForTiles(lightmap.width, lightmap.height, AO_BAKE_TILE_SIZE, [&](int x0, int y0, int x1, int y1) {
+		uint64_t tilePoints = 0;
+
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				size_t index = size_t(y) * lightmap.width + x;
+				const LightmapTexel &texel = lightmap.texels[index];
+				if (texel.primitiveIndex == LIGHTMAP_EMPTY_TEXEL) continue;
+
+				double rotationU, rotationV;
+				sequenceRotation(info.seed, index, rotationU, rotationV);
+
+				lightmap.ao[index] = traceAO(bvh, level, info, texel.position, texel.normal, rotationU, rotationV, 0, info.raysCount)
+					/ float(info.raysCount);
+				baked[index] = 1;
+				tilePoints++;
+			}
+		}
+
+		pointsCount += tilePoints;
+		raysCount += tilePoints * info.raysCount;
+	});
+
+	dilateLightmap(scheduler, lightmap, baked);
+
+	if (stats) {
+		stats->time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->pointsCount = pointsCount;
+		stats->raysCount = raysCount;
+		stats->mraysPerSecond = (stats->time > 0.0) ? stats->raysCount / (stats->time * 1e3) : 0.0;
+		stats->loaded = false;
+	}
+}
+
+void Get_Lightmap_Texture(const Lightmap &lightmap, TextureInfo &texture)
+{
+	texture.width = lightmap.width;
+	texture.height = lightmap.height;
+	texture.stride = 4;
+	texture.pixels.resize(size_t(lightmap.width) * lightmap.height * 4);
+
+	for (size_t i = 0; i < lightmap.ao.size(); i++) {
+		UINT8 value = UINT8(min(1.0f, max(0.0f, lightmap.ao[i])) * 255.0f + 0.5f);
+		texture.pixels[i * 4 + 0] = value;
+		texture.pixels[i * 4 + 1] = value;
+		texture.pixels[i * 4 + 2] = value;
+		texture.pixels[i * 4 + 3] = 0xff;
+	}
+}
+
+void Save_Lightmap_Texture(const string &path, const Lightmap &lightmap)
+{
+	if (lightmap.ao.empty() || lightmap.width > 0xFFFF || lightmap.height > 0xFFFF)
+	{
+		throw std::runtime_error("Error: lightmap can't be saved as a texture!");
+	}
+
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Error: failed to open lightmap texture file for writing!");
+	}
+
+	// Uncompressed true color image, 24 bits per pixel, rows from the top
+	uint8_t header[18] = {};
+	header[2] = 2;
+	header[12] = uint8_t(lightmap.width & 0xFF);
+	header[13] = uint8_t(lightmap.width >> 8);
+	header[14] = uint8_t(lightmap.height & 0xFF);
+	header[15] = uint8_t(lightmap.height >> 8);
+	header[16] = 24;
+	header[17] = 0x20;
+	file.write((const char*)header, sizeof(header));
+
+	TextureInfo texture;
+	Get_Lightmap_Texture(lightmap, texture);
+
+	vector<uint8_t> pixels(lightmap.ao.size() * 3);
+	for (size_t i = 0; i < lightmap.ao.size(); i++) {
+		const UINT8* texel = &texture.pixels[(lightmap.ao.size() - 1 - i) * 4];
+		pixels[i * 3 + 0] = texel[2];
+		pixels[i * 3 + 1] = texel[1];
+		pixels[i * 3 + 2] = texel[0];
+	}
+
+	file.write((const char*)pixels.data(), std::streamsize(pixels.size()));
+	file.close();
+
+	if (file.fail())
+	{
+		throw std::runtime_error("Error: failed to write lightmap texture file!");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Progressive Lightmaps
+//--------------------------------------------------------------------------------------
+
+static uint64_t getTexelsHash(const Lightmap &lightmap)
+{
+	uint64_t hash = BVH_CACHE_HASH_SEED;
+	hash = HashWord(hash, uint32_t(lightmap.width));
+	hash = HashWord(hash, uint32_t(lightmap.height));
+
+	const uint32_t* words = (const uint32_t*)lightmap.texels.data();
+	size_t wordsCount = lightmap.texels.size() * sizeof(LightmapTexel) / sizeof(uint32_t);
+	for (size_t i = 0; i < wordsCount; i++) hash = HashWord(hash, words[i]);
+
+	return hash;
+}
+
+// The rays count only limits how far a texel is sampled, a bake may continue with more
+static uint64_t getSamplingHash(const AOBakeInfo &info)
+{
+	AOBakeInfo sampling = info;
+	sampling.raysCount = 0;
+	return Get_AO_Bake_Hash(sampling);
+}
+
+/**
+* Standard error of the texel's mean AO from the variance of its samples. Samples of the rotated R2 sequence are correlated, so
+* the actual error is lower than estimated and the target is met conservatively.
+*/
+static float texelError(const LightmapTexelState &state)
+{
+	if (state.samplesCount < 2) return FLT_MAX;
+
+	double n = double(state.samplesCount);
+	double variance = max(0.0, (state.sumSquares - state.sum * state.sum / n) / (n - 1.0));
+	return float(sqrt(variance / n));
+}
+
+// Without a target error, texels converge once they have all rays
+static inline bool isTexelConverged(const LightmapTexelState &state, const AOBakeInfo &info, const AOProgressiveInfo &progressiveInfo)
+{
+	if (progressiveInfo.targetError <= 0.0f) return state.samplesCount >= uint32_t(info.raysCount);
+	return state.samplesCount >= uint32_t(max(progressiveInfo.minSamples, 2)) && state.error <= progressiveInfo.targetError;
+}
+
+static inline bool isTexelActive(const LightmapTexelState &state, const AOBakeInfo &info, const AOProgressiveInfo &progressiveInfo)
+{
+	return state.samplesCount < uint32_t(info.raysCount) && !isTexelConverged(state, info, progressiveInfo);
+}
+
+/**
+* Converged, capped (all rays traced above the target error) and pending texels, returns the number of baked texels.
+*/
+static uint64_t countTexels(const Lightmap &lightmap, const vector<LightmapTexelState> &states, const AOBakeInfo &info,
+	const AOProgressiveInfo &progressiveInfo, uint64_t &convergedTexels, uint64_t &cappedTexels, uint64_t &pendingTexels)
+{
+	uint64_t bakedTexels = 0;
+	convergedTexels = 0;
+	cappedTexels = 0;
+	pendingTexels = 0;
+
+	for (size_t i = 0; i < states.size(); i++) {
+		if (lightmap.texels[i].primitiveIndex == LIGHTMAP_EMPTY_TEXEL) continue;
+		bakedTexels++;
+
+		if (isTexelConverged(states[i], info, progressiveInfo)) convergedTexels++;
+		else if (states[i].samplesCount >= uint32_t(info.raysCount)) cappedTexels++;
+		else pendingTexels++;
+	}
+
+	return bakedTexels;
+}
+
+static bool loadCheckpoint(const string &path, uint64_t texelsHash, uint64_t samplingHash, const Lightmap &lightmap,
+	vector<LightmapTexelState> &states, int &passesCount)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file.is_open()) return false;
+
+	uint64_t fileSize = (uint64_t)file.tellg();
+	file.seekg(0);
+
+	AOCheckpointHeader header;
+	if (fileSize < sizeof(header) || !file.read((char*)&header, sizeof(header))) return false;
+
+	if (header.magic != AO_CHECKPOINT_MAGIC || header.version != AO_CHECKPOINT_VERSION) return false;
+	if (header.texelsHash != texelsHash || header.samplingHash != samplingHash) return false;
+	if (header.width != uint32_t(lightmap.width) || header.height != uint32_t(lightmap.height)) return false;
+	if (header.texelStateSize != sizeof(LightmapTexelState) || header.fileSize != fileSize) return false;
+
+	size_t count = lightmap.texels.size();
+	if (fileSize != sizeof(header) + count * sizeof(LightmapTexelState)) return false;
+
+	vector<LightmapTexelState> loaded(count);
+	if (!file.read((char*)loaded.data(), std::streamsize(count * sizeof(LightmapTexelState)))) return false;
+
+	states.swap(loaded);
+	passesCount = int(header.passesCount);
+	return true;
+}
+
+/**
+* The checkpoint is written next to the file and moved over it, a crash while writing leaves the previous one intact.
+*/
+static uint64_t saveCheckpoint(const string &path, uint64_t texelsHash, uint64_t samplingHash, const Lightmap &lightmap,
+	const vector<LightmapTexelState> &states, int passesCount)
+{
+	string temporaryPath = path + ".tmp";
+
+	AOCheckpointHeader header = {};
+	header.magic = AO_CHECKPOINT_MAGIC;
+	header.version = AO_CHECKPOINT_VERSION;
+	header.texelsHash = texelsHash;
+	header.samplingHash = samplingHash;
+	header.width = uint32_t(lightmap.width);
+	header.height = uint32_t(lightmap.height);
+	header.passesCount = uint32_t(passesCount);
+	header.texelStateSize = sizeof(LightmapTexelState);
+	header.fileSize = sizeof(header) + states.size() * sizeof(LightmapTexelState);
+
+	ofstream file(temporaryPath, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Error: failed to open AO checkpoint file for writing!");
+	}
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)states.data(), std::streamsize(states.size() * sizeof(LightmapTexelState)));
+	file.close();
+
+	if (file.fail())
+	{
+		throw std::runtime_error("Error: failed to write AO checkpoint file!");
+	}
+
+	if (!MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		throw std::runtime_error("Error: failed to replace AO checkpoint file!");
+	}
+
+	return header.fileSize;
+}
+
+bool Bake_Lightmap_AO_Progressive(TaskScheduler &scheduler, const BVH8 &bvh, const AOBakeInfo &info, const AOProgressiveInfo &progressiveInfo,
+	Lightmap &lightmap, AOProgressiveStats* stats, const function<bool(const AOPassReport&)> &progress)
+{
+	if (info.raysCount <= 0 || info.aoRadius <= 0.0f || progressiveInfo.samplesPerPass <= 0)
+	{
+		throw std::runtime_error("Error: progressive AO bake requires a positive rays count, samples per pass and AO radius!");
+	}
+
+	if (lightmap.texels.size() != size_t(lightmap.width) * lightmap.height)
+	{
+		throw std::runtime_error("Error: lightmap is not built!");
+	}
+
+	AOProgressiveStats localStats;
+	if (!stats) stats = &localStats;
+	*stats = AOProgressiveStats();
+
+	auto milliseconds = [](std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	const bool checkpoints = !progressiveInfo.checkpointPath.empty();
+	const uint64_t texelsHash = checkpoints ? getTexelsHash(lightmap) : 0;
+	const uint64_t samplingHash = getSamplingHash(info);
+
+	vector<LightmapTexelState> states;
+	int passesCount = 0;
+
+	if (!checkpoints || !loadCheckpoint(progressiveInfo.checkpointPath, texelsHash, samplingHash, lightmap, states, passesCount)) {
+		states.resize(lightmap.texels.size());
+		passesCount = 0;
+
+		// Same sequences as Bake_Lightmap_AO
+		for (size_t i = 0; i < states.size(); i++) {
+			states[i].sum = 0.0;
+			states[i].sumSquares = 0.0;
+			states[i].sequence = sequenceState(info.seed, i);
+			states[i].samplesCount = 0;
+			states[i].error = FLT_MAX;
+		}
+	}
+
+	stats->resumedPasses = passesCount;
+
+	auto checkpoint = [&]() {
+		auto checkpointStart = std::chrono::steady_clock::now();
+		stats->checkpointBytes = saveCheckpoint(progressiveInfo.checkpointPath, texelsHash, samplingHash, lightmap, states, passesCount);
+		stats->checkpointTime += milliseconds(checkpointStart);
+	};
+
+	const SIMDLevel level = Get_Supported_SIMD_Level();
+	countTexels(lightmap, states, info, progressiveInfo, stats->convergedTexels, stats->cappedTexels, stats->pendingTexels);
+	bool stopped = false;
+	double tracingTime = 0.0;
+
+	while (stats->pendingTexels > 0 && !stopped) {
+		auto passStart = std::chrono::steady_clock::now();
+		std::atomic<uint64_t> activeTexels(0), raysCount(0);
+
+		scheduler.ParallelForTiles(lightmap.width, lightmap.height, AO_BAKE_TILE_SIZE, [&](int x0, int y0, int x1, int y1) {
+			uint64_t tileTexels = 0, tileRays = 0;
+
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					size_t index = size_t(y) * lightmap.width + x;
+					const LightmapTexel &texel = lightmap.texels[index];
+					LightmapTexelState &state = states[index];
+					if (texel.primitiveIndex == LIGHTMAP_EMPTY_TEXEL || !isTexelActive(state, info, progressiveInfo)) continue;
+
+					uint32_t count = min(uint32_t(progressiveInfo.samplesPerPass), uint32_t(info.raysCount) - state.samplesCount);
+
+					double rotationU, rotationV;
+					sequenceRotation(state.sequence, rotationU, rotationV);
+
+					float sumSquares = 0.0f;
+					state.sum += traceAO(bvh, level, info, texel.position, texel.normal, rotationU, rotationV, state.samplesCount, count, &sumSquares);
+					state.sumSquares += sumSquares;
+					state.samplesCount += count;
+					state.error = texelError(state);
+
+					tileTexels++;
+					tileRays += count;
+				}
+			}
+
+			activeTexels += tileTexels;
+			raysCount += tileRays;
+		});
+
+		passesCount++;
+
+		AOPassReport report;
+		report.pass = passesCount;
+		report.activeTexels = activeTexels;
+		report.raysCount = raysCount;
+		report.time = milliseconds(passStart);
+		report.maxSamplesCount = 0;
+		report.meanSamplesCount = 0.0;
+		report.rmsError = 0.0;
+		report.maxError = 0.0;
+		report.checkpointed = false;
+
+		uint64_t bakedTexels = countTexels(lightmap, states, info, progressiveInfo, report.convergedTexels, report.cappedTexels, report.pendingTexels);
+		uint64_t estimatedTexels = 0;
+
+		for (size_t i = 0; i < states.size(); i++) {
+			if (lightmap.texels[i].primitiveIndex == LIGHTMAP_EMPTY_TEXEL) continue;
+
+			const LightmapTexelState &state = states[i];
+			report.maxSamplesCount = max(report.maxSamplesCount, state.samplesCount);
+			report.meanSamplesCount += state.samplesCount;
+
+			if (state.error == FLT_MAX) continue;
+			report.rmsError += double(state.error) * state.error;
+			report.maxError = max(report.maxError, double(state.error));
+			estimatedTexels++;
+		}
+
+		report.meanSamplesCount /= max(uint64_t(1), bakedTexels);
+		report.rmsError = sqrt(report.rmsError / max(uint64_t(1), estimatedTexels));
+
+		tracingTime += report.time;
+		stats->raysCount += report.raysCount;
+
+		stats->convergedTexels = report.convergedTexels;
+		stats->cappedTexels = report.cappedTexels;
+		stats->pendingTexels = report.pendingTexels;
+
+		bool finished = (report.pendingTexels == 0);
+		stopped = progressiveInfo.maxPasses > 0 && int(stats->passes.size()) + 1 >= progressiveInfo.maxPasses;
+
+		if (checkpoints && (finished || stopped || (progressiveInfo.checkpointPasses > 0 && passesCount % progressiveInfo.checkpointPasses == 0))) {
+			checkpoint();
+			report.checkpointed = true;
+		}
+
+		stats->passes.push_back(report);
+
+		if (progress && !progress(report) && !finished && !stopped) {
+			stopped = true;
+
+			if (checkpoints && !report.checkpointed) {
+				checkpoint();
+				stats->passes.back().checkpointed = true;
+			}
+		}
+	}
+
+	lightmap.ao.assign(lightmap.texels.size(), 1.0f);
+	vector<uint8_t> baked(lightmap.texels.size(), 0);
+
+	for (size_t i = 0; i < states.size(); i++) {
+		if (lightmap.texels[i].primitiveIndex == LIGHTMAP_EMPTY_TEXEL || states[i].samplesCount == 0) continue;
+		lightmap.ao[i] = float(states[i].sum / states[i].samplesCount);
+		baked[i] = 1;
+	}
+
+	dilateLightmap(scheduler, lightmap, baked);
+
+	stats->finished = (stats->pendingTexels == 0);
+	stats->converged = stats->finished && stats->cappedTexels == 0;
+	stats->time = milliseconds(start);
+	stats->mraysPerSecond = (tracingTime > 0.0) ? stats->raysCount / (tracingTime * 1e3) : 0.0;
+
+	return stats->converged;
+}
+
+}
@@ -0,0 +1,194 @@
+// RTAO - CPU implementation of the AO ray tracing pass
+#include "AOPass.h"
+#include "BVH8Entry.h"
+#include "Camera.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace CPURT
+{
+
+// Constants of the pass shared by all tiles
+struct AOPassContext
+{
+	const BVH8* bvh;
+	const ViewCB* view;
+	const RtaoCB* rtao;
+	const vector<XMFLOAT3>* samples;
+	const Image* normalAndDepthsCurrent;
+	const Image* normalAndDepthsPrevious;
+	const Image* aoPrevious;
+	SIMDLevel level;
+	bool useEntry;					//< AO radius is short enough for per-pixel entry nodes to pay off
+	XMFLOAT4X4 previousViewMatrix;
+	XMFLOAT4X4 motionVectorsMatrix;
+};
+
+/**
+* Transform a point by a matrix uploaded without transposition - mul(matrix, float4(p, 1)) in the shaders.
+*/
+static inline XMFLOAT4 transformPoint(const XMFLOAT4X4 &m, const XMFLOAT3 &p)
+{
+	return XMFLOAT4(p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+		p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+		p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+		p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + m.m[3][3]);
+}
+
+/**
+* One RTAORayGen invocation. Returns true when the pixel has a primary hit.
+*/
+static bool shadePixel(const AOPassContext &context, int x, int y, Image &aoOutput, uint64_t &raysCount, uint64_t &reprojectedCount)
+{
+	const RtaoCB &rtao = *context.rtao;
+
+	// Figure out pixel world space position (using length of a primary ray found in previous pass)
+	Ray primaryRay = Get_Primary_Ray(*context.view, x, y);
+	const XMFLOAT4 &normalAndDepth = context.normalAndDepthsCurrent->Load(x, y);
+	XMFLOAT3 position = Add(primaryRay.origin, Mul(primaryRay.direction, normalAndDepth.w));
+
+	if (normalAndDepth.w < 0.0f) {
+		aoOutput.At(x, y) = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		return false;
+	}
+
+	// Pick subset of samples to use based on frame number within the sampling sequence and position on screen within the interleave block
+	int pixelIdx = (x % rtao.interleaveWidth) + (y % rtao.interleaveHeight) * rtao.interleaveWidth;
+	int currentSamplesStartIndex = (pixelIdx + rtao.frameNumber * rtao.interleaveWidth * rtao.interleaveHeight) * rtao.samplesCount;
+
+	// Construct TBN matrix to orient sampling hemisphere along the surface normal
+	XMFLOAT3 n = Normalize(XMFLOAT3(normalAndDepth.x, normalAndDepth.y, normalAndDepth.z));
+	XMFLOAT3 b1 = Normalize(Sub(primaryRay.direction, Mul(n, Dot(primaryRay.direction, n))));
+	XMFLOAT3 b2 = Cross(n, b1);
+
+	// AO rays of the pixel can't leave the sphere of AO radius around the position, so they start at the subtree holding it
+	uint32_t entry = context.useEntry ? Find_BVH8_Entry(*context.bvh, position, rtao.aoRadius) : 0;
+
+	float ao = 0.0f;
+
+	for (int i = 0; i < rtao.samplesCount; i++) {
+		const XMFLOAT3 &s = (*context.samples)[currentSamplesStartIndex + i];
+		XMFLOAT3 direction = Add(Add(Mul(b1, s.x), Mul(b2, s.y)), Mul(n, s.z));
+
+		// Misses keep T at AO radius and produce no occlusion
+		Hit hit;
+		float t = Intersect(*context.bvh, Ray(position, direction, 0.1f, rtao.aoRadius), hit, context.level, entry) ? hit.t : rtao.aoRadius;
+		ao += t / rtao.aoRadius;
+	}
+
+	ao /= float(rtao.samplesCount);
+	raysCount += rtao.samplesCount;
+
+	// Reverse reprojection
+	XMFLOAT4 previousViewSpacePosition = transformPoint(context.previousViewMatrix, position);
+	float previousReprojectedLinearDepth = Length(XMFLOAT3(previousViewSpacePosition.x, previousViewSpacePosition.y, previousViewSpacePosition.z));
+	XMFLOAT4 previousScreenSpacePosition = transformPoint(context.motionVectorsMatrix, position);
+
+	XMFLOAT2 previousUvs = XMFLOAT2((previousScreenSpacePosition.x / previousScreenSpacePosition.w) * 0.5f + 0.5f,
+		(previousScreenSpacePosition.y / previousScreenSpacePosition.w) * -0.5f + 0.5f);
+
+	bool isReprojectionValid = true;
+
+	// Discard invalid reprojection (outside of the frame)
+	if (previousUvs.x > 1.0f || previousUvs.x < 0.0f || previousUvs.y > 1.0f || previousUvs.y < 0.0f)
+		isReprojectionValid = false;
+
+	// Discard invalid reprojection (depth mismatch)
+	const float maxReprojectionDepthDifference = 0.03f;
+	float previousSampledLinearDepth = context.normalAndDepthsPrevious->SampleLinearClamp(previousUvs).w;
+
+	if (fabsf(1.0f - (previousReprojectedLinearDepth / previousSampledLinearDepth)) > maxReprojectionDepthDifference)
+		isReprojectionValid = false;
+
+	// Store AO to history cache
+	if (isReprojectionValid) {
+		XMFLOAT4 history = context.aoPrevious->SampleLinearClamp(previousUvs);
+		aoOutput.At(x, y) = XMFLOAT4(ao, history.x, history.y, history.z);
+		reprojectedCount++;
+	} else {
+		aoOutput.At(x, y) = XMFLOAT4(ao, ao, ao, ao);
+	}
+
+	return true;
+}
+
+/**
+* Pass over tiles, tileBVH returns the BVH8 a tile is traced against.
+*/
+static void renderAO(TaskScheduler &scheduler, const function<const BVH8&()> &tileBVH, const ViewCB &view, const RtaoCB &rtao, const vector<XMFLOAT3> &samples,
+	const Image &normalAndDepthsCurrent, const Image &normalAndDepthsPrevious, const Image &aoPrevious, Image &aoOutput, AOPassStats* stats)
+{
+	size_t requiredSamples = size_t(rtao.interleaveWidth) * rtao.interleaveHeight * (rtao.frameNumber + 1) * rtao.samplesCount;
+	if (samples.size() < requiredSamples)
+	{
+		throw std::runtime_error("Error: AO samples table is too small for the AO pass configuration!");
+	}
+
+	if (normalAndDepthsPrevious.texels.empty() || aoPrevious.texels.empty())
+	{
+		throw std::runtime_error("Error: AO pass history buffers are not initialized!");
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	AOPassContext context;
+	context.bvh = nullptr;
+	context.view = &view;
+	context.rtao = &rtao;
+	context.samples = &samples;
+	context.normalAndDepthsCurrent = &normalAndDepthsCurrent;
+	context.normalAndDepthsPrevious = &normalAndDepthsPrevious;
+	context.aoPrevious = &aoPrevious;
+	context.level = Get_Supported_SIMD_Level();
+	context.useEntry = false;
+	XMStoreFloat4x4(&context.previousViewMatrix, view.previousViewMatrix);
+	XMStoreFloat4x4(&context.motionVectorsMatrix, view.motionVectorsMatrix);
+
+	int width = normalAndDepthsCurrent.width;
+	int height = normalAndDepthsCurrent.height;
+	aoOutput.Resize(width, height);
+
+	std::atomic<uint64_t> pixelsCount(0), raysCount(0), reprojectedCount(0);
+
+	scheduler.ParallelForTiles(width, height, AO_PASS_TILE_SIZE, [&](int x0, int y0, int x1, int y1) {
+		uint64_t tilePixels = 0, tileRays = 0, tileReprojected = 0;
+
+		AOPassContext tileContext = context;
+		tileContext.bvh = &tileBVH();
+		tileContext.useEntry = Use_BVH8_Entry(*tileContext.bvh, rtao.aoRadius);
+
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				if (shadePixel(tileContext, x, y, aoOutput, tileRays, tileReprojected)) tilePixels++;
+			}
+		}
+
+		pixelsCount += tilePixels;
+		raysCount += tileRays;
+		reprojectedCount += tileReprojected;
+	});
+
+	if (stats) {
+		stats->time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->pixelsCount = pixelsCount;
+		stats->raysCount = raysCount;
+		stats->reprojectedCount = reprojectedCount;
+	}
+}
+
+void Render_AO(TaskScheduler &scheduler, const BVH8 &bvh, const ViewCB &view, const RtaoCB &rtao, const vector<XMFLOAT3> &samples,
+	const Image &normalAndDepthsCurrent, const Image &normalAndDepthsPrevious, const Image &aoPrevious, Image &aoOutput, AOPassStats* stats)
+{
+	renderAO(scheduler, [&]() -> const BVH8& { return bvh; }, view, rtao, samples, normalAndDepthsCurrent, normalAndDepthsPrevious, aoPrevious,
+		aoOutput, stats);
+}
+
+void Render_AO(TaskScheduler &scheduler, const NumaReplicas<BVH8> &bvh, const ViewCB &view, const RtaoCB &rtao, const vector<XMFLOAT3> &samples,
+	const Image &normalAndDepthsCurrent, const Image &normalAndDepthsPrevious, const Image &aoPrevious, Image &aoOutput, AOPassStats* stats)
+{
+	renderAO(scheduler, [&]() -> const BVH8& { return bvh.Get(); }, view, rtao, samples, normalAndDepthsCurrent, normalAndDepthsPrevious, aoPrevious,
+		aoOutput, stats);
+}
+
+}
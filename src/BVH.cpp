@@ -0,0 +1,1412 @@
+// RTAO - CPU bounding volume hierarchy
+#include "BVH.h"
+
+#include <chrono>
+#include <intrin.h>
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Binned SAH Builder
+//--------------------------------------------------------------------------------------
+
+#define BVH_MAX_BINS 64
+
+// Ranges larger than this are bounded and binned in parallel
+static const size_t parallelRangeThreshold = 64 * 1024;
+static const size_t parallelChunkSize = 16 * 1024;
+
+// Subtrees larger than this are built as separate tasks
+static const size_t taskThreshold = 4 * 1024;
+
+// Deeper nodes are split at the object median, which bounds the tree depth (and traversal stack) for any input
+static const int maxSAHDepth = 48;
+
+struct PrimitiveRef
+{
+	AABB bounds;
+	uint32_t index;
+
+	float Centroid(int axis) const { return 0.5f * (Component(bounds.min, axis) + Component(bounds.max, axis)); }
+};
+
+struct Bin
+{
+	AABB bounds;
+	uint32_t count;
+};
+
+static inline void resetBins(Bin (&bins)[3][BVH_MAX_BINS], int binsCount)
+{
+	for (int axis = 0; axis < 3; axis++) {
+		for (int b = 0; b < binsCount; b++) {
+			bins[axis][b].bounds = AABB();
+			bins[axis][b].count = 0;
+		}
+	}
+}
+
+struct SplitInfo
+{
+	int axis;
+	int bin;		//< Primitives in bins [0, bin] go to the left child
+	float cost;		//< Sum of child areas weighted by their primitive counts
+	AABB leftBounds;
+	AABB rightBounds;
+};
+
+struct BuildContext
+{
+	TaskScheduler* scheduler;
+	const BVHBuildInfo* info;
+	vector<BVHNode>* nodes;
+
+	vector<PrimitiveRef> refs;
+	std::atomic<uint32_t> nodesCount;
+	std::atomic<uint32_t> leavesCount;
+};
+
+static inline int binIndex(const PrimitiveRef &ref, int axis, float centroidMin, float binScale, int binsCount)
+{
+	int bin = int((ref.Centroid(axis) - centroidMin) * binScale);
+	return min(max(bin, 0), binsCount - 1);
+}
+
+/**
+* Compute bounds of primitives and of their centroids in the range.
+*/
+static void computeBounds(BuildContext &context, const PrimitiveRef* refs, size_t begin, size_t end, AABB &bounds, AABB &centroidBounds)
+{
+	auto accumulate = [refs](size_t first, size_t last, AABB &b, AABB &c) {
+		for (size_t i = first; i < last; i++) {
+			const PrimitiveRef &ref = refs[i];
+			b.Grow(ref.bounds);
+			c.Grow(ref.bounds.Center());
+		}
+	};
+
+	if (end - begin < parallelRangeThreshold) {
+		accumulate(begin, end, bounds, centroidBounds);
+		return;
+	}
+
+	size_t chunksCount = (end - begin + parallelChunkSize - 1) / parallelChunkSize;
+	vector<AABB> chunkBounds(chunksCount), chunkCentroidBounds(chunksCount);
+
+	context.scheduler->ParallelFor(chunksCount, 1, [&](size_t firstChunk, size_t lastChunk) {
+		for (size_t c = firstChunk; c < lastChunk; c++)
+			accumulate(begin + c * parallelChunkSize, min(begin + (c + 1) * parallelChunkSize, end), chunkBounds[c], chunkCentroidBounds[c]);
+	});
+
+	for (size_t c = 0; c < chunksCount; c++) {
+		bounds.Grow(chunkBounds[c]);
+		centroidBounds.Grow(chunkCentroidBounds[c]);
+	}
+}
+
+/**
+* Find the best binned SAH split of the range, axis is -1 when primitives can't be separated by centroids.
+*/
+static SplitInfo findBestSplit(BuildContext &context, const PrimitiveRef* refs, size_t begin, size_t end, const AABB &centroidBounds)
+{
+	const int binsCount = min(max(context.info->binsCount, 2), BVH_MAX_BINS);
+
+	XMFLOAT3 extent = centroidBounds.Extent();
+	float binScales[3];
+	for (int axis = 0; axis < 3; axis++) {
+		float axisExtent = Component(extent, axis);
+		binScales[axis] = axisExtent > 0.0f ? (binsCount * 0.99999f) / axisExtent : 0.0f;
+	}
+
+	// Fill bins of all three axes
+	auto fillBins = [&](size_t first, size_t last, Bin (&bins)[3][BVH_MAX_BINS]) {
+		resetBins(bins, binsCount);
+		for (size_t i = first; i < last; i++) {
+			const PrimitiveRef &ref = refs[i];
+			for (int axis = 0; axis < 3; axis++) {
+				Bin &bin = bins[axis][binIndex(ref, axis, Component(centroidBounds.min, axis), binScales[axis], binsCount)];
+				bin.bounds.Grow(ref.bounds);
+				bin.count++;
+			}
+		}
+	};
+
+	Bin bins[3][BVH_MAX_BINS];
+
+	if (end - begin < parallelRangeThreshold) {
+		fillBins(begin, end, bins);
+	} else {
+		size_t chunksCount = (end - begin + parallelChunkSize - 1) / parallelChunkSize;
+		vector<Bin> chunkBins(chunksCount * 3 * BVH_MAX_BINS);
+
+		context.scheduler->ParallelFor(chunksCount, 1, [&](size_t firstChunk, size_t lastChunk) {
+			for (size_t c = firstChunk; c < lastChunk; c++) {
+				Bin localBins[3][BVH_MAX_BINS];
+				fillBins(begin + c * parallelChunkSize, min(begin + (c + 1) * parallelChunkSize, end), localBins);
+				memcpy(&chunkBins[c * 3 * BVH_MAX_BINS], localBins, sizeof(localBins));
+			}
+		});
+
+		resetBins(bins, binsCount);
+		for (size_t c = 0; c < chunksCount; c++) {
+			for (int axis = 0; axis < 3; axis++) {
+				for (int b = 0; b < binsCount; b++) {
+					const Bin &chunkBin = chunkBins[(c * 3 + axis) * BVH_MAX_BINS + b];
+					bins[axis][b].bounds.Grow(chunkBin.bounds);
+					bins[axis][b].count += chunkBin.count;
+				}
+			}
+		}
+	}
+
+	// Sweep the bins from both sides and evaluate SAH of every split plane
+	SplitInfo best;
+	best.axis = -1;
+	best.bin = 0;
+	best.cost = FLT_MAX;
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (binScales[axis] == 0.0f) continue;
+
+		float rightCosts[BVH_MAX_BINS];
+		AABB rightBounds[BVH_MAX_BINS];
+		uint32_t rightCount = 0;
+		for (int b = binsCount - 1; b > 0; b--) {
+			if (b < binsCount - 1) rightBounds[b] = rightBounds[b + 1];
+			rightBounds[b].Grow(bins[axis][b].bounds);
+			rightCount += bins[axis][b].count;
+			rightCosts[b] = rightBounds[b].SurfaceArea() * rightCount;
+		}
+
+		AABB leftBounds;
+		uint32_t leftCount = 0;
+		for (int b = 0; b < binsCount - 1; b++) {
+			leftBounds.Grow(bins[axis][b].bounds);
+			leftCount += bins[axis][b].count;
+
+			if (leftCount == 0 || leftCount == (end - begin)) continue;
+
+			float cost = leftBounds.SurfaceArea() * leftCount + rightCosts[b + 1];
+			if (cost < best.cost) {
+				best.axis = axis;
+				best.bin = b;
+				best.cost = cost;
+				best.leftBounds = leftBounds;
+				best.rightBounds = rightBounds[b + 1];
+			}
+		}
+	}
+
+	return best;
+}
+
+static void buildNode(BuildContext &context, uint32_t nodeIndex, size_t begin, size_t end, int depth, TaskGroup &group)
+{
+	const BVHBuildInfo &info = *context.info;
+	BVHNode &node = (*context.nodes)[nodeIndex];
+	size_t count = end - begin;
+
+	AABB bounds, centroidBounds;
+	computeBounds(context, context.refs.data(), begin, end, bounds, centroidBounds);
+
+	node.boundsMin = bounds.min;
+	node.boundsMax = bounds.max;
+
+	auto makeLeaf = [&]() {
+		node.leftFirst = (uint32_t)begin;
+		node.count = (uint32_t)count;
+		context.leavesCount++;
+	};
+
+	if (count <= (size_t)max(info.leafSize, 1)) {
+		makeLeaf();
+		return;
+	}
+
+	size_t middle = begin;
+
+	if (depth < maxSAHDepth) {
+		SplitInfo split = findBestSplit(context, context.refs.data(), begin, end, centroidBounds);
+
+		if (split.axis >= 0) {
+			const int binsCount = min(max(info.binsCount, 2), BVH_MAX_BINS);
+			float centroidMin = Component(centroidBounds.min, split.axis);
+			float binScale = (binsCount * 0.99999f) / Component(centroidBounds.Extent(), split.axis);
+
+			auto it = std::partition(context.refs.begin() + begin, context.refs.begin() + end, [&](const PrimitiveRef &ref) {
+				return binIndex(ref, split.axis, centroidMin, binScale, binsCount) <= split.bin;
+			});
+			middle = it - context.refs.begin();
+		}
+	}
+
+	if (middle == begin || middle == end) {
+		// Fall back to object median split along the largest centroid extent
+		XMFLOAT3 extent = centroidBounds.Extent();
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+
+		middle = begin + count / 2;
+		std::nth_element(context.refs.begin() + begin, context.refs.begin() + middle, context.refs.begin() + end, [axis](const PrimitiveRef &a, const PrimitiveRef &b) {
+			return a.Centroid(axis) < b.Centroid(axis);
+		});
+	}
+
+	// Children are always allocated as a pair, right child follows the left one
+	uint32_t leftIndex = context.nodesCount.fetch_add(2);
+	node.leftFirst = leftIndex;
+	node.count = 0;
+
+	if (count > taskThreshold) {
+		context.scheduler->Run(group, [&context, &group, leftIndex, begin, middle, depth]() {
+			buildNode(context, leftIndex, begin, middle, depth + 1, group);
+		});
+		buildNode(context, leftIndex + 1, middle, end, depth + 1, group);
+	} else {
+		buildNode(context, leftIndex, begin, middle, depth + 1, group);
+		buildNode(context, leftIndex + 1, middle, end, depth + 1, group);
+	}
+}
+
+/**
+* Binned SAH build over primitive bounds. Top levels bin in parallel, subtrees are built as parallel tasks.
+*/
+void Build_BVH_Nodes(TaskScheduler &scheduler, const vector<AABB> &bounds, const BVHBuildInfo &info, vector<BVHNode> &nodes, vector<uint32_t> &order, BVHBuildStats &stats)
+{
+	size_t primitivesCount = bounds.size();
+
+	nodes.clear();
+	order.clear();
+
+	if (primitivesCount == 0) return;
+
+	BuildContext context;
+	context.scheduler = &scheduler;
+	context.info = &info;
+	context.nodes = &nodes;
+	context.nodesCount = 1;
+	context.leavesCount = 0;
+	context.refs.resize(primitivesCount);
+
+	scheduler.ParallelFor(primitivesCount, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			context.refs[i].bounds = bounds[i];
+			context.refs[i].index = (uint32_t)i;
+		}
+	});
+
+	// Binary tree with single-primitive leaves is the largest possible one
+	nodes.resize(2 * primitivesCount - 1);
+
+	TaskGroup group;
+	buildNode(context, 0, 0, primitivesCount, 0, group);
+	scheduler.Wait(group);
+
+	nodes.resize(context.nodesCount);
+	nodes.shrink_to_fit();
+
+	order.resize(primitivesCount);
+	for (size_t i = 0; i < primitivesCount; i++) order[i] = context.refs[i].index;
+
+	stats.nodesCount = context.nodesCount;
+	stats.leavesCount = context.leavesCount;
+}
+
+//--------------------------------------------------------------------------------------
+// Spatial Split Builder (SBVH)
+//--------------------------------------------------------------------------------------
+
+struct SpatialBin
+{
+	AABB bounds;
+	uint32_t entries;		//< References whose bounds start in the bin
+	uint32_t exits;			//< References whose bounds end in the bin
+};
+
+struct SpatialSplitInfo
+{
+	int axis;
+	float position;
+	float cost;				//< Same units as SplitInfo cost
+};
+
+// References are owned by nodes (duplication changes their counts), leaves append theirs to the shared leaf order
+struct SpatialBuildContext : BuildContext
+{
+	const Model* model;
+	vector<uint32_t>* order;
+
+	float minOverlapArea;					//< Spatial splits are only searched where object split children overlap more
+	size_t maxReferences;					//< Triangles plus the duplication budget
+	std::atomic<size_t> referencesCount;	//< Including reserved duplicates
+	std::atomic<size_t> leafReferences;		//< References written to order
+};
+
+static inline XMFLOAT3 triangleVertex(const Model &model, uint32_t triangleIndex, int vertex)
+{
+	return model.vertices[model.indices[triangleIndex * 3 + vertex]].position;
+}
+
+static inline void setComponent(XMFLOAT3 &a, int axis, float value)
+{
+	if (axis == 0) a.x = value;
+	else if (axis == 1) a.y = value;
+	else a.z = value;
+}
+
+static inline AABB intersectBounds(const AABB &a, const AABB &b)
+{
+	AABB result;
+	result.min = Max3(a.min, b.min);
+	result.max = Min3(a.max, b.max);
+	return result;
+}
+
+/**
+* Split the reference by the plane: both halves bound the part of the triangle on their side (vertices and edge crossings),
+* clipped by the reference's current bounds.
+*/
+static void splitReference(const SpatialBuildContext &context, const PrimitiveRef &ref, int axis, float position, PrimitiveRef &left, PrimitiveRef &right)
+{
+	AABB leftBounds, rightBounds;
+
+	for (int i = 0; i < 3; i++) {
+		XMFLOAT3 v0 = triangleVertex(*context.model, ref.index, i);
+		XMFLOAT3 v1 = triangleVertex(*context.model, ref.index, (i + 1) % 3);
+		float p0 = Component(v0, axis);
+		float p1 = Component(v1, axis);
+
+		if (p0 <= position) leftBounds.Grow(v0);
+		if (p0 >= position) rightBounds.Grow(v0);
+
+		if ((p0 < position && p1 > position) || (p0 > position && p1 < position)) {
+			float t = (position - p0) / (p1 - p0);
+			XMFLOAT3 crossing = Add(v0, Mul(Sub(v1, v0), t));
+			setComponent(crossing, axis, position);
+			leftBounds.Grow(crossing);
+			rightBounds.Grow(crossing);
+		}
+	}
+
+	left.index = ref.index;
+	left.bounds = intersectBounds(leftBounds, ref.bounds);
+	right.index = ref.index;
+	right.bounds = intersectBounds(rightBounds, ref.bounds);
+}
+
+/**
+* Chop every reference into the spatial bins it overlaps and evaluate SAH of the planes between bins (entries count to the
+* left, exits to the right, so straddling references are counted on both sides).
+*/
+static SpatialSplitInfo findSpatialSplit(const SpatialBuildContext &context, const vector<PrimitiveRef> &refs, const AABB &bounds)
+{
+	const int binsCount = min(max(context.info->binsCount, 2), BVH_MAX_BINS);
+
+	SpatialSplitInfo best;
+	best.axis = -1;
+	best.position = 0.0f;
+	best.cost = FLT_MAX;
+
+	for (int axis = 0; axis < 3; axis++) {
+		float origin = Component(bounds.min, axis);
+		float binSize = Component(bounds.Extent(), axis) / binsCount;
+		if (binSize <= 0.0f) continue;
+
+		SpatialBin bins[BVH_MAX_BINS];
+		for (int b = 0; b < binsCount; b++) {
+			bins[b].entries = 0;
+			bins[b].exits = 0;
+		}
+
+		for (const PrimitiveRef &ref : refs) {
+			int firstBin = min(max(int((Component(ref.bounds.min, axis) - origin) / binSize), 0), binsCount - 1);
+			int lastBin = min(max(int((Component(ref.bounds.max, axis) - origin) / binSize), firstBin), binsCount - 1);
+
+			PrimitiveRef current = ref;
+			for (int b = firstBin; b < lastBin; b++) {
+				PrimitiveRef left, right;
+				splitReference(context, current, axis, origin + (b + 1) * binSize, left, right);
+				bins[b].bounds.Grow(left.bounds);
+				current = right;
+			}
+
+			bins[lastBin].bounds.Grow(current.bounds);
+			bins[firstBin].entries++;
+			bins[lastBin].exits++;
+		}
+
+		float rightCosts[BVH_MAX_BINS];
+		AABB rightBounds;
+		uint32_t rightCount = 0;
+		for (int b = binsCount - 1; b > 0; b--) {
+			rightBounds.Grow(bins[b].bounds);
+			rightCount += bins[b].exits;
+			rightCosts[b] = rightCount > 0 ? rightBounds.SurfaceArea() * rightCount : -1.0f;
+		}
+
+		AABB leftBounds;
+		uint32_t leftCount = 0;
+		for (int b = 0; b < binsCount - 1; b++) {
+			leftBounds.Grow(bins[b].bounds);
+			leftCount += bins[b].entries;
+
+			if (leftCount == 0 || rightCosts[b + 1] < 0.0f) continue;
+
+			float cost = leftBounds.SurfaceArea() * leftCount + rightCosts[b + 1];
+			if (cost < best.cost) {
+				best.axis = axis;
+				best.position = origin + (b + 1) * binSize;
+				best.cost = cost;
+			}
+		}
+	}
+
+	return best;
+}
+
+/**
+* Distribute references by the plane. Straddling ones are duplicated unless putting them wholly on one side is cheaper
+* (reference unsplitting). Returns false when the duplication budget is exhausted or a side would end up empty.
+*/
+static bool performSpatialSplit(SpatialBuildContext &context, const vector<PrimitiveRef> &refs, const SpatialSplitInfo &split,
+	vector<PrimitiveRef> &left, vector<PrimitiveRef> &right)
+{
+	AABB leftBounds, rightBounds;
+	vector<uint32_t> straddling;
+
+	for (uint32_t i = 0; i < (uint32_t)refs.size(); i++) {
+		const PrimitiveRef &ref = refs[i];
+		if (Component(ref.bounds.max, split.axis) <= split.position) {
+			left.push_back(ref);
+			leftBounds.Grow(ref.bounds);
+		} else if (Component(ref.bounds.min, split.axis) >= split.position) {
+			right.push_back(ref);
+			rightBounds.Grow(ref.bounds);
+		} else {
+			straddling.push_back(i);
+		}
+	}
+
+	// Reserve the worst case, unsplit references give their share back
+	size_t reserved = straddling.size();
+	if (context.referencesCount.fetch_add(reserved) + reserved > context.maxReferences) {
+		context.referencesCount -= reserved;
+		left.clear();
+		right.clear();
+		return false;
+	}
+
+	size_t duplicates = 0;
+
+	for (uint32_t i : straddling) {
+		const PrimitiveRef &ref = refs[i];
+		PrimitiveRef leftPart, rightPart;
+		splitReference(context, ref, split.axis, split.position, leftPart, rightPart);
+
+		AABB leftSplit = leftBounds, rightSplit = rightBounds, leftWhole = leftBounds, rightWhole = rightBounds;
+		leftSplit.Grow(leftPart.bounds);
+		rightSplit.Grow(rightPart.bounds);
+		leftWhole.Grow(ref.bounds);
+		rightWhole.Grow(ref.bounds);
+
+		float leftCount = float(left.size());
+		float rightCount = float(right.size());
+		float splitCost = leftSplit.SurfaceArea() * (leftCount + 1) + rightSplit.SurfaceArea() * (rightCount + 1);
+		float leftCost = leftWhole.SurfaceArea() * (leftCount + 1) + rightBounds.SurfaceArea() * rightCount;
+		float rightCost = leftBounds.SurfaceArea() * leftCount + rightWhole.SurfaceArea() * (rightCount + 1);
+
+		if (splitCost < leftCost && splitCost < rightCost && !leftPart.bounds.IsEmpty() && !rightPart.bounds.IsEmpty()) {
+			left.push_back(leftPart);
+			right.push_back(rightPart);
+			leftBounds = leftSplit;
+			rightBounds = rightSplit;
+			duplicates++;
+		} else if (leftCost <= rightCost) {
+			left.push_back(ref);
+			leftBounds = leftWhole;
+		} else {
+			right.push_back(ref);
+			rightBounds = rightWhole;
+		}
+	}
+
+	if (left.empty() || right.empty()) {
+		context.referencesCount -= reserved;
+		left.clear();
+		right.clear();
+		return false;
+	}
+
+	context.referencesCount -= reserved - duplicates;
+	return true;
+}
+
+static void buildSpatialNode(SpatialBuildContext &context, uint32_t nodeIndex, vector<PrimitiveRef> &refs, int depth, TaskGroup &group)
+{
+	const BVHBuildInfo &info = *context.info;
+	BVHNode &node = (*context.nodes)[nodeIndex];
+	size_t count = refs.size();
+
+	AABB bounds, centroidBounds;
+	computeBounds(context, refs.data(), 0, count, bounds, centroidBounds);
+
+	node.boundsMin = bounds.min;
+	node.boundsMax = bounds.max;
+
+	if (count <= (size_t)max(info.leafSize, 1)) {
+		size_t first = context.leafReferences.fetch_add(count);
+		for (size_t i = 0; i < count; i++) (*context.order)[first + i] = refs[i].index;
+
+		node.leftFirst = (uint32_t)first;
+		node.count = (uint32_t)count;
+		context.leavesCount++;
+		return;
+	}
+
+	vector<PrimitiveRef> left, right;
+
+	if (depth < maxSAHDepth) {
+		SplitInfo objectSplit = findBestSplit(context, refs.data(), 0, count, centroidBounds);
+
+		// Spatial splits pay off only where children of the object split overlap
+		bool searchSpatial = objectSplit.axis < 0 || intersectBounds(objectSplit.leftBounds, objectSplit.rightBounds).SurfaceArea() > context.minOverlapArea;
+
+		SpatialSplitInfo spatialSplit;
+		spatialSplit.cost = FLT_MAX;
+		if (searchSpatial && context.referencesCount < context.maxReferences) spatialSplit = findSpatialSplit(context, refs, bounds);
+
+		if (spatialSplit.cost < objectSplit.cost && performSpatialSplit(context, refs, spatialSplit, left, right)) {
+			// Done
+		} else if (objectSplit.axis >= 0) {
+			const int binsCount = min(max(info.binsCount, 2), BVH_MAX_BINS);
+			float centroidMin = Component(centroidBounds.min, objectSplit.axis);
+			float binScale = (binsCount * 0.99999f) / Component(centroidBounds.Extent(), objectSplit.axis);
+
+			for (const PrimitiveRef &ref : refs) {
+				if (binIndex(ref, objectSplit.axis, centroidMin, binScale, binsCount) <= objectSplit.bin) left.push_back(ref);
+				else right.push_back(ref);
+			}
+		}
+	}
+
+	if (left.empty() || right.empty()) {
+		// Object median split along the largest centroid extent
+		XMFLOAT3 extent = centroidBounds.Extent();
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+
+		size_t middle = count / 2;
+		std::nth_element(refs.begin(), refs.begin() + middle, refs.end(), [axis](const PrimitiveRef &a, const PrimitiveRef &b) {
+			return a.Centroid(axis) < b.Centroid(axis);
+		});
+
+		left.assign(refs.begin(), refs.begin() + middle);
+		right.assign(refs.begin() + middle, refs.end());
+	}
+
+	// Parent's references are not needed any more
+	vector<PrimitiveRef>().swap(refs);
+
+	uint32_t leftIndex = context.nodesCount.fetch_add(2);
+	node.leftFirst = leftIndex;
+	node.count = 0;
+
+	if (count > taskThreshold) {
+		auto leftRefs = std::make_shared<vector<PrimitiveRef>>(std::move(left));
+		context.scheduler->Run(group, [&context, &group, leftIndex, leftRefs, depth]() {
+			buildSpatialNode(context, leftIndex, *leftRefs, depth + 1, group);
+		});
+	} else {
+		buildSpatialNode(context, leftIndex, left, depth + 1, group);
+	}
+
+	buildSpatialNode(context, leftIndex + 1, right, depth + 1, group);
+}
+
+/**
+* SBVH build over triangles of the model with the given bounds, order receives triangle indices in leaf order (with duplicates).
+*/
+static void buildSpatialNodes(TaskScheduler &scheduler, const Model &model, const vector<AABB> &bounds, const BVHBuildInfo &info,
+	vector<BVHNode> &nodes, vector<uint32_t> &order, BVHBuildStats &stats)
+{
+	size_t trianglesCount = bounds.size();
+
+	nodes.clear();
+	order.clear();
+
+	if (trianglesCount == 0) return;
+
+	SpatialBuildContext context;
+	context.scheduler = &scheduler;
+	context.info = &info;
+	context.nodes = &nodes;
+	context.nodesCount = 1;
+	context.leavesCount = 0;
+	context.model = &model;
+	context.order = &order;
+	context.maxReferences = trianglesCount + size_t(trianglesCount * max(info.duplicationBudget, 0.0f));
+	context.referencesCount = trianglesCount;
+	context.leafReferences = 0;
+
+	vector<PrimitiveRef> refs(trianglesCount);
+	AABB sceneBounds;
+	for (size_t i = 0; i < trianglesCount; i++) {
+		refs[i].bounds = bounds[i];
+		refs[i].index = (uint32_t)i;
+		sceneBounds.Grow(bounds[i]);
+	}
+
+	context.minOverlapArea = info.spatialSplitAlpha * sceneBounds.SurfaceArea();
+
+	nodes.resize(2 * context.maxReferences - 1);
+	order.resize(context.maxReferences);
+
+	TaskGroup group;
+	buildSpatialNode(context, 0, refs, 0, group);
+	scheduler.Wait(group);
+
+	nodes.resize(context.nodesCount);
+	nodes.shrink_to_fit();
+	order.resize(context.leafReferences);
+	order.shrink_to_fit();
+
+	stats.nodesCount = context.nodesCount;
+	stats.leavesCount = context.leavesCount;
+}
+
+//--------------------------------------------------------------------------------------
+// Linear Builder (LBVH)
+//--------------------------------------------------------------------------------------
+
+// Bits of the sort key per axis, 63 bits keep nearby triangles of dense meshes apart
+static const int mortonAxisBits = 21;
+
+// Radix sort digit (6 passes over 63-bit keys) and the size of chunks sorted by one task per pass
+static const int radixBits = 11;
+static const size_t radixChunkSize = 64 * 1024;
+
+// Treelet restructuring works on this many treelet leaves (the optimal topology search visits 3^7 subset pairs), rooted at nodes
+// of at least 4 leaves worth of primitives: smaller treelets mostly end up inside collapsed leaves and would halve the pass speed
+static const int treeletLeaves = 7;
+static const int treeletMinLeaves = 4;
+
+// Spread the low 21 bits so that two zero bits follow each of them
+static inline uint64_t expandBits(uint64_t value)
+{
+	value &= 0x1fffff;
+	value = (value | (value << 32)) & 0x1f00000000ffffull;
+	value = (value | (value << 16)) & 0x1f0000ff0000ffull;
+	value = (value | (value << 8)) & 0x100f00f00f00f00full;
+	value = (value | (value << 4)) & 0x10c30c30c30c30c3ull;
+	value = (value | (value << 2)) & 0x1249249249249249ull;
+	return value;
+}
+
+static inline int countLeadingZeros(uint64_t value)
+{
+	unsigned long index;
+	return _BitScanReverse64(&index, value) ? 63 - int(index) : 64;
+}
+
+/**
+* Sort 64-bit keys with their values by stable least significant digit passes. Every pass counts digits of chunks in parallel,
+* then scatters each chunk into its own slots of every digit. Passes over digits all keys share are skipped.
+*/
+static void radixSort(TaskScheduler &scheduler, vector<uint64_t> &keys, vector<uint32_t> &values)
+{
+	const size_t count = keys.size();
+	const size_t digitsCount = size_t(1) << radixBits;
+	const size_t chunksCount = (count + radixChunkSize - 1) / radixChunkSize;
+
+	vector<uint64_t> keysOut(count);
+	vector<uint32_t> valuesOut(count);
+	vector<size_t> offsets(chunksCount * digitsCount);
+
+	for (int shift = 0; shift < 64; shift += radixBits) {
+		std::fill(offsets.begin(), offsets.end(), 0);
+
+		scheduler.ParallelFor(chunksCount, 1, [&](size_t firstChunk, size_t lastChunk) {
+			for (size_t c = firstChunk; c < lastChunk; c++) {
+				size_t* histogram = &offsets[c * digitsCount];
+				for (size_t i = c * radixChunkSize; i < min((c + 1) * radixChunkSize, count); i++) histogram[(keys[i] >> shift) & (digitsCount - 1)]++;
+			}
+		});
+
+		// Exclusive prefix sum in digit major order, so chunks of a digit follow each other
+		size_t sum = 0;
+		bool uniform = false;
+		for (size_t digit = 0; digit < digitsCount; digit++) {
+			size_t digitCount = 0;
+			for (size_t c = 0; c < chunksCount; c++) {
+				size_t chunkCount = offsets[c * digitsCount + digit];
+				offsets[c * digitsCount + digit] = sum;
+				sum += chunkCount;
+				digitCount += chunkCount;
+			}
+			if (digitCount == count) uniform = true;
+		}
+
+		if (uniform) continue;
+
+		scheduler.ParallelFor(chunksCount, 1, [&](size_t firstChunk, size_t lastChunk) {
+			for (size_t c = firstChunk; c < lastChunk; c++) {
+				size_t* offset = &offsets[c * digitsCount];
+				for (size_t i = c * radixChunkSize; i < min((c + 1) * radixChunkSize, count); i++) {
+					size_t slot = offset[(keys[i] >> shift) & (digitsCount - 1)]++;
+					keysOut[slot] = keys[i];
+					valuesOut[slot] = values[i];
+				}
+			}
+		});
+
+		keys.swap(keysOut);
+		values.swap(valuesOut);
+	}
+}
+
+/**
+* Binary radix tree over the sorted keys (Karras 2012): n - 1 inner nodes followed by n single primitive leaves, the root is node 0.
+* Bounds, primitive counts and SAH costs are filled bottom-up, treelet restructuring rewrites inner nodes in place.
+*/
+struct RadixTree
+{
+	size_t primitivesCount;
+	vector<uint32_t> children;		//< Left and right child of every inner node
+	vector<uint32_t> parents;		//< Of all nodes, UINT32_MAX for the root
+	vector<AABB> bounds;
+	vector<uint32_t> counts;		//< Primitives in the subtree
+	vector<float> costs;			//< SAH cost of the subtree as the emitted tree will have it (small subtrees collapse into leaves)
+	vector<std::atomic<uint32_t>> visits;
+
+	bool IsLeaf(uint32_t node) const { return node >= primitivesCount - 1; }
+};
+
+/**
+* Length of the common key prefix of sorted primitives i and j, or -1 when j is out of range. Equal keys fall back to the
+* indices, so duplicate codes still make a valid tree.
+*/
+static inline int commonPrefix(const vector<uint64_t> &keys, int64_t i, int64_t j)
+{
+	if (j < 0 || j >= (int64_t)keys.size()) return -1;
+	if (keys[i] == keys[j]) return 64 + countLeadingZeros(uint64_t(i ^ j));
+	return countLeadingZeros(keys[i] ^ keys[j]);
+}
+
+/**
+* Find the range the inner node covers and the split inside it, all inner nodes are independent of each other.
+*/
+static void emitRadixNode(const vector<uint64_t> &keys, RadixTree &tree, int64_t i)
+{
+	// Direction of the range from the prefix shared with neighbors
+	int direction = commonPrefix(keys, i, i + 1) - commonPrefix(keys, i, i - 1) >= 0 ? 1 : -1;
+	int minPrefix = commonPrefix(keys, i, i - direction);
+
+	int64_t maxLength = 2;
+	while (commonPrefix(keys, i, i + maxLength * direction) > minPrefix) maxLength *= 2;
+
+	int64_t length = 0;
+	for (int64_t step = maxLength / 2; step > 0; step /= 2) {
+		if (commonPrefix(keys, i, i + (length + step) * direction) > minPrefix) length += step;
+	}
+	int64_t j = i + length * direction;
+
+	// Highest differing bit of the range splits it
+	int nodePrefix = commonPrefix(keys, i, j);
+	int64_t split = 0;
+	for (int64_t step = (length + 1) / 2; ; step = (step + 1) / 2) {
+		if (commonPrefix(keys, i, i + (split + step) * direction) > nodePrefix) split += step;
+		if (step == 1) break;
+	}
+	int64_t gamma = i + split * direction + min(direction, 0);
+
+	const uint32_t leafBase = uint32_t(tree.primitivesCount - 1);
+	uint32_t left = (min(i, j) == gamma) ? leafBase + uint32_t(gamma) : uint32_t(gamma);
+	uint32_t right = (max(i, j) == gamma + 1) ? leafBase + uint32_t(gamma + 1) : uint32_t(gamma + 1);
+
+	tree.children[i * 2 + 0] = left;
+	tree.children[i * 2 + 1] = right;
+	tree.parents[left] = uint32_t(i);
+	tree.parents[right] = uint32_t(i);
+}
+
+static inline float subtreeCost(const BVHBuildInfo &info, const AABB &bounds, uint32_t count, float childrenCost)
+{
+	float area = bounds.SurfaceArea();
+	if (count <= (uint32_t)max(info.leafSize, 1)) return info.intersectionCost * area * count;
+	return info.traversalCost * area + childrenCost;
+}
+
+static void updateRadixNode(const BVHBuildInfo &info, RadixTree &tree, uint32_t node)
+{
+	uint32_t left = tree.children[node * 2 + 0];
+	uint32_t right = tree.children[node * 2 + 1];
+
+	tree.bounds[node] = tree.bounds[left];
+	tree.bounds[node].Grow(tree.bounds[right]);
+	tree.counts[node] = tree.counts[left] + tree.counts[right];
+	tree.costs[node] = subtreeCost(info, tree.bounds[node], tree.counts[node], tree.costs[left] + tree.costs[right]);
+}
+
+/**
+* Replace the topology below the node by the SAH optimal one over its treelet (Karras and Aila 2013). The treelet grows from the
+* node by expanding the largest inner treelet leaf, its inner nodes are reused for the new topology.
+*/
+static void restructureTreelet(const BVHBuildInfo &info, RadixTree &tree, uint32_t root)
+{
+	const int subsetsCount = 1 << treeletLeaves;
+
+	uint32_t leaves[treeletLeaves];
+	uint32_t inners[treeletLeaves - 1];
+	int leavesCount = 2, innersCount = 1;
+	leaves[0] = tree.children[root * 2 + 0];
+	leaves[1] = tree.children[root * 2 + 1];
+	inners[0] = root;
+
+	while (leavesCount < treeletLeaves) {
+		int largest = -1;
+		float largestArea = -1.0f;
+		for (int i = 0; i < leavesCount; i++) {
+			if (tree.IsLeaf(leaves[i])) continue;
+			float area = tree.bounds[leaves[i]].SurfaceArea();
+			if (area > largestArea) {
+				largest = i;
+				largestArea = area;
+			}
+		}
+		if (largest < 0) break;
+
+		uint32_t expanded = leaves[largest];
+		inners[innersCount++] = expanded;
+		leaves[largest] = tree.children[expanded * 2 + 0];
+		leaves[leavesCount++] = tree.children[expanded * 2 + 1];
+	}
+
+	if (leavesCount < 3) return;
+
+	// Optimal cost and split of every subset of treelet leaves. Proper subsets are numerically smaller, so increasing order
+	// visits both halves of a subset before it.
+	const int fullSet = (1 << leavesCount) - 1;
+	float costs[subsetsCount];
+	uint8_t splits[subsetsCount];
+	AABB bounds[subsetsCount];
+	uint32_t counts[subsetsCount];
+
+	for (int subset = 1; subset <= fullSet; subset++) {
+		int lowest = subset & -subset;
+		int leaf = 0;
+		while (lowest != (1 << leaf)) leaf++;
+
+		if (subset == lowest) {
+			bounds[subset] = tree.bounds[leaves[leaf]];
+			counts[subset] = tree.counts[leaves[leaf]];
+			costs[subset] = tree.costs[leaves[leaf]];
+			continue;
+		}
+
+		bounds[subset] = bounds[subset ^ lowest];
+		bounds[subset].Grow(tree.bounds[leaves[leaf]]);
+		counts[subset] = counts[subset ^ lowest] + tree.counts[leaves[leaf]];
+
+		// Partitions where the lowest leaf goes left, each pair is visited once
+		int rest = subset ^ lowest;
+		float bestCost = FLT_MAX;
+		int bestSplit = lowest;
+		for (int other = (rest - 1) & rest; ; other = (other - 1) & rest) {
+			float cost = costs[lowest | other] + costs[rest ^ other];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = lowest | other;
+			}
+			if (other == 0) break;
+		}
+
+		costs[subset] = subtreeCost(info, bounds[subset], counts[subset], bestCost);
+		splits[subset] = (uint8_t)bestSplit;
+	}
+
+	if (costs[fullSet] >= tree.costs[root]) return;
+
+	// Rebuild top-down, the treelet root keeps its node and parent
+	struct Pending { uint32_t node; int subset; };
+	Pending pending[treeletLeaves];
+	uint32_t order[treeletLeaves - 1];
+	int pendingCount = 0, nextInner = 1, orderCount = 0;
+	pending[pendingCount++] = { root, fullSet };
+
+	while (pendingCount > 0) {
+		Pending entry = pending[--pendingCount];
+		order[orderCount++] = entry.node;
+
+		int halves[2] = { splits[entry.subset], entry.subset ^ splits[entry.subset] };
+		for (int side = 0; side < 2; side++) {
+			uint32_t child;
+			if ((halves[side] & (halves[side] - 1)) == 0) {
+				int leaf = 0;
+				while (halves[side] != (1 << leaf)) leaf++;
+				child = leaves[leaf];
+			} else {
+				child = inners[nextInner++];
+				pending[pendingCount++] = { child, halves[side] };
+			}
+			tree.children[entry.node * 2 + side] = child;
+			tree.parents[child] = entry.node;
+		}
+	}
+
+	// Children were rewritten before their parents' bounds, so update in reverse
+	for (int i = orderCount - 1; i >= 0; i--) updateRadixNode(info, tree, order[i]);
+}
+
+/**
+* Bottom-up pass from every leaf, the second visitor of an inner node continues to its parent (Apetrei 2014), so nodes are
+* updated after both children. Restructuring rewrites only the subtree below a node, which no other visitor touches any more.
+*/
+static void updateRadixTree(TaskScheduler &scheduler, const BVHBuildInfo &info, RadixTree &tree, bool restructure)
+{
+	const size_t primitivesCount = tree.primitivesCount;
+	const uint32_t leafBase = uint32_t(primitivesCount - 1);
+
+	for (auto &visits : tree.visits) visits = 0;
+
+	scheduler.ParallelFor(primitivesCount, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			uint32_t node = tree.parents[leafBase + i];
+
+			while (node != UINT32_MAX) {
+				if (tree.visits[node].fetch_add(1) == 0) break;
+
+				updateRadixNode(info, tree, node);
+				if (restructure && tree.counts[node] >= (uint32_t)max(treeletLeaves, treeletMinLeaves * info.leafSize)) restructureTreelet(info, tree, node);
+
+				node = tree.parents[node];
+			}
+		}
+	});
+}
+
+struct LinearBuildContext
+{
+	TaskScheduler* scheduler;
+	const BVHBuildInfo* info;
+	const RadixTree* tree;
+	const vector<uint32_t>* sortedPrimitives;
+	vector<BVHNode>* nodes;
+	vector<uint32_t>* order;
+	std::atomic<uint32_t> nodesCount;
+	std::atomic<uint32_t> leavesCount;
+};
+
+static void gatherPrimitives(const LinearBuildContext &context, uint32_t radixNode, uint32_t &offset)
+{
+	const RadixTree &tree = *context.tree;
+
+	if (tree.IsLeaf(radixNode)) {
+		(*context.order)[offset++] = (*context.sortedPrimitives)[radixNode - (tree.primitivesCount - 1)];
+		return;
+	}
+
+	gatherPrimitives(context, tree.children[radixNode * 2 + 0], offset);
+	gatherPrimitives(context, tree.children[radixNode * 2 + 1], offset);
+}
+
+/**
+* Emit the radix tree node as BVHNode at nodeIndex, subtrees of at most leafSize primitives collapse into leaves. Primitives of a
+* subtree take consecutive slots of the order starting at first.
+*/
+static void emitNode(LinearBuildContext &context, uint32_t radixNode, uint32_t nodeIndex, uint32_t first, TaskGroup &group)
+{
+	const RadixTree &tree = *context.tree;
+	BVHNode &node = (*context.nodes)[nodeIndex];
+	uint32_t count = tree.counts[radixNode];
+
+	node.boundsMin = tree.bounds[radixNode].min;
+	node.boundsMax = tree.bounds[radixNode].max;
+
+	if (count <= (uint32_t)max(context.info->leafSize, 1)) {
+		uint32_t offset = first;
+		gatherPrimitives(context, radixNode, offset);
+		node.leftFirst = first;
+		node.count = count;
+		context.leavesCount++;
+		return;
+	}
+
+	uint32_t left = tree.children[radixNode * 2 + 0];
+	uint32_t right = tree.children[radixNode * 2 + 1];
+	uint32_t rightFirst = first + tree.counts[left];
+
+	uint32_t leftIndex = context.nodesCount.fetch_add(2);
+	node.leftFirst = leftIndex;
+	node.count = 0;
+
+	if (count > taskThreshold) {
+		context.scheduler->Run(group, [&context, &group, left, leftIndex, first]() {
+			emitNode(context, left, leftIndex, first, group);
+		});
+		emitNode(context, right, leftIndex + 1, rightFirst, group);
+	} else {
+		emitNode(context, left, leftIndex, first, group);
+		emitNode(context, right, leftIndex + 1, rightFirst, group);
+	}
+}
+
+/**
+* LBVH build over primitive bounds: Morton codes of centroids, parallel radix sort, radix tree emitted for all inner nodes at once,
+* bottom-up bounds (and optional treelet restructuring passes), then the tree is written out in the BVHNode layout.
+*/
+static void buildLinearNodes(TaskScheduler &scheduler, const vector<AABB> &bounds, const BVHBuildInfo &info, vector<BVHNode> &nodes,
+	vector<uint32_t> &order, BVHBuildStats &stats)
+{
+	const size_t primitivesCount = bounds.size();
+
+	nodes.clear();
+	order.clear();
+
+	if (primitivesCount == 0) return;
+
+	// Centroid bounds, reduced over chunks
+	const size_t chunksCount = (primitivesCount + parallelChunkSize - 1) / parallelChunkSize;
+	vector<AABB> chunkBounds(chunksCount);
+
+	scheduler.ParallelFor(chunksCount, 1, [&](size_t firstChunk, size_t lastChunk) {
+		for (size_t c = firstChunk; c < lastChunk; c++) {
+			for (size_t i = c * parallelChunkSize; i < min((c + 1) * parallelChunkSize, primitivesCount); i++) chunkBounds[c].Grow(bounds[i].Center());
+		}
+	});
+
+	AABB centroidBounds;
+	for (const AABB &chunk : chunkBounds) centroidBounds.Grow(chunk);
+
+	XMFLOAT3 extent = centroidBounds.Extent();
+	const float cells = float(1 << mortonAxisBits);
+	XMFLOAT3 scale = XMFLOAT3(extent.x > 0.0f ? cells / extent.x : 0.0f, extent.y > 0.0f ? cells / extent.y : 0.0f, extent.z > 0.0f ? cells / extent.z : 0.0f);
+
+	vector<uint64_t> keys(primitivesCount);
+	vector<uint32_t> sortedPrimitives(primitivesCount);
+
+	scheduler.ParallelFor(primitivesCount, 4096, [&](size_t begin, size_t end) {
+		const float maxCell = cells - 1.0f;
+		for (size_t i = begin; i < end; i++) {
+			XMFLOAT3 offset = Sub(bounds[i].Center(), centroidBounds.min);
+			XMFLOAT3 cell = XMFLOAT3(offset.x * scale.x, offset.y * scale.y, offset.z * scale.z);
+			uint64_t x = (uint64_t)min(max(cell.x, 0.0f), maxCell);
+			uint64_t y = (uint64_t)min(max(cell.y, 0.0f), maxCell);
+			uint64_t z = (uint64_t)min(max(cell.z, 0.0f), maxCell);
+			keys[i] = (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+			sortedPrimitives[i] = (uint32_t)i;
+		}
+	});
+
+	radixSort(scheduler, keys, sortedPrimitives);
+
+	RadixTree tree;
+	tree.primitivesCount = primitivesCount;
+	tree.children.resize(2 * (primitivesCount - 1));
+	tree.parents.resize(2 * primitivesCount - 1);
+	tree.bounds.resize(2 * primitivesCount - 1);
+	tree.counts.resize(2 * primitivesCount - 1);
+	tree.costs.resize(2 * primitivesCount - 1);
+	tree.visits = vector<std::atomic<uint32_t>>(primitivesCount);
+	tree.parents[0] = UINT32_MAX;
+
+	const uint32_t leafBase = uint32_t(primitivesCount - 1);
+
+	scheduler.ParallelFor(primitivesCount, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			if (i + 1 < primitivesCount) emitRadixNode(keys, tree, (int64_t)i);
+
+			tree.bounds[leafBase + i] = bounds[sortedPrimitives[i]];
+			tree.counts[leafBase + i] = 1;
+			tree.costs[leafBase + i] = info.intersectionCost * bounds[sortedPrimitives[i]].SurfaceArea();
+		}
+	});
+
+	updateRadixTree(scheduler, info, tree, false);
+	for (int pass = 0; pass < info.treeletPasses; pass++) updateRadixTree(scheduler, info, tree, true);
+
+	// Write out the collapsed tree
+	nodes.resize(2 * primitivesCount - 1);
+	order.resize(primitivesCount);
+
+	LinearBuildContext context;
+	context.scheduler = &scheduler;
+	context.info = &info;
+	context.tree = &tree;
+	context.sortedPrimitives = &sortedPrimitives;
+	context.nodes = &nodes;
+	context.order = &order;
+	context.nodesCount = 1;
+	context.leavesCount = 0;
+
+	TaskGroup group;
+	emitNode(context, 0, 0, 0, group);
+	scheduler.Wait(group);
+
+	nodes.resize(context.nodesCount);
+	nodes.shrink_to_fit();
+
+	stats.nodesCount = context.nodesCount;
+	stats.leavesCount = context.leavesCount;
+}
+
+/**
+* Build BVH over triangles of the model using binned SAH, with spatial splits when info.spatialSplits is set, or as an LBVH when info.linear is.
+*/
+void Build_BVH(TaskScheduler &scheduler, const Model &model, const BVHBuildInfo &info, BVH &bvh)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	size_t trianglesCount = model.indices.size() / 3;
+
+	bvh.nodes.clear();
+	bvh.triangles.clear();
+	bvh.primitiveIndices.clear();
+	bvh.stats = BVHBuildStats();
+
+	if (trianglesCount == 0) return;
+
+	// Bound all triangles
+	vector<AABB> bounds(trianglesCount);
+
+	scheduler.ParallelFor(trianglesCount, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			bounds[i].Grow(model.vertices[model.indices[i * 3 + 0]].position);
+			bounds[i].Grow(model.vertices[model.indices[i * 3 + 1]].position);
+			bounds[i].Grow(model.vertices[model.indices[i * 3 + 2]].position);
+		}
+	});
+
+	if (info.spatialSplits) {
+		buildSpatialNodes(scheduler, model, bounds, info, bvh.nodes, bvh.primitiveIndices, bvh.stats);
+	} else if (info.linear) {
+		buildLinearNodes(scheduler, bounds, info, bvh.nodes, bvh.primitiveIndices, bvh.stats);
+	} else {
+		Build_BVH_Nodes(scheduler, bounds, info, bvh.nodes, bvh.primitiveIndices, bvh.stats);
+	}
+
+	// Store triangles in leaf order (spatial splits reference some of them from several leaves)
+	bvh.triangles.resize(bvh.primitiveIndices.size());
+
+	scheduler.ParallelFor(bvh.triangles.size(), 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			uint32_t triangleIndex = bvh.primitiveIndices[i];
+			bvh.triangles[i].v0 = model.vertices[model.indices[triangleIndex * 3 + 0]].position;
+			bvh.triangles[i].v1 = model.vertices[model.indices[triangleIndex * 3 + 1]].position;
+			bvh.triangles[i].v2 = model.vertices[model.indices[triangleIndex * 3 + 2]].position;
+		}
+	});
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	bvh.stats.buildTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	bvh.stats.referencesCount = (uint32_t)bvh.triangles.size();
+	bvh.stats.sahCost = Compute_SAH_Cost(bvh, info);
+	bvh.stats.builtSahCost = bvh.stats.sahCost;
+}
+
+/**
+* SAH cost of the tree, normalized by the root surface area.
+*/
+float Compute_SAH_Cost(const BVH &bvh, const BVHBuildInfo &info)
+{
+	if (bvh.nodes.empty()) return 0.0f;
+
+	auto nodeArea = [](const BVHNode &node) {
+		AABB bounds;
+		bounds.min = node.boundsMin;
+		bounds.max = node.boundsMax;
+		return double(bounds.SurfaceArea());
+	};
+
+	double rootArea = nodeArea(bvh.nodes[0]);
+	if (rootArea <= 0.0) return 0.0f;
+
+	double cost = 0.0;
+	for (const BVHNode &node : bvh.nodes)
+		cost += nodeArea(node) * (node.IsLeaf() ? info.intersectionCost * node.count : info.traversalCost);
+
+	return float(cost / rootArea);
+}
+
+//--------------------------------------------------------------------------------------
+// Refit
+//--------------------------------------------------------------------------------------
+
+// Subtrees above this depth are refitted as separate tasks
+static const int refitTaskDepth = 10;
+
+struct RefitContext
+{
+	TaskScheduler* scheduler;
+	const BVHBuildInfo* info;
+	const Model* model;
+	BVH* bvh;
+};
+
+static inline float boundsSurfaceArea(const XMFLOAT3 &boundsMin, const XMFLOAT3 &boundsMax)
+{
+	AABB bounds;
+	bounds.min = boundsMin;
+	bounds.max = boundsMax;
+	return bounds.SurfaceArea();
+}
+
+/**
+* Refit the subtree after its children, returns its unnormalized SAH cost (sum of node areas times their costs).
+*/
+static double refitNode(RefitContext &context, uint32_t nodeIndex, int depth)
+{
+	BVH &bvh = *context.bvh;
+	BVHNode &node = bvh.nodes[nodeIndex];
+
+	if (node.IsLeaf()) {
+		const Model &model = *context.model;
+		AABB bounds;
+
+		for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+			uint32_t triangleIndex = bvh.primitiveIndices[i];
+			Triangle &triangle = bvh.triangles[i];
+			triangle.v0 = model.vertices[model.indices[triangleIndex * 3 + 0]].position;
+			triangle.v1 = model.vertices[model.indices[triangleIndex * 3 + 1]].position;
+			triangle.v2 = model.vertices[model.indices[triangleIndex * 3 + 2]].position;
+			bounds.Grow(triangle.v0);
+			bounds.Grow(triangle.v1);
+			bounds.Grow(triangle.v2);
+		}
+
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+		return double(bounds.SurfaceArea()) * context.info->intersectionCost * node.count;
+	}
+
+	uint32_t left = node.leftFirst;
+	uint32_t right = left + 1;
+	double leftCost, rightCost;
+
+	if (depth < refitTaskDepth) {
+		TaskGroup group;
+		context.scheduler->Run(group, [&context, &leftCost, left, depth]() {
+			leftCost = refitNode(context, left, depth + 1);
+		});
+		rightCost = refitNode(context, right, depth + 1);
+		context.scheduler->Wait(group);
+	} else {
+		leftCost = refitNode(context, left, depth + 1);
+		rightCost = refitNode(context, right, depth + 1);
+	}
+
+	node.boundsMin = Min3(bvh.nodes[left].boundsMin, bvh.nodes[right].boundsMin);
+	node.boundsMax = Max3(bvh.nodes[left].boundsMax, bvh.nodes[right].boundsMax);
+
+	return double(boundsSurfaceArea(node.boundsMin, node.boundsMax)) * context.info->traversalCost + leftCost + rightCost;
+}
+
+/**
+* Keep the tree topology and leaf order, only bounds follow the moved vertices. Sibling subtrees are refitted in parallel,
+* SAH cost is accumulated along the way so that the quality check comes for free.
+*/
+void Refit_BVH(TaskScheduler &scheduler, const Model &model, const BVHBuildInfo &info, BVH &bvh)
+{
+	if (model.indices.size() / 3 != bvh.triangles.size())
+	{
+		throw std::runtime_error("Error: BVH refit requires the model the BVH was built from!");
+	}
+
+	if (bvh.nodes.empty()) return;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	RefitContext context;
+	context.scheduler = &scheduler;
+	context.info = &info;
+	context.model = &model;
+	context.bvh = &bvh;
+
+	double cost = refitNode(context, 0, 0);
+	double rootArea = boundsSurfaceArea(bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	bvh.stats.refitTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	bvh.stats.sahCost = rootArea > 0.0 ? float(cost / rootArea) : 0.0f;
+}
+
+bool Update_BVH(TaskScheduler &scheduler, const Model &model, const BVHBuildInfo &info, BVH &bvh)
+{
+	Refit_BVH(scheduler, model, info, bvh);
+
+	if (bvh.stats.sahCost <= bvh.stats.builtSahCost * info.rebuildThreshold) return false;
+
+	double refitTime = bvh.stats.refitTime;
+	Build_BVH(scheduler, model, info, bvh);
+	bvh.stats.refitTime = refitTime;
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Traversal
+//--------------------------------------------------------------------------------------
+
+/**
+* Find the closest hit along the ray (ordered depth-first traversal).
+*/
+bool Intersect(const BVH &bvh, const Ray &ray, Hit &hit)
+{
+	if (bvh.nodes.empty()) return false;
+
+	const BVHNode* nodes = bvh.nodes.data();
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+	float tMax = ray.tMax;
+	bool found = false;
+
+	if (IntersectAABB(nodes[0].boundsMin, nodes[0].boundsMax, ray.origin, invDirection, ray.tMin, tMax) == FLT_MAX) return false;
+
+	uint32_t stack[BVH_STACK_SIZE];
+	float stackDistances[BVH_STACK_SIZE];
+	int stackSize = 0;
+	uint32_t nodeIndex = 0;
+
+	while (true) {
+		const BVHNode &node = nodes[nodeIndex];
+
+		if (node.IsLeaf()) {
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+				float t, u, v;
+				if (IntersectTriangle(bvh.triangles[i], ray.origin, ray.direction, ray.tMin, tMax, t, u, v)) {
+					tMax = t;
+					hit.t = t;
+					hit.primitiveIndex = bvh.primitiveIndices[i];
+					hit.barycentrics = XMFLOAT2(u, v);
+					found = true;
+				}
+			}
+		} else {
+			uint32_t left = node.leftFirst;
+			uint32_t right = left + 1;
+			float tLeft = IntersectAABB(nodes[left].boundsMin, nodes[left].boundsMax, ray.origin, invDirection, ray.tMin, tMax);
+			float tRight = IntersectAABB(nodes[right].boundsMin, nodes[right].boundsMax, ray.origin, invDirection, ray.tMin, tMax);
+
+			if (tLeft != FLT_MAX && tRight != FLT_MAX) {
+				// Visit the nearer child first, the other one is stacked
+				bool leftFirst = tLeft <= tRight;
+				stack[stackSize] = leftFirst ? right : left;
+				stackDistances[stackSize++] = leftFirst ? tRight : tLeft;
+				nodeIndex = leftFirst ? left : right;
+				continue;
+			}
+
+			if (tLeft != FLT_MAX) { nodeIndex = left; continue; }
+			if (tRight != FLT_MAX) { nodeIndex = right; continue; }
+		}
+
+		// Pop next node, skipping those that are now farther than the closest hit
+		do {
+			if (stackSize == 0) return found;
+			stackSize--;
+		} while (stackDistances[stackSize] > tMax);
+
+		nodeIndex = stack[stackSize];
+	}
+}
+
+}
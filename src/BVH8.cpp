@@ -0,0 +1,636 @@
+// RTAO - 8-wide bounding volume hierarchy with SIMD traversal
+#include "BVH8.h"
+
+#include <intrin.h>
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Collapse
+//--------------------------------------------------------------------------------------
+
+static float nodeSurfaceArea(const BVHNode &node)
+{
+	AABB bounds;
+	bounds.min = node.boundsMin;
+	bounds.max = node.boundsMax;
+	return bounds.SurfaceArea();
+}
+
+/**
+* Create 8-wide node from the binary subtree: children are repeatedly replaced by their own children,
+* largest inner child first, until the node is full or only leaves remain.
+*/
+static uint32_t collapseNode(const BVH &bvh, uint32_t binaryIndex, BVH8 &bvh8)
+{
+	uint32_t nodeIndex = (uint32_t)bvh8.nodes.size();
+	bvh8.nodes.emplace_back();
+
+	const BVHNode &binaryNode = bvh.nodes[binaryIndex];
+
+	uint32_t children[BVH8_WIDTH];
+	int childrenCount = 0;
+
+	if (binaryNode.IsLeaf()) {
+		children[childrenCount++] = binaryIndex;
+	} else {
+		children[childrenCount++] = binaryNode.leftFirst;
+		children[childrenCount++] = binaryNode.leftFirst + 1;
+	}
+
+	while (childrenCount < BVH8_WIDTH) {
+		int largest = -1;
+		float largestArea = -1.0f;
+
+		for (int i = 0; i < childrenCount; i++) {
+			const BVHNode &child = bvh.nodes[children[i]];
+			if (child.IsLeaf()) continue;
+
+			float area = nodeSurfaceArea(child);
+			if (area > largestArea) {
+				largest = i;
+				largestArea = area;
+			}
+		}
+
+		if (largest < 0) break;
+
+		uint32_t left = bvh.nodes[children[largest]].leftFirst;
+		children[largest] = left;
+		children[childrenCount++] = left + 1;
+	}
+
+	// Fill child slots, inner children are collapsed recursively (nodes vector may grow, so node is re-fetched by index)
+	for (int i = 0; i < BVH8_WIDTH; i++) {
+		uint32_t child = BVH8_EMPTY_CHILD;
+		uint32_t count = 0;
+		XMFLOAT3 boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		if (i < childrenCount) {
+			const BVHNode &binaryChild = bvh.nodes[children[i]];
+			boundsMin = binaryChild.boundsMin;
+			boundsMax = binaryChild.boundsMax;
+
+			if (binaryChild.IsLeaf()) {
+				child = BVH8_LEAF_FLAG | binaryChild.leftFirst;
+				count = binaryChild.count;
+			} else {
+				child = collapseNode(bvh, children[i], bvh8);
+			}
+		}
+
+		BVH8Node &node = bvh8.nodes[nodeIndex];
+		node.children[i] = child;
+		node.counts[i] = count;
+		node.boundsMin[0][i] = boundsMin.x;
+		node.boundsMin[1][i] = boundsMin.y;
+		node.boundsMin[2][i] = boundsMin.z;
+		node.boundsMax[0][i] = boundsMax.x;
+		node.boundsMax[1][i] = boundsMax.y;
+		node.boundsMax[2][i] = boundsMax.z;
+	}
+
+	return nodeIndex;
+}
+
+/**
+* Collapse binary BVH into 8-wide one, leaves and triangle order of the binary BVH are kept.
+*/
+void Build_BVH8(const BVH &bvh, BVH8 &bvh8)
+{
+	bvh8.nodes.clear();
+	bvh8.triangles = bvh.triangles;
+	bvh8.primitiveIndices = bvh.primitiveIndices;
+
+	if (bvh.nodes.empty()) return;
+
+	bvh8.nodes.reserve(bvh.nodes.size() / 4 + 1);
+	collapseNode(bvh, 0, bvh8);
+	bvh8.nodes.shrink_to_fit();
+
+	// Larger children are opened first, so a path through small siblings may descend a single binary level per BVH8 level
+	bvh8.depth = Get_BVH8_Depth(bvh8);
+	if (bvh8.depth > BVH8_MAX_DEPTH)
+	{
+		throw std::runtime_error("Error: BVH8 is too deep for the traversal stack!");
+	}
+}
+
+uint32_t Get_BVH8_Depth(const BVH8 &bvh8)
+{
+	if (bvh8.nodes.empty()) return 0;
+
+	uint32_t depth = 0;
+	vector<pair<uint32_t, uint32_t>> stack(1, make_pair(0u, 1u));
+
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back().first;
+		uint32_t level = stack.back().second;
+		stack.pop_back();
+
+		depth = max(depth, level);
+		if (level > BVH8_MAX_DEPTH || nodeIndex >= bvh8.nodes.size()) return max(depth, uint32_t(BVH8_MAX_DEPTH + 1));
+
+		const BVH8Node &node = bvh8.nodes[nodeIndex];
+		for (int i = 0; i < BVH8_WIDTH; i++) {
+			if (node.children[i] & BVH8_LEAF_FLAG) continue;	//< Leaves and empty slots
+			stack.push_back(make_pair(node.children[i], level + 1));
+		}
+	}
+
+	return depth;
+}
+
+AABB Get_Bounds(const BVH8 &bvh)
+{
+	AABB bounds;
+	if (bvh.nodes.empty()) return bounds;
+
+	const BVH8Node &root = bvh.nodes[0];
+	for (int i = 0; i < BVH8_WIDTH; i++) {
+		if (root.children[i] == BVH8_EMPTY_CHILD) continue;
+		bounds.Grow(XMFLOAT3(root.boundsMin[0][i], root.boundsMin[1][i], root.boundsMin[2][i]));
+		bounds.Grow(XMFLOAT3(root.boundsMax[0][i], root.boundsMax[1][i], root.boundsMax[2][i]));
+	}
+
+	return bounds;
+}
+
+//--------------------------------------------------------------------------------------
+// Layout
+//--------------------------------------------------------------------------------------
+
+/**
+* Inner children of the node ordered by decreasing surface area, returns their count.
+*/
+static int innerChildren(const BVH8Node &node, uint32_t* children)
+{
+	float areas[BVH8_WIDTH];
+	int count = 0;
+
+	for (int i = 0; i < BVH8_WIDTH; i++) {
+		if (node.children[i] & BVH8_LEAF_FLAG) continue;	//< Leaves and empty slots
+
+		float dx = node.boundsMax[0][i] - node.boundsMin[0][i];
+		float dy = node.boundsMax[1][i] - node.boundsMin[1][i];
+		float dz = node.boundsMax[2][i] - node.boundsMin[2][i];
+		float area = dx * dy + dy * dz + dz * dx;
+
+		int j = count++;
+		while (j > 0 && areas[j - 1] < area) {
+			areas[j] = areas[j - 1];
+			children[j] = children[j - 1];
+			j--;
+		}
+		areas[j] = area;
+		children[j] = node.children[i];
+	}
+
+	return count;
+}
+
+static void depthFirst(const BVH8 &bvh8, uint32_t root, vector<uint32_t> &order)
+{
+	vector<uint32_t> stack(1, root);
+
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+		order.push_back(nodeIndex);
+
+		// Pushed in reverse, so that the largest child is emitted next
+		uint32_t children[BVH8_WIDTH];
+		int count = innerChildren(bvh8.nodes[nodeIndex], children);
+		for (int i = count - 1; i >= 0; i--)
+			stack.push_back(children[i]);
+	}
+}
+
+/**
+* Nodes levels below the root (in order of the children within a level), those in the levels above are appended to top when given.
+*/
+static void gatherLevel(const BVH8 &bvh8, uint32_t root, int levels, vector<uint32_t> &level, vector<uint32_t>* top)
+{
+	level.assign(1, root);
+
+	for (int depth = 0; depth < levels && !level.empty(); depth++) {
+		vector<uint32_t> next;
+		for (uint32_t nodeIndex : level) {
+			if (top) top->push_back(nodeIndex);
+
+			uint32_t children[BVH8_WIDTH];
+			int count = innerChildren(bvh8.nodes[nodeIndex], children);
+			next.insert(next.end(), children, children + count);
+		}
+		level.swap(next);
+	}
+}
+
+/**
+* Number of node levels of every subtree, a node with leaves only has one.
+*/
+static int subtreeHeight(const BVH8 &bvh8, uint32_t nodeIndex, vector<int> &heights)
+{
+	int height = 0;
+	for (uint32_t child : bvh8.nodes[nodeIndex].children) {
+		if (!(child & BVH8_LEAF_FLAG)) height = max(height, subtreeHeight(bvh8, child, heights));
+	}
+
+	heights[nodeIndex] = height + 1;
+	return height + 1;
+}
+
+/**
+* Van Emde Boas layout of the top levels of the subtree: the upper half of them is laid out recursively, followed by the subtrees
+* rooted below it, each recursively as well. Any cache line or page size then holds a subtree of about its size.
+*/
+static void vanEmdeBoas(const BVH8 &bvh8, const vector<int> &heights, uint32_t root, int levels, vector<uint32_t> &order)
+{
+	levels = min(levels, heights[root]);
+	if (levels == 1) {
+		order.push_back(root);
+		return;
+	}
+
+	int topLevels = levels / 2;
+	vanEmdeBoas(bvh8, heights, root, topLevels, order);
+
+	vector<uint32_t> bottom;
+	gatherLevel(bvh8, root, topLevels, bottom, nullptr);
+	for (uint32_t nodeIndex : bottom)
+		vanEmdeBoas(bvh8, heights, nodeIndex, levels - topLevels, order);
+}
+
+/**
+* Nodes are emitted in the order of the layout, then copied to their new position with inner child indices remapped.
+*/
+void Reorder_BVH8(BVH8 &bvh8, BVH8Layout layout, int topLevels)
+{
+	if (bvh8.nodes.empty() || layout == BVH8_LAYOUT_BUILD) return;
+
+	vector<uint32_t> order;
+	order.reserve(bvh8.nodes.size());
+
+	if (layout == BVH8_LAYOUT_DEPTH_FIRST) {
+		depthFirst(bvh8, 0, order);
+	} else if (layout == BVH8_LAYOUT_BREADTH_DEPTH) {
+		vector<uint32_t> bottom;
+		gatherLevel(bvh8, 0, max(topLevels, 1), bottom, &order);
+		for (uint32_t nodeIndex : bottom)
+			depthFirst(bvh8, nodeIndex, order);
+	} else if (layout == BVH8_LAYOUT_VAN_EMDE_BOAS) {
+		vector<int> heights(bvh8.nodes.size());
+		vanEmdeBoas(bvh8, heights, 0, subtreeHeight(bvh8, 0, heights), order);
+	} else {
+		throw std::runtime_error("Error: unknown BVH8 layout!");
+	}
+
+	if (order.size() != bvh8.nodes.size())
+	{
+		throw std::runtime_error("Error: BVH8 nodes are not reachable from the root!");
+	}
+
+	vector<uint32_t> newIndices(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		newIndices[order[i]] = uint32_t(i);
+
+	vector<BVH8Node> nodes(order.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		nodes[i] = bvh8.nodes[order[i]];
+		for (uint32_t &child : nodes[i].children) {
+			if (!(child & BVH8_LEAF_FLAG)) child = newIndices[child];
+		}
+	}
+
+	bvh8.nodes.swap(nodes);
+}
+
+const char* Get_BVH8_Layout_Name(BVH8Layout layout)
+{
+	switch (layout) {
+	case BVH8_LAYOUT_DEPTH_FIRST: return "dfs";
+	case BVH8_LAYOUT_BREADTH_DEPTH: return "bfs_dfs";
+	case BVH8_LAYOUT_VAN_EMDE_BOAS: return "veb";
+	default: return "build";
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Refit
+//--------------------------------------------------------------------------------------
+
+// Subtrees above this depth are refitted as separate tasks (8^3 of them at most)
+static const int refitTaskDepth = 3;
+
+/**
+* Update child bounds of the node from its leaves' triangles and refitted inner children, returns the node's bounds.
+*/
+static AABB refitNode(TaskScheduler &scheduler, const Model &model, BVH8 &bvh8, uint32_t nodeIndex, int depth)
+{
+	AABB childBounds[BVH8_WIDTH];
+	TaskGroup group;
+
+	for (int i = 0; i < BVH8_WIDTH; i++) {
+		uint32_t child = bvh8.nodes[nodeIndex].children[i];
+		if (child == BVH8_EMPTY_CHILD) continue;
+
+		if (child & BVH8_LEAF_FLAG) {
+			uint32_t first = child & ~BVH8_LEAF_FLAG;
+			uint32_t count = bvh8.nodes[nodeIndex].counts[i];
+
+			for (uint32_t j = first; j < first + count; j++) {
+				uint32_t triangleIndex = bvh8.primitiveIndices[j];
+				Triangle &triangle = bvh8.triangles[j];
+				triangle.v0 = model.vertices[model.indices[triangleIndex * 3 + 0]].position;
+				triangle.v1 = model.vertices[model.indices[triangleIndex * 3 + 1]].position;
+				triangle.v2 = model.vertices[model.indices[triangleIndex * 3 + 2]].position;
+				childBounds[i].Grow(triangle.v0);
+				childBounds[i].Grow(triangle.v1);
+				childBounds[i].Grow(triangle.v2);
+			}
+		} else if (depth < refitTaskDepth) {
+			AABB* bounds = &childBounds[i];
+			scheduler.Run(group, [&scheduler, &model, &bvh8, bounds, child, depth]() {
+				*bounds = refitNode(scheduler, model, bvh8, child, depth + 1);
+			});
+		} else {
+			childBounds[i] = refitNode(scheduler, model, bvh8, child, depth + 1);
+		}
+	}
+
+	scheduler.Wait(group);
+
+	BVH8Node &node = bvh8.nodes[nodeIndex];
+	AABB bounds;
+
+	for (int i = 0; i < BVH8_WIDTH; i++) {
+		if (node.children[i] == BVH8_EMPTY_CHILD) continue;
+
+		node.boundsMin[0][i] = childBounds[i].min.x;
+		node.boundsMin[1][i] = childBounds[i].min.y;
+		node.boundsMin[2][i] = childBounds[i].min.z;
+		node.boundsMax[0][i] = childBounds[i].max.x;
+		node.boundsMax[1][i] = childBounds[i].max.y;
+		node.boundsMax[2][i] = childBounds[i].max.z;
+		bounds.Grow(childBounds[i]);
+	}
+
+	return bounds;
+}
+
+/**
+* Refit the collapsed tree in place, nodes, leaves and triangle order stay those of the last Build_BVH8.
+*/
+void Refit_BVH8(TaskScheduler &scheduler, const Model &model, BVH8 &bvh8)
+{
+	if (model.indices.size() / 3 != bvh8.triangles.size())
+	{
+		throw std::runtime_error("Error: BVH8 refit requires the model the BVH8 was built from!");
+	}
+
+	if (bvh8.nodes.empty()) return;
+
+	refitNode(scheduler, model, bvh8, 0, 0);
+}
+
+//--------------------------------------------------------------------------------------
+// Kernel Selection
+//--------------------------------------------------------------------------------------
+
+/**
+* Detect the widest instruction set supported by both the CPU and the OS (extended register state must be enabled).
+*/
+SIMDLevel Get_Supported_SIMD_Level()
+{
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7) return SIMD_SCALAR;
+
+	__cpuidex(info, 1, 0);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool popcnt = (info[2] & (1 << 23)) != 0;
+	if (!osxsave || !avx || !fma) return SIMD_SCALAR;
+
+	unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6) return SIMD_SCALAR;
+
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0 && (info[1] & (1 << 3)) != 0; //< Kernels use BMI1 bit scans as well
+	if (!avx2) return SIMD_SCALAR;
+
+	// Kernels are written with AVX-512 F and VL intrinsics only (and count hits with POPCNT)
+	bool avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 31)) != 0 && popcnt;
+
+	// Opmask and upper ZMM state
+	if (avx512 && (xcr0 & 0xE6) == 0xE6) return SIMD_AVX512;
+
+	return SIMD_AVX2;
+}
+
+const char* Get_SIMD_Level_Name(SIMDLevel level)
+{
+	switch (level) {
+	case SIMD_AVX2: return "avx2";
+	case SIMD_AVX512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+bool Intersect(const BVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	return Intersect(bvh, ray, hit, supportedLevel);
+}
+
+bool Intersect(const BVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level, uint32_t root)
+{
+	switch (level) {
+	case SIMD_AVX512: return Intersect_BVH8_AVX512(bvh, ray, hit, root);
+	case SIMD_AVX2: return Intersect_BVH8_AVX2(bvh, ray, hit, root);
+	default: return Intersect_BVH8_Scalar(bvh, ray, hit, root);
+	}
+}
+
+bool Occluded(const BVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	return Occluded(bvh, ray, hit, supportedLevel);
+}
+
+bool Occluded(const BVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level, uint32_t root)
+{
+	switch (level) {
+	case SIMD_AVX512: return Occluded_BVH8_AVX512(bvh, ray, hit, root);
+	case SIMD_AVX2: return Occluded_BVH8_AVX2(bvh, ray, hit, root);
+	default: return Occluded_BVH8_Scalar(bvh, ray, hit, root);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Occlusion Queries
+//--------------------------------------------------------------------------------------
+
+typedef bool (*OccludedKernel)(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root);
+
+static OccludedKernel selectOccludedKernel(SIMDLevel level)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	if (level == SIMD_LEVELS_COUNT) level = supportedLevel;
+
+	switch (level) {
+	case SIMD_AVX512: return Occluded_BVH8_AVX512;
+	case SIMD_AVX2: return Occluded_BVH8_AVX2;
+	default: return Occluded_BVH8_Scalar;
+	}
+}
+
+void Occluded(const BVH8 &bvh, const Ray* rays, size_t count, uint32_t* occludedBits, SIMDLevel level)
+{
+	OccludedKernel kernel = selectOccludedKernel(level);
+
+	for (size_t word = 0; word < (count + 31) / 32; word++) {
+		uint32_t bits = 0;
+		for (size_t i = word * 32; i < min(count, (word + 1) * 32); i++) {
+			Hit hit;
+			if (kernel(bvh, rays[i], hit, 0)) bits |= 1u << (i % 32);
+		}
+		occludedBits[word] = bits;
+	}
+}
+
+void Occlusion_Distance(const BVH8 &bvh, const Ray* rays, size_t count, float* t, SIMDLevel level)
+{
+	OccludedKernel kernel = selectOccludedKernel(level);
+
+	for (size_t i = 0; i < count; i++) {
+		Hit hit;
+		t[i] = kernel(bvh, rays[i], hit, 0) ? hit.t : rays[i].tMax;
+	}
+}
+
+/**
+* Bits of the batch are cleared up front, interleaved rays finish out of order.
+*/
+void Intersect_Interleaved(const BVH8 &bvh, const Ray* rays, size_t count, Hit* hits, uint32_t* hitBits, int raysInFlight)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+
+	for (size_t word = 0; word < (count + 31) / 32; word++)
+		hitBits[word] = 0;
+
+	if (supportedLevel >= SIMD_AVX2) {
+		Intersect_BVH8_Interleaved_AVX2(bvh, rays, count, hits, hitBits, raysInFlight);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (Intersect_BVH8_Scalar(bvh, rays[i], hits[i])) hitBits[i / 32] |= 1u << (i % 32);
+	}
+}
+
+void Occluded_Interleaved(const BVH8 &bvh, const Ray* rays, size_t count, uint32_t* occludedBits, int raysInFlight)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+
+	if (supportedLevel < SIMD_AVX2) {
+		Occluded(bvh, rays, count, occludedBits, SIMD_SCALAR);
+		return;
+	}
+
+	for (size_t word = 0; word < (count + 31) / 32; word++)
+		occludedBits[word] = 0;
+
+	Occluded_BVH8_Interleaved_AVX2(bvh, rays, count, occludedBits, raysInFlight);
+}
+
+//--------------------------------------------------------------------------------------
+// Scalar Kernel
+//--------------------------------------------------------------------------------------
+
+// Memory accesses are only reported for cache simulation, traversal proper compiles them away
+struct IgnoreAccesses
+{
+	void operator()(const void*, size_t, bool) const {}
+};
+
+template <bool anyHit, typename Access>
+static bool traverse(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root, const Access &access)
+{
+	if (bvh.nodes.empty()) return false;
+
+	const BVH8Node* nodes = bvh.nodes.data();
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+	float originScaled[3] = { ray.origin.x * invDirection.x, ray.origin.y * invDirection.y, ray.origin.z * invDirection.z };
+	float inverse[3] = { invDirection.x, invDirection.y, invDirection.z };
+
+	// Near and far planes are picked by direction sign, so inverted bounds of empty slots never pass the test
+	bool negative[3] = { ray.direction.x < 0.0f, ray.direction.y < 0.0f, ray.direction.z < 0.0f };
+
+	float tMax = ray.tMax;
+	bool found = false;
+
+	BVH8StackEntry stack[BVH8_STACK_SIZE];
+	int stackSize = 0;
+	BVH8StackEntry entry = { root, 0, ray.tMin };
+
+	while (true) {
+		if (entry.child & BVH8_LEAF_FLAG) {
+			uint32_t first = entry.child & ~BVH8_LEAF_FLAG;
+			access(&bvh.triangles[first], entry.count * sizeof(Triangle), false);
+
+			found |= IntersectLeaf(bvh, first, entry.count, ray, tMax, hit, anyHit);
+			if (anyHit && found) break;
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		const BVH8Node &node = nodes[entry.child];
+		access(&node, sizeof(BVH8Node), true);
+
+		BVH8StackEntry hits[BVH8_WIDTH];
+		int hitsCount = 0;
+
+		for (int i = 0; i < BVH8_WIDTH; i++) {
+			float tNear = ray.tMin;
+			float tFar = tMax;
+			for (int axis = 0; axis < 3; axis++) {
+				float nearPlane = negative[axis] ? node.boundsMax[axis][i] : node.boundsMin[axis][i];
+				float farPlane = negative[axis] ? node.boundsMin[axis][i] : node.boundsMax[axis][i];
+				tNear = max(tNear, nearPlane * inverse[axis] - originScaled[axis]);
+				tFar = min(tFar, farPlane * inverse[axis] - originScaled[axis]);
+			}
+
+			if (tNear <= tFar) hits[hitsCount++] = { node.children[i], node.counts[i], tNear };
+		}
+
+		if (hitsCount > 0) {
+			entry = PushChildren(stack, stackSize, hits, hitsCount, anyHit);
+		} else if (!PopEntry(stack, stackSize, tMax, entry)) {
+			break;
+		}
+	}
+
+	return found;
+}
+
+bool Intersect_BVH8_Scalar(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	return traverse<false>(bvh, ray, hit, root, IgnoreAccesses());
+}
+
+bool Intersect_BVH8_Scalar(const BVH8 &bvh, const Ray &ray, Hit &hit, const function<void(const void*, size_t, bool)> &access)
+{
+	return traverse<false>(bvh, ray, hit, 0, access);
+}
+
+bool Occluded_BVH8_Scalar(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	return traverse<true>(bvh, ray, hit, root, IgnoreAccesses());
+}
+
+}
@@ -0,0 +1,334 @@
+// RTAO - 8-wide BVH traversal kernel, written with AVX2 and FMA intrinsics
+#include "TrianglePackets.h"
+
+#include <immintrin.h>
+
+namespace CPURT
+{
+
+// 1 + 2 * gamma(3) of Ize's robust BVH traversal, covers the rounding of the inverse direction and of the plane distances
+static const float robustFarScale = 1.0f + 2.0f * (3.0f * 0.5f * FLT_EPSILON) / (1.0f - 3.0f * 0.5f * FLT_EPSILON);
+
+/**
+* Leaves are handed to intersectLeaf(first, count, tMax), so the same node loop serves triangles stored in the tree and packed ones.
+* Robust traversal subtracts the origin before scaling and widens far distances, so a ray through a face shared by two children
+* can't be rejected by both (the FMA form rounds relative to origin / direction, which may be large against the distance).
+*/
+template <bool anyHit, bool robust, typename LeafIntersector>
+static bool traverse(const BVH8 &bvh, const Ray &ray, const LeafIntersector &intersectLeaf, uint32_t root = 0)
+{
+	if (bvh.nodes.empty()) return false;
+
+	const BVH8Node* nodes = bvh.nodes.data();
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+
+	const __m256 inverseX = _mm256_set1_ps(invDirection.x);
+	const __m256 inverseY = _mm256_set1_ps(invDirection.y);
+	const __m256 inverseZ = _mm256_set1_ps(invDirection.z);
+	const __m256 originScaledX = _mm256_set1_ps(ray.origin.x * invDirection.x);
+	const __m256 originScaledY = _mm256_set1_ps(ray.origin.y * invDirection.y);
+	const __m256 originScaledZ = _mm256_set1_ps(ray.origin.z * invDirection.z);
+	const __m256 originX = _mm256_set1_ps(ray.origin.x);
+	const __m256 originY = _mm256_set1_ps(ray.origin.y);
+	const __m256 originZ = _mm256_set1_ps(ray.origin.z);
+	const __m256 tMinV = _mm256_set1_ps(ray.tMin);
+
+	// Offsets of near and far planes within the node, picked by direction sign (inverted empty slots never pass)
+	const size_t planesOffset = BVH8_WIDTH * 3;
+	const size_t nearX = ray.direction.x < 0.0f ? planesOffset : 0;
+	const size_t nearY = (ray.direction.y < 0.0f ? planesOffset : 0) + BVH8_WIDTH;
+	const size_t nearZ = (ray.direction.z < 0.0f ? planesOffset : 0) + BVH8_WIDTH * 2;
+	const size_t farX = (nearX + planesOffset) % (planesOffset * 2);
+	const size_t farY = (nearY + planesOffset) % (planesOffset * 2);
+	const size_t farZ = (nearZ + planesOffset) % (planesOffset * 2);
+
+	float tMax = ray.tMax;
+	bool found = false;
+
+	BVH8StackEntry stack[BVH8_STACK_SIZE];
+	int stackSize = 0;
+	BVH8StackEntry entry = { root, 0, ray.tMin };
+
+	while (true) {
+		if (entry.child & BVH8_LEAF_FLAG) {
+			found |= intersectLeaf(entry.child & ~BVH8_LEAF_FLAG, entry.count, tMax);
+			if (anyHit && found) break;
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		const BVH8Node &node = nodes[entry.child];
+		const float* planes = &node.boundsMin[0][0];
+
+		__m256 tNearX, tNearY, tNearZ, tFarX, tFarY, tFarZ;
+		if (robust) {
+			tNearX = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + nearX), originX), inverseX);
+			tNearY = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + nearY), originY), inverseY);
+			tNearZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + nearZ), originZ), inverseZ);
+			tFarX = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + farX), originX), inverseX);
+			tFarY = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + farY), originY), inverseY);
+			tFarZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + farZ), originZ), inverseZ);
+		} else {
+			tNearX = _mm256_fmsub_ps(_mm256_loadu_ps(planes + nearX), inverseX, originScaledX);
+			tNearY = _mm256_fmsub_ps(_mm256_loadu_ps(planes + nearY), inverseY, originScaledY);
+			tNearZ = _mm256_fmsub_ps(_mm256_loadu_ps(planes + nearZ), inverseZ, originScaledZ);
+			tFarX = _mm256_fmsub_ps(_mm256_loadu_ps(planes + farX), inverseX, originScaledX);
+			tFarY = _mm256_fmsub_ps(_mm256_loadu_ps(planes + farY), inverseY, originScaledY);
+			tFarZ = _mm256_fmsub_ps(_mm256_loadu_ps(planes + farZ), inverseZ, originScaledZ);
+		}
+
+		__m256 tNear = _mm256_max_ps(_mm256_max_ps(tNearX, tNearY), _mm256_max_ps(tNearZ, tMinV));
+		__m256 tFar = _mm256_min_ps(_mm256_min_ps(tFarX, tFarY), tFarZ);
+		if (robust) tFar = _mm256_mul_ps(tFar, _mm256_set1_ps(robustFarScale));
+		tFar = _mm256_min_ps(tFar, _mm256_set1_ps(tMax));
+
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+		if (mask == 0) {
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		alignas(32) float distances[BVH8_WIDTH];
+		_mm256_store_ps(distances, tNear);
+
+		BVH8StackEntry hits[BVH8_WIDTH];
+		int hitsCount = 0;
+
+		while (mask) {
+			int i = _tzcnt_u32(mask);
+			mask &= mask - 1;
+			hits[hitsCount++] = { node.children[i], node.counts[i], distances[i] };
+		}
+
+		entry = PushChildren(stack, stackSize, hits, hitsCount, anyHit);
+	}
+
+	return found;
+}
+
+template <bool anyHit>
+static bool traverse(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	return traverse<anyHit, false>(bvh, ray, [&](uint32_t first, uint32_t count, float &tMax) {
+		return IntersectLeaf(bvh, first, count, ray, tMax, hit, anyHit);
+	}, root);
+}
+
+template <bool anyHit>
+static bool traverse(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit)
+{
+	const uint32_t width = (uint32_t)packets.width;
+
+	auto intersectLeaf = [&](uint32_t first, uint32_t count, float &tMax) {
+		return Intersect_Triangle_Packets(packets, packets.leafPackets[first], (count + width - 1) / width, ray, tMax, hit, anyHit);
+	};
+
+	// Watertight triangles are only worth it when the node test can't lose the ray either
+	if (packets.test == TRIANGLE_TEST_WATERTIGHT) return traverse<anyHit, true>(bvh, ray, intersectLeaf);
+	return traverse<anyHit, false>(bvh, ray, intersectLeaf);
+}
+
+bool Intersect_BVH8_AVX2(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	return traverse<false>(bvh, ray, hit, root);
+}
+
+bool Occluded_BVH8_AVX2(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	return traverse<true>(bvh, ray, hit, root);
+}
+
+bool Intersect_BVH8_Packets_AVX2(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit)
+{
+	return traverse<false>(bvh, packets, ray, hit);
+}
+
+bool Occluded_BVH8_Packets_AVX2(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit)
+{
+	return traverse<true>(bvh, packets, ray, hit);
+}
+
+//--------------------------------------------------------------------------------------
+// Interleaved Kernel
+//--------------------------------------------------------------------------------------
+
+// Traversal state of a ray in flight, the ray's constants are kept in the form the node test broadcasts them from
+struct InterleavedRay
+{
+	const Ray* ray;
+	size_t index;
+	float inverse[3];
+	float originScaled[3];
+	size_t nearOffsets[3];
+	size_t farOffsets[3];
+	float tMax;
+	bool found;
+	Hit hit;
+	BVH8StackEntry entry;
+	int stackSize;
+	BVH8StackEntry stack[BVH8_STACK_SIZE];
+};
+
+static void startRay(InterleavedRay &state, const Ray* rays, size_t index)
+{
+	const Ray &ray = rays[index];
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+	const float direction[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+	const size_t planesOffset = BVH8_WIDTH * 3;
+
+	state.ray = &ray;
+	state.index = index;
+	state.inverse[0] = invDirection.x;
+	state.inverse[1] = invDirection.y;
+	state.inverse[2] = invDirection.z;
+	state.originScaled[0] = ray.origin.x * invDirection.x;
+	state.originScaled[1] = ray.origin.y * invDirection.y;
+	state.originScaled[2] = ray.origin.z * invDirection.z;
+
+	for (int axis = 0; axis < 3; axis++) {
+		state.nearOffsets[axis] = (direction[axis] < 0.0f ? planesOffset : 0) + BVH8_WIDTH * axis;
+		state.farOffsets[axis] = (state.nearOffsets[axis] + planesOffset) % (planesOffset * 2);
+	}
+
+	state.tMax = ray.tMax;
+	state.found = false;
+	state.hit = Hit();
+	state.entry = { 0, 0, ray.tMin };
+	state.stackSize = 0;
+}
+
+/**
+* Request the node or leaf triangles of the entry, they should be in cache once the ray gets its next turn.
+*/
+static inline void prefetchEntry(const BVH8 &bvh, const BVH8StackEntry &entry)
+{
+	if (entry.child & BVH8_LEAF_FLAG) {
+		const char* first = reinterpret_cast<const char*>(&bvh.triangles[entry.child & ~BVH8_LEAF_FLAG]);
+		for (size_t offset = 0; offset < entry.count * sizeof(Triangle); offset += 64)
+			_mm_prefetch(first + offset, _MM_HINT_T0);
+	} else {
+		const char* node = reinterpret_cast<const char*>(&bvh.nodes[entry.child]);
+		for (size_t offset = 0; offset < sizeof(BVH8Node); offset += 64)
+			_mm_prefetch(node + offset, _MM_HINT_T0);
+	}
+}
+
+/**
+* Visit the current entry of the ray (the same node test as traverse) and prefetch the next one. Returns false once the ray is done.
+*/
+template <bool anyHit>
+static bool stepRay(const BVH8 &bvh, InterleavedRay &state)
+{
+	const Ray &ray = *state.ray;
+
+	if (state.entry.child & BVH8_LEAF_FLAG) {
+		state.found |= IntersectLeaf(bvh, state.entry.child & ~BVH8_LEAF_FLAG, state.entry.count, ray, state.tMax, state.hit, anyHit);
+		if (anyHit && state.found) return false;
+		if (!PopEntry(state.stack, state.stackSize, state.tMax, state.entry)) return false;
+		prefetchEntry(bvh, state.entry);
+		return true;
+	}
+
+	const BVH8Node &node = bvh.nodes[state.entry.child];
+	const float* planes = &node.boundsMin[0][0];
+
+	const __m256 inverseX = _mm256_set1_ps(state.inverse[0]);
+	const __m256 inverseY = _mm256_set1_ps(state.inverse[1]);
+	const __m256 inverseZ = _mm256_set1_ps(state.inverse[2]);
+	const __m256 originScaledX = _mm256_set1_ps(state.originScaled[0]);
+	const __m256 originScaledY = _mm256_set1_ps(state.originScaled[1]);
+	const __m256 originScaledZ = _mm256_set1_ps(state.originScaled[2]);
+
+	__m256 tNearX = _mm256_fmsub_ps(_mm256_loadu_ps(planes + state.nearOffsets[0]), inverseX, originScaledX);
+	__m256 tNearY = _mm256_fmsub_ps(_mm256_loadu_ps(planes + state.nearOffsets[1]), inverseY, originScaledY);
+	__m256 tNearZ = _mm256_fmsub_ps(_mm256_loadu_ps(planes + state.nearOffsets[2]), inverseZ, originScaledZ);
+	__m256 tFarX = _mm256_fmsub_ps(_mm256_loadu_ps(planes + state.farOffsets[0]), inverseX, originScaledX);
+	__m256 tFarY = _mm256_fmsub_ps(_mm256_loadu_ps(planes + state.farOffsets[1]), inverseY, originScaledY);
+	__m256 tFarZ = _mm256_fmsub_ps(_mm256_loadu_ps(planes + state.farOffsets[2]), inverseZ, originScaledZ);
+
+	__m256 tNear = _mm256_max_ps(_mm256_max_ps(tNearX, tNearY), _mm256_max_ps(tNearZ, _mm256_set1_ps(ray.tMin)));
+	__m256 tFar = _mm256_min_ps(_mm256_min_ps(_mm256_min_ps(tFarX, tFarY), tFarZ), _mm256_set1_ps(state.tMax));
+
+	int mask = _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+	if (mask == 0) {
+		if (!PopEntry(state.stack, state.stackSize, state.tMax, state.entry)) return false;
+		prefetchEntry(bvh, state.entry);
+		return true;
+	}
+
+	alignas(32) float distances[BVH8_WIDTH];
+	_mm256_store_ps(distances, tNear);
+
+	BVH8StackEntry hits[BVH8_WIDTH];
+	int hitsCount = 0;
+
+	while (mask) {
+		int i = _tzcnt_u32(mask);
+		mask &= mask - 1;
+		hits[hitsCount++] = { node.children[i], node.counts[i], distances[i] };
+	}
+
+	state.entry = PushChildren(state.stack, state.stackSize, hits, hitsCount, anyHit);
+	prefetchEntry(bvh, state.entry);
+	return true;
+}
+
+/**
+* Keep raysInFlight rays in flight, AMAC style: every turn a ray visits one node and issues the prefetch of the next one, the other
+* rays' turns hide the latency. A finished ray hands its slot to the next ray of the batch, done(state) receives its result.
+*/
+template <bool anyHit, typename Done>
+static void traverseInterleaved(const BVH8 &bvh, const Ray* rays, size_t count, int raysInFlight, const Done &done)
+{
+	if (bvh.nodes.empty() || count == 0) return;
+
+	// Stacks of all rays in flight are too big for the thread's stack, they are kept per thread instead
+	static thread_local vector<InterleavedRay> states(BVH8_MAX_RAYS_IN_FLIGHT);
+	int slots[BVH8_MAX_RAYS_IN_FLIGHT];
+	int activeCount = 0;
+	size_t next = 0;
+
+	raysInFlight = max(1, min(raysInFlight, BVH8_MAX_RAYS_IN_FLIGHT));
+	while (activeCount < raysInFlight && next < count) {
+		slots[activeCount] = activeCount;
+		startRay(states[activeCount++], rays, next++);
+	}
+
+	while (activeCount > 0) {
+		for (int s = 0; s < activeCount;) {
+			InterleavedRay &state = states[slots[s]];
+
+			if (stepRay<anyHit>(bvh, state)) {
+				s++;
+				continue;
+			}
+
+			done(state);
+
+			if (next < count) {
+				startRay(state, rays, next++);
+				s++;
+			} else {
+				slots[s] = slots[--activeCount];
+			}
+		}
+	}
+}
+
+void Intersect_BVH8_Interleaved_AVX2(const BVH8 &bvh, const Ray* rays, size_t count, Hit* hits, uint32_t* hitBits, int raysInFlight)
+{
+	traverseInterleaved<false>(bvh, rays, count, raysInFlight, [&](const InterleavedRay &state) {
+		if (!state.found) return;
+		hits[state.index] = state.hit;
+		hitBits[state.index / 32] |= 1u << (state.index % 32);
+	});
+}
+
+void Occluded_BVH8_Interleaved_AVX2(const BVH8 &bvh, const Ray* rays, size_t count, uint32_t* occludedBits, int raysInFlight)
+{
+	traverseInterleaved<true>(bvh, rays, count, raysInFlight, [&](const InterleavedRay &state) {
+		if (state.found) occludedBits[state.index / 32] |= 1u << (state.index % 32);
+	});
+}
+
+}
@@ -0,0 +1,99 @@
+// RTAO - 8-wide BVH traversal kernel, written with AVX-512 (F + VL) intrinsics
+#include "BVH8.h"
+
+#include <immintrin.h>
+
+namespace CPURT
+{
+
+/**
+* Same slab test as the AVX2 kernel, intersected children are gathered with mask compress stores instead of bit scans.
+*/
+template <bool anyHit>
+static bool traverse(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	if (bvh.nodes.empty()) return false;
+
+	const BVH8Node* nodes = bvh.nodes.data();
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+
+	const __m256 inverseX = _mm256_set1_ps(invDirection.x);
+	const __m256 inverseY = _mm256_set1_ps(invDirection.y);
+	const __m256 inverseZ = _mm256_set1_ps(invDirection.z);
+	const __m256 originScaledX = _mm256_set1_ps(ray.origin.x * invDirection.x);
+	const __m256 originScaledY = _mm256_set1_ps(ray.origin.y * invDirection.y);
+	const __m256 originScaledZ = _mm256_set1_ps(ray.origin.z * invDirection.z);
+	const __m256 tMinV = _mm256_set1_ps(ray.tMin);
+
+	const size_t planesOffset = BVH8_WIDTH * 3;
+	const size_t nearX = ray.direction.x < 0.0f ? planesOffset : 0;
+	const size_t nearY = (ray.direction.y < 0.0f ? planesOffset : 0) + BVH8_WIDTH;
+	const size_t nearZ = (ray.direction.z < 0.0f ? planesOffset : 0) + BVH8_WIDTH * 2;
+	const size_t farX = (nearX + planesOffset) % (planesOffset * 2);
+	const size_t farY = (nearY + planesOffset) % (planesOffset * 2);
+	const size_t farZ = (nearZ + planesOffset) % (planesOffset * 2);
+
+	float tMax = ray.tMax;
+	bool found = false;
+
+	BVH8StackEntry stack[BVH8_STACK_SIZE];
+	int stackSize = 0;
+	BVH8StackEntry entry = { root, 0, ray.tMin };
+
+	while (true) {
+		if (entry.child & BVH8_LEAF_FLAG) {
+			found |= IntersectLeaf(bvh, entry.child & ~BVH8_LEAF_FLAG, entry.count, ray, tMax, hit, anyHit);
+			if (anyHit && found) break;
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		const BVH8Node &node = nodes[entry.child];
+		const float* planes = &node.boundsMin[0][0];
+
+		__m256 tNearX = _mm256_fmsub_ps(_mm256_loadu_ps(planes + nearX), inverseX, originScaledX);
+		__m256 tNearY = _mm256_fmsub_ps(_mm256_loadu_ps(planes + nearY), inverseY, originScaledY);
+		__m256 tNearZ = _mm256_fmsub_ps(_mm256_loadu_ps(planes + nearZ), inverseZ, originScaledZ);
+		__m256 tFarX = _mm256_fmsub_ps(_mm256_loadu_ps(planes + farX), inverseX, originScaledX);
+		__m256 tFarY = _mm256_fmsub_ps(_mm256_loadu_ps(planes + farY), inverseY, originScaledY);
+		__m256 tFarZ = _mm256_fmsub_ps(_mm256_loadu_ps(planes + farZ), inverseZ, originScaledZ);
+
+		__m256 tNear = _mm256_max_ps(_mm256_max_ps(tNearX, tNearY), _mm256_max_ps(tNearZ, tMinV));
+		__m256 tFar = _mm256_min_ps(_mm256_min_ps(tFarX, tFarY), _mm256_min_ps(tFarZ, _mm256_set1_ps(tMax)));
+
+		__mmask8 mask = _mm256_cmp_ps_mask(tNear, tFar, _CMP_LE_OQ);
+		if (mask == 0) {
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		int hitsCount = _mm_popcnt_u32(mask);
+
+		float distances[BVH8_WIDTH];
+		uint32_t children[BVH8_WIDTH];
+		uint32_t counts[BVH8_WIDTH];
+		_mm256_mask_compressstoreu_ps(distances, mask, tNear);
+		_mm256_mask_compressstoreu_epi32(children, mask, _mm256_loadu_si256((const __m256i*)node.children));
+		_mm256_mask_compressstoreu_epi32(counts, mask, _mm256_loadu_si256((const __m256i*)node.counts));
+
+		BVH8StackEntry hits[BVH8_WIDTH];
+		for (int i = 0; i < hitsCount; i++)
+			hits[i] = { children[i], counts[i], distances[i] };
+
+		entry = PushChildren(stack, stackSize, hits, hitsCount, anyHit);
+	}
+
+	return found;
+}
+
+bool Intersect_BVH8_AVX512(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	return traverse<false>(bvh, ray, hit, root);
+}
+
+bool Occluded_BVH8_AVX512(const BVH8 &bvh, const Ray &ray, Hit &hit, uint32_t root)
+{
+	return traverse<true>(bvh, ray, hit, root);
+}
+
+}
@@ -0,0 +1,143 @@
+// RTAO - Traversal entry points of short rays: the smallest BVH8 subtree holding everything within reach of a ray origin
+#include "BVH8Entry.h"
+
+namespace CPURT
+{
+
+// Reach is widened by this fraction, so that a child merely touching the reachable bounds after rounding is still kept
+static const float reachMargin = 1e-4f;
+
+static bool overlaps(const BVH8Node &node, int child, const AABB &bounds)
+{
+	return node.boundsMin[0][child] <= bounds.max.x && node.boundsMax[0][child] >= bounds.min.x
+		&& node.boundsMin[1][child] <= bounds.max.y && node.boundsMax[1][child] >= bounds.min.y
+		&& node.boundsMin[2][child] <= bounds.max.z && node.boundsMax[2][child] >= bounds.min.z;
+}
+
+uint32_t Find_BVH8_Entry(const BVH8 &bvh, const AABB &bounds)
+{
+	uint32_t entry = 0;
+	if (bvh.nodes.empty()) return entry;
+
+	while (true) {
+		const BVH8Node &node = bvh.nodes[entry];
+		uint32_t overlapping = BVH8_EMPTY_CHILD;
+		int overlappingCount = 0;
+
+		for (int i = 0; i < BVH8_WIDTH; i++) {
+			if (node.children[i] == BVH8_EMPTY_CHILD || !overlaps(node, i, bounds)) continue;
+			overlapping = node.children[i];
+			overlappingCount++;
+		}
+
+		// Traversal starts at an inner node, a single overlapping leaf is reached from its parent
+		if (overlappingCount != 1 || (overlapping & BVH8_LEAF_FLAG)) return entry;
+		entry = overlapping;
+	}
+}
+
+uint32_t Find_BVH8_Entry(const BVH8 &bvh, const XMFLOAT3 &origin, float radius)
+{
+	float reach = radius * (1.0f + reachMargin);
+
+	AABB bounds;
+	bounds.min = Sub(origin, XMFLOAT3(reach, reach, reach));
+	bounds.max = Add(origin, XMFLOAT3(reach, reach, reach));
+	return Find_BVH8_Entry(bvh, bounds);
+}
+
+bool Use_BVH8_Entry(const BVH8 &bvh, float radius)
+{
+	if (bvh.nodes.empty()) return false;
+
+	XMFLOAT3 extent = Get_Bounds(bvh).Extent();
+	return radius <= BVH8_ENTRY_MAX_REACH * max(extent.x, max(extent.y, extent.z));
+}
+
+/**
+* Entries are found independently for every cell from the cell's bounds grown by the radius, rows of cells are split over threads.
+*/
+void Build_BVH8_Entry_Grid(TaskScheduler &scheduler, const BVH8 &bvh, float radius, BVH8EntryGrid &grid, size_t maxCells)
+{
+	if (radius <= 0.0f)
+	{
+		throw std::runtime_error("Error: BVH8 entry grid requires a positive ray reach!");
+	}
+
+	grid.entries.clear();
+	grid.radius = radius;
+	grid.resolution[0] = grid.resolution[1] = grid.resolution[2] = 0;
+	if (bvh.nodes.empty()) return;
+
+	AABB bounds = Get_Bounds(bvh);
+	XMFLOAT3 extent = bounds.Extent();
+	float extents[3] = { extent.x, extent.y, extent.z };
+
+	grid.origin = bounds.min;
+	grid.cellSize = radius;
+
+	size_t cellsCount;
+	while (true) {
+		cellsCount = 1;
+		for (int axis = 0; axis < 3; axis++) {
+			grid.resolution[axis] = max(1, (int)ceil(extents[axis] / grid.cellSize));
+			cellsCount *= size_t(grid.resolution[axis]);
+		}
+
+		if (cellsCount <= max(maxCells, size_t(1))) break;
+		grid.cellSize *= 1.25f;
+	}
+
+	grid.entries.resize(cellsCount);
+
+	const int resolutionX = grid.resolution[0];
+	const int resolutionY = grid.resolution[1];
+	const float reach = radius * (1.0f + reachMargin);
+
+	scheduler.ParallelFor(size_t(resolutionY) * grid.resolution[2], 16, [&](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++) {
+			int y = int(row % resolutionY);
+			int z = int(row / resolutionY);
+
+			for (int x = 0; x < resolutionX; x++) {
+				AABB cell;
+				cell.min = Add(grid.origin, XMFLOAT3(x * grid.cellSize - reach, y * grid.cellSize - reach, z * grid.cellSize - reach));
+				cell.max = Add(grid.origin, XMFLOAT3((x + 1) * grid.cellSize + reach, (y + 1) * grid.cellSize + reach, (z + 1) * grid.cellSize + reach));
+				grid.entries[row * resolutionX + x] = Find_BVH8_Entry(bvh, cell);
+			}
+		}
+	});
+}
+
+uint32_t Get_BVH8_Entry(const BVH8EntryGrid &grid, const Ray &ray)
+{
+	if (grid.entries.empty() || ray.tMax * Length(ray.direction) > grid.radius) return 0;
+
+	float cell[3] = {
+		floorf((ray.origin.x - grid.origin.x) / grid.cellSize),
+		floorf((ray.origin.y - grid.origin.y) / grid.cellSize),
+		floorf((ray.origin.z - grid.origin.z) / grid.cellSize)
+	};
+
+	// Written so that NaN origins fail as well
+	for (int axis = 0; axis < 3; axis++) {
+		if (!(cell[axis] >= 0.0f && cell[axis] < float(grid.resolution[axis]))) return 0;
+	}
+
+	size_t index = (size_t(cell[2]) * grid.resolution[1] + size_t(cell[1])) * grid.resolution[0] + size_t(cell[0]);
+	return grid.entries[index];
+}
+
+bool Intersect(const BVH8 &bvh, const BVH8EntryGrid &grid, const Ray &ray, Hit &hit)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	return Intersect(bvh, ray, hit, supportedLevel, Get_BVH8_Entry(grid, ray));
+}
+
+bool Occluded(const BVH8 &bvh, const BVH8EntryGrid &grid, const Ray &ray, Hit &hit)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	return Occluded(bvh, ray, hit, supportedLevel, Get_BVH8_Entry(grid, ray));
+}
+
+}
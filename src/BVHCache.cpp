@@ -0,0 +1,259 @@
+// RTAO - On-disk cache of 8-wide BVHs
+#include "BVHCache.h"
+
+#include <chrono>
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Keys
+//--------------------------------------------------------------------------------------
+
+static inline uint32_t floatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+uint64_t Get_Geometry_Hash(const Model &model)
+{
+	uint64_t hash = BVH_CACHE_HASH_SEED;
+
+	hash = HashWord(hash, (uint32_t)model.vertices.size());
+	hash = HashWord(hash, (uint32_t)model.indices.size());
+
+	for (const Vertex &vertex : model.vertices) {
+		hash = HashWord(hash, floatBits(vertex.position.x));
+		hash = HashWord(hash, floatBits(vertex.position.y));
+		hash = HashWord(hash, floatBits(vertex.position.z));
+	}
+
+	for (uint32_t index : model.indices) hash = HashWord(hash, index);
+
+	// Final avalanche, FNV leaves the high bits weak
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+static uint64_t getBuildHash(const BVHBuildInfo &info)
+{
+	// SAH costs only weigh the reported cost of SAH split builds, they don't change the tree
+	uint64_t hash = BVH_CACHE_HASH_SEED;
+	hash = HashWord(hash, (uint32_t)info.leafSize);
+	hash = HashWord(hash, (uint32_t)info.binsCount);
+	hash = HashWord(hash, info.spatialSplits ? 1u : 0u);
+
+	if (info.spatialSplits) {
+		hash = HashWord(hash, floatBits(info.spatialSplitAlpha));
+		hash = HashWord(hash, floatBits(info.duplicationBudget));
+	} else if (info.linear) {
+		hash = HashWord(hash, 2u + (uint32_t)info.treeletPasses);
+
+		// Treelets are optimized for the SAH costs
+		if (info.treeletPasses > 0) {
+			hash = HashWord(hash, floatBits(info.traversalCost));
+			hash = HashWord(hash, floatBits(info.intersectionCost));
+		}
+	}
+
+	return hash;
+}
+
+//--------------------------------------------------------------------------------------
+// File
+//--------------------------------------------------------------------------------------
+
+// Read-only view of a whole file, unmapped on destruction
+struct MappedFile
+{
+	HANDLE file;
+	HANDLE mapping;
+	const uint8_t* data;
+	uint64_t size;
+
+	MappedFile() {
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+		data = nullptr;
+		size = 0;
+	}
+
+	~MappedFile() {
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	}
+
+	bool Open(const string &path) {
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return false;
+		size = (uint64_t)fileSize.QuadPart;
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping) return false;
+
+		data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		return data != nullptr;
+	}
+};
+
+static inline uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + BVH_CACHE_ALIGNMENT - 1) / BVH_CACHE_ALIGNMENT * BVH_CACHE_ALIGNMENT;
+}
+
+static inline bool isSectionValid(const BVHCacheSection &section, uint64_t elementSize, uint64_t fileSize)
+{
+	if (section.offset % BVH_CACHE_ALIGNMENT != 0 || section.offset > fileSize) return false;
+	return section.count <= (fileSize - section.offset) / elementSize;
+}
+
+template <typename T>
+static void writeSection(ofstream &file, const vector<T> &elements, BVHCacheSection &section)
+{
+	static const char padding[BVH_CACHE_ALIGNMENT] = {};
+
+	uint64_t position = (uint64_t)file.tellp();
+	section.offset = alignOffset(position);
+	section.count = elements.size();
+
+	file.write(padding, std::streamsize(section.offset - position));
+	file.write((const char*)elements.data(), std::streamsize(elements.size() * sizeof(T)));
+}
+
+uint64_t Save_BVH_Cache(const string &path, uint64_t geometryHash, const BVHBuildInfo &info, const BVH8 &bvh, const vector<float>* vertexAO,
+	uint64_t vertexAOHash)
+{
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Error: failed to open BVH cache file for writing!");
+	}
+
+	BVHCacheHeader header = {};
+	header.magic = BVH_CACHE_MAGIC;
+	header.version = BVH_CACHE_VERSION;
+	header.geometryHash = geometryHash;
+	header.buildHash = getBuildHash(info);
+	header.nodeSize = sizeof(BVH8Node);
+	header.triangleSize = sizeof(Triangle);
+
+	// Sections go after the header, which is rewritten once their offsets are known
+	file.write((const char*)&header, sizeof(header));
+	writeSection(file, bvh.nodes, header.nodes);
+	writeSection(file, bvh.triangles, header.triangles);
+	writeSection(file, bvh.primitiveIndices, header.primitiveIndices);
+
+	if (vertexAO) {
+		header.vertexAOHash = vertexAOHash;
+		writeSection(file, *vertexAO, header.vertexAO);
+	}
+
+	header.fileSize = (uint64_t)file.tellp();
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	file.close();
+
+	if (file.fail())
+	{
+		throw std::runtime_error("Error: failed to write BVH cache file!");
+	}
+
+	return header.fileSize;
+}
+
+bool Load_BVH_Cache(const string &path, uint64_t geometryHash, const BVHBuildInfo &info, BVH8 &bvh, uint64_t* fileSize)
+{
+	MappedFile mapped;
+	if (!mapped.Open(path) || mapped.size < sizeof(BVHCacheHeader)) return false;
+
+	const BVHCacheHeader &header = *(const BVHCacheHeader*)mapped.data;
+
+	if (header.magic != BVH_CACHE_MAGIC || header.version != BVH_CACHE_VERSION) return false;
+	if (header.nodeSize != sizeof(BVH8Node) || header.triangleSize != sizeof(Triangle)) return false;
+	if (header.geometryHash != geometryHash || header.buildHash != getBuildHash(info)) return false;
+	if (header.fileSize != mapped.size) return false;
+
+	if (!isSectionValid(header.nodes, sizeof(BVH8Node), mapped.size) ||
+		!isSectionValid(header.triangles, sizeof(Triangle), mapped.size) ||
+		!isSectionValid(header.primitiveIndices, sizeof(uint32_t), mapped.size) ||
+		header.triangles.count != header.primitiveIndices.count) return false;
+
+	// Nodes hold indices only, so sections are used as they are
+	const BVH8Node* nodes = (const BVH8Node*)(mapped.data + header.nodes.offset);
+	const Triangle* triangles = (const Triangle*)(mapped.data + header.triangles.offset);
+	const uint32_t* primitiveIndices = (const uint32_t*)(mapped.data + header.primitiveIndices.offset);
+
+	bvh.nodes.assign(nodes, nodes + header.nodes.count);
+	bvh.triangles.assign(triangles, triangles + header.triangles.count);
+	bvh.primitiveIndices.assign(primitiveIndices, primitiveIndices + header.primitiveIndices.count);
+
+	// Rebuilt when too deep for traversal, the build then reports it
+	bvh.depth = Get_BVH8_Depth(bvh);
+	if (bvh.depth > BVH8_MAX_DEPTH) return false;
+
+	if (fileSize) *fileSize = mapped.size;
+	return true;
+}
+
+bool Load_Vertex_AO_Cache(const string &path, uint64_t geometryHash, uint64_t vertexAOHash, vector<float> &vertexAO)
+{
+	MappedFile mapped;
+	if (!mapped.Open(path) || mapped.size < sizeof(BVHCacheHeader)) return false;
+
+	const BVHCacheHeader &header = *(const BVHCacheHeader*)mapped.data;
+
+	if (header.magic != BVH_CACHE_MAGIC || header.version != BVH_CACHE_VERSION) return false;
+	if (header.geometryHash != geometryHash || header.fileSize != mapped.size) return false;
+	if (header.vertexAO.count == 0 || header.vertexAOHash != vertexAOHash) return false;
+	if (!isSectionValid(header.vertexAO, sizeof(float), mapped.size)) return false;
+
+	const float* values = (const float*)(mapped.data + header.vertexAO.offset);
+	vertexAO.assign(values, values + header.vertexAO.count);
+
+	return true;
+}
+
+void Build_BVH8_Cached(TaskScheduler &scheduler, const string &path, const Model &model, const BVHBuildInfo &info, BVH8 &bvh, BVHCacheStats* stats)
+{
+	BVHCacheStats localStats;
+	if (!stats) stats = &localStats;
+	*stats = BVHCacheStats();
+
+	auto milliseconds = [](std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t geometryHash = Get_Geometry_Hash(model);
+	stats->hashTime = milliseconds(start);
+
+	start = std::chrono::steady_clock::now();
+	uint64_t fileSize = 0;
+	stats->loaded = Load_BVH_Cache(path, geometryHash, info, bvh, &fileSize);
+	stats->loadTime = milliseconds(start);
+
+	if (!stats->loaded) {
+		start = std::chrono::steady_clock::now();
+		BVH binary;
+		Build_BVH(scheduler, model, info, binary);
+		Build_BVH8(binary, bvh);
+		stats->buildTime = milliseconds(start);
+
+		start = std::chrono::steady_clock::now();
+		fileSize = Save_BVH_Cache(path, geometryHash, info, bvh);
+		stats->saveTime = milliseconds(start);
+	}
+
+	stats->fileSize = size_t(fileSize);
+}
+
+}
@@ -0,0 +1,2946 @@
+// RTAO - Headless benchmarks
+#include "Benchmarks.h"
+#include "SampleSets.h"
+#include "RayStream.h"
+#include "AOPass.h"
+#include "AOBaker.h"
+#include "PrimaryPass.h"
+#include "Rasterizer.h"
+#include "FilterPass.h"
+#include "TopLevelBVH.h"
+#include "BVHCache.h"
+#include "BVH8Entry.h"
+#include "HashGrid.h"
+#include "QuantizedBVH8.h"
+#include "TrianglePackets.h"
+#include "Camera.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <random>
+
+namespace Benchmarks
+{
+
+struct BenchmarkEntry
+{
+	const char* name;
+	int (*run)(const ConfigInfo &config);
+};
+
+static const BenchmarkEntry benchmarks[] =
+{
+	{ "samples", Run_Sample_Sets },
+	{ "bvh", Run_BVH_Build },
+	{ "bvh8", Run_BVH8_Traversal },
+	{ "occlusion", Run_Occlusion_Queries },
+	{ "streams", Run_Ray_Streams },
+	{ "ao", Run_AO_Pass },
+	{ "primary", Run_Primary_Pass },
+	{ "raster", Run_Rasterizer },
+	{ "scheduler", Run_Scheduler_Scaling },
+	{ "refit", Run_BVH_Refit },
+	{ "instances", Run_Instancing },
+	{ "sbvh", Run_Spatial_Splits },
+	{ "bvhcache", Run_BVH_Cache },
+	{ "quantized", Run_Quantized_BVH8 },
+	{ "triangles", Run_Triangle_Packets },
+	{ "lbvh", Run_Linear_BVH },
+	{ "layouts", Run_Node_Layouts },
+	{ "shortrays", Run_Short_Rays },
+	{ "hashgrid", Run_Hash_Grid },
+	{ "interleave", Run_Interleaved_Traversal },
+	{ "numa", Run_NUMA_Scaling },
+	{ "vertexao", Run_Vertex_AO_Bake },
+	{ "lightmap", Run_Lightmap_AO_Bake },
+	{ "progressive", Run_Progressive_AO_Bake },
+};
+
+/**
+* Run benchmark selected on the command line (-benchmark [name]), results are written as CSV to the -output file. An unknown name
+* is reported in a message box listing the valid ones, there is no console to print to.
+*/
+int Run(const ConfigInfo &config)
+{
+	for (const BenchmarkEntry &benchmark : benchmarks) {
+		if (config.benchmark == benchmark.name) return benchmark.run(config);
+	}
+
+	string errorMsg = "Error: unknown benchmark \"" + config.benchmark + "\"!\nValid names:";
+	for (const BenchmarkEntry &benchmark : benchmarks) errorMsg += string(" ") + benchmark.name;
+
+	MessageBoxA(nullptr, errorMsg.c_str(), "Error!", MB_OK);
+	return EXIT_FAILURE;
+}
+
+//--------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------
+
+/**
+* Generate a displaced terrain grid with (at least) the given number of triangles, spanning [-30, 30] in XZ around the default camera.
+*/
+static void generateTerrain(int trianglesCount, Model &model)
+{
+	int resolution = max(1, (int)ceil(sqrt(trianglesCount / 2.0)));
+	int verticesPerSide = resolution + 1;
+
+	model.vertices.resize(size_t(verticesPerSide) * verticesPerSide);
+	model.indices.resize(size_t(resolution) * resolution * 6);
+
+	for (int y = 0; y < verticesPerSide; y++) {
+		for (int x = 0; x < verticesPerSide; x++) {
+			float u = float(x) / resolution;
+			float v = float(y) / resolution;
+			float height = 1.5f * sinf(u * 45.0f) * cosf(v * 35.0f) + 0.4f * sinf(u * 185.0f + v * 115.0f);
+
+			Vertex &vertex = model.vertices[size_t(y) * verticesPerSide + x];
+			vertex.position = XMFLOAT3(u * 60.0f - 30.0f, height, v * 60.0f - 30.0f);
+			vertex.uv = XMFLOAT2(u, v);
+		}
+	}
+
+	size_t index = 0;
+	for (int y = 0; y < resolution; y++) {
+		for (int x = 0; x < resolution; x++) {
+			uint32_t v0 = uint32_t(y * verticesPerSide + x);
+			uint32_t v1 = v0 + 1;
+			uint32_t v2 = v0 + verticesPerSide;
+			uint32_t v3 = v2 + 1;
+
+			model.indices[index++] = v0; model.indices[index++] = v2; model.indices[index++] = v1;
+			model.indices[index++] = v1; model.indices[index++] = v2; model.indices[index++] = v3;
+		}
+	}
+}
+
+/**
+* Model benchmarks run on: the -model OBJ file or a generated terrain of -triangles size.
+*/
+static void loadBenchmarkModel(const ConfigInfo &config, Model &model, Material* material = nullptr)
+{
+	Material modelMaterial;
+	if (!config.model.empty()) {
+		Utils::LoadModel(config.model, model, modelMaterial);
+	} else {
+		generateTerrain(config.benchmarkTriangles, model);
+	}
+
+	if (material) *material = modelMaterial;
+}
+
+/**
+* Albedo of the model's material as Create_Texture loads it, generated models get a checkerboard.
+*/
+static void loadBenchmarkTexture(const Material &material, TextureInfo &texture, MaterialCB &materialCB)
+{
+	if (!material.texturePath.empty()) {
+		texture = Utils::LoadTexture(material.texturePath);
+	} else {
+		const int resolution = 512;
+		const int checkerSize = 16;
+
+		texture.width = resolution;
+		texture.height = resolution;
+		texture.stride = 4;
+		texture.pixels.resize(size_t(resolution) * resolution * 4);
+
+		for (int y = 0; y < resolution; y++) {
+			for (int x = 0; x < resolution; x++) {
+				UINT8 value = ((x / checkerSize + y / checkerSize) % 2) ? 0xC0 : 0x60;
+				UINT8* texel = &texture.pixels[(size_t(y) * resolution + x) * 4];
+				texel[0] = value; texel[1] = value; texel[2] = value; texel[3] = 0xff;
+			}
+		}
+	}
+
+	materialCB.resolution = XMFLOAT4(static_cast<float>(texture.width), 0.f, 0.f, 0.f);
+}
+
+/**
+* ViewCB of a rendered frame, the camera orbits as in Update_View_CB in release builds (starting at the beginning of the orbit).
+* previousViewProjection carries motion vectors between consecutive frames.
+*/
+static ViewCB benchmarkView(const ConfigInfo &config, int frame, XMMATRIX &previousViewProjection)
+{
+	const float rotationSpeed = 0.005f;
+	float eyeAngle = rotationSpeed * frame;
+
+	XMFLOAT3 eye = XMFLOAT3(8.f * cosf(eyeAngle), 1.5f + 1.5f * cosf(eyeAngle), 8.f + 2.25f * sinf(eyeAngle));
+	XMFLOAT3 focus = XMFLOAT3(0.f, 1.75f, 0.f);
+	float fov = 65.f * (XM_PI / 180.f);
+
+	ViewCB view;
+	CPURT::Setup_View_CB(eye, focus, fov, config.width, config.height, previousViewProjection, view);
+	return view;
+}
+
+/**
+* AO rays of one frame set up as in RTAORayGen: origins at primary hits of -width x -height pixels, hemisphere around
+* the face normal oriented by the primary ray direction, default sample sets selected by pixel position in the interleave block.
+* Rays are generated tile by tile, tileOffsets (when given) receive the first ray of every tile and the total count.
+*/
+static void generateAORays(TaskScheduler &scheduler, const ConfigInfo &config, const Model &model, const BVH &bvh, vector<Ray> &rays, vector<size_t>* tileOffsets = nullptr, int tileSize = 16)
+{
+	SampleSetInfo info;
+	vector<XMFLOAT3> samples;
+	SampleSets::Build_Table(info, samples);
+
+	XMMATRIX viewProjection = XMMatrixIdentity();
+	ViewCB view = benchmarkView(config, 0, viewProjection);
+
+	int tilesX = (config.width + tileSize - 1) / tileSize;
+	int tilesY = (config.height + tileSize - 1) / tileSize;
+	vector<vector<Ray>> tileRays(size_t(tilesX) * tilesY);
+
+	scheduler.ParallelFor(tileRays.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; tile++) {
+			int tileX = int(tile % tilesX) * tileSize;
+			int tileY = int(tile / tilesX) * tileSize;
+
+			for (int y = tileY; y < min(tileY + tileSize, config.height); y++) {
+				for (int x = tileX; x < min(tileX + tileSize, config.width); x++) {
+					Ray ray = CPURT::Get_Primary_Ray(view, x, y);
+
+					Hit hit;
+					if (!CPURT::Intersect(bvh, ray, hit)) continue;
+
+					// Face normal as computed by GetVertexAttributes
+					const XMFLOAT3 &v0 = model.vertices[model.indices[hit.primitiveIndex * 3 + 0]].position;
+					const XMFLOAT3 &v1 = model.vertices[model.indices[hit.primitiveIndex * 3 + 1]].position;
+					const XMFLOAT3 &v2 = model.vertices[model.indices[hit.primitiveIndex * 3 + 2]].position;
+					XMFLOAT3 n = Normalize(Cross(Normalize(Sub(v1, v2)), Normalize(Sub(v0, v2))));
+
+					XMFLOAT3 b1 = Normalize(Sub(ray.direction, Mul(n, Dot(ray.direction, n))));
+					XMFLOAT3 b2 = Cross(n, b1);
+
+					XMFLOAT3 position = Add(ray.origin, Mul(ray.direction, hit.t));
+					int pixelIndex = (x % info.interleaveWidth) + (y % info.interleaveHeight) * info.interleaveWidth;
+
+					for (int i = 0; i < info.samplesCount; i++) {
+						const XMFLOAT3 &s = samples[pixelIndex * info.samplesCount + i];
+						XMFLOAT3 direction = Add(Add(Mul(b1, s.x), Mul(b2, s.y)), Mul(n, s.z));
+						tileRays[tile].push_back(Ray(position, direction, 0.1f, config.aoRadius));
+					}
+				}
+			}
+		}
+	});
+
+	rays.clear();
+	if (tileOffsets) tileOffsets->clear();
+
+	for (const vector<Ray> &tile : tileRays) {
+		if (tileOffsets) tileOffsets->push_back(rays.size());
+		rays.insert(rays.end(), tile.begin(), tile.end());
+	}
+
+	if (tileOffsets) tileOffsets->push_back(rays.size());
+}
+
+static ofstream openBenchmarkOutput(const ConfigInfo &config)
+{
+	ofstream output(config.benchmarkOutput);
+	if (!output.is_open())
+	{
+		throw std::runtime_error("Error: failed to open benchmark output file!");
+	}
+	return output;
+}
+
+//--------------------------------------------------------------------------------------
+// Sample Sets Quality
+//--------------------------------------------------------------------------------------
+
+// Analytic occlusion configurations, distances are in units of AO radius. Surface point is at the origin, normal is +Z.
+struct AnalyticOcclusion
+{
+	const char* name;
+	float (*hitDistance)(const XMFLOAT3 &direction);
+};
+
+static float ceilingHitDistance(const XMFLOAT3 &d)
+{
+	return d.z > 0.0f ? 0.5f / d.z : FLT_MAX;
+}
+
+static float wallHitDistance(const XMFLOAT3 &d)
+{
+	return d.x > 0.0f ? 0.3f / d.x : FLT_MAX;
+}
+
+static float cornerHitDistance(const XMFLOAT3 &d)
+{
+	return min(wallHitDistance(d), d.y > 0.0f ? 0.3f / d.y : FLT_MAX);
+}
+
+static float sphereHitDistance(const XMFLOAT3 &d)
+{
+	const XMFLOAT3 center = XMFLOAT3(0.3f, 0.0f, 0.5f);
+	const float radius = 0.25f;
+
+	float b = d.x * center.x + d.y * center.y + d.z * center.z;
+	float c = center.x * center.x + center.y * center.y + center.z * center.z - radius * radius;
+	float discriminant = b * b - c;
+	if (discriminant < 0.0f) return FLT_MAX;
+
+	float t = b - sqrtf(discriminant);
+	if (t < 0.0f) return FLT_MAX;
+	return t;
+}
+
+static const AnalyticOcclusion analyticOcclusions[] = {
+	{ "ceiling", ceilingHitDistance },
+	{ "wall", wallHitDistance },
+	{ "corner", cornerHitDistance },
+	{ "sphere", sphereHitDistance },
+};
+
+/**
+* AO estimate for a single ray, same as in RTAORayGen (T / aoRadius, hits closer than TMin are ignored).
+*/
+static float aoRayEstimate(const AnalyticOcclusion &occlusion, const XMFLOAT3 &direction)
+{
+	const float tMin = 0.1f;
+	const float aoRadius = 1.0f;
+
+	float t = occlusion.hitDistance(direction);
+	if (t < tMin || t > aoRadius) return 1.0f;
+	return t / aoRadius;
+}
+
+/**
+* Reference cosine-weighted AO integral, evaluated by a dense midpoint quadrature.
+*/
+static double aoReference(const AnalyticOcclusion &occlusion)
+{
+	const int resolution = 2048;
+	double sum = 0.0;
+
+	for (int y = 0; y < resolution; y++) {
+		for (int x = 0; x < resolution; x++) {
+			// Cosine-weighted mapping: r = sqrt(u), phi = 2PI * v
+			float r = sqrtf((x + 0.5f) / resolution);
+			float phi = 2.0f * XM_PI * ((y + 0.5f) / resolution);
+			XMFLOAT3 direction = XMFLOAT3(r * cosf(phi), r * sinf(phi), sqrtf(max(0.0f, 1.0f - r * r)));
+			sum += aoRayEstimate(occlusion, direction);
+		}
+	}
+
+	return sum / (double(resolution) * resolution);
+}
+
+/**
+* Measure quality of hemisphere sample sets: discrepancy and convergence of AO estimate on analytic occlusion configurations.
+* Candidates are the baked Samples.h sets, generated R2 and random sets of the same sizes and any sets passed with -samples.
+* Sample set is rotated around the normal (as TBN in RTAORayGen does) and error is averaged over all rotations.
+*/
+int Run_Sample_Sets(const ConfigInfo &config)
+{
+	const int rotationsCount = 64;
+
+	// Gather candidate sample sets
+	vector<pair<string, vector<XMFLOAT3>>> candidates;
+
+	for (int raysCount = 1; raysCount <= 4; raysCount++) {
+		SampleSetInfo info;
+		info.samplesCount = raysCount;
+
+		vector<XMFLOAT3> samples;
+		SampleSets::Build_Table(info, samples);
+		int size = (int)samples.size();
+
+		candidates.push_back(make_pair("baked_" + to_string(raysCount) + "rays", samples));
+
+		SampleSets::Generate_R2(size, samples);
+		candidates.push_back(make_pair("r2_" + to_string(size), samples));
+
+		SampleSets::Generate_Random(size, raysCount, samples);
+		candidates.push_back(make_pair("random_" + to_string(size), samples));
+	}
+
+	for (const string &path : config.sampleSets) {
+		vector<XMFLOAT3> samples;
+		SampleSets::Load_Sample_Set(path, samples);
+		if (!samples.empty()) candidates.push_back(make_pair(path, samples));
+	}
+
+	// Reference values of analytic configurations
+	vector<double> references;
+	for (const AnalyticOcclusion &occlusion : analyticOcclusions)
+		references.push_back(aoReference(occlusion));
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "set,samples,discrepancy,configuration,reference,mean,rmse\n";
+
+	for (const auto &candidate : candidates) {
+
+		const vector<XMFLOAT3> &samples = candidate.second;
+
+		vector<double> discrepancy;
+		SampleSets::Compute_Discrepancy(samples, discrepancy);
+
+		for (size_t c = 0; c < _countof(analyticOcclusions); c++) {
+
+			// Running sums of AO estimate for every rotation, so that all prefixes (sample counts) are evaluated in one pass
+			vector<double> sums(rotationsCount, 0.0);
+
+			for (size_t i = 0; i < samples.size(); i++) {
+
+				double mean = 0.0;
+				double squaredError = 0.0;
+
+				for (int r = 0; r < rotationsCount; r++) {
+					float angle = 2.0f * XM_PI * (r + 0.5f) / rotationsCount;
+					float cosAngle = cosf(angle);
+					float sinAngle = sinf(angle);
+
+					const XMFLOAT3 &s = samples[i];
+					XMFLOAT3 direction = XMFLOAT3(s.x * cosAngle - s.y * sinAngle, s.x * sinAngle + s.y * cosAngle, s.z);
+
+					sums[r] += aoRayEstimate(analyticOcclusions[c], direction);
+
+					double estimate = sums[r] / double(i + 1);
+					mean += estimate;
+					squaredError += (estimate - references[c]) * (estimate - references[c]);
+				}
+
+				output << candidate.first << "," << (i + 1) << "," << discrepancy[i] << "," << analyticOcclusions[c].name << ","
+					<< references[c] << "," << (mean / rotationsCount) << "," << sqrt(squaredError / rotationsCount) << "\n";
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// BVH Build
+//--------------------------------------------------------------------------------------
+
+/**
+* Build binned SAH BVH over the model with all threads for a range of leaf sizes, and single-threaded as a baseline.
+*/
+int Run_BVH_Build(const ConfigInfo &config)
+{
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "leafSize,threads,triangles,buildTimeMs,nodes,leaves,sahCost\n";
+
+	auto runBuilds = [&](int threadsCount, const vector<int> &leafSizes) {
+		TaskScheduler scheduler;
+		scheduler.Init(threadsCount);
+
+		for (int leafSize : leafSizes) {
+			BVHBuildInfo info;
+			info.leafSize = leafSize;
+
+			BVH bvh;
+			CPURT::Build_BVH(scheduler, model, info, bvh);
+
+			output << leafSize << "," << scheduler.GetThreadsCount() << "," << bvh.triangles.size() << "," << bvh.stats.buildTime << ","
+				<< bvh.stats.nodesCount << "," << bvh.stats.leavesCount << "," << bvh.stats.sahCost << "\n";
+		}
+
+		scheduler.Destroy();
+	};
+
+	runBuilds(config.threadsCount, { 1, 2, 4, 8, 16 });
+	runBuilds(1, { BVHBuildInfo().leafSize });
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// BVH8 Traversal
+//--------------------------------------------------------------------------------------
+
+/**
+* Trace all rays in parallel and return the throughput in Mrays/s, hits are counted to check traversals agree.
+*/
+static double traceRays(TaskScheduler &scheduler, const vector<Ray> &rays, const function<bool(const Ray&, Hit&)> &intersect, size_t &hitsCount)
+{
+	std::atomic<size_t> hits(0);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	scheduler.ParallelFor(rays.size(), 1024, [&](size_t begin, size_t end) {
+		size_t localHits = 0;
+		for (size_t i = begin; i < end; i++) {
+			Hit hit;
+			if (intersect(rays[i], hit)) localHits++;
+		}
+		hits += localHits;
+	});
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	hitsCount = hits;
+	return rays.size() / std::chrono::duration<double, std::micro>(endTime - startTime).count();
+}
+
+/**
+* Closest-hit throughput of RTAORayGen-like AO rays on the binary BVH and the 8-wide BVH with every supported kernel.
+*/
+int Run_BVH8_Traversal(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	vector<Ray> rays;
+	generateAORays(scheduler, config, model, bvh, rays);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "structure,kernel,threads,nodes,nodeBytes,rays,hits,mraysPerSecond\n";
+
+	auto measure = [&](const char* structure, const char* kernel, size_t nodesCount, size_t nodeBytes, const function<bool(const Ray&, Hit&)> &intersect) {
+		double best = 0.0;
+		size_t hitsCount = 0;
+		for (int r = 0; r < repetitions; r++)
+			best = max(best, traceRays(scheduler, rays, intersect, hitsCount));
+
+		output << structure << "," << kernel << "," << scheduler.GetThreadsCount() << "," << nodesCount << "," << nodeBytes << ","
+			<< rays.size() << "," << hitsCount << "," << best << "\n";
+	};
+
+	measure("bvh2", "scalar", bvh.nodes.size(), sizeof(BVHNode), [&](const Ray &ray, Hit &hit) {
+		return CPURT::Intersect(bvh, ray, hit);
+	});
+
+	SIMDLevel supportedLevel = CPURT::Get_Supported_SIMD_Level();
+	for (int level = SIMD_SCALAR; level <= supportedLevel; level++) {
+		measure("bvh8", CPURT::Get_SIMD_Level_Name((SIMDLevel)level), bvh8.nodes.size(), sizeof(BVH8Node), [&](const Ray &ray, Hit &hit) {
+			return CPURT::Intersect(bvh8, ray, hit, (SIMDLevel)level);
+		});
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Occlusion Queries
+//--------------------------------------------------------------------------------------
+
+/**
+* Run body over work items (rays or batches of rays) in parallel, returns the best throughput of several runs in Mrays/s.
+*/
+static double measureThroughput(TaskScheduler &scheduler, size_t itemsCount, size_t grainSize, size_t raysCount, int repetitions, const function<void(size_t, size_t)> &body)
+{
+	double best = 0.0;
+
+	for (int r = 0; r < repetitions; r++) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		scheduler.ParallelFor(itemsCount, grainSize, body);
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		best = max(best, raysCount / std::chrono::duration<double, std::micro>(endTime - startTime).count());
+	}
+
+	return best;
+}
+
+/**
+* Closest hit traversal against the any hit batch queries (occluded bits and any-hit distance) on the same AO rays.
+* Mean AO shows the bias of any-hit distance in the T / aoRadius estimator and the binary estimate of occluded bits.
+*/
+int Run_Occlusion_Queries(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	vector<Ray> rays;
+	generateAORays(scheduler, config, model, bvh, rays);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "query,kernel,threads,rays,occluded,meanAO,mraysPerSecond,speedup\n";
+
+	// Batches are aligned to 32 rays, so that threads never share a word of occluded bits
+	const size_t batchSize = 1024;
+	const size_t batchesCount = (rays.size() + batchSize - 1) / batchSize;
+	vector<float> distances(rays.size());
+	vector<uint32_t> occludedBits((rays.size() + 31) / 32);
+
+	auto writeResult = [&](const char* query, SIMDLevel level, size_t occludedCount, double meanAO, double mraysPerSecond, double closestHitMraysPerSecond) {
+		output << query << "," << CPURT::Get_SIMD_Level_Name(level) << "," << scheduler.GetThreadsCount() << "," << rays.size() << ","
+			<< occludedCount << "," << meanAO << "," << mraysPerSecond << "," << (mraysPerSecond / closestHitMraysPerSecond) << "\n";
+	};
+
+	auto distanceStats = [&](size_t &occludedCount, double &meanAO) {
+		occludedCount = 0;
+		meanAO = 0.0;
+		for (size_t i = 0; i < rays.size(); i++) {
+			if (distances[i] < rays[i].tMax) occludedCount++;
+			meanAO += distances[i] / config.aoRadius;
+		}
+		meanAO /= max(rays.size(), size_t(1));
+	};
+
+	SIMDLevel supportedLevel = CPURT::Get_Supported_SIMD_Level();
+	for (int l = SIMD_SCALAR; l <= supportedLevel; l++) {
+		SIMDLevel level = (SIMDLevel)l;
+		size_t occludedCount;
+		double meanAO;
+
+		// Closest hit, as RTAORayGen traces with RAY_FLAG_NONE
+		double closestHit = measureThroughput(scheduler, rays.size(), batchSize, rays.size(), repetitions, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				Hit hit;
+				distances[i] = CPURT::Intersect(bvh8, rays[i], hit, level) ? hit.t : rays[i].tMax;
+			}
+		});
+		distanceStats(occludedCount, meanAO);
+		writeResult("closest", level, occludedCount, meanAO, closestHit, closestHit);
+
+		double anyHit = measureThroughput(scheduler, batchesCount, 1, rays.size(), repetitions, [&](size_t begin, size_t end) {
+			for (size_t b = begin; b < end; b++) {
+				size_t first = b * batchSize;
+				CPURT::Occlusion_Distance(bvh8, &rays[first], min(batchSize, rays.size() - first), &distances[first], level);
+			}
+		});
+		distanceStats(occludedCount, meanAO);
+		writeResult("anyhit_distance", level, occludedCount, meanAO, anyHit, closestHit);
+
+		double occluded = measureThroughput(scheduler, batchesCount, 1, rays.size(), repetitions, [&](size_t begin, size_t end) {
+			for (size_t b = begin; b < end; b++) {
+				size_t first = b * batchSize;
+				CPURT::Occluded(bvh8, &rays[first], min(batchSize, rays.size() - first), &occludedBits[first / 32], level);
+			}
+		});
+
+		occludedCount = 0;
+		for (size_t i = 0; i < rays.size(); i++)
+			if (occludedBits[i / 32] & (1u << (i % 32))) occludedCount++;
+		meanAO = 1.0 - double(occludedCount) / max(rays.size(), size_t(1));
+		writeResult("occluded_bits", level, occludedCount, meanAO, occluded, closestHit);
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Ray Streams
+//--------------------------------------------------------------------------------------
+
+/**
+* Stream traversal of AO rays gathered from screen tiles with different binnings, against single-ray traversal of the same rays.
+* Coherence is measured as the average number of active rays per stream node visit.
+*/
+int Run_Ray_Streams(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo bvhInfo;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, bvhInfo, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	RayStreamInfo info;
+	info.originCellSize = config.aoRadius;
+
+	vector<Ray> rays;
+	vector<size_t> tileOffsets;
+	generateAORays(scheduler, config, model, bvh, rays, &tileOffsets, info.tileSize);
+	size_t tilesCount = tileOffsets.size() - 1;
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "method,query,kernel,threads,rays,streams,averageStreamSize,nodeVisitsPerStream,averageActiveRays,mraysPerSecond,speedup,mismatches\n";
+
+	vector<float> distances(rays.size());
+	vector<float> referenceDistances(rays.size());
+
+	const RayStreamBinning binnings[] = { RAY_STREAM_BINNING_NONE, RAY_STREAM_BINNING_OCTANT, RAY_STREAM_BINNING_OCTANT_AND_CELL };
+	const char* binningNames[] = { "stream_tile", "stream_octant", "stream_octant_cell" };
+
+	SIMDLevel supportedLevel = CPURT::Get_Supported_SIMD_Level();
+
+	for (int q = 0; q < 2; q++) {
+		bool anyHit = (q == 1);
+		const char* query = anyHit ? "anyhit" : "closest";
+
+		// Single ray baseline, in the same tile order
+		double single = measureThroughput(scheduler, rays.size(), 1024, rays.size(), repetitions, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				Hit hit;
+				bool found = anyHit ? CPURT::Occluded(bvh8, rays[i], hit, supportedLevel) : CPURT::Intersect(bvh8, rays[i], hit, supportedLevel);
+				referenceDistances[i] = found ? hit.t : rays[i].tMax;
+			}
+		});
+
+		output << "single," << query << "," << CPURT::Get_SIMD_Level_Name(supportedLevel) << "," << scheduler.GetThreadsCount() << "," << rays.size()
+			<< "," << rays.size() << ",1,,1," << single << ",1,0\n";
+
+		for (size_t b = 0; b < _countof(binnings); b++) {
+			info.binning = binnings[b];
+
+			// Binning is part of the measured time, it happens per tile as rays are produced
+			for (int l = SIMD_SCALAR; l <= min((int)supportedLevel, (int)SIMD_AVX2); l++) {
+				RayStreamStats stats;
+				std::mutex statsMutex;
+
+				double streams = measureThroughput(scheduler, tilesCount, 1, rays.size(), repetitions, [&](size_t begin, size_t end) {
+					RayStreamContext* context = new RayStreamContext();
+					RayStreamStats localStats;
+					vector<uint32_t> order;
+					vector<pair<uint32_t, uint32_t>> tileStreams;
+
+					for (size_t tile = begin; tile < end; tile++) {
+						const Ray* tileRays = &rays[tileOffsets[tile]];
+						size_t count = tileOffsets[tile + 1] - tileOffsets[tile];
+
+						CPURT::Bin_Ray_Streams(info, tileRays, count, order, tileStreams);
+						for (const auto &stream : tileStreams)
+							CPURT::Trace_Ray_Stream(*context, bvh8, tileRays, &order[stream.first], stream.second - stream.first, anyHit, &distances[tileOffsets[tile]], localStats, (SIMDLevel)l);
+					}
+
+					delete context;
+
+					std::lock_guard<std::mutex> lock(statsMutex);
+					stats.Add(localStats);
+				});
+
+				// Any hit may legitimately find a different hit, but never a different occlusion
+				size_t mismatches = 0;
+				for (size_t i = 0; i < rays.size(); i++) {
+					bool mismatch = anyHit ? ((distances[i] < rays[i].tMax) != (referenceDistances[i] < rays[i].tMax)) : (fabsf(distances[i] - referenceDistances[i]) > 1e-4f);
+					if (mismatch) mismatches++;
+				}
+
+				double runs = double(repetitions);
+				output << binningNames[b] << "," << query << "," << CPURT::Get_SIMD_Level_Name((SIMDLevel)l) << "," << scheduler.GetThreadsCount() << ","
+					<< rays.size() << "," << (stats.streamsCount / runs) << "," << (double(stats.raysCount) / stats.streamsCount) << ","
+					<< (double(stats.nodeVisits) / stats.streamsCount) << "," << (double(stats.activeRays) / stats.nodeVisits) << ","
+					<< streams << "," << (streams / single) << "," << mismatches << "\n";
+			}
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// AO Pass
+//--------------------------------------------------------------------------------------
+
+/**
+* Headless CPU AO pass over a sequence of frames of the orbiting camera, with the same sampling configuration and
+* history ping-pong as the renderer. Reports time, throughput and mean AO of the current and history slots per frame.
+*/
+int Run_AO_Pass(const ConfigInfo &config)
+{
+	const int framesCount = 8;
+
+	Model model;
+	Material material;
+	loadBenchmarkModel(config, model, &material);
+
+	TextureInfo albedo;
+	MaterialCB materialCB;
+	loadBenchmarkTexture(material, albedo, materialCB);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	SampleSetInfo sampleSetInfo;
+	vector<XMFLOAT3> samples;
+	SampleSets::Build_Table(sampleSetInfo, samples);
+
+	RtaoCB rtao;
+	rtao.aoRadius = config.aoRadius;
+	rtao.samplesCount = sampleSetInfo.samplesCount;
+	rtao.interleaveWidth = sampleSetInfo.interleaveWidth;
+	rtao.interleaveHeight = sampleSetInfo.interleaveHeight;
+
+	// First frame reprojects onto itself and finds no history (sky everywhere)
+	XMMATRIX viewProjection = XMMatrixIdentity();
+	benchmarkView(config, 0, viewProjection);
+
+	Image primaryOutput;
+	Image normalAndDepths[2];
+	Image ao[2];
+	normalAndDepths[1].Resize(config.width, config.height, XMFLOAT4(-1.0f, -1.0f, -1.0f, -1.0f));
+	ao[1].Resize(config.width, config.height, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "frame,threads,pixels,rays,reprojected,timeMs,mraysPerSecond,meanAO,meanHistoryAO\n";
+
+	for (int frame = 0; frame < framesCount; frame++) {
+		Image &currentNormalAndDepths = normalAndDepths[frame % 2];
+		Image &currentAO = ao[frame % 2];
+
+		ViewCB view = benchmarkView(config, frame, viewProjection);
+		CPURT::Render_Primary(scheduler, bvh8, model, albedo, materialCB, view, primaryOutput, currentNormalAndDepths);
+
+		rtao.frameNumber = frame % sampleSetInfo.framesCount;
+
+		AOPassStats stats;
+		CPURT::Render_AO(scheduler, bvh8, view, rtao, samples, currentNormalAndDepths, normalAndDepths[(frame + 1) % 2], ao[(frame + 1) % 2], currentAO, &stats);
+
+		double meanAO = 0.0, meanHistoryAO = 0.0;
+		for (const XMFLOAT4 &texel : currentAO.texels) {
+			meanAO += texel.x;
+			meanHistoryAO += (texel.x + texel.y + texel.z + texel.w) * 0.25;
+		}
+
+		output << frame << "," << scheduler.GetThreadsCount() << "," << stats.pixelsCount << "," << stats.raysCount << "," << stats.reprojectedCount << ","
+			<< stats.time << "," << (stats.raysCount / (stats.time * 1000.0)) << "," << (meanAO / currentAO.texels.size()) << ","
+			<< (meanHistoryAO / currentAO.texels.size()) << "\n";
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Primary Pass
+//--------------------------------------------------------------------------------------
+
+/**
+* Headless CPU primary visibility pass (RayGen, ClosestHit and Miss) over a sequence of frames of the orbiting camera.
+*/
+int Run_Primary_Pass(const ConfigInfo &config)
+{
+	const int framesCount = 8;
+
+	Model model;
+	Material material;
+	loadBenchmarkModel(config, model, &material);
+
+	TextureInfo albedo;
+	MaterialCB materialCB;
+	loadBenchmarkTexture(material, albedo, materialCB);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	XMMATRIX viewProjection = XMMatrixIdentity();
+	Image output, normalAndDepths;
+
+	ofstream outputFile = openBenchmarkOutput(config);
+
+	outputFile << "frame,threads,rays,hits,timeMs,mraysPerSecond,meanDepth\n";
+
+	for (int frame = 0; frame < framesCount; frame++) {
+		ViewCB view = benchmarkView(config, frame, viewProjection);
+
+		PrimaryPassStats stats;
+		CPURT::Render_Primary(scheduler, bvh8, model, albedo, materialCB, view, output, normalAndDepths, &stats);
+
+		double depth = 0.0;
+		for (const XMFLOAT4 &texel : normalAndDepths.texels) {
+			if (texel.w >= 0.0f) depth += texel.w;
+		}
+
+		outputFile << frame << "," << scheduler.GetThreadsCount() << "," << stats.raysCount << "," << stats.hitsCount << "," << stats.time << ","
+			<< (stats.raysCount / (stats.time * 1000.0)) << "," << (stats.hitsCount ? depth / stats.hitsCount : 0.0) << "\n";
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Rasterizer
+//--------------------------------------------------------------------------------------
+
+/**
+* Normal and depth buffer of the first frame from the software rasterizer (with every supported block kernel) and from
+* the CPU primary ray pass, on a single thread and on all of them. Rasterized buffers are compared against the ray cast one.
+*/
+int Run_Rasterizer(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+
+	Model model;
+	Material material;
+	loadBenchmarkModel(config, model, &material);
+
+	TextureInfo albedo;
+	MaterialCB materialCB;
+	loadBenchmarkTexture(material, albedo, materialCB);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	XMMATRIX viewProjection = XMMatrixIdentity();
+	ViewCB view = benchmarkView(config, 0, viewProjection);
+
+	Image primaryOutput, reference, normalAndDepths;
+	CPURT::Render_Primary(scheduler, bvh8, model, albedo, materialCB, view, primaryOutput, reference);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "method,kernel,threads,pixels,timeMs,mpixelsPerSecond,triangles,tileReferences,blocks,coveredBlocks,coverageMismatches,depthMismatches,meanDepthError\n";
+
+	vector<int> threadCounts = { 1 };
+	if (scheduler.GetThreadsCount() > 1) threadCounts.push_back(scheduler.GetThreadsCount());
+
+	scheduler.Destroy();
+
+	size_t pixelsCount = size_t(config.width) * config.height;
+	SIMDLevel supportedLevel = CPURT::Get_Supported_SIMD_Level();
+	RasterizerContext context;
+
+	for (int threads : threadCounts) {
+		scheduler.Init(threads);
+
+		double best = DBL_MAX;
+		for (int r = 0; r < repetitions; r++) {
+			PrimaryPassStats stats;
+			CPURT::Render_Primary(scheduler, bvh8, model, albedo, materialCB, view, primaryOutput, normalAndDepths, &stats);
+			best = min(best, stats.time);
+		}
+
+		output << "raycast,bvh8," << threads << "," << pixelsCount << "," << best << "," << (pixelsCount / (best * 1000.0)) << ",,,,,0,0,0\n";
+
+		for (int level = SIMD_SCALAR; level <= min((int)supportedLevel, (int)SIMD_AVX2); level++) {
+			RasterizerStats stats, bestStats;
+			bestStats.time = DBL_MAX;
+
+			for (int r = 0; r < repetitions; r++) {
+				CPURT::Rasterize_Normal_And_Depths(scheduler, model, view, context, normalAndDepths, &stats, (SIMDLevel)level);
+				if (stats.time < bestStats.time) bestStats = stats;
+			}
+
+			// Hit/miss disagreements and pixels whose T differs by more than 0.1% (different triangles at silhouettes)
+			size_t coverageMismatches = 0, depthMismatches = 0;
+			double depthError = 0.0;
+			for (size_t i = 0; i < pixelsCount; i++) {
+				float rasterDepth = normalAndDepths.texels[i].w;
+				float referenceDepth = reference.texels[i].w;
+				if ((rasterDepth < 0.0f) != (referenceDepth < 0.0f)) {
+					coverageMismatches++;
+				} else if (referenceDepth > 0.0f) {
+					double error = fabsf(rasterDepth - referenceDepth) / referenceDepth;
+					if (error > 1e-3) depthMismatches++;
+					depthError += error;
+				}
+			}
+
+			output << "raster," << CPURT::Get_SIMD_Level_Name((SIMDLevel)level) << "," << threads << "," << pixelsCount << "," << bestStats.time << ","
+				<< (pixelsCount / (bestStats.time * 1000.0)) << "," << bestStats.trianglesCount << "," << bestStats.tileReferences << ","
+				<< bestStats.blocksCount << "," << bestStats.coveredBlocksCount << "," << coverageMismatches << "," << depthMismatches << ","
+				<< (depthError / pixelsCount) << "\n";
+		}
+
+		scheduler.Destroy();
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Scheduler Scaling
+//--------------------------------------------------------------------------------------
+
+/**
+* Full CPU frame (primary pass, AO pass and low-pass filter) over thread counts doubling from 1 up to -threads (all hardware
+* threads by default). Every thread reports its busy time, tasks and steals, speed-up is relative to the single thread run.
+*/
+int Run_Scheduler_Scaling(const ConfigInfo &config)
+{
+	const int framesCount = 4;
+
+	Model model;
+	Material material;
+	loadBenchmarkModel(config, model, &material);
+
+	TextureInfo albedo;
+	MaterialCB materialCB;
+	loadBenchmarkTexture(material, albedo, materialCB);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	int maxThreads = scheduler.GetThreadsCount();
+	scheduler.Destroy();
+
+	vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	SampleSetInfo sampleSetInfo;
+	vector<XMFLOAT3> samples;
+	SampleSets::Build_Table(sampleSetInfo, samples);
+
+	RtaoCB rtao;
+	rtao.aoRadius = config.aoRadius;
+	rtao.samplesCount = sampleSetInfo.samplesCount;
+	rtao.interleaveWidth = sampleSetInfo.interleaveWidth;
+	rtao.interleaveHeight = sampleSetInfo.interleaveHeight;
+
+	LowPassFilerCB filter;
+	filter.outputMode = 1;
+	filter.texelSize = XMFLOAT2(1.0f / config.width, 1.0f / config.height);
+	filter.filterRadiusX = max(2, sampleSetInfo.interleaveWidth / 2);
+	filter.filterRadiusY = max(2, sampleSetInfo.interleaveHeight / 2);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "threads,thread,frameMs,primaryMs,aoMs,filterMs,speedup,efficiency,busyMs,utilization,tasks,steals\n";
+
+	double singleThreadTime = 0.0;
+
+	for (int threads : threadCounts) {
+		scheduler.Init(threads);
+
+		// Same frames for every thread count, history starts empty
+		XMMATRIX viewProjection = XMMatrixIdentity();
+		benchmarkView(config, 0, viewProjection);
+
+		Image primaryOutput, temp, filtered;
+		Image normalAndDepths[2];
+		Image ao[2];
+		normalAndDepths[1].Resize(config.width, config.height, XMFLOAT4(-1.0f, -1.0f, -1.0f, -1.0f));
+		ao[1].Resize(config.width, config.height, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+
+		double primaryTime = 0.0, aoTime = 0.0, filterTime = 0.0;
+		scheduler.ResetStats();
+
+		for (int frame = 0; frame < framesCount; frame++) {
+			ViewCB view = benchmarkView(config, frame, viewProjection);
+			rtao.frameNumber = frame % sampleSetInfo.framesCount;
+			filter.normalMatrix = view.view;
+
+			PrimaryPassStats primaryStats;
+			CPURT::Render_Primary(scheduler, bvh8, model, albedo, materialCB, view, primaryOutput, normalAndDepths[frame % 2], &primaryStats);
+
+			AOPassStats aoStats;
+			CPURT::Render_AO(scheduler, bvh8, view, rtao, samples, normalAndDepths[frame % 2], normalAndDepths[(frame + 1) % 2], ao[(frame + 1) % 2],
+				ao[frame % 2], &aoStats);
+
+			FilterPassStats filterStats;
+			CPURT::Render_Low_Pass_Filter(scheduler, filter, normalAndDepths[frame % 2], ao[frame % 2], primaryOutput, temp, filtered, &filterStats);
+
+			primaryTime += primaryStats.time;
+			aoTime += aoStats.time;
+			filterTime += filterStats.time;
+		}
+
+		vector<TaskThreadStats> threadStats;
+		scheduler.GetStats(threadStats);
+		scheduler.Destroy();
+
+		primaryTime /= framesCount;
+		aoTime /= framesCount;
+		filterTime /= framesCount;
+
+		double frameTime = primaryTime + aoTime + filterTime;
+		if (threads == 1) singleThreadTime = frameTime;
+		double speedup = singleThreadTime / frameTime;
+
+		for (size_t i = 0; i < threadStats.size(); i++) {
+			output << threads << "," << i << "," << frameTime << "," << primaryTime << "," << aoTime << "," << filterTime << "," << speedup << ","
+				<< (speedup / threads) << "," << threadStats[i].busyTime << "," << threadStats[i].utilization << "," << threadStats[i].tasksCount << ","
+				<< threadStats[i].stealsCount << "\n";
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// BVH Refit
+//--------------------------------------------------------------------------------------
+
+/**
+* Deform the rest pose: twist around the vertical axis by amount radians per unit of distance from it, plus a travelling wave.
+*/
+static void deformModel(const Model &rest, float amount, float phase, Model &deformed)
+{
+	for (size_t i = 0; i < rest.vertices.size(); i++) {
+		const XMFLOAT3 &p = rest.vertices[i].position;
+		float radius = sqrtf(p.x * p.x + p.z * p.z);
+		float angle = amount * radius;
+		float c = cosf(angle), s = sinf(angle);
+
+		XMFLOAT3 &q = deformed.vertices[i].position;
+		q.x = p.x * c - p.z * s;
+		q.z = p.x * s + p.z * c;
+		q.y = p.y + 0.5f * sinf(0.5f * radius - phase);
+	}
+}
+
+/**
+* Animated model (growing twist), BVH kept up to date by Update_BVH (refit, rebuild once SAH degrades past the threshold) and
+* Refit_BVH8, compared with a full rebuild every frame: update times, SAH cost of both trees and primary ray throughput.
+*/
+int Run_BVH_Refit(const ConfigInfo &config)
+{
+	const int framesCount = 16;
+
+	Model rest;
+	loadBenchmarkModel(config, rest);
+	Model model = rest;
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh, rebuilt;
+	BVH8 bvh8, rebuilt8;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	XMMATRIX viewProjection = XMMatrixIdentity();
+	ViewCB view = benchmarkView(config, 0, viewProjection);
+
+	vector<Ray> rays;
+	for (int y = 0; y < config.height; y++) {
+		for (int x = 0; x < config.width; x++) rays.push_back(CPURT::Get_Primary_Ray(view, x, y));
+	}
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "frame,threads,twist,refitMs,refit8Ms,rebuildMs,collapseMs,rebuilt,sahUpdated,sahRebuilt,sahRatio,mraysUpdated,mraysRebuilt,mismatches\n";
+
+	for (int frame = 1; frame <= framesCount; frame++) {
+		float twist = 0.003f * frame;
+		deformModel(rest, twist, 0.4f * frame, model);
+
+		// Maintained tree, the wide one is refitted unless the binary one had to be rebuilt
+		bool wasRebuilt = CPURT::Update_BVH(scheduler, model, info, bvh);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		if (wasRebuilt) {
+			CPURT::Build_BVH8(bvh, bvh8);
+		} else {
+			CPURT::Refit_BVH8(scheduler, model, bvh8);
+		}
+		double refit8Time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// Reference rebuilt from scratch
+		CPURT::Build_BVH(scheduler, model, info, rebuilt);
+
+		start = std::chrono::high_resolution_clock::now();
+		CPURT::Build_BVH8(rebuilt, rebuilt8);
+		double collapseTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		size_t hitsCount;
+		double mraysUpdated = traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, ray, hit); }, hitsCount);
+		double mraysRebuilt = traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(rebuilt8, ray, hit); }, hitsCount);
+
+		// Both trees hold the same triangles, closest hits must agree
+		std::atomic<size_t> mismatches(0);
+		scheduler.ParallelFor(rays.size(), 1024, [&](size_t begin, size_t end) {
+			size_t localMismatches = 0;
+			for (size_t i = begin; i < end; i++) {
+				Hit a, b;
+				bool hitA = CPURT::Intersect(bvh8, rays[i], a);
+				bool hitB = CPURT::Intersect(rebuilt8, rays[i], b);
+				if (hitA != hitB || (hitA && a.t != b.t)) localMismatches++;
+			}
+			mismatches += localMismatches;
+		});
+
+		output << frame << "," << scheduler.GetThreadsCount() << "," << twist << "," << bvh.stats.refitTime << "," << refit8Time << ","
+			<< rebuilt.stats.buildTime << "," << collapseTime << "," << (wasRebuilt ? 1 : 0) << "," << bvh.stats.sahCost << "," << rebuilt.stats.sahCost << ","
+			<< (bvh.stats.sahCost / rebuilt.stats.sahCost) << "," << mraysUpdated << "," << mraysRebuilt << "," << mismatches << "\n";
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Instancing
+//--------------------------------------------------------------------------------------
+
+/**
+* Bumpy sphere of unit radius (about 1K triangles), variant selects the bumps. Vertices repeated along the seam and at the poles
+* have the same positions bit for bit, so the mesh is closed.
+*/
+static void generateRock(int variant, Model &model)
+{
+	const int rings = 16;
+	const int segments = 32;
+
+	model.vertices.clear();
+	model.indices.clear();
+
+	for (int ring = 0; ring <= rings; ring++) {
+		float theta = XM_PI * ring / rings;
+		bool pole = ring == 0 || ring == rings;
+		float sinTheta = pole ? 0.0f : sinf(theta);
+
+		for (int segment = 0; segment <= segments; segment++) {
+			float phi = 2.0f * XM_PI * (segment % segments) / segments;
+			float bumpPhi = pole ? 0.0f : phi;
+			float radius = 1.0f + 0.15f * sinf(3.0f * theta + variant) * cosf((2.0f + variant) * bumpPhi) + 0.05f * sinf(7.0f * bumpPhi + 5.0f * theta);
+
+			Vertex vertex;
+			vertex.position = XMFLOAT3(radius * sinTheta * cosf(phi), radius * cosf(theta), radius * sinTheta * sinf(phi));
+			vertex.uv = XMFLOAT2(float(segment) / segments, float(ring) / rings);
+			model.vertices.push_back(vertex);
+		}
+	}
+
+	for (int ring = 0; ring < rings; ring++) {
+		for (int segment = 0; segment < segments; segment++) {
+			uint32_t a = ring * (segments + 1) + segment;
+			uint32_t b = a + segments + 1;
+
+			if (ring > 0) { model.indices.push_back(a); model.indices.push_back(a + 1); model.indices.push_back(b); }
+			if (ring < rings - 1) { model.indices.push_back(a + 1); model.indices.push_back(b + 1); model.indices.push_back(b); }
+		}
+	}
+}
+
+/**
+* Rocks scattered over a grid covering the terrain area, random yaw and scale. Every other instance has mask 2 instead of 1.
+*/
+static void generateInstances(int instancesCount, int meshesCount, vector<Instance> &instances)
+{
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+	int side = max(1, (int)ceil(sqrt(double(instancesCount))));
+	float cellSize = 60.0f / side;
+
+	instances.resize(instancesCount);
+
+	for (int i = 0; i < instancesCount; i++) {
+		float yaw = 2.0f * XM_PI * uniform(generator);
+		float scale = cellSize * 0.45f * (0.6f + 0.4f * uniform(generator));
+		float c = cosf(yaw) * scale, s = sinf(yaw) * scale;
+
+		Instance &instance = instances[i];
+		instance.transform[0][0] = c;    instance.transform[0][1] = 0.0f;  instance.transform[0][2] = s;
+		instance.transform[1][0] = 0.0f; instance.transform[1][1] = scale; instance.transform[1][2] = 0.0f;
+		instance.transform[2][0] = -s;   instance.transform[2][1] = 0.0f;  instance.transform[2][2] = c;
+		instance.transform[0][3] = ((i % side) + 0.5f) * cellSize - 30.0f;
+		instance.transform[1][3] = scale * 0.5f;
+		instance.transform[2][3] = ((i / side) + 0.5f) * cellSize - 30.0f;
+		instance.instanceID = i;
+		instance.mask = (i % 2) ? 0x2 : 0x1;
+		instance.meshIndex = i % meshesCount;
+	}
+}
+
+static size_t meshMemorySize(const BVH8 &bvh)
+{
+	return bvh.nodes.size() * sizeof(BVH8Node) + bvh.triangles.size() * (sizeof(Triangle) + sizeof(uint32_t));
+}
+
+/**
+* Two-level structure over growing numbers of instances of a few rock meshes: build time, memory of the top level and of the unique
+* meshes against the memory a flattened scene would need, primary ray throughput with all instances and with half of them masked out.
+* Small scenes are also flattened into a single BVH to check that both find the same closest hits.
+*/
+int Run_Instancing(const ConfigInfo &config)
+{
+	const int meshesCount = 4;
+	const int instanceCounts[] = { 1000, 10000, 100000, 1000000 };
+	const int maxFlattenedInstances = 1000;
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	vector<Model> models(meshesCount);
+	vector<BVH8> meshes(meshesCount);
+	vector<const BVH8*> meshPointers;
+	size_t uniqueTriangles = 0, uniqueBytes = 0;
+
+	for (int i = 0; i < meshesCount; i++) {
+		generateRock(i, models[i]);
+
+		BVH bvh;
+		CPURT::Build_BVH(scheduler, models[i], info, bvh);
+		CPURT::Build_BVH8(bvh, meshes[i]);
+
+		meshPointers.push_back(&meshes[i]);
+		uniqueTriangles += meshes[i].triangles.size();
+		uniqueBytes += meshMemorySize(meshes[i]);
+	}
+
+	XMMATRIX viewProjection = XMMatrixIdentity();
+	ViewCB view = benchmarkView(config, 0, viewProjection);
+
+	vector<Ray> rays;
+	for (int y = 0; y < config.height; y++) {
+		for (int x = 0; x < config.width; x++) rays.push_back(CPURT::Get_Primary_Ray(view, x, y));
+	}
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "instances,threads,uniqueTriangles,instancedTriangles,buildMs,topLevelBytes,uniqueBytes,flattenedBytes,mraysAll,hitsAll,mraysMasked,hitsMasked,flattenedMrays,mismatches\n";
+
+	for (int instancesCount : instanceCounts) {
+		vector<Instance> instances;
+		generateInstances(instancesCount, meshesCount, instances);
+
+		TopLevelBVH tlas;
+		CPURT::Build_Top_Level_BVH(scheduler, meshPointers, instances, tlas);
+
+		size_t instancedTriangles = 0, flattenedBytes = 0;
+		for (const Instance &instance : instances) {
+			instancedTriangles += meshes[instance.meshIndex].triangles.size();
+			flattenedBytes += meshMemorySize(meshes[instance.meshIndex]);
+		}
+
+		size_t hitsAll, hitsMasked;
+		double mraysAll = traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(tlas, ray, 0xFF, hit); }, hitsAll);
+		double mraysMasked = traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(tlas, ray, 0x1, hit); }, hitsMasked);
+
+		output << instancesCount << "," << scheduler.GetThreadsCount() << "," << uniqueTriangles << "," << instancedTriangles << "," << tlas.stats.buildTime << ","
+			<< tlas.GetMemorySize() << "," << uniqueBytes << "," << flattenedBytes << "," << mraysAll << "," << hitsAll << "," << mraysMasked << "," << hitsMasked << ",";
+
+		if (instancesCount > maxFlattenedInstances) {
+			output << ",\n";
+			continue;
+		}
+
+		// Flattened reference, instance transforms baked into the vertices
+		Model flattened;
+		for (const Instance &instance : instances) {
+			const Model &mesh = models[instance.meshIndex];
+			uint32_t baseVertex = (uint32_t)flattened.vertices.size();
+
+			for (const Vertex &vertex : mesh.vertices) {
+				const XMFLOAT3 &p = vertex.position;
+				const float (&m)[3][4] = instance.transform;
+				Vertex transformed;
+				transformed.uv = vertex.uv;
+				transformed.position = XMFLOAT3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+					m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+					m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+				flattened.vertices.push_back(transformed);
+			}
+
+			for (uint32_t index : mesh.indices) flattened.indices.push_back(baseVertex + index);
+		}
+
+		BVH flattenedBVH;
+		BVH8 flattenedBVH8;
+		CPURT::Build_BVH(scheduler, flattened, info, flattenedBVH);
+		CPURT::Build_BVH8(flattenedBVH, flattenedBVH8);
+
+		size_t flattenedHits;
+		double flattenedMrays = traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(flattenedBVH8, ray, hit); }, flattenedHits);
+
+		// Object space intersection rounds differently, T must agree to 0.1%. The rocks are closed, so a ray grazing an edge hits a
+		// triangle on one side of it in both spaces instead of slipping through a crack in one of them
+		std::atomic<size_t> mismatches(0);
+		scheduler.ParallelFor(rays.size(), 1024, [&](size_t begin, size_t end) {
+			size_t localMismatches = 0;
+			for (size_t i = begin; i < end; i++) {
+				Hit a, b;
+				bool hitA = CPURT::Intersect(tlas, rays[i], 0xFF, a);
+				bool hitB = CPURT::Intersect(flattenedBVH8, rays[i], b);
+				if (hitA != hitB || (hitA && fabsf(a.t - b.t) > 1e-3f * b.t)) localMismatches++;
+			}
+			mismatches += localMismatches;
+		});
+
+		output << flattenedMrays << "," << mismatches << "\n";
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Spatial Splits
+//--------------------------------------------------------------------------------------
+
+/**
+* Long thin diagonal planks scattered over the terrain area (two triangles each), their bounds overlap heavily and are mostly empty.
+*/
+static void generateSlivers(int trianglesCount, Model &model)
+{
+	std::mt19937 generator(11);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+	model.vertices.clear();
+	model.indices.clear();
+
+	for (int plank = 0; plank < max(1, trianglesCount / 2); plank++) {
+		float yaw = 2.0f * XM_PI * uniform(generator);
+		float pitch = 0.4f * (uniform(generator) - 0.5f);
+		float length = 2.0f + 4.0f * uniform(generator);
+		float width = 0.02f + 0.06f * uniform(generator);
+
+		XMFLOAT3 center = XMFLOAT3(60.0f * uniform(generator) - 30.0f, 4.0f * uniform(generator), 60.0f * uniform(generator) - 30.0f);
+		XMFLOAT3 axis = XMFLOAT3(cosf(yaw) * cosf(pitch), sinf(pitch), sinf(yaw) * cosf(pitch));
+		XMFLOAT3 side = Normalize(Cross(axis, XMFLOAT3(0.0f, 1.0f, 0.0f)));
+
+		XMFLOAT3 a = Sub(center, Mul(axis, 0.5f * length));
+		XMFLOAT3 b = Add(center, Mul(axis, 0.5f * length));
+		XMFLOAT3 corners[4] = { a, Add(a, Mul(side, width)), b, Add(b, Mul(side, width)) };
+
+		uint32_t baseVertex = (uint32_t)model.vertices.size();
+		for (int i = 0; i < 4; i++) {
+			Vertex vertex;
+			vertex.position = corners[i];
+			vertex.uv = XMFLOAT2(float(i & 1), float(i >> 1));
+			model.vertices.push_back(vertex);
+		}
+
+		const uint32_t indices[6] = { 0, 2, 1, 1, 2, 3 };
+		for (uint32_t index : indices) model.indices.push_back(baseVertex + index);
+	}
+}
+
+/**
+* Binned SAH against spatial splits (SBVH) on the model and on a mesh of long slivers of the same size: build time, references
+* (duplicates included), nodes, memory of the 8-wide tree, SAH cost, closest-hit and occlusion throughput of AO rays and closest hits
+* that differ from the binned tree.
+*/
+int Run_Spatial_Splits(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "mesh,builder,threads,triangles,references,nodes,bvh8Nodes,bytes,buildMs,sahCost,rays,mraysClosest,mraysOcclusion,hits,mismatches\n";
+
+	for (int mesh = 0; mesh < 2; mesh++) {
+		Model model;
+		if (mesh == 0) loadBenchmarkModel(config, model);
+		else generateSlivers(config.benchmarkTriangles, model);
+
+		BVHBuildInfo binnedInfo;
+		BVH binned;
+		CPURT::Build_BVH(scheduler, model, binnedInfo, binned);
+
+		BVH8 binned8;
+		CPURT::Build_BVH8(binned, binned8);
+
+		vector<Ray> rays;
+		generateAORays(scheduler, config, model, binned, rays);
+
+		for (int builder = 0; builder < 2; builder++) {
+			BVHBuildInfo info;
+			info.spatialSplits = (builder == 1);
+
+			BVH bvh;
+			CPURT::Build_BVH(scheduler, model, info, bvh);
+
+			BVH8 bvh8;
+			CPURT::Build_BVH8(bvh, bvh8);
+
+			double mraysClosest = 0.0, mraysOcclusion = 0.0;
+			size_t hitsCount = 0, occludedCount = 0;
+			for (int r = 0; r < repetitions; r++) {
+				mraysClosest = max(mraysClosest, traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, ray, hit); }, hitsCount));
+				mraysOcclusion = max(mraysOcclusion, traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Occluded(bvh8, ray, hit); }, occludedCount));
+			}
+
+			std::atomic<size_t> mismatches(0);
+			scheduler.ParallelFor(rays.size(), 1024, [&](size_t begin, size_t end) {
+				size_t localMismatches = 0;
+				for (size_t i = begin; i < end; i++) {
+					Hit a, b;
+					bool hitA = CPURT::Intersect(bvh8, rays[i], a);
+					bool hitB = CPURT::Intersect(binned8, rays[i], b);
+					if (hitA != hitB || (hitA && a.t != b.t)) localMismatches++;
+				}
+				mismatches += localMismatches;
+			});
+
+			output << (mesh == 0 ? "model" : "slivers") << "," << (builder == 0 ? "binned" : "sbvh") << "," << scheduler.GetThreadsCount() << ","
+				<< model.indices.size() / 3 << "," << bvh.stats.referencesCount << "," << bvh.stats.nodesCount << "," << bvh8.nodes.size() << ","
+				<< meshMemorySize(bvh8) << "," << bvh.stats.buildTime << "," << bvh.stats.sahCost << "," << rays.size() << ","
+				<< mraysClosest << "," << mraysOcclusion << "," << hitsCount << "," << mismatches << "\n";
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// BVH Cache
+//--------------------------------------------------------------------------------------
+
+/**
+* Rebuild against reload of the cached 8-wide BVH of the model (binned and spatial split builds): build and save time on a miss,
+* geometry hash and load time on a hit, whether the loaded tree is identical to the built one and whether a cache of slightly
+* different geometry is rejected. The cache file is written next to the output and removed afterwards.
+*/
+int Run_BVH_Cache(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	string cachePath = config.benchmarkOutput + ".bvh";
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "builder,threads,triangles,fileBytes,buildMs,saveMs,hashMs,loadMs,speedup,identical,staleRejected\n";
+
+	for (int builder = 0; builder < 2; builder++) {
+		BVHBuildInfo info;
+		info.spatialSplits = (builder == 1);
+
+		std::remove(cachePath.c_str());
+
+		BVH8 built;
+		BVHCacheStats missStats;
+		CPURT::Build_BVH8_Cached(scheduler, cachePath, model, info, built, &missStats);
+
+		// Best of several loads, the file is in the OS cache after the first one
+		BVH8 loaded;
+		BVHCacheStats hitStats;
+		double hashTime = DBL_MAX, loadTime = DBL_MAX;
+		for (int r = 0; r < repetitions; r++) {
+			CPURT::Build_BVH8_Cached(scheduler, cachePath, model, info, loaded, &hitStats);
+			hashTime = min(hashTime, hitStats.hashTime);
+			loadTime = min(loadTime, hitStats.loadTime);
+		}
+
+		bool identical = hitStats.loaded && !missStats.loaded &&
+			loaded.nodes.size() == built.nodes.size() && loaded.triangles.size() == built.triangles.size() &&
+			memcmp(loaded.nodes.data(), built.nodes.data(), built.nodes.size() * sizeof(BVH8Node)) == 0 &&
+			memcmp(loaded.triangles.data(), built.triangles.data(), built.triangles.size() * sizeof(Triangle)) == 0 &&
+			loaded.primitiveIndices == built.primitiveIndices;
+
+		// Moving one vertex must invalidate the cache
+		Model moved = model;
+		moved.vertices[0].position.y += 1e-3f;
+		BVH8 stale;
+		bool staleRejected = !CPURT::Load_BVH_Cache(cachePath, CPURT::Get_Geometry_Hash(moved), info, stale);
+
+		output << (builder == 0 ? "binned" : "sbvh") << "," << scheduler.GetThreadsCount() << "," << model.indices.size() / 3 << ","
+			<< hitStats.fileSize << "," << missStats.buildTime << "," << missStats.saveTime << "," << hashTime << "," << loadTime << ","
+			<< missStats.buildTime / (hashTime + loadTime) << "," << identical << "," << staleRejected << "\n";
+	}
+
+	std::remove(cachePath.c_str());
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Quantized Nodes
+//--------------------------------------------------------------------------------------
+
+/**
+* Full precision 8-wide nodes against 8-bit quantized ones on the model and on the sliver mesh: memory of nodes and of the whole
+* structure, closest-hit and occlusion throughput of AO rays per kernel, and closest hits that differ from the full precision tree.
+*/
+int Run_Quantized_BVH8(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "mesh,structure,kernel,threads,nodes,nodeBytes,totalBytes,rays,mraysClosest,mraysOcclusion,hits,mismatches\n";
+
+	SIMDLevel supportedLevel = CPURT::Get_Supported_SIMD_Level();
+
+	for (int mesh = 0; mesh < 2; mesh++) {
+		Model model;
+		if (mesh == 0) loadBenchmarkModel(config, model);
+		else generateSlivers(config.benchmarkTriangles, model);
+
+		BVHBuildInfo info;
+		BVH bvh;
+		CPURT::Build_BVH(scheduler, model, info, bvh);
+
+		BVH8 bvh8;
+		CPURT::Build_BVH8(bvh, bvh8);
+
+		QuantizedBVH8 quantized;
+		CPURT::Build_Quantized_BVH8(bvh8, quantized);
+
+		vector<Ray> rays;
+		generateAORays(scheduler, config, model, bvh, rays);
+
+		auto measure = [&](const char* structure, SIMDLevel level, size_t nodesCount, size_t nodeBytes, size_t totalBytes,
+			const function<bool(const Ray&, Hit&)> &intersect, const function<bool(const Ray&, Hit&)> &occluded) {
+			double mraysClosest = 0.0, mraysOcclusion = 0.0;
+			size_t hitsCount = 0, occludedCount = 0;
+			for (int r = 0; r < repetitions; r++) {
+				mraysClosest = max(mraysClosest, traceRays(scheduler, rays, intersect, hitsCount));
+				mraysOcclusion = max(mraysOcclusion, traceRays(scheduler, rays, occluded, occludedCount));
+			}
+
+			std::atomic<size_t> mismatches(0);
+			scheduler.ParallelFor(rays.size(), 1024, [&](size_t begin, size_t end) {
+				size_t localMismatches = 0;
+				for (size_t i = begin; i < end; i++) {
+					Hit a, b;
+					bool hitA = intersect(rays[i], a);
+					bool hitB = CPURT::Intersect(bvh8, rays[i], b, level);
+					if (hitA != hitB || (hitA && (a.t != b.t || a.primitiveIndex != b.primitiveIndex))) localMismatches++;
+				}
+				mismatches += localMismatches;
+			});
+
+			output << (mesh == 0 ? "model" : "slivers") << "," << structure << "," << CPURT::Get_SIMD_Level_Name(level) << ","
+				<< scheduler.GetThreadsCount() << "," << nodesCount << "," << nodeBytes << "," << totalBytes << "," << rays.size() << ","
+				<< mraysClosest << "," << mraysOcclusion << "," << hitsCount << "," << mismatches << "\n";
+		};
+
+		for (int level = SIMD_SCALAR; level <= supportedLevel; level++) {
+			measure("bvh8", (SIMDLevel)level, bvh8.nodes.size(), bvh8.nodes.size() * sizeof(BVH8Node), meshMemorySize(bvh8),
+				[&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, ray, hit, (SIMDLevel)level); },
+				[&](const Ray &ray, Hit &hit) { return CPURT::Occluded(bvh8, ray, hit, (SIMDLevel)level); });
+		}
+
+		for (int level = SIMD_SCALAR; level <= min(supportedLevel, SIMD_AVX2); level++) {
+			measure("quantized", (SIMDLevel)level, quantized.nodes.size(), quantized.nodes.size() * sizeof(QuantizedBVH8Node), quantized.GetMemorySize(),
+				[&](const Ray &ray, Hit &hit) { return CPURT::Intersect(quantized, ray, hit, (SIMDLevel)level); },
+				[&](const Ray &ray, Hit &hit) { return CPURT::Occluded(quantized, ray, hit, (SIMDLevel)level); });
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Triangle Packets
+//--------------------------------------------------------------------------------------
+
+/**
+* Gently sloped heightfield grid of quads with jittered vertices far from the origin. It never folds over seen from within 45 degrees
+* of the vertical, so rays from there aimed at an interior point always hit.
+*/
+static void generateJitteredGrid(int quadsCount, float offset, Model &model)
+{
+	std::mt19937 generator(13);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+	model.vertices.clear();
+	model.indices.clear();
+
+	for (int z = 0; z <= quadsCount; z++) {
+		for (int x = 0; x <= quadsCount; x++) {
+			Vertex vertex;
+			vertex.position = XMFLOAT3(offset + x + 0.6f * (uniform(generator) - 0.5f), 0.25f * uniform(generator), offset + z + 0.6f * (uniform(generator) - 0.5f));
+			vertex.uv = XMFLOAT2(float(x) / quadsCount, float(z) / quadsCount);
+			model.vertices.push_back(vertex);
+		}
+	}
+
+	const uint32_t rowLength = uint32_t(quadsCount + 1);
+	for (uint32_t z = 0; z < (uint32_t)quadsCount; z++) {
+		for (uint32_t x = 0; x < (uint32_t)quadsCount; x++) {
+			uint32_t a = z * rowLength + x, b = a + 1, c = a + rowLength, d = c + 1;
+
+			// Alternate diagonals, so that vertices are shared by both 4 and 8 triangles
+			const uint32_t quad[2][6] = { { a, c, b, b, c, d }, { a, c, d, a, d, b } };
+			for (uint32_t index : quad[(x + z) & 1]) model.indices.push_back(index);
+		}
+	}
+}
+
+/**
+* Leaf storage and triangle tests for leaves of 4, 8 and 16 triangles (BVHBuildInfo::leafSize):
+* - leaf: triangle tests per second of single leaves, with rays aimed at a random triangle of a random leaf. Triangles are fetched
+*   through the index buffer (as GetVertexAttributes does), read from the BVH8 triangles or tested as precomputed SoA packets.
+* - closest / occlusion: AO ray throughput of the AVX2 traversal with each leaf storage.
+* - edges: rays aimed exactly at vertices and edges of a jittered grid, every miss is a ray that slipped between two triangles.
+*/
+int Run_Triangle_Packets(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+	const size_t leafQueriesCount = 1 << 19;
+	const int gridQuads = 256;
+	const float gridOffset = 1000.0f;
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	Model grid;
+	generateJitteredGrid(gridQuads, gridOffset, grid);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "section,layout,test,width,threads,bytesPerTriangle,queries,mqueriesPerSecond,hits,falseMisses\n";
+
+	SIMDLevel supportedLevel = CPURT::Get_Supported_SIMD_Level();
+	const TriangleTest tests[] = { TRIANGLE_TEST_MOLLER_TRUMBORE, TRIANGLE_TEST_WATERTIGHT };
+
+	// Rays from above aimed at interior grid vertices and points on grid edges (and on the diagonal, which is an edge of every other quad)
+	vector<Ray> edgeRays;
+	{
+		std::mt19937 generator(17);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		const int rowLength = gridQuads + 1;
+
+		for (int z = 1; z < gridQuads - 1; z++) {
+			for (int x = 1; x < gridQuads - 1; x++) {
+				const XMFLOAT3 &a = grid.vertices[z * rowLength + x].position;
+				const XMFLOAT3 neighbors[3] = { grid.vertices[z * rowLength + x + 1].position, grid.vertices[(z + 1) * rowLength + x].position,
+					grid.vertices[(z + 1) * rowLength + x + 1].position };
+
+				XMFLOAT3 targets[4] = { a };
+				for (int i = 0; i < 3; i++) {
+					float s = uniform(generator);
+					targets[i + 1] = Add(Mul(a, 1.0f - s), Mul(neighbors[i], s));
+				}
+
+				for (const XMFLOAT3 &target : targets) {
+					float phi = 2.0f * XM_PI * uniform(generator);
+					float cosTheta = 0.7f + 0.3f * uniform(generator);
+					float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+					XMFLOAT3 up = XMFLOAT3(cosf(phi) * sinTheta, cosTheta, sinf(phi) * sinTheta);
+					edgeRays.push_back(Ray(Add(target, Mul(up, 5.0f)), Mul(up, -1.0f), 0.0f, 10.0f));
+				}
+			}
+		}
+	}
+
+	for (int width : { 4, 8, 16 }) {
+		if (width == 16 && supportedLevel < SIMD_AVX512) continue;
+		if (supportedLevel < SIMD_AVX2) break;
+
+		BVHBuildInfo info;
+		info.leafSize = width;
+
+		BVH bvh;
+		CPURT::Build_BVH(scheduler, model, info, bvh);
+
+		BVH8 bvh8;
+		CPURT::Build_BVH8(bvh, bvh8);
+
+		TrianglePackets packets[TRIANGLE_TESTS_COUNT];
+		for (TriangleTest test : tests) CPURT::Build_Triangle_Packets(bvh8, width, test, packets[test]);
+
+		const double trianglesCount = double(bvh8.triangles.size());
+
+		// Leaves (first triangle and count) and the rays aimed at one of their triangles
+		vector<pair<uint32_t, uint32_t>> leaves;
+		for (const BVH8Node &node : bvh8.nodes) {
+			for (int i = 0; i < BVH8_WIDTH; i++) {
+				if (node.children[i] != BVH8_EMPTY_CHILD && (node.children[i] & BVH8_LEAF_FLAG) && node.counts[i] > 0)
+					leaves.push_back(std::make_pair(node.children[i] & ~BVH8_LEAF_FLAG, node.counts[i]));
+			}
+		}
+
+		vector<uint32_t> queryLeaves(leafQueriesCount);
+		vector<Ray> queryRays(leafQueriesCount);
+		size_t testsCount = 0;
+		{
+			std::mt19937 generator(19);
+			std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+			for (size_t i = 0; i < leafQueriesCount; i++) {
+				uint32_t leaf = uint32_t(generator() % leaves.size());
+				const Triangle &triangle = bvh8.triangles[leaves[leaf].first + generator() % leaves[leaf].second];
+
+				float u = uniform(generator), v = uniform(generator);
+				if (u + v > 1.0f) { u = 1.0f - u; v = 1.0f - v; }
+				XMFLOAT3 target = Add(triangle.v0, Add(Mul(Sub(triangle.v1, triangle.v0), u), Mul(Sub(triangle.v2, triangle.v0), v)));
+
+				float z = 2.0f * uniform(generator) - 1.0f;
+				float phi = 2.0f * XM_PI * uniform(generator);
+				float r = sqrtf(max(0.0f, 1.0f - z * z));
+				XMFLOAT3 direction = XMFLOAT3(r * cosf(phi), r * sinf(phi), z);
+
+				queryLeaves[i] = leaf;
+				queryRays[i] = Ray(Sub(target, direction), direction, 0.0f, 2.0f);
+				testsCount += leaves[leaf].second;
+			}
+		}
+
+		auto measureLeaves = [&](const char* layout, TriangleTest test, size_t bytes, const function<bool(uint32_t, uint32_t, const Ray&, float&, Hit&)> &intersectLeaf) {
+			std::atomic<size_t> hits(0);
+			double best = measureThroughput(scheduler, leafQueriesCount, 1024, testsCount, repetitions, [&](size_t begin, size_t end) {
+				size_t localHits = 0;
+				for (size_t i = begin; i < end; i++) {
+					const pair<uint32_t, uint32_t> &leaf = leaves[queryLeaves[i]];
+					float tMax = queryRays[i].tMax;
+					Hit hit;
+					if (intersectLeaf(leaf.first, leaf.second, queryRays[i], tMax, hit)) localHits++;
+				}
+				hits += localHits;
+			});
+
+			output << "leaf," << layout << "," << CPURT::Get_Triangle_Test_Name(test) << "," << width << "," << scheduler.GetThreadsCount() << ","
+				<< bytes / trianglesCount << "," << testsCount << "," << best << "," << hits / repetitions << ",\n";
+		};
+
+		measureLeaves("indexed", TRIANGLE_TEST_MOLLER_TRUMBORE, model.indices.size() * sizeof(uint32_t) + model.vertices.size() * sizeof(Vertex),
+			[&](uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit) {
+			bool found = false;
+			for (uint32_t i = first; i < first + count; i++) {
+				const uint32_t* indices = &model.indices[bvh8.primitiveIndices[i] * 3];
+				Triangle triangle;
+				triangle.v0 = model.vertices[indices[0]].position;
+				triangle.v1 = model.vertices[indices[1]].position;
+				triangle.v2 = model.vertices[indices[2]].position;
+
+				float t, u, v;
+				if (IntersectTriangle(triangle, ray.origin, ray.direction, ray.tMin, tMax, t, u, v)) {
+					tMax = t;
+					hit.t = t;
+					hit.primitiveIndex = bvh8.primitiveIndices[i];
+					hit.barycentrics = XMFLOAT2(u, v);
+					found = true;
+				}
+			}
+			return found;
+		});
+
+		const size_t triangleBytes = bvh8.triangles.size() * (sizeof(Triangle) + sizeof(uint32_t));
+
+		measureLeaves("aos", TRIANGLE_TEST_MOLLER_TRUMBORE, triangleBytes, [&](uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit) {
+			return IntersectLeaf(bvh8, first, count, ray, tMax, hit, false);
+		});
+
+		measureLeaves("aos", TRIANGLE_TEST_WATERTIGHT, triangleBytes, [&](uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit) {
+			WatertightRay sheared = GetWatertightRay(ray.direction);
+			bool found = false;
+			for (uint32_t i = first; i < first + count; i++) {
+				float t, u, v;
+				if (IntersectTriangleWatertight(bvh8.triangles[i], ray.origin, sheared, ray.tMin, tMax, t, u, v)) {
+					tMax = t;
+					hit.t = t;
+					hit.primitiveIndex = bvh8.primitiveIndices[i];
+					hit.barycentrics = XMFLOAT2(u, v);
+					found = true;
+				}
+			}
+			return found;
+		});
+
+		for (TriangleTest test : tests) {
+			const TrianglePackets &leafPackets = packets[test];
+			measureLeaves("packets", test, leafPackets.GetMemorySize(), [&](uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit) {
+				return CPURT::Intersect_Triangle_Packets(leafPackets, leafPackets.leafPackets[first], (count + width - 1) / width, ray, tMax, hit, false);
+			});
+		}
+
+		// Traversal of AO rays
+		vector<Ray> rays;
+		generateAORays(scheduler, config, model, bvh, rays);
+
+		auto measureRays = [&](const char* layout, TriangleTest test, size_t bytes, const function<bool(const Ray&, Hit&)> &intersect, const function<bool(const Ray&, Hit&)> &occluded) {
+			double mraysClosest = 0.0, mraysOcclusion = 0.0;
+			size_t hitsCount = 0, occludedCount = 0;
+			for (int r = 0; r < repetitions; r++) {
+				mraysClosest = max(mraysClosest, traceRays(scheduler, rays, intersect, hitsCount));
+				mraysOcclusion = max(mraysOcclusion, traceRays(scheduler, rays, occluded, occludedCount));
+			}
+
+			output << "closest," << layout << "," << CPURT::Get_Triangle_Test_Name(test) << "," << width << "," << scheduler.GetThreadsCount() << ","
+				<< bytes / trianglesCount << "," << rays.size() << "," << mraysClosest << "," << hitsCount << ",\n";
+			output << "occlusion," << layout << "," << CPURT::Get_Triangle_Test_Name(test) << "," << width << "," << scheduler.GetThreadsCount() << ","
+				<< bytes / trianglesCount << "," << rays.size() << "," << mraysOcclusion << "," << occludedCount << ",\n";
+		};
+
+		measureRays("aos", TRIANGLE_TEST_MOLLER_TRUMBORE, triangleBytes,
+			[&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, ray, hit, SIMD_AVX2); },
+			[&](const Ray &ray, Hit &hit) { return CPURT::Occluded(bvh8, ray, hit, SIMD_AVX2); });
+
+		for (TriangleTest test : tests) {
+			const TrianglePackets &leafPackets = packets[test];
+			measureRays("packets", test, leafPackets.GetMemorySize(),
+				[&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, leafPackets, ray, hit); },
+				[&](const Ray &ray, Hit &hit) { return CPURT::Occluded(bvh8, leafPackets, ray, hit); });
+		}
+
+		// Shared edges of the grid
+		BVH gridBVH;
+		CPURT::Build_BVH(scheduler, grid, info, gridBVH);
+
+		BVH8 gridBVH8;
+		CPURT::Build_BVH8(gridBVH, gridBVH8);
+
+		auto countMisses = [&](const char* layout, TriangleTest test, const function<bool(const Ray&, Hit&)> &intersect) {
+			size_t hitsCount = 0;
+			double mrays = traceRays(scheduler, edgeRays, intersect, hitsCount);
+
+			output << "edges," << layout << "," << CPURT::Get_Triangle_Test_Name(test) << "," << width << "," << scheduler.GetThreadsCount() << ",,"
+				<< edgeRays.size() << "," << mrays << "," << hitsCount << "," << edgeRays.size() - hitsCount << "\n";
+		};
+
+		countMisses("aos", TRIANGLE_TEST_MOLLER_TRUMBORE, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(gridBVH8, ray, hit, SIMD_AVX2); });
+
+		for (TriangleTest test : tests) {
+			TrianglePackets gridPackets;
+			CPURT::Build_Triangle_Packets(gridBVH8, width, test, gridPackets);
+			countMisses("packets", test, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(gridBVH8, gridPackets, ray, hit); });
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Linear BVH
+//--------------------------------------------------------------------------------------
+
+/**
+* Binned SAH builder against the LBVH (BVHBuildInfo::linear) without and with treelet restructuring passes:
+* - static: best build time, nodes, SAH cost, closest-hit throughput of AO rays and closest hits that differ from the SAH tree.
+* - animated: per frame rebuilds of the twisting model with every builder, against refitting the first frame's SAH tree.
+*/
+int Run_Linear_BVH(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+	const int framesCount = 8;
+	const int treeletPasses[] = { 0, 1, 3 };
+
+	Model rest;
+	loadBenchmarkModel(config, rest);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "scenario,builder,treeletPasses,threads,triangles,frames,nodes,buildMs,sahCost,rays,mraysClosest,mismatches\n";
+
+	vector<BVHBuildInfo> builders(1);
+	for (int passes : treeletPasses) {
+		BVHBuildInfo info;
+		info.linear = true;
+		info.treeletPasses = passes;
+		builders.push_back(info);
+	}
+
+	BVH reference;
+	CPURT::Build_BVH(scheduler, rest, builders[0], reference);
+
+	BVH8 reference8;
+	CPURT::Build_BVH8(reference, reference8);
+
+	vector<Ray> rays;
+	generateAORays(scheduler, config, rest, reference, rays);
+
+	for (const BVHBuildInfo &info : builders) {
+		BVH bvh;
+		double buildTime = DBL_MAX;
+		for (int r = 0; r < repetitions; r++) {
+			CPURT::Build_BVH(scheduler, rest, info, bvh);
+			buildTime = min(buildTime, bvh.stats.buildTime);
+		}
+
+		BVH8 bvh8;
+		CPURT::Build_BVH8(bvh, bvh8);
+
+		double mraysClosest = 0.0;
+		size_t hitsCount = 0;
+		for (int r = 0; r < repetitions; r++)
+			mraysClosest = max(mraysClosest, traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, ray, hit); }, hitsCount));
+
+		std::atomic<size_t> mismatches(0);
+		scheduler.ParallelFor(rays.size(), 1024, [&](size_t begin, size_t end) {
+			size_t localMismatches = 0;
+			for (size_t i = begin; i < end; i++) {
+				Hit a, b;
+				bool hitA = CPURT::Intersect(bvh8, rays[i], a);
+				bool hitB = CPURT::Intersect(reference8, rays[i], b);
+				if (hitA != hitB || (hitA && a.t != b.t)) localMismatches++;
+			}
+			mismatches += localMismatches;
+		});
+
+		output << "static," << (info.linear ? "lbvh" : "binned") << "," << info.treeletPasses << "," << scheduler.GetThreadsCount() << ","
+			<< rest.indices.size() / 3 << ",1," << bvh.stats.nodesCount << "," << buildTime << "," << bvh.stats.sahCost << ","
+			<< rays.size() << "," << mraysClosest << "," << mismatches << "\n";
+	}
+
+	// Animated model, mean build time and SAH cost over the frames
+	Model model = rest;
+	BVH refitted;
+	CPURT::Build_BVH(scheduler, rest, builders[0], refitted);
+
+	for (size_t builder = 0; builder <= builders.size(); builder++) {
+		const bool refit = (builder == builders.size());
+		const BVHBuildInfo &info = refit ? builders[0] : builders[builder];
+
+		BVH bvh;
+		double buildTime = 0.0, sahCost = 0.0;
+
+		for (int frame = 1; frame <= framesCount; frame++) {
+			deformModel(rest, 0.003f * frame, 0.4f * frame, model);
+
+			if (refit) {
+				CPURT::Refit_BVH(scheduler, model, info, refitted);
+				buildTime += refitted.stats.refitTime;
+				sahCost += refitted.stats.sahCost;
+			} else {
+				CPURT::Build_BVH(scheduler, model, info, bvh);
+				buildTime += bvh.stats.buildTime;
+				sahCost += bvh.stats.sahCost;
+			}
+		}
+
+		output << "animated," << (refit ? "refit" : (info.linear ? "lbvh" : "binned")) << "," << info.treeletPasses << "," << scheduler.GetThreadsCount() << ","
+			<< rest.indices.size() / 3 << "," << framesCount << ",," << buildTime / framesCount << "," << sahCost / framesCount << ",,,\n";
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Node Layouts
+//--------------------------------------------------------------------------------------
+
+/**
+* Set associative cache with LRU replacement, counts misses of the 64 byte lines accessed.
+*/
+struct CacheModel
+{
+	size_t setsCount;
+	int ways;
+	vector<uint64_t> lines;		//< Line address + 1 held by every way of a set, most recently used first (0 is empty)
+	uint64_t misses;
+
+	CacheModel(size_t size, int associativity) {
+		ways = associativity;
+		setsCount = size / (64 * ways);
+		lines.assign(setsCount * ways, 0);
+		misses = 0;
+	}
+
+	// Returns true on a miss
+	bool Access(uint64_t line) {
+		uint64_t* set = &lines[(line % setsCount) * ways];
+		int way = 0;
+		while (way < ways && set[way] != line + 1) way++;
+
+		bool miss = (way == ways);
+		if (miss) {
+			misses++;
+			way = ways - 1;
+		}
+
+		for (; way > 0; way--)
+			set[way] = set[way - 1];
+		set[0] = line + 1;
+
+		return miss;
+	}
+};
+
+/**
+* 8-wide BVH with nodes in build order against the depth first, breadth first top / depth first bottom and van Emde Boas layouts:
+* reorder time, closest-hit and occlusion throughput of AO rays in tile order and shuffled (incoherent), and cache misses per ray.
+* Misses come from per-thread models of a 32 KB 8-way L1 and 1 MB 16-way L2 fed with the lines read by the scalar closest-hit kernel
+* (Windows offers no user mode access to hardware counters), closest hits that differ from the build order check the permutation.
+*/
+int Run_Node_Layouts(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+	const size_t simulationGrain = 64 * 1024;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 reference;
+	CPURT::Build_BVH8(bvh, reference);
+
+	vector<Ray> tileRays;
+	generateAORays(scheduler, config, model, bvh, tileRays);
+
+	vector<Ray> shuffledRays = tileRays;
+	std::mt19937 generator(23);
+	std::shuffle(shuffledRays.begin(), shuffledRays.end(), generator);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "layout,rays,threads,nodes,reorderMs,raysCount,mraysClosest,mraysOcclusion,nodesPerRay,l1MissesPerRay,l2MissesPerRay,mismatches\n";
+
+	for (int l = BVH8_LAYOUT_BUILD; l < BVH8_LAYOUTS_COUNT; l++) {
+		BVH8Layout layout = (BVH8Layout)l;
+
+		BVH8 bvh8 = reference;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		CPURT::Reorder_BVH8(bvh8, layout);
+		auto endTime = std::chrono::high_resolution_clock::now();
+		double reorderTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+		for (int shuffled = 0; shuffled < 2; shuffled++) {
+			const vector<Ray> &rays = shuffled ? shuffledRays : tileRays;
+
+			double mraysClosest = 0.0, mraysOcclusion = 0.0;
+			size_t hitsCount = 0, occludedCount = 0;
+			for (int r = 0; r < repetitions; r++) {
+				mraysClosest = max(mraysClosest, traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, ray, hit); }, hitsCount));
+				mraysOcclusion = max(mraysOcclusion, traceRays(scheduler, rays, [&](const Ray &ray, Hit &hit) { return CPURT::Occluded(bvh8, ray, hit); }, occludedCount));
+			}
+
+			// Every grain of rays is simulated on cold caches of its own, as a thread would trace it
+			std::atomic<uint64_t> nodeVisits(0), l1Misses(0), l2Misses(0), mismatches(0);
+			scheduler.ParallelFor(rays.size(), simulationGrain, [&](size_t begin, size_t end) {
+				CacheModel l1(32 * 1024, 8), l2(1024 * 1024, 16);
+				uint64_t localVisits = 0, localMismatches = 0;
+
+				auto access = [&](const void* address, size_t bytes, bool node) {
+					if (node) localVisits++;
+					for (uintptr_t line = uintptr_t(address) / 64; line <= (uintptr_t(address) + bytes - 1) / 64; line++) {
+						if (l1.Access(line)) l2.Access(line);
+					}
+				};
+
+				for (size_t i = begin; i < end; i++) {
+					Hit traced;
+					CPURT::Intersect_BVH8_Scalar(bvh8, rays[i], traced, access);
+
+					Hit a, b;
+					bool hitA = CPURT::Intersect(bvh8, rays[i], a);
+					bool hitB = CPURT::Intersect(reference, rays[i], b);
+					if (hitA != hitB || (hitA && (a.t != b.t || a.primitiveIndex != b.primitiveIndex))) localMismatches++;
+				}
+
+				nodeVisits += localVisits;
+				l1Misses += l1.misses;
+				l2Misses += l2.misses;
+				mismatches += localMismatches;
+			});
+
+			double raysCount = double(max(rays.size(), size_t(1)));
+			output << CPURT::Get_BVH8_Layout_Name(layout) << "," << (shuffled ? "shuffled" : "tiles") << "," << scheduler.GetThreadsCount() << ","
+				<< bvh8.nodes.size() << "," << reorderTime << "," << rays.size() << "," << mraysClosest << "," << mraysOcclusion << ","
+				<< nodeVisits / raysCount << "," << l1Misses / raysCount << "," << l2Misses / raysCount << "," << mismatches << "\n";
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Short Ray Entry Points
+//--------------------------------------------------------------------------------------
+
+/**
+* AO rays traversed from the root against rays entering the BVH8 at the smallest subtree holding everything within their reach,
+* looked up in the entry grid built for the radius or found by descending from the root once per ray origin (consecutive rays of
+* a pixel share it), for AO radii of the GUI's range: grid build time and memory, mean depth of the entry node, closest-hit and
+* occlusion throughput, speed-up over root traversal and closest hits that differ from it.
+*/
+int Run_Short_Rays(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+	const float radii[] = { 0.25f, 0.5f, 1.0f, 2.0f };
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	// Depth of every node, children always follow their parent in build order
+	vector<int> depths(bvh8.nodes.size(), 0);
+	for (size_t i = 0; i < bvh8.nodes.size(); i++) {
+		for (uint32_t child : bvh8.nodes[i].children) {
+			if (!(child & BVH8_LEAF_FLAG)) depths[child] = depths[i] + 1;
+		}
+	}
+
+	const SIMDLevel level = CPURT::Get_Supported_SIMD_Level();
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "aoRadius,entry,threads,nodes,rays,cells,cellSize,gridBytes,buildMs,meanEntryDepth,mraysClosest,mraysOcclusion,speedupClosest,speedupOcclusion,mismatches,aoPassEntry\n";
+
+	for (float radius : radii) {
+		ConfigInfo radiusConfig = config;
+		radiusConfig.aoRadius = radius;
+
+		vector<Ray> rays;
+		generateAORays(scheduler, radiusConfig, model, bvh, rays);
+
+		BVH8EntryGrid grid;
+		double buildTime = DBL_MAX;
+		for (int r = 0; r < repetitions; r++) {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			CPURT::Build_BVH8_Entry_Grid(scheduler, bvh8, radius, grid);
+			auto endTime = std::chrono::high_resolution_clock::now();
+			buildTime = min(buildTime, std::chrono::duration<double, std::milli>(endTime - startTime).count());
+		}
+
+		vector<float> reference(rays.size());
+		vector<float> distances(rays.size());
+		vector<uint32_t> entries(rays.size());
+		double rootClosest = 0.0, rootOcclusion = 0.0;
+
+		for (int method = 0; method < 3; method++) {
+			const char* entryName = (method == 0) ? "root" : (method == 1 ? "grid" : "origin");
+
+			// Entry of a range of rays, per origin entries are found once for every run of rays sharing the origin
+			auto findEntries = [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					if (method == 0) {
+						entries[i] = 0;
+					} else if (method == 1) {
+						entries[i] = CPURT::Get_BVH8_Entry(grid, rays[i]);
+					} else if (i > begin && rays[i].origin.x == rays[i - 1].origin.x && rays[i].origin.y == rays[i - 1].origin.y
+						&& rays[i].origin.z == rays[i - 1].origin.z && rays[i].tMax == rays[i - 1].tMax) {
+						entries[i] = entries[i - 1];
+					} else {
+						entries[i] = CPURT::Find_BVH8_Entry(bvh8, rays[i].origin, rays[i].tMax * Length(rays[i].direction));
+					}
+				}
+			};
+
+			double mraysClosest = measureThroughput(scheduler, rays.size(), 1024, rays.size(), repetitions, [&](size_t begin, size_t end) {
+				findEntries(begin, end);
+				for (size_t i = begin; i < end; i++) {
+					Hit hit;
+					distances[i] = CPURT::Intersect(bvh8, rays[i], hit, level, entries[i]) ? hit.t : rays[i].tMax;
+				}
+			});
+
+			double mraysOcclusion = measureThroughput(scheduler, rays.size(), 1024, rays.size(), repetitions, [&](size_t begin, size_t end) {
+				findEntries(begin, end);
+				for (size_t i = begin; i < end; i++) {
+					Hit hit;
+					CPURT::Occluded(bvh8, rays[i], hit, level, entries[i]);
+				}
+			});
+
+			if (method == 0) {
+				reference = distances;
+				rootClosest = mraysClosest;
+				rootOcclusion = mraysOcclusion;
+			}
+
+			double entryDepth = 0.0;
+			size_t mismatches = 0;
+			for (size_t i = 0; i < rays.size(); i++) {
+				entryDepth += depths[entries[i]];
+				if (distances[i] != reference[i]) mismatches++;
+			}
+			entryDepth /= max(rays.size(), size_t(1));
+
+			output << radius << "," << entryName << "," << scheduler.GetThreadsCount() << "," << bvh8.nodes.size() << "," << rays.size() << ",";
+			if (method == 1) output << grid.entries.size() << "," << grid.cellSize << "," << grid.GetMemorySize() << "," << buildTime << ",";
+			else output << ",,,,";
+			output << entryDepth << "," << mraysClosest << "," << mraysOcclusion << "," << (mraysClosest / rootClosest) << ","
+				<< (mraysOcclusion / rootOcclusion) << "," << mismatches << "," << CPURT::Use_BVH8_Entry(bvh8, radius) << "\n";
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Hash Grid
+//--------------------------------------------------------------------------------------
+
+/**
+* Sparse hash grid with cells of half and of the full AO radius against the 8-wide BVH for AO radii of the GUI's range:
+* build time (BVH and its collapse for the BVH8), occupied cells, references, memory, throughput of occluded bits batches and of
+* closest hits, occluded rays that differ from the BVH8 and closest hits that differ from it.
+*/
+int Run_Hash_Grid(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+	const float radii[] = { 0.25f, 0.5f, 1.0f, 2.0f };
+	const float cellScales[] = { 0.5f, 1.0f };
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	BVH8 bvh8;
+	double bvhBuildTime = DBL_MAX;
+	for (int r = 0; r < repetitions; r++) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		CPURT::Build_BVH(scheduler, model, info, bvh);
+		CPURT::Build_BVH8(bvh, bvh8);
+		auto endTime = std::chrono::high_resolution_clock::now();
+		bvhBuildTime = min(bvhBuildTime, std::chrono::duration<double, std::milli>(endTime - startTime).count());
+	}
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "aoRadius,structure,cellSize,threads,triangles,buildMs,cells,references,totalBytes,rays,occluded,mraysOcclusion,mraysClosest,occlusionMismatches,closestMismatches\n";
+
+	for (float radius : radii) {
+		ConfigInfo radiusConfig = config;
+		radiusConfig.aoRadius = radius;
+
+		vector<Ray> rays;
+		generateAORays(scheduler, radiusConfig, model, bvh, rays);
+
+		// Batches are aligned to 32 rays, so that threads never share a word of occluded bits
+		const size_t batchSize = 1024;
+		const size_t batchesCount = (rays.size() + batchSize - 1) / batchSize;
+		vector<uint32_t> referenceBits((rays.size() + 31) / 32), occludedBits((rays.size() + 31) / 32);
+		vector<float> referenceDistances(rays.size()), distances(rays.size());
+
+		auto measure = [&](const char* structure, float cellSize, double buildTime, size_t cellsCount, size_t referencesCount, size_t totalBytes,
+			const function<void(const Ray*, size_t, uint32_t*)> &occluded, const function<bool(const Ray&, Hit&)> &intersect) {
+			double mraysOcclusion = measureThroughput(scheduler, batchesCount, 1, rays.size(), repetitions, [&](size_t begin, size_t end) {
+				for (size_t b = begin; b < end; b++) {
+					size_t first = b * batchSize;
+					occluded(&rays[first], min(batchSize, rays.size() - first), &occludedBits[first / 32]);
+				}
+			});
+
+			double mraysClosest = measureThroughput(scheduler, rays.size(), batchSize, rays.size(), repetitions, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					Hit hit;
+					distances[i] = intersect(rays[i], hit) ? hit.t : rays[i].tMax;
+				}
+			});
+
+			if (cellSize == 0.0f) {
+				referenceBits = occludedBits;
+				referenceDistances = distances;
+			}
+
+			size_t occludedCount = 0, occlusionMismatches = 0, closestMismatches = 0;
+			for (size_t i = 0; i < rays.size(); i++) {
+				uint32_t bit = 1u << (i % 32);
+				if (occludedBits[i / 32] & bit) occludedCount++;
+				if ((occludedBits[i / 32] & bit) != (referenceBits[i / 32] & bit)) occlusionMismatches++;
+				if (distances[i] != referenceDistances[i]) closestMismatches++;
+			}
+
+			output << radius << "," << structure << "," << cellSize << "," << scheduler.GetThreadsCount() << "," << model.indices.size() / 3 << ","
+				<< buildTime << "," << cellsCount << "," << referencesCount << "," << totalBytes << "," << rays.size() << "," << occludedCount << ","
+				<< mraysOcclusion << "," << mraysClosest << "," << occlusionMismatches << "," << closestMismatches << "\n";
+		};
+
+		measure("bvh8", 0.0f, bvhBuildTime, 0, bvh8.triangles.size(), meshMemorySize(bvh8),
+			[&](const Ray* batch, size_t count, uint32_t* bits) { CPURT::Occluded(bvh8, batch, count, bits); },
+			[&](const Ray &ray, Hit &hit) { return CPURT::Intersect(bvh8, ray, hit); });
+
+		for (float scale : cellScales) {
+			HashGrid grid;
+			double buildTime = DBL_MAX;
+			for (int r = 0; r < repetitions; r++) {
+				CPURT::Build_Hash_Grid(scheduler, model, radius * scale, grid);
+				buildTime = min(buildTime, grid.buildTime);
+			}
+
+			measure("hashgrid", grid.cellSize, buildTime, grid.occupiedCells, grid.references.size(), grid.GetMemorySize(),
+				[&](const Ray* batch, size_t count, uint32_t* bits) { CPURT::Occluded(grid, batch, count, bits); },
+				[&](const Ray &ray, Hit &hit) { return CPURT::Intersect(grid, ray, hit); });
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Interleaved Traversal
+//--------------------------------------------------------------------------------------
+
+/**
+* One ray at a time (AVX2 kernel) against interleaved batch traversal with 1 to 32 rays in flight per thread, for AO rays in tile
+* order and shuffled (incoherent). Run with -triangles large enough for the structure to exceed the last level cache: structure
+* size, throughput of occluded bits and of closest hits, speed-up, and rays whose result differs from one ray at a time.
+*/
+int Run_Interleaved_Traversal(const ConfigInfo &config)
+{
+	const int repetitions = 4;
+	const int raysInFlight[] = { 1, 4, 8, 16, 32 };
+	const size_t batchSize = 1024;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	vector<Ray> tileRays;
+	generateAORays(scheduler, config, model, bvh, tileRays);
+
+	vector<Ray> shuffledRays = tileRays;
+	std::mt19937 generator(29);
+	std::shuffle(shuffledRays.begin(), shuffledRays.end(), generator);
+
+	const SIMDLevel level = min(CPURT::Get_Supported_SIMD_Level(), SIMD_AVX2);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "rays,traversal,raysInFlight,threads,triangles,structureBytes,raysCount,occluded,hits,mraysOcclusion,mraysClosest,speedupOcclusion,speedupClosest,mismatches\n";
+
+	for (int shuffled = 0; shuffled < 2; shuffled++) {
+		const vector<Ray> &rays = shuffled ? shuffledRays : tileRays;
+		const size_t batchesCount = (rays.size() + batchSize - 1) / batchSize;
+
+		vector<uint32_t> occludedBits((rays.size() + 31) / 32), hitBits((rays.size() + 31) / 32);
+		vector<uint32_t> referenceOccluded, referenceHits;
+		vector<Hit> hits(rays.size()), referenceClosest;
+		double singleOcclusion = 0.0, singleClosest = 0.0;
+
+		for (int variant = -1; variant < int(sizeof(raysInFlight) / sizeof(raysInFlight[0])); variant++) {
+			const bool single = (variant < 0);
+			const int inFlight = single ? 1 : raysInFlight[variant];
+
+			double mraysOcclusion = measureThroughput(scheduler, batchesCount, 1, rays.size(), repetitions, [&](size_t begin, size_t end) {
+				for (size_t b = begin; b < end; b++) {
+					size_t first = b * batchSize;
+					size_t count = min(batchSize, rays.size() - first);
+					if (single) CPURT::Occluded(bvh8, &rays[first], count, &occludedBits[first / 32], level);
+					else CPURT::Occluded_Interleaved(bvh8, &rays[first], count, &occludedBits[first / 32], inFlight);
+				}
+			});
+
+			double mraysClosest = measureThroughput(scheduler, batchesCount, 1, rays.size(), repetitions, [&](size_t begin, size_t end) {
+				for (size_t b = begin; b < end; b++) {
+					size_t first = b * batchSize;
+					size_t count = min(batchSize, rays.size() - first);
+					if (single) {
+						for (size_t i = first; i < first + count; i++) {
+							if (i % 32 == 0) hitBits[i / 32] = 0;
+							if (CPURT::Intersect(bvh8, rays[i], hits[i], level)) hitBits[i / 32] |= 1u << (i % 32);
+						}
+					} else {
+						CPURT::Intersect_Interleaved(bvh8, &rays[first], count, &hits[first], &hitBits[first / 32], inFlight);
+					}
+				}
+			});
+
+			if (single) {
+				referenceOccluded = occludedBits;
+				referenceHits = hitBits;
+				referenceClosest = hits;
+				singleOcclusion = mraysOcclusion;
+				singleClosest = mraysClosest;
+			}
+
+			size_t occludedCount = 0, hitsCount = 0, mismatches = 0;
+			for (size_t i = 0; i < rays.size(); i++) {
+				uint32_t bit = 1u << (i % 32);
+				bool occluded = (occludedBits[i / 32] & bit) != 0, hit = (hitBits[i / 32] & bit) != 0;
+				occludedCount += occluded;
+				hitsCount += hit;
+
+				if (occluded != ((referenceOccluded[i / 32] & bit) != 0) || hit != ((referenceHits[i / 32] & bit) != 0)
+					|| (hit && (hits[i].t != referenceClosest[i].t || hits[i].primitiveIndex != referenceClosest[i].primitiveIndex))) mismatches++;
+			}
+
+			output << (shuffled ? "shuffled" : "tiles") << "," << (single ? "single" : "interleaved") << "," << inFlight << ","
+				<< scheduler.GetThreadsCount() << "," << model.indices.size() / 3 << "," << meshMemorySize(bvh8) << "," << rays.size() << ","
+				<< occludedCount << "," << hitsCount << "," << mraysOcclusion << "," << mraysClosest << "," << (mraysOcclusion / singleOcclusion) << ","
+				<< (mraysClosest / singleClosest) << "," << mismatches << "\n";
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// NUMA Scaling
+//--------------------------------------------------------------------------------------
+
+/**
+* Primary and AO passes on 1 and 2 NUMA nodes (sockets): the plain scheduler with threads left to the OS, threads pinned per node
+* with per-node tile queues, and the same with BVH8 and mesh replicated per node. All runs use the processors of the nodes (or
+* -threads), speed-up is against the plain scheduler on one node and on the same nodes. Systems with a single node report it only.
+*/
+int Run_NUMA_Scaling(const ConfigInfo &config)
+{
+	const int framesCount = 4;
+	const int maxNodes = 2;
+	const char* modes[] = { "flat", "pinned", "replicated" };
+
+	Model model;
+	Material material;
+	loadBenchmarkModel(config, model, &material);
+
+	TextureInfo albedo;
+	MaterialCB materialCB;
+	loadBenchmarkTexture(material, albedo, materialCB);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo info;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, info, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	scheduler.Destroy();
+
+	vector<NumaNodeInfo> numaNodes;
+	TaskScheduler::GetNumaNodes(numaNodes);
+
+	SampleSetInfo sampleSetInfo;
+	vector<XMFLOAT3> samples;
+	SampleSets::Build_Table(sampleSetInfo, samples);
+
+	RtaoCB rtao;
+	rtao.aoRadius = config.aoRadius;
+	rtao.samplesCount = sampleSetInfo.samplesCount;
+	rtao.interleaveWidth = sampleSetInfo.interleaveWidth;
+	rtao.interleaveHeight = sampleSetInfo.interleaveHeight;
+
+	size_t replicaBytes = meshMemorySize(bvh8) + model.vertices.size() * sizeof(Vertex) + model.indices.size() * sizeof(uint32_t);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "nodes,systemNodes,mode,threads,frameMs,primaryMs,aoMs,mraysPerSecond,speedup,speedupVsFlat,steals,remoteSteals,replicasBytes\n";
+
+	double singleNodeFlatTime = 0.0;
+
+	for (int nodesCount = 1; nodesCount <= min(maxNodes, (int)numaNodes.size()); nodesCount++) {
+		int threads = 0;
+		for (int node = 0; node < nodesCount; node++) threads += numaNodes[node].processorsCount;
+		if (config.threadsCount > 0) threads = min(threads, config.threadsCount);
+		if (threads < nodesCount) break;
+
+		double flatTime = 0.0;
+
+		for (int mode = 0; mode < int(sizeof(modes) / sizeof(modes[0])); mode++) {
+			scheduler.Init(threads, (mode == 0) ? 0 : nodesCount);
+
+			NumaReplicas<BVH8> bvhReplicas;
+			NumaReplicas<Model> modelReplicas;
+			if (mode == 2) {
+				bvhReplicas.Init(scheduler, bvh8);
+				modelReplicas.Init(scheduler, model);
+			}
+
+			XMMATRIX viewProjection = XMMatrixIdentity();
+			benchmarkView(config, 0, viewProjection);
+
+			Image primaryOutput;
+			Image normalAndDepths[2];
+			Image ao[2];
+			normalAndDepths[1].Resize(config.width, config.height, XMFLOAT4(-1.0f, -1.0f, -1.0f, -1.0f));
+			ao[1].Resize(config.width, config.height, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+
+			double primaryTime = 0.0, aoTime = 0.0;
+			uint64_t raysCount = 0;
+			scheduler.ResetStats();
+
+			for (int frame = 0; frame < framesCount; frame++) {
+				ViewCB view = benchmarkView(config, frame, viewProjection);
+				rtao.frameNumber = frame % sampleSetInfo.framesCount;
+
+				PrimaryPassStats primaryStats;
+				AOPassStats aoStats;
+
+				if (mode == 2) {
+					CPURT::Render_Primary(scheduler, bvhReplicas, modelReplicas, albedo, materialCB, view, primaryOutput, normalAndDepths[frame % 2], &primaryStats);
+					CPURT::Render_AO(scheduler, bvhReplicas, view, rtao, samples, normalAndDepths[frame % 2], normalAndDepths[(frame + 1) % 2],
+						ao[(frame + 1) % 2], ao[frame % 2], &aoStats);
+				} else {
+					CPURT::Render_Primary(scheduler, bvh8, model, albedo, materialCB, view, primaryOutput, normalAndDepths[frame % 2], &primaryStats);
+					CPURT::Render_AO(scheduler, bvh8, view, rtao, samples, normalAndDepths[frame % 2], normalAndDepths[(frame + 1) % 2],
+						ao[(frame + 1) % 2], ao[frame % 2], &aoStats);
+				}
+
+				primaryTime += primaryStats.time;
+				aoTime += aoStats.time;
+				raysCount += primaryStats.raysCount + aoStats.raysCount;
+			}
+
+			vector<TaskThreadStats> threadStats;
+			scheduler.GetStats(threadStats);
+
+			uint64_t steals = 0, remoteSteals = 0;
+			for (const TaskThreadStats &stats : threadStats) {
+				steals += stats.stealsCount;
+				remoteSteals += stats.remoteStealsCount;
+			}
+
+			int replicasCount = bvhReplicas.GetCount();
+			scheduler.Destroy();
+
+			double frameTime = (primaryTime + aoTime) / framesCount;
+			if (mode == 0) flatTime = frameTime;
+			if (mode == 0 && nodesCount == 1) singleNodeFlatTime = frameTime;
+
+			output << nodesCount << "," << numaNodes.size() << "," << modes[mode] << "," << threads << "," << frameTime << ","
+				<< (primaryTime / framesCount) << "," << (aoTime / framesCount) << "," << (raysCount / ((primaryTime + aoTime) * 1e3)) << ","
+				<< (singleNodeFlatTime / frameTime) << "," << (flatTime / frameTime) << "," << steals << "," << remoteSteals << ","
+				<< (replicasCount * replicaBytes) << "\n";
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Vertex AO Bake
+//--------------------------------------------------------------------------------------
+
+/**
+* Per-vertex AO baked into the BVH cache file of the model for 16 to 256 rays per vertex: bake time and Mrays/s, mean and lowest
+* AO, whether a single threaded bake gives the same result, and reading the AO back from the cache. The cache file is written
+* next to the output and removed afterwards.
+*/
+int Run_Vertex_AO_Bake(const ConfigInfo &config)
+{
+	const int raysCounts[] = { 16, 64, 256 };
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	BVHBuildInfo buildInfo;
+	BVH8 bvh8;
+
+	string cachePath = config.benchmarkOutput + ".bvh";
+
+	AOBakeInfo info;
+	info.aoRadius = config.aoRadius;
+	info.raysCount = raysCounts[0];
+
+	// Same bake on one thread, every vertex must come out bit for bit the same as with all threads
+	vector<float> singleThreadAO;
+	scheduler.Init(1);
+	{
+		BVH bvh;
+		CPURT::Build_BVH(scheduler, model, buildInfo, bvh);
+		CPURT::Build_BVH8(bvh, bvh8);
+	}
+	CPURT::Bake_Vertex_AO(scheduler, bvh8, model, info, singleThreadAO);
+	scheduler.Destroy();
+
+	scheduler.Init(config.threadsCount);
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "raysPerVertex,threads,vertices,points,rays,bakeMs,mraysPerSecond,meanAO,minAO,deterministic,cacheBytes,loadMs,loaded\n";
+
+	for (int raysCount : raysCounts) {
+		info.raysCount = raysCount;
+
+		std::remove(cachePath.c_str());
+
+		vector<float> vertexAO;
+		AOBakeStats bakeStats;
+		CPURT::Bake_Vertex_AO_Cached(scheduler, cachePath, model, buildInfo, info, bvh8, vertexAO, &bakeStats);
+
+		vector<float> cachedAO;
+		AOBakeStats loadStats;
+		CPURT::Bake_Vertex_AO_Cached(scheduler, cachePath, model, buildInfo, info, bvh8, cachedAO, &loadStats);
+
+		double meanAO = 0.0;
+		float minAO = 1.0f;
+		for (float ao : vertexAO) {
+			meanAO += ao;
+			minAO = min(minAO, ao);
+		}
+		meanAO /= max(size_t(1), vertexAO.size());
+
+		bool deterministic = (raysCount != raysCounts[0]) || (singleThreadAO.size() == vertexAO.size() &&
+			memcmp(singleThreadAO.data(), vertexAO.data(), vertexAO.size() * sizeof(float)) == 0);
+
+		ifstream cacheFile(cachePath, ios::binary | ios::ate);
+		size_t cacheBytes = cacheFile.is_open() ? size_t(cacheFile.tellg()) : 0;
+		cacheFile.close();
+
+		output << raysCount << "," << scheduler.GetThreadsCount() << "," << model.vertices.size() << "," << bakeStats.pointsCount << ","
+			<< bakeStats.raysCount << "," << bakeStats.time << "," << bakeStats.mraysPerSecond << "," << meanAO << "," << minAO << ","
+			<< deterministic << "," << cacheBytes << "," << loadStats.time << "," << (loadStats.loaded && cachedAO == vertexAO) << "\n";
+	}
+
+	std::remove(cachePath.c_str());
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Lightmap AO Bake
+//--------------------------------------------------------------------------------------
+
+/**
+* AO baked into lightmaps of the model with its own uvs (when usable) and with generated charts at 256 to 1024 texels: coverage and
+* utilization of the atlas, bake time and Mrays/s, mean AO, memory of the lightmap and of the texture. Each lightmap is saved as a TGA next to the
+* output and loaded back as Create_Texture does, it must match the baked texture (the file is removed afterwards).
+*/
+int Run_Lightmap_AO_Bake(const ConfigInfo &config)
+{
+	const int resolutions[] = { 256, 512, 1024 };
+	const LightmapUVs uvModes[] = { LIGHTMAP_UVS_AUTO, LIGHTMAP_UVS_GENERATED };
+	const int raysCount = 16;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo buildInfo;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, buildInfo, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	AOBakeInfo info;
+	info.aoRadius = config.aoRadius;
+	info.raysCount = raysCount;
+
+	string texturePath = config.benchmarkOutput + ".tga";
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "uvs,resolution,threads,texels,covered,conservative,overlapping,utilization,rays,buildMs,bakeMs,mraysPerSecond,meanAO,lightmapBytes,textureBytes,fileBytes,loaded\n";
+
+	for (LightmapUVs uvs : uvModes) {
+		for (int resolution : resolutions) {
+			LightmapInfo lightmapInfo;
+			lightmapInfo.resolution = resolution;
+			lightmapInfo.uvs = uvs;
+
+			// Generated charts keep at least a texel and its padding around every chart, at most one chart per triangle
+			int reserved = 2 * lightmapInfo.padding + 2;
+			if (uvs == LIGHTMAP_UVS_GENERATED && double(model.indices.size() / 3) * reserved * reserved > double(resolution) * resolution) continue;
+
+			auto buildStart = std::chrono::steady_clock::now();
+			Lightmap lightmap;
+			CPURT::Build_Lightmap(model, lightmapInfo, lightmap);
+			double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+			AOBakeStats bakeStats;
+			CPURT::Bake_Lightmap_AO(scheduler, bvh8, info, lightmap, &bakeStats);
+
+			double meanAO = 0.0;
+			for (size_t i = 0; i < lightmap.texels.size(); i++) {
+				if (lightmap.texels[i].primitiveIndex != LIGHTMAP_EMPTY_TEXEL) meanAO += lightmap.ao[i];
+			}
+			meanAO /= max(uint64_t(1), bakeStats.pointsCount);
+
+			TextureInfo texture;
+			CPURT::Get_Lightmap_Texture(lightmap, texture);
+
+			CPURT::Save_Lightmap_Texture(texturePath, lightmap);
+
+			ifstream textureFile(texturePath, ios::binary | ios::ate);
+			size_t fileBytes = textureFile.is_open() ? size_t(textureFile.tellg()) : 0;
+			textureFile.close();
+
+			TextureInfo loaded = Utils::LoadTexture(texturePath);
+			std::remove(texturePath.c_str());
+
+			bool matches = loaded.width == texture.width && loaded.height == texture.height && loaded.pixels == texture.pixels;
+
+			// Share of the atlas baked, texels of charts and their conservative border
+			double utilization = double(lightmap.coveredTexels + lightmap.conservativeTexels) / max(size_t(1), lightmap.texels.size());
+
+			output << (lightmap.generatedUVs ? "generated" : "model") << "," << resolution << "," << scheduler.GetThreadsCount() << ","
+				<< lightmap.texels.size() << "," << lightmap.coveredTexels << "," << lightmap.conservativeTexels << "," << lightmap.overlappingTexels << "," << utilization << ","
+				<< bakeStats.raysCount << "," << buildTime << "," << bakeStats.time << "," << bakeStats.mraysPerSecond << "," << meanAO << ","
+				<< lightmap.GetMemorySize() << "," << texture.pixels.size() << "," << fileBytes << "," << matches << "\n";
+		}
+	}
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------------
+// Progressive AO Bake
+//--------------------------------------------------------------------------------------
+
+/**
+* Convergence of a progressive lightmap bake pass by pass: texels traced, at the target error, capped at the rays count above it
+* and pending, rays, mean and highest samples per texel, RMS and highest standard error. The same bake is then interrupted halfway and resumed from its checkpoint (written next to the output
+* and removed afterwards), the resumed lightmap must match the uninterrupted one bit for bit.
+*/
+int Run_Progressive_AO_Bake(const ConfigInfo &config)
+{
+	const int resolution = 256;
+
+	Model model;
+	loadBenchmarkModel(config, model);
+
+	TaskScheduler scheduler;
+	scheduler.Init(config.threadsCount);
+
+	BVHBuildInfo buildInfo;
+	BVH bvh;
+	CPURT::Build_BVH(scheduler, model, buildInfo, bvh);
+
+	BVH8 bvh8;
+	CPURT::Build_BVH8(bvh, bvh8);
+
+	LightmapInfo lightmapInfo;
+	lightmapInfo.resolution = resolution;
+
+	Lightmap lightmap;
+	CPURT::Build_Lightmap(model, lightmapInfo, lightmap);
+
+	AOBakeInfo info;
+	info.aoRadius = config.aoRadius;
+	info.raysCount = 256;
+
+	AOProgressiveInfo progressiveInfo;
+	progressiveInfo.samplesPerPass = 8;
+	progressiveInfo.targetError = 0.01f;
+	progressiveInfo.checkpointPasses = 2;
+
+	ofstream output = openBenchmarkOutput(config);
+
+	output << "run,pass,threads,activeTexels,convergedTexels,cappedTexels,pendingTexels,targetReached,rays,meanSamples,maxSamples,rmsError,"
+		"maxError,passMs,checkpointed,resumedPasses,mraysPerSecond,checkpointBytes,checkpointMs,matchesUninterrupted\n";
+
+	auto writePasses = [&](const char* run, const AOProgressiveStats &stats, bool matches) {
+		for (const AOPassReport &report : stats.passes) {
+			bool targetReached = (report.cappedTexels == 0 && report.pendingTexels == 0);
+
+			output << run << "," << report.pass << "," << scheduler.GetThreadsCount() << "," << report.activeTexels << ","
+				<< report.convergedTexels << "," << report.cappedTexels << "," << report.pendingTexels << "," << targetReached << ","
+				<< report.raysCount << "," << report.meanSamplesCount << "," << report.maxSamplesCount << "," << report.rmsError << ","
+				<< report.maxError << "," << report.time << "," << report.checkpointed << "," << stats.resumedPasses << "," << stats.mraysPerSecond << "," << stats.checkpointBytes << "," << stats.checkpointTime << "," << matches << "\n";
+		}
+	};
+
+	// Uninterrupted bake without checkpoints
+	Lightmap uninterrupted = lightmap;
+	AOProgressiveStats uninterruptedStats;
+	CPURT::Bake_Lightmap_AO_Progressive(scheduler, bvh8, info, progressiveInfo, uninterrupted, &uninterruptedStats);
+	writePasses("uninterrupted", uninterruptedStats, true);
+
+	// Same bake stopped halfway, as if the process died after its last checkpoint, then restarted
+	progressiveInfo.checkpointPath = config.benchmarkOutput + ".checkpoint";
+	std::remove(progressiveInfo.checkpointPath.c_str());
+
+	progressiveInfo.maxPasses = max(1, int(uninterruptedStats.passes.size()) / 2);
+	Lightmap interrupted = lightmap;
+	AOProgressiveStats interruptedStats;
+	CPURT::Bake_Lightmap_AO_Progressive(scheduler, bvh8, info, progressiveInfo, interrupted, &interruptedStats);
+	writePasses("interrupted", interruptedStats, false);
+
+	progressiveInfo.maxPasses = 0;
+	Lightmap resumed = lightmap;
+	AOProgressiveStats resumedStats;
+	CPURT::Bake_Lightmap_AO_Progressive(scheduler, bvh8, info, progressiveInfo, resumed, &resumedStats);
+	writePasses("resumed", resumedStats, resumed.ao == uninterrupted.ao);
+
+	std::remove(progressiveInfo.checkpointPath.c_str());
+
+	scheduler.Destroy();
+
+	return EXIT_SUCCESS;
+}
+
+}
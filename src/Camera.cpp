@@ -0,0 +1,58 @@
+// RTAO - View constants and primary rays of the CPU passes
+#include "Camera.h"
+
+namespace CPURT
+{
+
+void Setup_View_CB(const XMFLOAT3 &eye, const XMFLOAT3 &focus, float fov, int width, int height, XMMATRIX &previousViewProjection, ViewCB &view)
+{
+	XMFLOAT3 up = XMFLOAT3(0.f, 1.f, 0.f);
+	float aspect = (float)width / (float)height;
+
+	XMMATRIX viewMatrix = XMMatrixLookAtLH(XMLoadFloat3(&eye), XMLoadFloat3(&focus), XMLoadFloat3(&up));
+	XMMATRIX invView = XMMatrixInverse(NULL, viewMatrix);
+
+	float nearPlane = 0.01f;
+	float farPlane = 100.0f;
+
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(fov, aspect, nearPlane, farPlane);
+
+	view.view = XMMatrixTranspose(invView);
+	view.motionVectorsMatrix = previousViewProjection;
+	view.previousViewMatrix = viewMatrix;
+	view.viewOriginAndTanHalfFovY = XMFLOAT4(eye.x, eye.y, eye.z, tanf(fov * 0.5f));
+	view.resolution = XMFLOAT2((float)width, (float)height);
+
+	previousViewProjection = XMMatrixMultiply(viewMatrix, projection);
+}
+
+/**
+* ViewCB stores the transposed inverse view matrix, the axes (its rows) are columns here.
+*/
+void Get_View_Axes(const ViewCB &view, XMFLOAT3 &right, XMFLOAT3 &up, XMFLOAT3 &forward)
+{
+	XMFLOAT4X4 invView;
+	XMStoreFloat4x4(&invView, view.view);
+
+	right = XMFLOAT3(invView.m[0][0], invView.m[1][0], invView.m[2][0]);
+	up = XMFLOAT3(invView.m[0][1], invView.m[1][1], invView.m[2][1]);
+	forward = XMFLOAT3(invView.m[0][2], invView.m[1][2], invView.m[2][2]);
+}
+
+Ray Get_Primary_Ray(const ViewCB &view, int x, int y)
+{
+	XMFLOAT3 right, up, forward;
+	Get_View_Axes(view, right, up, forward);
+
+	float dx = ((x + 0.5f) / view.resolution.x) * 2.0f - 1.0f;
+	float dy = ((y + 0.5f) / view.resolution.y) * 2.0f - 1.0f;
+	float aspectRatio = view.resolution.x / view.resolution.y;
+	float tanHalfFovY = view.viewOriginAndTanHalfFovY.w;
+
+	XMFLOAT3 origin = XMFLOAT3(view.viewOriginAndTanHalfFovY.x, view.viewOriginAndTanHalfFovY.y, view.viewOriginAndTanHalfFovY.z);
+	XMFLOAT3 direction = Add(Sub(Mul(right, dx * tanHalfFovY * aspectRatio), Mul(up, dy * tanHalfFovY)), forward);
+
+	return Ray(origin, Normalize(direction), 0.1f, 1000.0f);
+}
+
+}
@@ -0,0 +1,118 @@
+// RTAO - CPU implementation of the low-pass filter passes
+#include "FilterPass.h"
+
+#include <chrono>
+
+namespace CPURT
+{
+
+/**
+* Same test as isValidTap: relative depth difference (tolerance shrinks as the surface faces the camera) and normals.
+*/
+static inline bool isValidTap(float tapDepth, float centerDepth, const XMFLOAT3 &tapNormal, const XMFLOAT3 &centerNormal, float dotViewNormal)
+{
+	const float depthRelativeDifferenceEpsilonMin = 0.003f;
+	const float depthRelativeDifferenceEpsilonMax = 0.02f;
+	const float dotNormalsEpsilon = 0.9f;
+
+	float depthRelativeDifferenceEpsilon = depthRelativeDifferenceEpsilonMax + (depthRelativeDifferenceEpsilonMin - depthRelativeDifferenceEpsilonMax) * dotViewNormal;
+
+	if (fabsf(1.0f - (tapDepth / centerDepth)) > depthRelativeDifferenceEpsilon) return false;
+	if (Dot(tapNormal, centerNormal) < dotNormalsEpsilon) return false;
+
+	return true;
+}
+
+/**
+* One invocation of lowPassFilter, direction is (1, 0) or (0, 1). Temporal variant averages all 4 channels of ao.
+*/
+static float lowPassFilter(const Image &normalAndDepths, const Image &ao, const XMFLOAT3 &viewForward, int x, int y,
+	int directionX, int directionY, int filterRadius, bool doTemporalFilter)
+{
+	float result = 0.0f;
+	float weight = 0.0f;
+
+	float sigma = 0.5f * float(filterRadius);
+
+	const XMFLOAT4 &center = normalAndDepths.Load(x, y);
+	float centerDepth = center.w;
+	XMFLOAT3 centerNormal = Normalize(XMFLOAT3(center.x, center.y, center.z));
+
+	// z of the view space normal, normalMatrix rotates to view space
+	float dotViewNormal = fabsf(Dot(viewForward, centerNormal));
+
+	for (int i = -filterRadius; i <= filterRadius; ++i) {
+		int tapX = min(max(x + i * directionX, 0), ao.width - 1);
+		int tapY = min(max(y + i * directionY, 0), ao.height - 1);
+
+		const XMFLOAT4 &tapDepthNormal = normalAndDepths.Load(tapX, tapY);
+		const XMFLOAT4 &tapAO = ao.Load(tapX, tapY);
+		XMFLOAT3 tapNormal = Normalize(XMFLOAT3(tapDepthNormal.x, tapDepthNormal.y, tapDepthNormal.z));
+
+		float tapWeight = expf(-0.5f * float(i * i) / (sigma * sigma));
+
+		if (isValidTap(tapDepthNormal.w, centerDepth, tapNormal, centerNormal, dotViewNormal)) {
+			result += (doTemporalFilter ? (tapAO.x + tapAO.y + tapAO.z + tapAO.w) * 0.25f : tapAO.x) * tapWeight;
+			weight += tapWeight;
+		}
+	}
+
+	return result / weight;
+}
+
+void Render_Low_Pass_Filter(TaskScheduler &scheduler, const LowPassFilerCB &filter, const Image &normalAndDepths, const Image &ao,
+	const Image &color, Image &temp, Image &output, FilterPassStats* stats)
+{
+	if (normalAndDepths.width != ao.width || normalAndDepths.height != ao.height || color.width != ao.width || color.height != ao.height)
+	{
+		throw std::runtime_error("Error: low-pass filter inputs have different sizes!");
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Forward axis is the third column of the stored (transposed) matrix, as in Get_View_Axes
+	XMFLOAT4X4 normalMatrix;
+	XMStoreFloat4x4(&normalMatrix, filter.normalMatrix);
+	XMFLOAT3 viewForward = XMFLOAT3(normalMatrix.m[0][2], normalMatrix.m[1][2], normalMatrix.m[2][2]);
+
+	int width = ao.width;
+	int height = ao.height;
+	temp.Resize(width, height);
+	output.Resize(width, height);
+
+	scheduler.ParallelForTiles(width, height, FILTER_PASS_TILE_SIZE, [&](int x0, int y0, int x1, int y1) {
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				float value = lowPassFilter(normalAndDepths, ao, viewForward, x, y, 1, 0, filter.filterRadiusX, true);
+				temp.At(x, y) = XMFLOAT4(value, value, value, value);
+			}
+		}
+	});
+
+	auto passX = std::chrono::steady_clock::now();
+
+	scheduler.ParallelForTiles(width, height, FILTER_PASS_TILE_SIZE, [&](int x0, int y0, int x1, int y1) {
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				float value = lowPassFilter(normalAndDepths, temp, viewForward, x, y, 0, 1, filter.filterRadiusY, false);
+				const XMFLOAT4 &texel = color.Load(x, y);
+
+				if (filter.outputMode == 0) {
+					output.At(x, y) = XMFLOAT4(value, value, value, value);
+				} else if (filter.outputMode == 2) {
+					output.At(x, y) = texel;
+				} else {
+					output.At(x, y) = XMFLOAT4(texel.x * value, texel.y * value, texel.z * value, 1.0f);
+				}
+			}
+		}
+	});
+
+	if (stats) {
+		auto end = std::chrono::steady_clock::now();
+		stats->time = std::chrono::duration<double, std::milli>(end - start).count();
+		stats->timeX = std::chrono::duration<double, std::milli>(passX - start).count();
+	}
+}
+
+}
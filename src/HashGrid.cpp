@@ -0,0 +1,375 @@
+// RTAO - Sparse uniform grid of triangle references, hashed by cell, for radius bounded occlusion queries
+#include "HashGrid.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Cells
+//--------------------------------------------------------------------------------------
+
+// Triangles are referenced by chunks of this many, every chunk is a task
+static const size_t referenceChunkSize = 16 * 1024;
+
+static const int cellBias = HASH_GRID_MAX_CELL + 1;
+
+static inline uint64_t cellKey(int x, int y, int z)
+{
+	return (uint64_t(x + cellBias) << 42) | (uint64_t(y + cellBias) << 21) | uint64_t(z + cellBias);
+}
+
+static inline size_t cellHash(uint64_t key)
+{
+	key ^= key >> 31;
+	key *= 0xBF58476D1CE4E5B9ull;
+	key ^= key >> 29;
+	return size_t(key);
+}
+
+static inline const HashGridCell* findCell(const HashGrid &grid, uint64_t key)
+{
+	const size_t mask = grid.cells.size() - 1;
+	for (size_t slot = cellHash(key) & mask; ; slot = (slot + 1) & mask) {
+		const HashGridCell &cell = grid.cells[slot];
+		if (cell.key == key) return &cell;
+		if (cell.key == HASH_GRID_EMPTY_KEY) return nullptr;
+	}
+}
+
+/**
+* Visit keys of the cells overlapped by the triangle: all cells of its bounds, minus those its plane misses when it spans
+* more than one cell in two axes or more (large triangles at an angle to the grid would otherwise fill their whole bounds).
+*/
+template <typename Visitor>
+static void visitTriangleCells(const Triangle &triangle, float cellSize, const Visitor &visit)
+{
+	const float padding = 1e-4f * cellSize;
+
+	AABB bounds;
+	bounds.Grow(triangle.v0);
+	bounds.Grow(triangle.v1);
+	bounds.Grow(triangle.v2);
+
+	int low[3] = {
+		(int)floorf((bounds.min.x - padding) / cellSize),
+		(int)floorf((bounds.min.y - padding) / cellSize),
+		(int)floorf((bounds.min.z - padding) / cellSize)
+	};
+	int high[3] = {
+		(int)floorf((bounds.max.x + padding) / cellSize),
+		(int)floorf((bounds.max.y + padding) / cellSize),
+		(int)floorf((bounds.max.z + padding) / cellSize)
+	};
+
+	int spannedAxes = int(high[0] > low[0]) + int(high[1] > low[1]) + int(high[2] > low[2]);
+	XMFLOAT3 normal = Cross(Sub(triangle.v1, triangle.v0), Sub(triangle.v2, triangle.v0));
+	float radius = (0.5f * cellSize + padding) * (fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z));
+
+	for (int z = low[2]; z <= high[2]; z++) {
+		for (int y = low[1]; y <= high[1]; y++) {
+			for (int x = low[0]; x <= high[0]; x++) {
+				if (spannedAxes >= 2) {
+					XMFLOAT3 center = XMFLOAT3((x + 0.5f) * cellSize, (y + 0.5f) * cellSize, (z + 0.5f) * cellSize);
+					if (fabsf(Dot(normal, Sub(center, triangle.v0))) > radius) continue;
+				}
+
+				visit(cellKey(x, y, z));
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Build
+//--------------------------------------------------------------------------------------
+
+// Reference of a triangle from a cell
+struct CellReference
+{
+	uint64_t key;
+	uint32_t triangle;
+
+	bool operator<(const CellReference &other) const { return key < other.key || (key == other.key && triangle < other.triangle); }
+};
+
+// References of a chunk to one cell
+struct CellRun
+{
+	uint64_t key;
+	uint32_t count;
+	uint32_t offset;	//< Position of the run's references in the grid
+};
+
+/**
+* Chunks of triangles emit and sort their references in parallel, runs of a cell within a chunk are then inserted into the table
+* and given their place in chunk order, so every cell lists its triangles in index order. References are scattered in parallel.
+*/
+void Build_Hash_Grid(TaskScheduler &scheduler, const Model &model, float cellSize, HashGrid &grid)
+{
+	if (cellSize <= 0.0f)
+	{
+		throw std::runtime_error("Error: hash grid requires a positive cell size!");
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	AABB bounds;
+	for (const Vertex &vertex : model.vertices)
+		bounds.Grow(vertex.position);
+
+	// Triangle cells are padded, so the range is one cell larger on each side
+	float boundsMin[3] = { bounds.min.x, bounds.min.y, bounds.min.z };
+	float boundsMax[3] = { bounds.max.x, bounds.max.y, bounds.max.z };
+	for (int axis = 0; axis < 3; axis++) {
+		float low = bounds.IsEmpty() ? 0.0f : floorf(boundsMin[axis] / cellSize) - 1.0f;
+		float high = bounds.IsEmpty() ? 0.0f : floorf(boundsMax[axis] / cellSize) + 1.0f;
+
+		if (!(low >= -float(HASH_GRID_MAX_CELL) && high <= float(HASH_GRID_MAX_CELL)))
+		{
+			throw std::runtime_error("Error: hash grid cell size is too small for the model extent!");
+		}
+
+		grid.cellsMin[axis] = int(low);
+		grid.cellsMax[axis] = int(high);
+	}
+
+	const size_t trianglesCount = model.indices.size() / 3;
+	const size_t chunksCount = (trianglesCount + referenceChunkSize - 1) / referenceChunkSize;
+
+	grid.cellSize = cellSize;
+	grid.triangles.resize(trianglesCount);
+
+	vector<vector<CellReference>> chunkReferences(chunksCount);
+	vector<vector<CellRun>> chunkRuns(chunksCount);
+
+	scheduler.ParallelFor(chunksCount, 1, [&](size_t begin, size_t end) {
+		for (size_t chunk = begin; chunk < end; chunk++) {
+			vector<CellReference> &references = chunkReferences[chunk];
+
+			for (size_t i = chunk * referenceChunkSize; i < min(trianglesCount, (chunk + 1) * referenceChunkSize); i++) {
+				Triangle &triangle = grid.triangles[i];
+				triangle.v0 = model.vertices[model.indices[i * 3 + 0]].position;
+				triangle.v1 = model.vertices[model.indices[i * 3 + 1]].position;
+				triangle.v2 = model.vertices[model.indices[i * 3 + 2]].position;
+
+				visitTriangleCells(triangle, cellSize, [&](uint64_t key) {
+					CellReference reference = { key, uint32_t(i) };
+					references.push_back(reference);
+				});
+			}
+
+			std::sort(references.begin(), references.end());
+
+			for (size_t r = 0; r < references.size(); r++) {
+				if (r == 0 || references[r].key != references[r - 1].key) {
+					CellRun run = { references[r].key, 0, 0 };
+					chunkRuns[chunk].push_back(run);
+				}
+				chunkRuns[chunk].back().count++;
+			}
+		}
+	});
+
+	// Runs are far fewer than references, the table is filled and references placed serially
+	size_t runsCount = 0;
+	for (const vector<CellRun> &runs : chunkRuns)
+		runsCount += runs.size();
+
+	size_t tableSize = 1;
+	while (tableSize < runsCount * 2) tableSize *= 2;
+
+	HashGridCell emptyCell = { HASH_GRID_EMPTY_KEY, 0, 0 };
+	grid.cells.assign(tableSize, emptyCell);
+	grid.occupiedCells = 0;
+
+	vector<uint32_t> runSlots;
+	runSlots.reserve(runsCount);
+
+	const size_t mask = tableSize - 1;
+	for (const vector<CellRun> &runs : chunkRuns) {
+		for (const CellRun &run : runs) {
+			size_t slot = cellHash(run.key) & mask;
+			while (grid.cells[slot].key != run.key && grid.cells[slot].key != HASH_GRID_EMPTY_KEY)
+				slot = (slot + 1) & mask;
+
+			if (grid.cells[slot].key == HASH_GRID_EMPTY_KEY) {
+				grid.cells[slot].key = run.key;
+				grid.occupiedCells++;
+			}
+
+			grid.cells[slot].count += run.count;
+			runSlots.push_back(uint32_t(slot));
+		}
+	}
+
+	size_t referencesCount = 0;
+	for (HashGridCell &cell : grid.cells) {
+		cell.first = uint32_t(referencesCount);
+		referencesCount += cell.count;
+	}
+
+	if (referencesCount > UINT32_MAX)
+	{
+		throw std::runtime_error("Error: hash grid has too many triangle references, increase the cell size!");
+	}
+
+	// Runs take the next free place of their cell in chunk order
+	vector<uint32_t> cursors(tableSize);
+	for (size_t slot = 0; slot < tableSize; slot++)
+		cursors[slot] = grid.cells[slot].first;
+
+	size_t runIndex = 0;
+	for (vector<CellRun> &runs : chunkRuns) {
+		for (CellRun &run : runs) {
+			uint32_t slot = runSlots[runIndex++];
+			run.offset = cursors[slot];
+			cursors[slot] += run.count;
+		}
+	}
+
+	grid.references.resize(referencesCount);
+
+	scheduler.ParallelFor(chunksCount, 1, [&](size_t begin, size_t end) {
+		for (size_t chunk = begin; chunk < end; chunk++) {
+			size_t r = 0;
+			for (const CellRun &run : chunkRuns[chunk]) {
+				for (uint32_t i = 0; i < run.count; i++)
+					grid.references[run.offset + i] = chunkReferences[chunk][r++].triangle;
+			}
+		}
+	});
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	grid.buildTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+//--------------------------------------------------------------------------------------
+// Traversal
+//--------------------------------------------------------------------------------------
+
+// Triangles spanning several cells are tested once while they are among the last ones tested
+static const int mailboxSize = 8;
+
+/**
+* Cells are visited in order along the ray (Amanatides and Woo). Closest hit queries stop once the closest hit found lies
+* within the cells visited so far, any hit queries at the first hit.
+*/
+template <bool anyHit>
+static bool traverse(const HashGrid &grid, const Ray &ray, Hit &hit)
+{
+	if (grid.cells.empty()) return false;
+
+	const float cellSize = grid.cellSize;
+	const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const float direction[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+
+	int cell[3], step[3];
+	float tNext[3], tDelta[3];
+
+	for (int axis = 0; axis < 3; axis++) {
+		float start = origin[axis] + direction[axis] * ray.tMin;
+		cell[axis] = (int)floorf(start / cellSize);
+
+		if (direction[axis] > 0.0f) {
+			step[axis] = 1;
+			tDelta[axis] = cellSize / direction[axis];
+			tNext[axis] = ((cell[axis] + 1) * cellSize - origin[axis]) / direction[axis];
+		} else if (direction[axis] < 0.0f) {
+			step[axis] = -1;
+			tDelta[axis] = -cellSize / direction[axis];
+			tNext[axis] = (cell[axis] * cellSize - origin[axis]) / direction[axis];
+		} else {
+			step[axis] = 0;
+			tDelta[axis] = FLT_MAX;
+			tNext[axis] = FLT_MAX;
+		}
+	}
+
+	// Rays leaving the range of occupied cells are done, those that can't enter it miss
+	for (int axis = 0; axis < 3; axis++) {
+		bool below = cell[axis] < grid.cellsMin[axis], above = cell[axis] > grid.cellsMax[axis];
+		if ((below && step[axis] <= 0) || (above && step[axis] >= 0)) return false;
+	}
+
+	uint32_t mailbox[mailboxSize];
+	for (uint32_t &entry : mailbox) entry = UINT32_MAX;
+	int mailboxNext = 0;
+
+	float tMax = ray.tMax;
+	bool found = false;
+
+	while (true) {
+		bool inside = true;
+		for (int axis = 0; axis < 3; axis++)
+			inside &= (cell[axis] >= grid.cellsMin[axis] && cell[axis] <= grid.cellsMax[axis]);
+
+		const HashGridCell* gridCell = inside ? findCell(grid, cellKey(cell[0], cell[1], cell[2])) : nullptr;
+
+		if (gridCell) {
+			for (uint32_t r = gridCell->first; r < gridCell->first + gridCell->count; r++) {
+				uint32_t triangleIndex = grid.references[r];
+
+				bool tested = false;
+				for (uint32_t entry : mailbox) tested |= (entry == triangleIndex);
+				if (tested) continue;
+
+				mailbox[mailboxNext] = triangleIndex;
+				mailboxNext = (mailboxNext + 1) % mailboxSize;
+
+				float t, u, v;
+				if (IntersectTriangle(grid.triangles[triangleIndex], ray.origin, ray.direction, ray.tMin, tMax, t, u, v)) {
+					tMax = t;
+					hit.t = t;
+					hit.primitiveIndex = triangleIndex;
+					hit.barycentrics = XMFLOAT2(u, v);
+					found = true;
+					if (anyHit) return true;
+				}
+			}
+		}
+
+		int axis = (tNext[0] < tNext[1]) ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+		if (tNext[axis] >= tMax) break;
+
+		cell[axis] += step[axis];
+		tNext[axis] += tDelta[axis];
+		if ((step[axis] > 0 && cell[axis] > grid.cellsMax[axis]) || (step[axis] < 0 && cell[axis] < grid.cellsMin[axis])) break;
+	}
+
+	return found;
+}
+
+bool Intersect(const HashGrid &grid, const Ray &ray, Hit &hit)
+{
+	return traverse<false>(grid, ray, hit);
+}
+
+bool Occluded(const HashGrid &grid, const Ray &ray, Hit &hit)
+{
+	return traverse<true>(grid, ray, hit);
+}
+
+void Occluded(const HashGrid &grid, const Ray* rays, size_t count, uint32_t* occludedBits)
+{
+	for (size_t word = 0; word < (count + 31) / 32; word++) {
+		uint32_t bits = 0;
+		for (size_t i = word * 32; i < min(count, (word + 1) * 32); i++) {
+			Hit hit;
+			if (traverse<true>(grid, rays[i], hit)) bits |= 1u << (i % 32);
+		}
+		occludedBits[word] = bits;
+	}
+}
+
+void Occlusion_Distance(const HashGrid &grid, const Ray* rays, size_t count, float* t)
+{
+	for (size_t i = 0; i < count; i++) {
+		Hit hit;
+		t[i] = traverse<true>(grid, rays[i], hit) ? hit.t : rays[i].tMax;
+	}
+}
+
+}
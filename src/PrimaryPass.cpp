@@ -0,0 +1,108 @@
+// RTAO - CPU implementation of the primary visibility pass
+#include "PrimaryPass.h"
+#include "Camera.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace CPURT
+{
+
+/**
+* Texture Load of the albedo, RGBA8 UNORM texels are returned as floats.
+*/
+static inline XMFLOAT3 loadAlbedo(const TextureInfo &albedo, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= albedo.width || y >= albedo.height) return XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	const UINT8* texel = &albedo.pixels[(size_t(y) * albedo.width + x) * albedo.stride];
+	return XMFLOAT3(texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f);
+}
+
+/**
+* One RayGen invocation, ClosestHit and Miss shaders included. Returns true when the ray hits.
+*/
+static bool tracePixel(const BVH8 &bvh, const Model &model, const TextureInfo &albedo, const MaterialCB &material, const ViewCB &view,
+	int x, int y, Image &output, Image &normalAndDepths)
+{
+	Ray ray = Get_Primary_Ray(view, x, y);
+
+	Hit hit;
+	if (!Intersect(bvh, ray, hit)) {
+		output.At(x, y) = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+		normalAndDepths.At(x, y) = XMFLOAT4(-1.0f, -1.0f, -1.0f, -1.0f);
+		return false;
+	}
+
+	const Vertex &v0 = model.vertices[model.indices[hit.primitiveIndex * 3 + 0]];
+	const Vertex &v1 = model.vertices[model.indices[hit.primitiveIndex * 3 + 1]];
+	const Vertex &v2 = model.vertices[model.indices[hit.primitiveIndex * 3 + 2]];
+
+	// Face normal and interpolated UV as computed by GetVertexAttributes
+	XMFLOAT3 normal = Cross(Normalize(Sub(v1.position, v2.position)), Normalize(Sub(v0.position, v2.position)));
+
+	float b0 = 1.0f - hit.barycentrics.x - hit.barycentrics.y;
+	float b1 = hit.barycentrics.x;
+	float b2 = hit.barycentrics.y;
+	XMFLOAT2 uv = XMFLOAT2(v0.uv.x * b0 + v1.uv.x * b1 + v2.uv.x * b2, v0.uv.y * b0 + v1.uv.y * b1 + v2.uv.y * b2);
+
+	XMFLOAT3 color = loadAlbedo(albedo, (int)floorf(uv.x * material.resolution.x), (int)floorf(uv.y * material.resolution.x));
+
+	output.At(x, y) = XMFLOAT4(color.x, color.y, color.z, 1.0f);
+	normalAndDepths.At(x, y) = XMFLOAT4(normal.x, normal.y, normal.z, hit.t);
+	return true;
+}
+
+/**
+* Pass over tiles, tileData returns the BVH8 and mesh a tile reads.
+*/
+static void renderPrimary(TaskScheduler &scheduler, const function<void(const BVH8*&, const Model*&)> &tileData, const TextureInfo &albedo,
+	const MaterialCB &material, const ViewCB &view, Image &output, Image &normalAndDepths, PrimaryPassStats* stats)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	int width = (int)view.resolution.x;
+	int height = (int)view.resolution.y;
+	output.Resize(width, height);
+	normalAndDepths.Resize(width, height);
+
+	std::atomic<uint64_t> hitsCount(0);
+
+	scheduler.ParallelForTiles(width, height, PRIMARY_PASS_TILE_SIZE, [&](int x0, int y0, int x1, int y1) {
+		uint64_t tileHits = 0;
+
+		const BVH8* bvh = nullptr;
+		const Model* model = nullptr;
+		tileData(bvh, model);
+
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				if (tracePixel(*bvh, *model, albedo, material, view, x, y, output, normalAndDepths)) tileHits++;
+			}
+		}
+
+		hitsCount += tileHits;
+	});
+
+	if (stats) {
+		stats->time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->raysCount = uint64_t(width) * height;
+		stats->hitsCount = hitsCount;
+	}
+}
+
+void Render_Primary(TaskScheduler &scheduler, const BVH8 &bvh, const Model &model, const TextureInfo &albedo, const MaterialCB &material,
+	const ViewCB &view, Image &output, Image &normalAndDepths, PrimaryPassStats* stats)
+{
+	renderPrimary(scheduler, [&](const BVH8* &tileBVH, const Model* &tileModel) { tileBVH = &bvh; tileModel = &model; }, albedo, material, view,
+		output, normalAndDepths, stats);
+}
+
+void Render_Primary(TaskScheduler &scheduler, const NumaReplicas<BVH8> &bvh, const NumaReplicas<Model> &model, const TextureInfo &albedo,
+	const MaterialCB &material, const ViewCB &view, Image &output, Image &normalAndDepths, PrimaryPassStats* stats)
+{
+	renderPrimary(scheduler, [&](const BVH8* &tileBVH, const Model* &tileModel) { tileBVH = &bvh.Get(); tileModel = &model.Get(); }, albedo, material,
+		view, output, normalAndDepths, stats);
+}
+
+}
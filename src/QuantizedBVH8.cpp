@@ -0,0 +1,229 @@
+// RTAO - 8-wide BVH with 8-bit quantized child bounds
+#include "QuantizedBVH8.h"
+
+namespace CPURT
+{
+
+// Keeps scales of flat and huge nodes normal floats
+static const int minExponent = -100;
+static const int maxExponent = 100;
+
+//--------------------------------------------------------------------------------------
+// Build
+//--------------------------------------------------------------------------------------
+
+/**
+* Smallest power of two scale for which 255 steps from the origin cover the node extent.
+*/
+static int8_t quantizationExponent(float origin, float boundsMax)
+{
+	float extent = boundsMax - origin;
+	int exponent = extent > 0.0f ? (int)ceilf(log2f(extent / 255.0f)) : minExponent;
+	exponent = min(max(exponent, minExponent), maxExponent);
+
+	while (exponent < maxExponent && origin + 255.0f * QuantizedScale((int8_t)exponent) < boundsMax) exponent++;
+
+	return (int8_t)exponent;
+}
+
+/**
+* Quantize a child interval outwards, decoded bounds contain the original ones.
+*/
+static void quantizeInterval(float origin, float scale, float childMin, float childMax, uint8_t &quantizedMin, uint8_t &quantizedMax)
+{
+	int low = min(max((int)floorf((childMin - origin) / scale), 0), 255);
+	while (low > 0 && origin + low * scale > childMin) low--;
+
+	int high = min(max((int)ceilf((childMax - origin) / scale), 0), 255);
+	while (high < 255 && origin + high * scale < childMax) high++;
+
+	quantizedMin = (uint8_t)low;
+	quantizedMax = (uint8_t)high;
+}
+
+/**
+* Nodes are emitted breadth first, so inner children of every node get consecutive indices. Leaf triangles are copied node by node,
+* so that leaves of a node are consecutive as well and only need a small offset from the node's triangle base.
+*/
+void Build_Quantized_BVH8(const BVH8 &bvh, QuantizedBVH8 &quantized)
+{
+	quantized.nodes.clear();
+	quantized.triangles.clear();
+	quantized.primitiveIndices.clear();
+
+	if (bvh.nodes.empty()) return;
+
+	quantized.nodes.reserve(bvh.nodes.size());
+	quantized.triangles.reserve(bvh.triangles.size());
+	quantized.primitiveIndices.reserve(bvh.primitiveIndices.size());
+
+	// BVH8 node of every emitted node
+	vector<uint32_t> sources;
+	sources.reserve(bvh.nodes.size());
+
+	quantized.nodes.emplace_back();
+	sources.push_back(0);
+
+	for (size_t nodeIndex = 0; nodeIndex < quantized.nodes.size(); nodeIndex++) {
+		const BVH8Node &source = bvh.nodes[sources[nodeIndex]];
+
+		AABB bounds;
+		for (int i = 0; i < BVH8_WIDTH; i++) {
+			if (source.children[i] == BVH8_EMPTY_CHILD) continue;
+			bounds.Grow(XMFLOAT3(source.boundsMin[0][i], source.boundsMin[1][i], source.boundsMin[2][i]));
+			bounds.Grow(XMFLOAT3(source.boundsMax[0][i], source.boundsMax[1][i], source.boundsMax[2][i]));
+		}
+
+		QuantizedBVH8Node node;
+		memset(&node, 0, sizeof(node));
+		node.origin = bounds.IsEmpty() ? XMFLOAT3(0.0f, 0.0f, 0.0f) : bounds.min;
+		node.childBase = (uint32_t)quantized.nodes.size();
+		node.triangleBase = (uint32_t)quantized.triangles.size();
+
+		float origin[3] = { node.origin.x, node.origin.y, node.origin.z };
+		float scales[3];
+		for (int axis = 0; axis < 3; axis++) {
+			node.exponents[axis] = bounds.IsEmpty() ? (int8_t)minExponent : quantizationExponent(origin[axis], Component(bounds.max, axis));
+			scales[axis] = QuantizedScale(node.exponents[axis]);
+		}
+
+		uint32_t innerCount = 0;
+
+		for (int i = 0; i < BVH8_WIDTH; i++) {
+			uint32_t child = source.children[i];
+
+			if (child == BVH8_EMPTY_CHILD) {
+				for (int axis = 0; axis < 3; axis++) {
+					node.quantizedMin[axis][i] = 255;
+					node.quantizedMax[axis][i] = 0;
+				}
+				continue;
+			}
+
+			for (int axis = 0; axis < 3; axis++)
+				quantizeInterval(origin[axis], scales[axis], source.boundsMin[axis][i], source.boundsMax[axis][i], node.quantizedMin[axis][i], node.quantizedMax[axis][i]);
+
+			if (child & BVH8_LEAF_FLAG) {
+				uint32_t first = child & ~BVH8_LEAF_FLAG;
+				uint32_t count = source.counts[i];
+				uint32_t offset = (uint32_t)quantized.triangles.size() - node.triangleBase;
+
+				if (count == 0 || count > QBVH8_MAX_LEAF_SIZE || offset > QBVH8_LEAF_OFFSET_MASK)
+				{
+					throw std::runtime_error("Error: BVH8 leaves don't fit the quantized node encoding, build with a smaller leaf size!");
+				}
+
+				node.meta[i] = uint8_t((count << QBVH8_LEAF_COUNT_SHIFT) | offset);
+				quantized.triangles.insert(quantized.triangles.end(), bvh.triangles.begin() + first, bvh.triangles.begin() + first + count);
+				quantized.primitiveIndices.insert(quantized.primitiveIndices.end(), bvh.primitiveIndices.begin() + first, bvh.primitiveIndices.begin() + first + count);
+			} else {
+				node.innerMask |= uint8_t(1 << i);
+				node.meta[i] = uint8_t(QBVH8_INNER_CHILD | innerCount++);
+				sources.push_back(child);
+			}
+		}
+
+		quantized.nodes.resize(quantized.nodes.size() + innerCount);
+		quantized.nodes[nodeIndex] = node;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Traversal
+//--------------------------------------------------------------------------------------
+
+bool Intersect(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	if (level == SIMD_LEVELS_COUNT) level = supportedLevel;
+
+	return (level >= SIMD_AVX2) ? Intersect_QBVH8_AVX2(bvh, ray, hit) : Intersect_QBVH8_Scalar(bvh, ray, hit);
+}
+
+bool Occluded(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit, SIMDLevel level)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	if (level == SIMD_LEVELS_COUNT) level = supportedLevel;
+
+	return (level >= SIMD_AVX2) ? Occluded_QBVH8_AVX2(bvh, ray, hit) : Occluded_QBVH8_Scalar(bvh, ray, hit);
+}
+
+//--------------------------------------------------------------------------------------
+// Scalar Kernel
+//--------------------------------------------------------------------------------------
+
+template <bool anyHit>
+static bool traverse(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	if (bvh.nodes.empty()) return false;
+
+	const QuantizedBVH8Node* nodes = bvh.nodes.data();
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+	float inverse[3] = { invDirection.x, invDirection.y, invDirection.z };
+	float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+
+	// Near and far planes are picked by direction sign, so inverted bounds of empty slots never pass the test
+	bool negative[3] = { ray.direction.x < 0.0f, ray.direction.y < 0.0f, ray.direction.z < 0.0f };
+
+	float tMax = ray.tMax;
+	bool found = false;
+
+	BVH8StackEntry stack[BVH8_STACK_SIZE];
+	int stackSize = 0;
+	BVH8StackEntry entry = { 0, 0, ray.tMin };
+
+	while (true) {
+		if (entry.child & BVH8_LEAF_FLAG) {
+			found |= IntersectLeaf(bvh, entry.child & ~BVH8_LEAF_FLAG, entry.count, ray, tMax, hit, anyHit);
+			if (anyHit && found) break;
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		const QuantizedBVH8Node &node = nodes[entry.child];
+
+		// Plane distance is q * (scale / direction) + (nodeOrigin - rayOrigin) / direction
+		float nodeOrigin[3] = { node.origin.x, node.origin.y, node.origin.z };
+		float slope[3], offset[3];
+		for (int axis = 0; axis < 3; axis++) {
+			slope[axis] = QuantizedScale(node.exponents[axis]) * inverse[axis];
+			offset[axis] = (nodeOrigin[axis] - origin[axis]) * inverse[axis];
+		}
+
+		BVH8StackEntry hits[BVH8_WIDTH];
+		int hitsCount = 0;
+
+		for (int i = 0; i < BVH8_WIDTH; i++) {
+			float tNear = ray.tMin;
+			float tFar = tMax;
+			for (int axis = 0; axis < 3; axis++) {
+				float nearPlane = negative[axis] ? node.quantizedMax[axis][i] : node.quantizedMin[axis][i];
+				float farPlane = negative[axis] ? node.quantizedMin[axis][i] : node.quantizedMax[axis][i];
+				tNear = max(tNear, nearPlane * slope[axis] + offset[axis]);
+				tFar = min(tFar, farPlane * slope[axis] + offset[axis]);
+			}
+
+			if (tNear <= tFar) hits[hitsCount++] = DecodeQuantizedChild(node, i, tNear);
+		}
+
+		if (hitsCount > 0) {
+			entry = PushChildren(stack, stackSize, hits, hitsCount, anyHit);
+		} else if (!PopEntry(stack, stackSize, tMax, entry)) {
+			break;
+		}
+	}
+
+	return found;
+}
+
+bool Intersect_QBVH8_Scalar(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	return traverse<false>(bvh, ray, hit);
+}
+
+bool Occluded_QBVH8_Scalar(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	return traverse<true>(bvh, ray, hit);
+}
+
+}
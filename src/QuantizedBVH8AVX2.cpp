@@ -0,0 +1,104 @@
+// RTAO - Quantized 8-wide BVH traversal kernel, written with AVX2 and FMA intrinsics
+#include "QuantizedBVH8.h"
+
+#include <immintrin.h>
+
+namespace CPURT
+{
+
+// Widen 8 quantized planes to floats
+static inline __m256 loadPlanes(const uint8_t* planes)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)planes)));
+}
+
+template <bool anyHit>
+static bool traverse(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	if (bvh.nodes.empty()) return false;
+
+	const QuantizedBVH8Node* nodes = bvh.nodes.data();
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+
+	const __m256 tMinV = _mm256_set1_ps(ray.tMin);
+
+	// Offsets of near and far planes within the node, picked by direction sign (inverted empty slots never pass)
+	const size_t planesOffset = BVH8_WIDTH * 3;
+	const size_t nearX = ray.direction.x < 0.0f ? planesOffset : 0;
+	const size_t nearY = (ray.direction.y < 0.0f ? planesOffset : 0) + BVH8_WIDTH;
+	const size_t nearZ = (ray.direction.z < 0.0f ? planesOffset : 0) + BVH8_WIDTH * 2;
+	const size_t farX = (nearX + planesOffset) % (planesOffset * 2);
+	const size_t farY = (nearY + planesOffset) % (planesOffset * 2);
+	const size_t farZ = (nearZ + planesOffset) % (planesOffset * 2);
+
+	float tMax = ray.tMax;
+	bool found = false;
+
+	BVH8StackEntry stack[BVH8_STACK_SIZE];
+	int stackSize = 0;
+	BVH8StackEntry entry = { 0, 0, ray.tMin };
+
+	while (true) {
+		if (entry.child & BVH8_LEAF_FLAG) {
+			found |= IntersectLeaf(bvh, entry.child & ~BVH8_LEAF_FLAG, entry.count, ray, tMax, hit, anyHit);
+			if (anyHit && found) break;
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		const QuantizedBVH8Node &node = nodes[entry.child];
+		const uint8_t* planes = &node.quantizedMin[0][0];
+
+		// Plane distance is q * (scale / direction) + (nodeOrigin - rayOrigin) / direction
+		const __m256 slopeX = _mm256_set1_ps(QuantizedScale(node.exponents[0]) * invDirection.x);
+		const __m256 slopeY = _mm256_set1_ps(QuantizedScale(node.exponents[1]) * invDirection.y);
+		const __m256 slopeZ = _mm256_set1_ps(QuantizedScale(node.exponents[2]) * invDirection.z);
+		const __m256 offsetX = _mm256_set1_ps((node.origin.x - ray.origin.x) * invDirection.x);
+		const __m256 offsetY = _mm256_set1_ps((node.origin.y - ray.origin.y) * invDirection.y);
+		const __m256 offsetZ = _mm256_set1_ps((node.origin.z - ray.origin.z) * invDirection.z);
+
+		__m256 tNearX = _mm256_fmadd_ps(loadPlanes(planes + nearX), slopeX, offsetX);
+		__m256 tNearY = _mm256_fmadd_ps(loadPlanes(planes + nearY), slopeY, offsetY);
+		__m256 tNearZ = _mm256_fmadd_ps(loadPlanes(planes + nearZ), slopeZ, offsetZ);
+		__m256 tFarX = _mm256_fmadd_ps(loadPlanes(planes + farX), slopeX, offsetX);
+		__m256 tFarY = _mm256_fmadd_ps(loadPlanes(planes + farY), slopeY, offsetY);
+		__m256 tFarZ = _mm256_fmadd_ps(loadPlanes(planes + farZ), slopeZ, offsetZ);
+
+		__m256 tNear = _mm256_max_ps(_mm256_max_ps(tNearX, tNearY), _mm256_max_ps(tNearZ, tMinV));
+		__m256 tFar = _mm256_min_ps(_mm256_min_ps(tFarX, tFarY), _mm256_min_ps(tFarZ, _mm256_set1_ps(tMax)));
+
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+		if (mask == 0) {
+			if (!PopEntry(stack, stackSize, tMax, entry)) break;
+			continue;
+		}
+
+		alignas(32) float distances[BVH8_WIDTH];
+		_mm256_store_ps(distances, tNear);
+
+		BVH8StackEntry hits[BVH8_WIDTH];
+		int hitsCount = 0;
+
+		while (mask) {
+			int i = _tzcnt_u32(mask);
+			mask &= mask - 1;
+			hits[hitsCount++] = DecodeQuantizedChild(node, i, distances[i]);
+		}
+
+		entry = PushChildren(stack, stackSize, hits, hitsCount, anyHit);
+	}
+
+	return found;
+}
+
+bool Intersect_QBVH8_AVX2(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	return traverse<false>(bvh, ray, hit);
+}
+
+bool Occluded_QBVH8_AVX2(const QuantizedBVH8 &bvh, const Ray &ray, Hit &hit)
+{
+	return traverse<true>(bvh, ray, hit);
+}
+
+}
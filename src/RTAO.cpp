@@ -2,13 +2,14 @@
 #include "RTAO.h"
 #include "Graphics.h"
 
-#include "Samples.h"
-
 void RTAO::Init(D3D12Global &d3d, D3D12Resources &resources, D3D12ShaderCompilerInfo &shaderCompiler, DXRGlobal &dxr, const Model &model) {
 	
 	// Initialize gui update time
 	lastFPSUpdateTime = std::chrono::steady_clock::now();
 
+	// Start the sampling sequence from its first frame
+	aoFrameIndex = 0;
+
 	// Create DX12 resources
 	createConstantBuffers(d3d);
 	createRTAOBuffers(d3d);
@@ -42,15 +43,23 @@ void RTAO::Init(D3D12Global &d3d, D3D12Resources &resources, D3D12ShaderCompiler
 
 void RTAO::Update(D3D12Global &d3d, D3D12Resources &resources) {
 
-	// Update RTAO CB
-	rtaoCBData.frameNumber = d3d.frameNumber;
+	// Keep interleaving configuration within the size of AO samples texture
+	sampleSetInfo.interleaveWidth = min(max(sampleSetInfo.interleaveWidth, 1), AO_MAX_INTERLEAVE_SIZE);
+	sampleSetInfo.interleaveHeight = min(max(sampleSetInfo.interleaveHeight, 1), AO_MAX_INTERLEAVE_SIZE);
+	sampleSetInfo.framesCount = min(max(sampleSetInfo.framesCount, 1), AO_MAX_FRAMES_COUNT);
+	sampleSetInfo.samplesCount = min(max(sampleSetInfo.samplesCount, 1), AO_MAX_SAMPLES_COUNT);
 
-	switch (rtaoCBData.samplesCount) {
-	case 1: rtaoCBData.sampleStartIndex = 0; break;
-	case 2: rtaoCBData.sampleStartIndex = 36; break;
-	case 3: rtaoCBData.sampleStartIndex = 36 + 72; break;
-	case 4: rtaoCBData.sampleStartIndex = 36 + 72 + 108; break;
-	}
+	// Rebuild AO samples table when interleaving configuration has changed
+	if (sampleSetInfo != uploadedSampleSetInfo) uploadAOSamples(d3d);
+
+	// Advance the sampling sequence
+	aoFrameIndex = (aoFrameIndex + 1) % sampleSetInfo.framesCount;
+
+	// Update RTAO CB
+	rtaoCBData.frameNumber = aoFrameIndex;
+	rtaoCBData.samplesCount = sampleSetInfo.samplesCount;
+	rtaoCBData.interleaveWidth = sampleSetInfo.interleaveWidth;
+	rtaoCBData.interleaveHeight = sampleSetInfo.interleaveHeight;
 
 	memcpy(rtaoCBStart, &rtaoCBData, sizeof(rtaoCBData));
 
@@ -58,6 +67,10 @@ void RTAO::Update(D3D12Global &d3d, D3D12Resources &resources) {
 	lowPassFilerInfo.normalMatrix = resources.normalMatrix;
 	lowPassFilerInfo.texelSize = XMFLOAT2(1.0f / d3d.width, 1.0f / d3d.height);
 
+	// Separable filter needs at least (interleave size) taps in each direction to average all samples of the block
+	lowPassFilerInfo.filterRadiusX = max(2, sampleSetInfo.interleaveWidth / 2);
+	lowPassFilerInfo.filterRadiusY = max(2, sampleSetInfo.interleaveHeight / 2);
+
 	memcpy(lowPassFilerInfoCBStart, &lowPassFilerInfo, sizeof(LowPassFilerCB));
 }
 
@@ -247,7 +260,10 @@ void RTAO::Render(D3D12Global &d3d, D3D12Resources &resources, Profiler* profile
 	gui->Text("Total Frame Time: %.02fms", lastPrimaryRaysTime + lastAoRaytricingTime + lastAoFilteringTime);
 
 	gui->SliderFloat("AO Radius", &rtaoCBData.aoRadius, 0.01f, 2.0f);
-	gui->SliderInt("AO Rays Count", &rtaoCBData.samplesCount, 1, 4);
+	gui->SliderInt("AO Rays Count", &sampleSetInfo.samplesCount, 1, AO_MAX_SAMPLES_COUNT);
+	gui->SliderInt("AO Interleave Width", &sampleSetInfo.interleaveWidth, 1, AO_MAX_INTERLEAVE_SIZE);
+	gui->SliderInt("AO Interleave Height", &sampleSetInfo.interleaveHeight, 1, AO_MAX_INTERLEAVE_SIZE);
+	gui->SliderInt("AO Frames Count", &sampleSetInfo.framesCount, 1, AO_MAX_FRAMES_COUNT);
 	gui->Combo("Output Mode", &lowPassFilerInfo.outputMode, "AO Only\0AO & Color\0Color Only");
 
 	// Submit the command list and wait for the GPU to idle ===========================================
@@ -926,17 +942,17 @@ void RTAO::createRTAOBuffers(D3D12Global &d3d)
 	hr = d3d.device->CreateCommittedResource(&DefaultHeapProperties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(&tempScreenBuffer));
 	Utils::Validate(hr, L"Error: failed to create DXR output buffer!");
 
-	// Create Ao samples buffer
+	// Create Ao samples buffer (large enough for any supported interleaving configuration)
 
 	// Describe the texture
 	desc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	desc.Width = 360;
+	desc.Width = AO_MAX_SAMPLES_TABLE_SIZE;
 	desc.Height = 1;
 	desc.Flags = D3D12_RESOURCE_FLAG_NONE;
 	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE1D;
 
 	// Create the texture resource
-	hr = d3d.device->CreateCommittedResource(&DefaultHeapProperties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&AOSamples));
+	hr = d3d.device->CreateCommittedResource(&DefaultHeapProperties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(&AOSamples));
 	Utils::Validate(hr, L"Error: failed to create texture!");
 
 	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(AOSamples, 0, 1);
@@ -955,29 +971,50 @@ void RTAO::createRTAOBuffers(D3D12Global &d3d)
 	resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 	resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-	// Create the upload heap
+	// Create the upload heap (kept alive, samples are uploaded again when interleaving configuration changes)
 	hr = d3d.device->CreateCommittedResource(&UploadHeapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&AOSamplesUploadHeap));
 	Utils::Validate(hr, L"Error: failed to create texture upload heap!");
 
-	D3D12_SUBRESOURCE_DATA textureData = {};
-	textureData.pData = aoSamples;
-	textureData.RowPitch = 360 * 3 * 4; //< in bytes
-	textureData.SlicePitch = 1;
+	uploadAOSamples(d3d);
+}
 
-	// Schedule a copy from the upload heap to the Texture2D resource
-	UpdateSubresources(d3d.cmdList, AOSamples, AOSamplesUploadHeap, 0, 0, 1, &textureData);
+/**
+* Build AO samples table for current interleaving configuration and schedule its upload to the AO samples texture.
+*/
+void RTAO::uploadAOSamples(D3D12Global &d3d)
+{
+	vector<XMFLOAT3> samples;
+	SampleSets::Build_Table(sampleSetInfo, samples);
 
-	// Transition the texture to a shader resource
+	// Pad the table to the texture width, unused entries are never read
+	samples.resize(AO_MAX_SAMPLES_TABLE_SIZE, XMFLOAT3(0.0f, 0.0f, 1.0f));
+
+	// Transition the texture to a copy destination
 	D3D12_RESOURCE_BARRIER barrier = {};
 	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
 	barrier.Transition.pResource = AOSamples;
-	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
 	barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
 	barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 
 	d3d.cmdList->ResourceBarrier(1, &barrier);
-	
+
+	D3D12_SUBRESOURCE_DATA textureData = {};
+	textureData.pData = samples.data();
+	textureData.RowPitch = AO_MAX_SAMPLES_TABLE_SIZE * sizeof(XMFLOAT3); //< in bytes
+	textureData.SlicePitch = textureData.RowPitch;
+
+	// Schedule a copy from the upload heap to the Texture1D resource
+	UpdateSubresources(d3d.cmdList, AOSamples, AOSamplesUploadHeap, 0, 0, 1, &textureData);
+
+	// Transition the texture back to a shader resource
+	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+	d3d.cmdList->ResourceBarrier(1, &barrier);
+
+	uploadedSampleSetInfo = sampleSetInfo;
 }
 
 void RTAO::createRTAORayGenProgram(D3D12Global &d3d, D3D12ShaderCompilerInfo &shaderCompiler)
@@ -0,0 +1,405 @@
+// RTAO - Tile-based software rasterizer of the normal and depth buffer
+#include "Rasterizer.h"
+#include "Camera.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace CPURT
+{
+
+// Projection of view space positions to screen space as RayGen's primary rays define it
+struct RasterView
+{
+	float width;
+	float height;
+	float scaleX;			//< tan(fovY / 2) * aspect ratio
+	float scaleY;			//< tan(fovY / 2)
+};
+
+static const double subpixelPrecision = 16.0;
+
+//--------------------------------------------------------------------------------------
+// Triangle Setup
+//--------------------------------------------------------------------------------------
+
+static inline RasterVertex projectVertex(const RasterView &screen, const XMFLOAT3 &position)
+{
+	RasterVertex vertex;
+	vertex.x = floorf(((position.x / (position.z * screen.scaleX) + 1.0f) * 0.5f * screen.width) * subpixelPrecision + 0.5f) / subpixelPrecision;
+	vertex.y = floorf(((-position.y / (position.z * screen.scaleY) + 1.0f) * 0.5f * screen.height) * subpixelPrecision + 0.5f) / subpixelPrecision;
+	vertex.invDepth = 1.0f / position.z;
+	return vertex;
+}
+
+/**
+* Set up a triangle in front of the near plane. Degenerate triangles and triangles covering no pixel center are dropped.
+*/
+static void setupTriangle(const RasterView &screen, const RasterVertex* vertices, uint32_t primitiveIndex, vector<RasterTriangle> &triangles)
+{
+	// Most triangles of dense meshes fall between pixel centers
+	float minX = min(min(vertices[0].x, vertices[1].x), vertices[2].x);
+	float maxX = max(max(vertices[0].x, vertices[1].x), vertices[2].x);
+	float minY = min(min(vertices[0].y, vertices[1].y), vertices[2].y);
+	float maxY = max(max(vertices[0].y, vertices[1].y), vertices[2].y);
+
+	int boundsMinX = max((int)ceilf(minX - 0.5f), 0);
+	int boundsMinY = max((int)ceilf(minY - 0.5f), 0);
+	int boundsMaxX = min((int)floorf(maxX - 0.5f), (int)screen.width - 1);
+	int boundsMaxY = min((int)floorf(maxY - 0.5f), (int)screen.height - 1);
+	if (boundsMinX > boundsMaxX || boundsMinY > boundsMaxY) return;
+
+	double x[3], y[3], invDepth[3];
+	for (int i = 0; i < 3; i++) {
+		x[i] = vertices[i].x;
+		y[i] = vertices[i].y;
+		invDepth[i] = vertices[i].invDepth;
+	}
+
+	double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0.0) return;
+
+	// No face culling, orient the triangle so that its inside is positive
+	if (area < 0.0) {
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(invDepth[1], invDepth[2]);
+		area = -area;
+	}
+
+	RasterTriangle triangle;
+	triangle.boundsMin[0] = boundsMinX;
+	triangle.boundsMin[1] = boundsMinY;
+	triangle.boundsMax[0] = boundsMaxX;
+	triangle.boundsMax[1] = boundsMaxY;
+
+	// Edge e goes from vertex e to vertex e + 1, pixel center offset is folded into C
+	double edgeA[3], edgeB[3], edgeC[3];
+	triangle.ownedEdges = 0;
+
+	for (int e = 0; e < 3; e++) {
+		int a = e;
+		int b = (e + 1) % 3;
+		edgeA[e] = -(y[b] - y[a]);
+		edgeB[e] = x[b] - x[a];
+		edgeC[e] = -(edgeA[e] * x[a] + edgeB[e] * y[a]) + 0.5 * (edgeA[e] + edgeB[e]);
+
+		// Reversed edge of the neighbor has negated A and B, so exactly one of them owns the edge
+		if (edgeA[e] > 0.0 || (edgeA[e] == 0.0 && edgeB[e] < 0.0)) triangle.ownedEdges |= 1 << e;
+
+		triangle.edgeA[e] = (float)edgeA[e];
+		triangle.edgeB[e] = (float)edgeB[e];
+		triangle.edgeC[e] = edgeC[e];
+	}
+
+	// Edge e is the barycentric weight of the vertex opposite to it
+	double invArea = 1.0 / area;
+	triangle.invDepthA = (float)((invDepth[0] * edgeA[1] + invDepth[1] * edgeA[2] + invDepth[2] * edgeA[0]) * invArea);
+	triangle.invDepthB = (float)((invDepth[0] * edgeB[1] + invDepth[1] * edgeB[2] + invDepth[2] * edgeB[0]) * invArea);
+	triangle.invDepthC = (invDepth[0] * edgeC[1] + invDepth[1] * edgeC[2] + invDepth[2] * edgeC[0]) * invArea;
+	triangle.primitiveIndex = primitiveIndex;
+
+	triangles.push_back(triangle);
+}
+
+/**
+* Clip a triangle crossing the near plane (Sutherland-Hodgman), the resulting polygon is set up as a triangle fan.
+*/
+static void clipAndSetupTriangle(const RasterView &screen, const XMFLOAT3* positions, uint32_t primitiveIndex, vector<RasterTriangle> &triangles)
+{
+	int insideCount = 0;
+	for (int i = 0; i < 3; i++) {
+		if (positions[i].z >= RASTER_NEAR_PLANE) insideCount++;
+	}
+
+	if (insideCount == 0) return;
+
+	XMFLOAT3 polygon[4];
+	int polygonSize = 0;
+
+	for (int i = 0; i < 3; i++) {
+		const XMFLOAT3 &a = positions[i];
+		const XMFLOAT3 &b = positions[(i + 1) % 3];
+		bool aInside = a.z >= RASTER_NEAR_PLANE;
+		bool bInside = b.z >= RASTER_NEAR_PLANE;
+
+		if (aInside) polygon[polygonSize++] = a;
+		if (aInside != bInside) {
+			// Always interpolated from the inside vertex, so that neighbors clip their shared edge at the same point
+			const XMFLOAT3 &inside = aInside ? a : b;
+			const XMFLOAT3 &outside = aInside ? b : a;
+			float t = (RASTER_NEAR_PLANE - inside.z) / (outside.z - inside.z);
+			polygon[polygonSize] = Add(inside, Mul(Sub(outside, inside), t));
+			polygon[polygonSize++].z = RASTER_NEAR_PLANE;
+		}
+	}
+
+	for (int i = 1; i + 1 < polygonSize; i++) {
+		RasterVertex fan[3] = { projectVertex(screen, polygon[0]), projectVertex(screen, polygon[i]), projectVertex(screen, polygon[i + 1]) };
+		setupTriangle(screen, fan, primitiveIndex, triangles);
+	}
+}
+
+/**
+* Largest edge function value over pixel centers of a rectangle - the rectangle is outside of the edge when negative.
+*/
+static inline double maxEdgeValue(const RasterTriangle &triangle, int e, int x0, int y0, int x1, int y1)
+{
+	return triangle.edgeA[e] * double(triangle.edgeA[e] > 0.0f ? x1 : x0) + triangle.edgeB[e] * double(triangle.edgeB[e] > 0.0f ? y1 : y0) + triangle.edgeC[e];
+}
+
+static inline double minEdgeValue(const RasterTriangle &triangle, int e, int x0, int y0, int x1, int y1)
+{
+	return triangle.edgeA[e] * double(triangle.edgeA[e] > 0.0f ? x0 : x1) + triangle.edgeB[e] * double(triangle.edgeB[e] > 0.0f ? y0 : y1) + triangle.edgeC[e];
+}
+
+//--------------------------------------------------------------------------------------
+// Rasterization
+//--------------------------------------------------------------------------------------
+
+/**
+* Rasterize all triangles binned into a tile with the block kernel, then resolve reciprocal depths into primary ray T.
+*/
+static void rasterizeTile(const RasterizerContext &context, const Model &model, const RasterView &screen, int tile, int tilesX,
+	int tilesCount, Image &normalAndDepths, RasterizerStats &stats, void (*kernel)(const RasterBlock&, float*, uint32_t*))
+{
+	alignas(32) float invDepths[RASTER_TILE_SIZE * RASTER_TILE_SIZE];
+	uint32_t primitives[RASTER_TILE_SIZE * RASTER_TILE_SIZE];
+
+	std::fill(invDepths, invDepths + RASTER_TILE_SIZE * RASTER_TILE_SIZE, 0.0f);
+	std::fill(primitives, primitives + RASTER_TILE_SIZE * RASTER_TILE_SIZE, UINT32_MAX);
+
+	int tileX = (tile % tilesX) * RASTER_TILE_SIZE;
+	int tileY = (tile / tilesX) * RASTER_TILE_SIZE;
+
+	for (size_t chunk = 0; chunk < context.triangles.size(); chunk++) {
+		const vector<RasterTriangle> &triangles = context.triangles[chunk];
+
+		for (uint32_t index : context.bins[chunk * tilesCount + tile]) {
+			const RasterTriangle &triangle = triangles[index];
+
+			int blockX0 = (max(triangle.boundsMin[0], tileX) - tileX) / RASTER_BLOCK_SIZE;
+			int blockY0 = (max(triangle.boundsMin[1], tileY) - tileY) / RASTER_BLOCK_SIZE;
+			int blockX1 = (min(triangle.boundsMax[0], tileX + RASTER_TILE_SIZE - 1) - tileX) / RASTER_BLOCK_SIZE;
+			int blockY1 = (min(triangle.boundsMax[1], tileY + RASTER_TILE_SIZE - 1) - tileY) / RASTER_BLOCK_SIZE;
+
+			// Small triangles (most of them in dense meshes) are within their only block's bounds already and can't cover it
+			bool singleBlock = blockX0 == blockX1 && blockY0 == blockY1;
+
+			for (int blockY = blockY0; blockY <= blockY1; blockY++) {
+				for (int blockX = blockX0; blockX <= blockX1; blockX++) {
+					int x0 = tileX + blockX * RASTER_BLOCK_SIZE;
+					int y0 = tileY + blockY * RASTER_BLOCK_SIZE;
+					int x1 = x0 + RASTER_BLOCK_SIZE - 1;
+					int y1 = y0 + RASTER_BLOCK_SIZE - 1;
+
+					RasterBlock block;
+					block.covered = !singleBlock;
+
+					bool rejected = false;
+					for (int e = 0; e < 3; e++) {
+						if (!singleBlock) {
+							if (maxEdgeValue(triangle, e, x0, y0, x1, y1) < 0.0) { rejected = true; break; }
+							if (minEdgeValue(triangle, e, x0, y0, x1, y1) <= 0.0) block.covered = false;
+						}
+
+						block.edges[e] = (float)(triangle.edgeA[e] * double(x0) + triangle.edgeB[e] * double(y0) + triangle.edgeC[e]);
+						block.edgeA[e] = triangle.edgeA[e];
+						block.edgeB[e] = triangle.edgeB[e];
+					}
+
+					if (rejected) continue;
+
+					// Blocks may extend beyond the screen, the pixels there are never resolved
+					block.ownedEdges = triangle.ownedEdges;
+					block.invDepth = (float)(triangle.invDepthA * double(x0) + triangle.invDepthB * double(y0) + triangle.invDepthC);
+					block.invDepthA = triangle.invDepthA;
+					block.invDepthB = triangle.invDepthB;
+					block.primitiveIndex = triangle.primitiveIndex;
+					block.rowsBegin = max(triangle.boundsMin[1] - y0, 0);
+					block.rowsEnd = min(triangle.boundsMax[1] - y0 + 1, RASTER_BLOCK_SIZE);
+
+					size_t offset = size_t(blockY * RASTER_BLOCK_SIZE) * RASTER_TILE_SIZE + blockX * RASTER_BLOCK_SIZE;
+					kernel(block, &invDepths[offset], &primitives[offset]);
+
+					stats.blocksCount++;
+					if (block.covered) stats.coveredBlocksCount++;
+				}
+			}
+		}
+	}
+
+	// Primary ray T is view space depth scaled by length of the unnormalized ray direction
+	for (int y = tileY; y < min(tileY + RASTER_TILE_SIZE, (int)screen.height); y++) {
+		for (int x = tileX; x < min(tileX + RASTER_TILE_SIZE, (int)screen.width); x++) {
+			size_t offset = size_t(y - tileY) * RASTER_TILE_SIZE + (x - tileX);
+			uint32_t primitiveIndex = primitives[offset];
+
+			if (primitiveIndex == UINT32_MAX) {
+				normalAndDepths.At(x, y) = XMFLOAT4(-1.0f, -1.0f, -1.0f, -1.0f);
+				continue;
+			}
+
+			float dx = ((x + 0.5f) / screen.width) * 2.0f - 1.0f;
+			float dy = ((y + 0.5f) / screen.height) * 2.0f - 1.0f;
+			float directionLength = sqrtf(1.0f + dx * dx * screen.scaleX * screen.scaleX + dy * dy * screen.scaleY * screen.scaleY);
+
+			// Face normal as computed by GetVertexAttributes
+			const XMFLOAT3 &v0 = model.vertices[model.indices[primitiveIndex * 3 + 0]].position;
+			const XMFLOAT3 &v1 = model.vertices[model.indices[primitiveIndex * 3 + 1]].position;
+			const XMFLOAT3 &v2 = model.vertices[model.indices[primitiveIndex * 3 + 2]].position;
+			XMFLOAT3 normal = Cross(Normalize(Sub(v1, v2)), Normalize(Sub(v0, v2)));
+
+			normalAndDepths.At(x, y) = XMFLOAT4(normal.x, normal.y, normal.z, directionLength / invDepths[offset]);
+		}
+	}
+}
+
+void Rasterize_Normal_And_Depths(TaskScheduler &scheduler, const Model &model, const ViewCB &view, RasterizerContext &context,
+	Image &normalAndDepths, RasterizerStats* stats, SIMDLevel level)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	if (level == SIMD_LEVELS_COUNT) level = supportedLevel;
+	auto kernel = level >= SIMD_AVX2 ? Rasterize_Block_AVX2 : Rasterize_Block_Scalar;
+
+	auto start = std::chrono::steady_clock::now();
+
+	RasterView screen;
+	screen.width = view.resolution.x;
+	screen.height = view.resolution.y;
+	screen.scaleY = view.viewOriginAndTanHalfFovY.w;
+	screen.scaleX = screen.scaleY * (screen.width / screen.height);
+
+	int width = (int)screen.width;
+	int height = (int)screen.height;
+	normalAndDepths.Resize(width, height);
+
+	// Transform vertices to view space
+	XMFLOAT3 eye = XMFLOAT3(view.viewOriginAndTanHalfFovY.x, view.viewOriginAndTanHalfFovY.y, view.viewOriginAndTanHalfFovY.z);
+	XMFLOAT3 right, up, forward;
+	Get_View_Axes(view, right, up, forward);
+
+	context.viewPositions.resize(model.vertices.size());
+	context.vertices.resize(model.vertices.size());
+	scheduler.ParallelFor(model.vertices.size(), 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			XMFLOAT3 p = Sub(model.vertices[i].position, eye);
+			context.viewPositions[i] = XMFLOAT3(Dot(p, right), Dot(p, up), Dot(p, forward));
+			context.vertices[i] = projectVertex(screen, context.viewPositions[i]);
+		}
+	});
+
+	// Set up and bin triangles chunk by chunk, each chunk has its own bins so no synchronization is needed
+	int tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+	int tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+	int tilesCount = tilesX * tilesY;
+
+	size_t trianglesCount = model.indices.size() / 3;
+	size_t chunksCount = (trianglesCount + RASTER_CHUNK_SIZE - 1) / RASTER_CHUNK_SIZE;
+
+	context.triangles.resize(chunksCount);
+	context.bins.resize(chunksCount * tilesCount);
+
+	std::atomic<uint64_t> setupCount(0), referencesCount(0);
+
+	scheduler.ParallelFor(chunksCount, 1, [&](size_t begin, size_t end) {
+		for (size_t chunk = begin; chunk < end; chunk++) {
+			vector<RasterTriangle> &triangles = context.triangles[chunk];
+			triangles.clear();
+
+			for (size_t i = chunk * RASTER_CHUNK_SIZE; i < min(trianglesCount, (chunk + 1) * RASTER_CHUNK_SIZE); i++) {
+				uint32_t i0 = model.indices[i * 3 + 0], i1 = model.indices[i * 3 + 1], i2 = model.indices[i * 3 + 2];
+				const XMFLOAT3* positions = context.viewPositions.data();
+
+				if (positions[i0].z >= RASTER_NEAR_PLANE && positions[i1].z >= RASTER_NEAR_PLANE && positions[i2].z >= RASTER_NEAR_PLANE) {
+					RasterVertex vertices[3] = { context.vertices[i0], context.vertices[i1], context.vertices[i2] };
+					setupTriangle(screen, vertices, (uint32_t)i, triangles);
+				} else {
+					XMFLOAT3 clipped[3] = { positions[i0], positions[i1], positions[i2] };
+					clipAndSetupTriangle(screen, clipped, (uint32_t)i, triangles);
+				}
+			}
+
+			for (int tile = 0; tile < tilesCount; tile++)
+				context.bins[chunk * tilesCount + tile].clear();
+
+			uint64_t references = 0;
+			for (uint32_t index = 0; index < (uint32_t)triangles.size(); index++) {
+				const RasterTriangle &triangle = triangles[index];
+				int tileX0 = triangle.boundsMin[0] / RASTER_TILE_SIZE;
+				int tileY0 = triangle.boundsMin[1] / RASTER_TILE_SIZE;
+				int tileX1 = triangle.boundsMax[0] / RASTER_TILE_SIZE;
+				int tileY1 = triangle.boundsMax[1] / RASTER_TILE_SIZE;
+				bool singleTile = tileX0 == tileX1 && tileY0 == tileY1;
+
+				for (int tileY = tileY0; tileY <= tileY1; tileY++) {
+					for (int tileX = tileX0; tileX <= tileX1; tileX++) {
+						// Tiles the bounds overlap but the triangle misses
+						if (!singleTile) {
+							int x0 = tileX * RASTER_TILE_SIZE, y0 = tileY * RASTER_TILE_SIZE;
+							int x1 = x0 + RASTER_TILE_SIZE - 1, y1 = y0 + RASTER_TILE_SIZE - 1;
+							if (maxEdgeValue(triangle, 0, x0, y0, x1, y1) < 0.0 || maxEdgeValue(triangle, 1, x0, y0, x1, y1) < 0.0 ||
+								maxEdgeValue(triangle, 2, x0, y0, x1, y1) < 0.0) continue;
+						}
+
+						context.bins[chunk * tilesCount + tileY * tilesX + tileX].push_back(index);
+						references++;
+					}
+				}
+			}
+
+			setupCount += triangles.size();
+			referencesCount += references;
+		}
+	});
+
+	// Rasterize tiles
+	std::atomic<uint64_t> blocksCount(0), coveredBlocksCount(0);
+
+	scheduler.ParallelFor(size_t(tilesCount), 1, [&](size_t begin, size_t end) {
+		RasterizerStats tileStats;
+		for (size_t tile = begin; tile < end; tile++)
+			rasterizeTile(context, model, screen, (int)tile, tilesX, tilesCount, normalAndDepths, tileStats, kernel);
+
+		blocksCount += tileStats.blocksCount;
+		coveredBlocksCount += tileStats.coveredBlocksCount;
+	});
+
+	if (stats) {
+		stats->time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->trianglesCount = setupCount;
+		stats->tileReferences = referencesCount;
+		stats->blocksCount = blocksCount;
+		stats->coveredBlocksCount = coveredBlocksCount;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Scalar Block Kernel
+//--------------------------------------------------------------------------------------
+
+void Rasterize_Block_Scalar(const RasterBlock &block, float* invDepths, uint32_t* primitives)
+{
+	for (int y = block.rowsBegin; y < block.rowsEnd; y++) {
+		for (int x = 0; x < RASTER_BLOCK_SIZE; x++) {
+			bool inside = true;
+
+			if (!block.covered) {
+				for (int e = 0; e < 3; e++) {
+					float edge = (block.edges[e] + block.edgeB[e] * y) + block.edgeA[e] * x;
+					inside &= edge > 0.0f || (edge == 0.0f && (block.ownedEdges & (1 << e)));
+				}
+			}
+
+			float invDepth = (block.invDepth + block.invDepthB * y) + block.invDepthA * x;
+			float &depth = invDepths[y * RASTER_TILE_SIZE + x];
+
+			if (inside && invDepth > depth) {
+				depth = invDepth;
+				primitives[y * RASTER_TILE_SIZE + x] = block.primitiveIndex;
+			}
+		}
+	}
+}
+
+}
@@ -0,0 +1,50 @@
+// RTAO - Rasterizer block kernel, written with AVX2 and FMA intrinsics
+#include "Rasterizer.h"
+
+#include <immintrin.h>
+
+namespace CPURT
+{
+
+/**
+* Rows of the block are evaluated 8 pixels at a time, edge and depth values are stepped the same way as in the scalar kernel.
+*/
+void Rasterize_Block_AVX2(const RasterBlock &block, float* invDepths, uint32_t* primitives)
+{
+	const __m256 offsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256i primitive = _mm256_set1_epi32((int)block.primitiveIndex);
+
+	__m256 edgeStepX[3], ownedMask[3];
+	for (int e = 0; e < 3; e++) {
+		edgeStepX[e] = _mm256_mul_ps(_mm256_set1_ps(block.edgeA[e]), offsets);
+		ownedMask[e] = (block.ownedEdges & (1 << e)) ? _mm256_castsi256_ps(_mm256_set1_epi32(-1)) : zero;
+	}
+
+	const __m256 invDepthStepX = _mm256_mul_ps(_mm256_set1_ps(block.invDepthA), offsets);
+
+	for (int y = block.rowsBegin; y < block.rowsEnd; y++) {
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		if (!block.covered) {
+			for (int e = 0; e < 3; e++) {
+				__m256 edge = _mm256_add_ps(_mm256_set1_ps(block.edges[e] + block.edgeB[e] * y), edgeStepX[e]);
+				__m256 onEdge = _mm256_and_ps(_mm256_cmp_ps(edge, zero, _CMP_EQ_OQ), ownedMask[e]);
+				inside = _mm256_and_ps(inside, _mm256_or_ps(_mm256_cmp_ps(edge, zero, _CMP_GT_OQ), onEdge));
+			}
+		}
+
+		__m256 invDepth = _mm256_add_ps(_mm256_set1_ps(block.invDepth + block.invDepthB * y), invDepthStepX);
+		__m256 depth = _mm256_load_ps(&invDepths[y * RASTER_TILE_SIZE]);
+		__m256 mask = _mm256_and_ps(inside, _mm256_cmp_ps(invDepth, depth, _CMP_GT_OQ));
+
+		if (_mm256_testz_ps(mask, mask)) continue;
+
+		_mm256_store_ps(&invDepths[y * RASTER_TILE_SIZE], _mm256_blendv_ps(depth, invDepth, mask));
+
+		__m256i* row = (__m256i*)&primitives[y * RASTER_TILE_SIZE];
+		_mm256_storeu_si256(row, _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(_mm256_loadu_si256(row)), _mm256_castsi256_ps(primitive), mask)));
+	}
+}
+
+}
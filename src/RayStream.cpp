@@ -0,0 +1,224 @@
+// RTAO - Ray stream traversal of coherent AO ray batches
+#include "RayStream.h"
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Binning
+//--------------------------------------------------------------------------------------
+
+static inline uint32_t directionOctant(const XMFLOAT3 &direction)
+{
+	return (direction.x < 0.0f ? 1 : 0) | (direction.y < 0.0f ? 2 : 0) | (direction.z < 0.0f ? 4 : 0);
+}
+
+static inline uint32_t originCellHash(const XMFLOAT3 &origin, float cellSize)
+{
+	int x = (int)floorf(origin.x / cellSize);
+	int y = (int)floorf(origin.y / cellSize);
+	int z = (int)floorf(origin.z / cellSize);
+	return (uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^ (uint32_t(z) * 83492791u);
+}
+
+/**
+* Group rays by direction octant and origin cell (as selected by binning), bins larger than maxStreamSize are split.
+*/
+void Bin_Ray_Streams(const RayStreamInfo &info, const Ray* rays, size_t count, vector<uint32_t> &order, vector<pair<uint32_t, uint32_t>> &streams)
+{
+	vector<uint32_t> keys(count);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t key = 0;
+		if (info.binning != RAY_STREAM_BINNING_NONE) key = directionOctant(rays[i].direction) << 24;
+		if (info.binning == RAY_STREAM_BINNING_OCTANT_AND_CELL) key |= originCellHash(rays[i].origin, info.originCellSize) & 0xFFFFFF;
+		keys[i] = key;
+	}
+
+	order.resize(count);
+	for (size_t i = 0; i < count; i++) order[i] = (uint32_t)i;
+
+	// Stable, so that rays within a bin stay in tile order
+	std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+	uint32_t maxStreamSize = (uint32_t)min(max(info.maxStreamSize, 1), RAY_STREAM_MAX_SIZE);
+
+	streams.clear();
+	uint32_t begin = 0;
+	for (uint32_t i = 1; i <= (uint32_t)count; i++) {
+		if (i == count || keys[order[i]] != keys[order[begin]] || i - begin == maxStreamSize) {
+			streams.push_back(make_pair(begin, i));
+			begin = i;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Traversal
+//--------------------------------------------------------------------------------------
+
+struct RayStreamStackEntry
+{
+	uint32_t child;
+	uint32_t count;
+	uint32_t listOffset;		//< Active rays of the entry in context.activeLists
+	uint32_t listSize;
+};
+
+/**
+* Depth-first traversal of the whole stream: every visited node is tested against all its active rays at once and
+* each intersected child gets a compacted list of the rays that hit it. Lists of nodes waiting on the stack are kept
+* in a stack of their own - the list of a popped node is always the last one.
+*/
+static void traceStream(RayStreamContext &context, const BVH8 &bvh, const Ray* rays, const uint32_t* indices, uint32_t count, bool anyHit, float* t, RayStreamStats &stats, SIMDLevel level)
+{
+	RayStreamRays &streamRays = context.rays;
+	RayStreamChildren &children = context.children;
+	vector<uint16_t> &lists = context.activeLists;
+
+	auto testNode = level >= SIMD_AVX2 ? Test_Stream_Node_AVX2 : Test_Stream_Node_Scalar;
+
+	for (uint32_t i = 0; i < count; i++) {
+		const Ray &ray = rays[indices[i]];
+		XMFLOAT3 invDirection = SafeInverse(ray.direction);
+		streamRays.inverseDirection[0][i] = invDirection.x;
+		streamRays.inverseDirection[1][i] = invDirection.y;
+		streamRays.inverseDirection[2][i] = invDirection.z;
+		streamRays.originScaled[0][i] = ray.origin.x * invDirection.x;
+		streamRays.originScaled[1][i] = ray.origin.y * invDirection.y;
+		streamRays.originScaled[2][i] = ray.origin.z * invDirection.z;
+		streamRays.tMin[i] = ray.tMin;
+		streamRays.tMax[i] = ray.tMax;
+		context.terminated[i] = 0;
+	}
+
+	stats.raysCount += count;
+	stats.streamsCount++;
+
+	if (lists.size() < RAY_STREAM_MAX_SIZE * BVH8_WIDTH) lists.resize(RAY_STREAM_MAX_SIZE * BVH8_WIDTH);
+	for (uint32_t i = 0; i < count; i++) lists[i] = (uint16_t)i;
+
+	RayStreamStackEntry stack[BVH8_STACK_SIZE];
+	int stackSize = 0;
+	RayStreamStackEntry entry = { 0, 0, 0, count };
+
+	while (!bvh.nodes.empty()) {
+		uint16_t* active = &lists[entry.listOffset];
+
+		// Drop rays that already found their hit
+		if (anyHit) {
+			uint32_t activeCount = 0;
+			for (uint32_t i = 0; i < entry.listSize; i++) {
+				if (!context.terminated[active[i]]) active[activeCount++] = active[i];
+			}
+			entry.listSize = activeCount;
+		}
+
+		bool descended = false;
+
+		if (entry.listSize > 0) {
+			stats.nodeVisits++;
+			stats.activeRays += entry.listSize;
+
+			if (entry.child & BVH8_LEAF_FLAG) {
+				for (uint32_t i = 0; i < entry.listSize; i++) {
+					uint32_t r = active[i];
+					Hit hit;
+					if (IntersectLeaf(bvh, entry.child & ~BVH8_LEAF_FLAG, entry.count, rays[indices[r]], streamRays.tMax[r], hit, anyHit) && anyHit)
+						context.terminated[r] = 1;
+				}
+			} else {
+				testNode(bvh.nodes[entry.child], streamRays, active, (int)entry.listSize, children);
+
+				const BVH8Node &node = bvh.nodes[entry.child];
+				int order[BVH8_WIDTH];
+				int hitsCount = 0;
+				uint32_t listsSize = 0;
+
+				for (int c = 0; c < BVH8_WIDTH; c++) {
+					if (children.counts[c] == 0) continue;
+					order[hitsCount++] = c;
+					listsSize += children.counts[c];
+				}
+
+				if (hitsCount > 0) {
+					// Farthest children are pushed first, the nearest one is visited next (insertion sort, as PushChildren)
+					for (int i = 1; i < hitsCount; i++) {
+						int c = order[i];
+						int j = i - 1;
+						while (j >= 0 && children.distances[order[j]] < children.distances[c]) {
+							order[j + 1] = order[j];
+							j--;
+						}
+						order[j + 1] = c;
+					}
+
+					uint32_t offset = entry.listOffset + entry.listSize;
+					if (lists.size() < offset + listsSize) lists.resize((offset + listsSize) * 2);
+
+					for (int h = 0; h < hitsCount; h++) {
+						int c = order[h];
+						memcpy(&lists[offset], children.rays[c], children.counts[c] * sizeof(uint16_t));
+
+						RayStreamStackEntry childEntry = { node.children[c], node.counts[c], offset, (uint32_t)children.counts[c] };
+						offset += children.counts[c];
+
+						if (h < hitsCount - 1) stack[stackSize++] = childEntry;
+						else entry = childEntry;
+					}
+
+					descended = true;
+				}
+			}
+		}
+
+		if (!descended) {
+			if (stackSize == 0) break;
+			entry = stack[--stackSize];
+		}
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+		t[indices[i]] = streamRays.tMax[i];
+}
+
+void Trace_Ray_Stream(RayStreamContext &context, const BVH8 &bvh, const Ray* rays, const uint32_t* indices, size_t count, bool anyHit, float* t, RayStreamStats &stats, SIMDLevel level)
+{
+	static const SIMDLevel supportedLevel = Get_Supported_SIMD_Level();
+	if (level == SIMD_LEVELS_COUNT) level = supportedLevel;
+
+	for (size_t first = 0; first < count; first += RAY_STREAM_MAX_SIZE)
+		traceStream(context, bvh, rays, indices + first, (uint32_t)min(count - first, size_t(RAY_STREAM_MAX_SIZE)), anyHit, t, stats, level);
+}
+
+//--------------------------------------------------------------------------------------
+// Scalar Node Kernel
+//--------------------------------------------------------------------------------------
+
+void Test_Stream_Node_Scalar(const BVH8Node &node, const RayStreamRays &rays, const uint16_t* active, int activeCount, RayStreamChildren &children)
+{
+	for (int c = 0; c < BVH8_WIDTH; c++) {
+		children.counts[c] = 0;
+		children.distances[c] = FLT_MAX;
+		if (node.children[c] == BVH8_EMPTY_CHILD) continue;
+
+		for (int i = 0; i < activeCount; i++) {
+			int r = active[i];
+			float tNear = rays.tMin[r];
+			float tFar = rays.tMax[r];
+
+			for (int axis = 0; axis < 3; axis++) {
+				float t1 = node.boundsMin[axis][c] * rays.inverseDirection[axis][r] - rays.originScaled[axis][r];
+				float t2 = node.boundsMax[axis][c] * rays.inverseDirection[axis][r] - rays.originScaled[axis][r];
+				tNear = max(tNear, min(t1, t2));
+				tFar = min(tFar, max(t1, t2));
+			}
+
+			if (tNear <= tFar) {
+				children.rays[c][children.counts[c]++] = (uint16_t)r;
+				children.distances[c] = min(children.distances[c], tNear);
+			}
+		}
+	}
+}
+
+}
@@ -0,0 +1,96 @@
+// RTAO - Ray stream node kernel, written with AVX2 and FMA intrinsics
+#include "RayStream.h"
+
+#include <immintrin.h>
+
+namespace CPURT
+{
+
+/**
+* Active rays are gathered into contiguous SoA arrays once per node, then every child is tested against 8 rays at a time.
+*/
+void Test_Stream_Node_AVX2(const BVH8Node &node, const RayStreamRays &rays, const uint16_t* active, int activeCount, RayStreamChildren &children)
+{
+	alignas(32) float originScaled[3][RAY_STREAM_MAX_SIZE];
+	alignas(32) float inverseDirection[3][RAY_STREAM_MAX_SIZE];
+	alignas(32) float tMin[RAY_STREAM_MAX_SIZE];
+	alignas(32) float tMax[RAY_STREAM_MAX_SIZE];
+
+	int paddedCount = (activeCount + 7) & ~7;
+
+	for (int i = 0; i < activeCount; i++) {
+		int r = active[i];
+		for (int axis = 0; axis < 3; axis++) {
+			originScaled[axis][i] = rays.originScaled[axis][r];
+			inverseDirection[axis][i] = rays.inverseDirection[axis][r];
+		}
+		tMin[i] = rays.tMin[r];
+		tMax[i] = rays.tMax[r];
+	}
+
+	// Padding lanes have an empty [tMin, tMax] interval and never hit
+	for (int i = activeCount; i < paddedCount; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			originScaled[axis][i] = 0.0f;
+			inverseDirection[axis][i] = 1.0f;
+		}
+		tMin[i] = 1.0f;
+		tMax[i] = 0.0f;
+	}
+
+	const __m256 infinity = _mm256_set1_ps(FLT_MAX);
+
+	for (int c = 0; c < BVH8_WIDTH; c++) {
+		children.counts[c] = 0;
+		children.distances[c] = FLT_MAX;
+		if (node.children[c] == BVH8_EMPTY_CHILD) continue;
+
+		__m256 boundsMin[3], boundsMax[3];
+		for (int axis = 0; axis < 3; axis++) {
+			boundsMin[axis] = _mm256_set1_ps(node.boundsMin[axis][c]);
+			boundsMax[axis] = _mm256_set1_ps(node.boundsMax[axis][c]);
+		}
+
+		__m256 nearest = infinity;
+		uint16_t* childRays = children.rays[c];
+		int childCount = 0;
+
+		for (int i = 0; i < paddedCount; i += 8) {
+			__m256 tNear = _mm256_load_ps(&tMin[i]);
+			__m256 tFar = _mm256_load_ps(&tMax[i]);
+
+			for (int axis = 0; axis < 3; axis++) {
+				__m256 inverse = _mm256_load_ps(&inverseDirection[axis][i]);
+				__m256 origin = _mm256_load_ps(&originScaled[axis][i]);
+				__m256 t1 = _mm256_fmsub_ps(boundsMin[axis], inverse, origin);
+				__m256 t2 = _mm256_fmsub_ps(boundsMax[axis], inverse, origin);
+				tNear = _mm256_max_ps(tNear, _mm256_min_ps(t1, t2));
+				tFar = _mm256_min_ps(tFar, _mm256_max_ps(t1, t2));
+			}
+
+			__m256 hitMask = _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ);
+			int mask = _mm256_movemask_ps(hitMask);
+			if (mask == 0) continue;
+
+			nearest = _mm256_min_ps(nearest, _mm256_blendv_ps(infinity, tNear, hitMask));
+
+			while (mask) {
+				int lane = _tzcnt_u32(mask);
+				mask &= mask - 1;
+				childRays[childCount++] = active[i + lane];
+			}
+		}
+
+		if (childCount == 0) continue;
+
+		// Horizontal minimum
+		__m128 m = _mm_min_ps(_mm256_castps256_ps128(nearest), _mm256_extractf128_ps(nearest, 1));
+		m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+		m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+
+		children.counts[c] = childCount;
+		children.distances[c] = _mm_cvtss_f32(m);
+	}
+}
+
+}
@@ -0,0 +1,179 @@
+// RTAO - Sample sets for interleaved AO sampling
+#include "SampleSets.h"
+
+#include "Samples.h"
+
+namespace SampleSets
+{
+
+/**
+* Map a point from unit square to a cosine-weighted direction on the hemisphere around +Z (Shirley-Chiu concentric mapping).
+*/
+XMFLOAT3 Square_To_Cosine_Hemisphere(float u, float v)
+{
+	float a = 2.0f * u - 1.0f;
+	float b = 2.0f * v - 1.0f;
+
+	float r, phi;
+	if (a == 0.0f && b == 0.0f) {
+		r = 0.0f;
+		phi = 0.0f;
+	} else if (a * a > b * b) {
+		r = a;
+		phi = (XM_PI / 4.0f) * (b / a);
+	} else {
+		r = b;
+		phi = (XM_PI / 2.0f) - (XM_PI / 4.0f) * (a / b);
+	}
+
+	float x = r * cosf(phi);
+	float y = r * sinf(phi);
+
+	return XMFLOAT3(x, y, sqrtf(max(0.0f, 1.0f - x * x - y * y)));
+}
+
+/**
+* Get number of samples needed for given interleaving configuration.
+*/
+int Get_Table_Size(const SampleSetInfo &info)
+{
+	return info.interleaveWidth * info.interleaveHeight * info.framesCount * info.samplesCount;
+}
+
+/**
+* Build the AO samples table for given interleaving configuration.
+* Samples are laid out as [frame][pixel within interleave block][sample], which is the order RTAORayGen reads them in.
+*/
+void Build_Table(const SampleSetInfo &info, vector<XMFLOAT3> &samples)
+{
+	int tableSize = Get_Table_Size(info);
+	samples.resize(tableSize);
+
+	// Default configuration (3x3 block, 4 frames, up to 4 rays) uses the pre-calculated sample sets
+	if (info.interleaveWidth == 3 && info.interleaveHeight == 3 && info.framesCount == 4 && info.samplesCount <= 4) {
+
+		// Baked table stores sets for 1, 2, 3 and 4 rays one after another (36, 72, 108 and 144 samples)
+		int bakedStartIndex = 0;
+		for (int i = 1; i < info.samplesCount; i++) bakedStartIndex += 36 * i;
+
+		memcpy(samples.data(), &aoSamples[bakedStartIndex], tableSize * sizeof(XMFLOAT3));
+		return;
+	}
+
+	// Otherwise generate the set from the R2 low-discrepancy sequence. Any prefix of it is well distributed,
+	// so samples of every frame (and of every pixel within that frame) are stratified over the hemisphere.
+	Generate_R2(tableSize, samples);
+}
+
+/**
+* Generate cosine-weighted hemisphere samples from the R2 low-discrepancy sequence.
+*/
+void Generate_R2(int count, vector<XMFLOAT3> &samples)
+{
+	const double g = 1.32471795724474602596;
+	const double alphaX = 1.0 / g;
+	const double alphaY = 1.0 / (g * g);
+
+	samples.resize(count);
+
+	for (int i = 0; i < count; i++) {
+		double u = fmod(0.5 + alphaX * double(i + 1), 1.0);
+		double v = fmod(0.5 + alphaY * double(i + 1), 1.0);
+
+		samples[i] = Square_To_Cosine_Hemisphere(float(u), float(v));
+	}
+}
+
+/**
+* Generate independent random cosine-weighted hemisphere samples (baseline for comparisons).
+*/
+void Generate_Random(int count, uint32_t seed, vector<XMFLOAT3> &samples)
+{
+	samples.resize(count);
+
+	// PCG32 random number generator
+	uint64_t state = uint64_t(seed) * 6364136223846793005ull + 1442695040888963407ull;
+	auto nextFloat = [&state]() {
+		uint64_t oldState = state;
+		state = oldState * 6364136223846793005ull + 1442695040888963407ull;
+		uint32_t xorShifted = uint32_t(((oldState >> 18u) ^ oldState) >> 27u);
+		uint32_t rot = uint32_t(oldState >> 59u);
+		uint32_t value = (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+		return float(value >> 8) * (1.0f / 16777216.0f);
+	};
+
+	for (int i = 0; i < count; i++) {
+		float u = nextFloat();
+		float v = nextFloat();
+		samples[i] = Square_To_Cosine_Hemisphere(u, v);
+	}
+}
+
+/**
+* Load a sample set from a text file, one direction (x y z, in tangent space with +Z along the normal) per line.
+* Values may be separated by spaces or commas, lines starting with '#' are ignored.
+*/
+void Load_Sample_Set(const string &filepath, vector<XMFLOAT3> &samples)
+{
+	ifstream file(filepath);
+
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Error: failed to open sample set file!");
+	}
+
+	samples.clear();
+
+	string line;
+	while (getline(file, line))
+	{
+		if (line.empty() || line[0] == '#') continue;
+		replace(line.begin(), line.end(), ',', ' ');
+
+		XMFLOAT3 sample;
+		if (sscanf(line.c_str(), "%f %f %f", &sample.x, &sample.y, &sample.z) != 3) continue;
+
+		float length = sqrtf(sample.x * sample.x + sample.y * sample.y + sample.z * sample.z);
+		if (length <= 0.0f) continue;
+
+		samples.push_back(XMFLOAT3(sample.x / length, sample.y / length, sample.z / length));
+	}
+}
+
+/**
+* Compute L2-star discrepancy (Warnock's formula) of every prefix of the sample set.
+* Directions are mapped back to the unit square by inverting the cosine-weighted mapping (u = sin^2(theta), v = phi / 2PI),
+* so a perfectly cosine-distributed set has zero discrepancy.
+*/
+void Compute_Discrepancy(const vector<XMFLOAT3> &samples, vector<double> &discrepancy)
+{
+	size_t count = samples.size();
+
+	vector<double> u(count), v(count);
+	for (size_t i = 0; i < count; i++) {
+		const XMFLOAT3 &s = samples[i];
+		u[i] = min(1.0, max(0.0, double(s.x) * s.x + double(s.y) * s.y));
+		v[i] = (atan2(double(s.y), double(s.x)) + XM_PI) / (2.0 * XM_PI);
+		v[i] = min(1.0, max(0.0, v[i]));
+	}
+
+	// Accumulate both sums of Warnock's formula incrementally, so all prefixes are evaluated in O(N^2)
+	double singleSum = 0.0;
+	double pairSum = 0.0;
+
+	discrepancy.resize(count);
+
+	for (size_t i = 0; i < count; i++) {
+		singleSum += (1.0 - u[i] * u[i]) * (1.0 - v[i] * v[i]);
+
+		for (size_t j = 0; j < i; j++)
+			pairSum += 2.0 * (1.0 - max(u[i], u[j])) * (1.0 - max(v[i], v[j]));
+		pairSum += (1.0 - u[i]) * (1.0 - v[i]);
+
+		double n = double(i + 1);
+		double squared = (1.0 / 9.0) - (singleSum / (2.0 * n)) + (pairSum / (n * n));
+		discrepancy[i] = sqrt(max(0.0, squared));
+	}
+}
+
+}
@@ -0,0 +1,583 @@
+// RTAO - Task scheduler for CPU passes
+#include "TaskScheduler.h"
+
+// Scheduler and index of the thread, set for the thread that called Init and for the workers
+static thread_local TaskScheduler* currentScheduler = nullptr;
+static thread_local int currentThreadIndex = -1;
+
+// Tasks executed from within other tasks (while waiting) are not counted into busy time twice
+static thread_local int executeDepth = 0;
+
+static const int64_t initialDequeCapacity = 256;
+static const int idleRoundsBeforeSleep = 64;
+
+static int countProcessors(uint64_t processorsMask)
+{
+	int count = 0;
+	for (uint64_t mask = processorsMask; mask; mask &= mask - 1) count++;
+	return count;
+}
+
+/**
+* Restrict the calling thread to the processors, the previous affinity is returned when requested.
+*/
+static bool pinThread(uint16_t group, uint64_t processorsMask, GROUP_AFFINITY* previous = nullptr)
+{
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = group;
+	affinity.Mask = KAFFINITY(processorsMask);
+
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, previous) != FALSE;
+}
+
+//--------------------------------------------------------------------------------------
+// Chase-Lev deque
+//--------------------------------------------------------------------------------------
+
+TaskScheduler::TaskDeque::TaskDeque()
+{
+	top = 0;
+	bottom = 0;
+	buffer = createBuffer(initialDequeCapacity);
+}
+
+TaskScheduler::TaskDeque::~TaskDeque()
+{
+	for (Buffer* retired : buffers) {
+		delete[] retired->tasks;
+		delete retired;
+	}
+}
+
+TaskScheduler::TaskDeque::Buffer* TaskScheduler::TaskDeque::createBuffer(int64_t capacity)
+{
+	Buffer* created = new Buffer();
+	created->capacity = capacity;
+	created->tasks = new std::atomic<Task*>[size_t(capacity)];
+	buffers.push_back(created);
+	return created;
+}
+
+/**
+* Owner only. Grows the buffer when full, the old one stays valid for thieves that already loaded it.
+*/
+void TaskScheduler::TaskDeque::Push(Task* task)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	Buffer* current = buffer.load(std::memory_order_relaxed);
+
+	if (b - t > current->capacity - 1) {
+		Buffer* grown = createBuffer(current->capacity * 2);
+		for (int64_t i = t; i < b; i++) grown->Put(i, current->Get(i));
+		buffer.store(grown, std::memory_order_release);
+		current = grown;
+	}
+
+	// Release publishes the task to thieves that acquire bottom
+	current->Put(b, task);
+	bottom.store(b + 1, std::memory_order_release);
+}
+
+/**
+* Owner only. Takes the newest task, races with thieves for the last one.
+*/
+TaskScheduler::Task* TaskScheduler::TaskDeque::Pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	Buffer* current = buffer.load(std::memory_order_relaxed);
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Task* task = current->Get(b);
+
+	if (t == b) {
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) task = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	return task;
+}
+
+/**
+* Any thread. Takes the oldest task, returns nullptr when the deque is empty or another thread won the race.
+*/
+TaskScheduler::Task* TaskScheduler::TaskDeque::Steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b) return nullptr;
+
+	Buffer* current = buffer.load(std::memory_order_acquire);
+	Task* task = current->Get(t);
+
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+
+	return task;
+}
+
+//--------------------------------------------------------------------------------------
+// Scheduler
+//--------------------------------------------------------------------------------------
+
+TaskScheduler::TaskScheduler()
+{
+	queuedTasks = 0;
+	sleepingCount = 0;
+	injectedCount = 0;
+	quit = false;
+	pinned = false;
+	initGroup = 0;
+	initProcessorsMask = 0;
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	Destroy();
+}
+
+/**
+* Processors of every node come from GetNumaNodeProcessorMaskEx, which reports those of a single processor group (up to 64).
+*/
+void TaskScheduler::GetNumaNodes(vector<NumaNodeInfo> &numaNodes)
+{
+	numaNodes.clear();
+
+	ULONG highestNode = 0;
+	if (GetNumaHighestNodeNumber(&highestNode)) {
+		for (ULONG node = 0; node <= highestNode; node++) {
+			GROUP_AFFINITY affinity = {};
+			if (!GetNumaNodeProcessorMaskEx(USHORT(node), &affinity) || affinity.Mask == 0) continue;
+
+			NumaNodeInfo info;
+			info.node = int(node);
+			info.group = affinity.Group;
+			info.processorsMask = uint64_t(affinity.Mask);
+			info.processorsCount = countProcessors(info.processorsMask);
+			numaNodes.push_back(info);
+		}
+	}
+
+	if (numaNodes.empty()) {
+		NumaNodeInfo info;
+		info.processorsCount = max(1, (int)std::thread::hardware_concurrency());
+		info.processorsMask = (info.processorsCount >= 64) ? ~0ull : (1ull << info.processorsCount) - 1;
+		numaNodes.push_back(info);
+	}
+}
+
+/**
+* Start worker threads. Calling thread counts as one of the threads (it executes tasks while waiting).
+*/
+void TaskScheduler::Init(int threadsCount, int numaNodesCount)
+{
+	vector<NumaNodeInfo> numaNodes;
+	pinned = numaNodesCount > 0;
+
+	if (pinned) {
+		GetNumaNodes(numaNodes);
+		numaNodes.resize(min((int)numaNodes.size(), numaNodesCount));
+
+		if (threadsCount <= 0) {
+			threadsCount = 0;
+			for (const NumaNodeInfo &info : numaNodes) threadsCount += info.processorsCount;
+		}
+
+		// Every node needs a thread of its own to execute its queue
+		if ((int)numaNodes.size() > threadsCount) numaNodes.resize(threadsCount);
+	} else {
+		if (threadsCount <= 0) threadsCount = max(1, (int)std::thread::hardware_concurrency());
+		numaNodes.push_back(NumaNodeInfo());
+	}
+
+	quit = false;
+	queuedTasks = 0;
+	sleepingCount = 0;
+
+	for (const NumaNodeInfo &info : numaNodes) {
+		NodeState* node = new NodeState();
+		node->info = info;
+		node->tasksCount = 0;
+		nodes.push_back(node);
+	}
+
+	for (int i = 0; i < threadsCount; i++) {
+		ThreadState* state = new ThreadState();
+		state->random = 2654435761u * uint32_t(i + 1);
+		state->busyTime = 0;
+		state->tasksCount = 0;
+		state->stealsCount = 0;
+		state->remoteStealsCount = 0;
+		state->node = int(size_t(i) * nodes.size() / threadsCount);
+		nodes[state->node]->threads.push_back(i);
+		threads.push_back(state);
+	}
+
+	currentScheduler = this;
+	currentThreadIndex = 0;
+
+	if (pinned) {
+		GROUP_AFFINITY previous = {};
+		if (!pinThread(nodes[0]->info.group, nodes[0]->info.processorsMask, &previous))
+		{
+			throw std::runtime_error("Error: failed to pin the scheduler's thread to its NUMA node!");
+		}
+		initGroup = previous.Group;
+		initProcessorsMask = uint64_t(previous.Mask);
+	}
+
+	for (int i = 1; i < threadsCount; i++)
+		workers.push_back(std::thread(&TaskScheduler::workerLoop, this, i));
+
+	ResetStats();
+}
+
+void TaskScheduler::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		quit = true;
+	}
+	sleepCondition.notify_all();
+
+	for (std::thread &worker : workers) worker.join();
+	workers.clear();
+
+	for (ThreadState* state : threads) delete state;
+	threads.clear();
+
+	for (NodeState* node : nodes) delete node;
+	nodes.clear();
+
+	if (currentScheduler == this) {
+		if (pinned) pinThread(initGroup, initProcessorsMask);
+
+		currentScheduler = nullptr;
+		currentThreadIndex = -1;
+	}
+
+	pinned = false;
+}
+
+int TaskScheduler::GetCurrentNode() const
+{
+	return (currentScheduler == this) ? threads[currentThreadIndex]->node : 0;
+}
+
+void TaskScheduler::Run(TaskGroup &group, const function<void()> &task)
+{
+	group.pendingTasks++;
+
+	// Counted before the task becomes visible, so a worker never goes to sleep while it is queued
+	queuedTasks++;
+
+	Task* queued = new Task{ task, &group };
+
+	if (currentScheduler == this) {
+		threads[currentThreadIndex]->deque.Push(queued);
+	} else {
+		std::lock_guard<std::mutex> lock(injectedMutex);
+		injectedTasks.push_back(queued);
+		injectedCount++;
+	}
+
+	if (sleepingCount > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		sleepCondition.notify_one();
+	}
+}
+
+void TaskScheduler::RunOnNode(TaskGroup &group, int node, const function<void()> &task)
+{
+	group.pendingTasks++;
+	queuedTasks++;
+
+	Task* queued = new Task{ task, &group };
+
+	{
+		NodeState* state = nodes[node];
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->tasks.push_back(queued);
+		state->tasksCount++;
+	}
+
+	// Sleeping workers may belong to other nodes, so all of them are woken up
+	if (sleepingCount > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		sleepCondition.notify_all();
+	}
+}
+
+void TaskScheduler::RunOnEachNode(const function<void(int)> &task)
+{
+	TaskGroup group;
+
+	for (int node = 0; node < GetNodesCount(); node++)
+		RunOnNode(group, node, [&task, node]() { task(node); });
+
+	Wait(group);
+}
+
+void TaskScheduler::Wait(TaskGroup &group)
+{
+	int threadIndex = (currentScheduler == this) ? currentThreadIndex : -1;
+
+	while (group.pendingTasks > 0) {
+		Task* task = findTask(threadIndex);
+		if (task) {
+			execute(task, threadIndex);
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void TaskScheduler::ParallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)> &body)
+{
+	if (count == 0) return;
+
+	int threadIndex = (currentScheduler == this) ? currentThreadIndex : -1;
+
+	// Small chunks balance uneven work (stealing keeps their overhead low), but never go below the grain size
+	size_t chunkSize = max(max(grainSize, size_t(1)), count / (size_t(GetThreadsCount()) * 16));
+
+	if (chunkSize >= count) {
+		measure(threadIndex, [&]() { body(0, count); });
+		return;
+	}
+
+	TaskGroup group;
+
+	// Spawn the upper half and keep splitting the lower one, thieves take the biggest halves from the top of the deque
+	function<void(size_t, size_t)> split = [&](size_t begin, size_t end) {
+		while (end - begin > chunkSize) {
+			size_t middle = begin + (end - begin) / 2;
+			Run(group, [&split, middle, end]() { split(middle, end); });
+			end = middle;
+		}
+
+		body(begin, end);
+	};
+
+	measure(threadIndex, [&]() { split(0, count); });
+
+	Wait(group);
+}
+
+void TaskScheduler::ParallelForTiles(int width, int height, int tileSize, const function<void(int, int, int, int)> &body)
+{
+	int tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (height + tileSize - 1) / tileSize;
+
+	auto tiles = [&](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; tile++) {
+			int x0 = int(tile % tilesX) * tileSize;
+			int y0 = int(tile / tilesX) * tileSize;
+			body(x0, y0, min(x0 + tileSize, width), min(y0 + tileSize, height));
+		}
+	};
+
+	if (nodes.size() <= 1) {
+		ParallelFor(size_t(tilesX) * tilesY, 1, tiles);
+		return;
+	}
+
+	// Adjacent rows share most of the geometry they see, so every node works on a contiguous band
+	TaskGroup group;
+	int rowsBegin = 0;
+	int threadsBegin = 0;
+
+	for (int node = 0; node < GetNodesCount(); node++) {
+		threadsBegin += (int)nodes[node]->threads.size();
+		int rowsEnd = int(int64_t(tilesY) * threadsBegin / GetThreadsCount());
+
+		if (rowsEnd > rowsBegin) {
+			size_t firstTile = size_t(rowsBegin) * tilesX;
+			size_t tilesCount = size_t(rowsEnd - rowsBegin) * tilesX;
+
+			RunOnNode(group, node, [this, &tiles, firstTile, tilesCount]() {
+				ParallelFor(tilesCount, 1, [&tiles, firstTile](size_t begin, size_t end) { tiles(firstTile + begin, firstTile + end); });
+			});
+		}
+
+		rowsBegin = rowsEnd;
+	}
+
+	Wait(group);
+}
+
+void TaskScheduler::GetStats(vector<TaskThreadStats> &stats) const
+{
+	double wallTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - statsStart).count();
+
+	stats.resize(threads.size());
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		stats[i].busyTime = threads[i]->busyTime.load(std::memory_order_relaxed) * 1e-6;
+		stats[i].utilization = (wallTime > 0.0) ? stats[i].busyTime / wallTime : 0.0;
+		stats[i].tasksCount = threads[i]->tasksCount.load(std::memory_order_relaxed);
+		stats[i].stealsCount = threads[i]->stealsCount.load(std::memory_order_relaxed);
+		stats[i].remoteStealsCount = threads[i]->remoteStealsCount.load(std::memory_order_relaxed);
+		stats[i].node = threads[i]->node;
+	}
+}
+
+void TaskScheduler::ResetStats()
+{
+	for (ThreadState* state : threads) {
+		state->busyTime = 0;
+		state->tasksCount = 0;
+		state->stealsCount = 0;
+		state->remoteStealsCount = 0;
+	}
+
+	statsStart = std::chrono::steady_clock::now();
+}
+
+/**
+* Own deque first (newest task, best locality), then the queue of the thread's node and the injection queue, then a steal from
+* random victims of the same node and finally from any thread. Thread index is -1 for threads outside of the scheduler, they only steal.
+*/
+TaskScheduler::Task* TaskScheduler::findTask(int threadIndex)
+{
+	Task* task = nullptr;
+
+	if (threadIndex >= 0) task = threads[threadIndex]->deque.Pop();
+
+	if (!task && threadIndex >= 0) {
+		NodeState* node = nodes[threads[threadIndex]->node];
+		if (node->tasksCount > 0) {
+			std::lock_guard<std::mutex> lock(node->mutex);
+			if (!node->tasks.empty()) {
+				task = node->tasks.front();
+				node->tasks.pop_front();
+				node->tasksCount--;
+			}
+		}
+	}
+
+	if (!task && injectedCount > 0) {
+		std::lock_guard<std::mutex> lock(injectedMutex);
+		if (!injectedTasks.empty()) {
+			task = injectedTasks.front();
+			injectedTasks.pop_front();
+			injectedCount--;
+		}
+	}
+
+	if (!task) {
+		uint32_t random = (threadIndex >= 0) ? threads[threadIndex]->random : uint32_t(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		int victim = -1;
+
+		if (threadIndex >= 0 && nodes.size() > 1) task = stealTask(threadIndex, threads[threadIndex]->node, random, victim);
+		if (!task) task = stealTask(threadIndex, -1, random, victim);
+
+		if (threadIndex >= 0) {
+			ThreadState* state = threads[threadIndex];
+			state->random = random;
+			if (task) state->stealsCount.fetch_add(1, std::memory_order_relaxed);
+			if (task && threads[victim]->node != state->node) state->remoteStealsCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (task) queuedTasks--;
+
+	return task;
+}
+
+/**
+* Steal from random victims among the threads of node (any thread when node is -1), victim receives the thread stolen from.
+*/
+TaskScheduler::Task* TaskScheduler::stealTask(int threadIndex, int node, uint32_t &random, int &victim)
+{
+	const vector<int>* victims = (node >= 0) ? &nodes[node]->threads : nullptr;
+	uint32_t victimsCount = victims ? (uint32_t)victims->size() : (uint32_t)threads.size();
+
+	for (uint32_t attempt = 0; attempt < victimsCount * 2; attempt++) {
+		// Xorshift
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+
+		victim = int(random % victimsCount);
+		if (victims) victim = (*victims)[victim];
+		if (victim == threadIndex) continue;
+
+		Task* task = threads[victim]->deque.Steal();
+		if (task) return task;
+	}
+
+	return nullptr;
+}
+
+void TaskScheduler::execute(Task* task, int threadIndex)
+{
+	measure(threadIndex, task->work);
+
+	// Group may be gone as soon as its counter drops to zero
+	TaskGroup* group = task->group;
+	delete task;
+	group->pendingTasks--;
+
+	if (threadIndex >= 0) threads[threadIndex]->tasksCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+* Run work on the current thread and add its duration to the thread's busy time (unless it is nested in measured work).
+*/
+void TaskScheduler::measure(int threadIndex, const function<void()> &work)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	executeDepth++;
+	work();
+	executeDepth--;
+
+	if (threadIndex >= 0 && executeDepth == 0) {
+		uint64_t elapsed = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		threads[threadIndex]->busyTime.fetch_add(elapsed, std::memory_order_relaxed);
+	}
+}
+
+void TaskScheduler::workerLoop(int threadIndex)
+{
+	currentScheduler = this;
+	currentThreadIndex = threadIndex;
+
+	// A worker that fails to pin keeps running anywhere, it only reads remote memory more often
+	if (pinned) {
+		const NumaNodeInfo &info = nodes[threads[threadIndex]->node]->info;
+		pinThread(info.group, info.processorsMask);
+	}
+
+	int idleRounds = 0;
+
+	while (!quit) {
+		Task* task = findTask(threadIndex);
+
+		if (task) {
+			execute(task, threadIndex);
+			idleRounds = 0;
+			continue;
+		}
+
+		if (++idleRounds < idleRoundsBeforeSleep) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingCount++;
+		sleepCondition.wait(lock, [this]() { return quit || queuedTasks > 0; });
+		sleepingCount--;
+		idleRounds = 0;
+	}
+}
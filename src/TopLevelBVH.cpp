@@ -0,0 +1,199 @@
+// RTAO - Two-level acceleration structure: BVH over instances of per-mesh BVHs
+#include "TopLevelBVH.h"
+
+#include <chrono>
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Transforms
+//--------------------------------------------------------------------------------------
+
+static inline XMFLOAT3 transformPoint(const float (&m)[3][4], const XMFLOAT3 &p)
+{
+	return XMFLOAT3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+		m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+		m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+}
+
+static inline XMFLOAT3 transformVector(const float (&m)[3][4], const XMFLOAT3 &v)
+{
+	return XMFLOAT3(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+		m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+		m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+}
+
+/**
+* Inverse of an affine 3x4 transform: inverse of the 3x3 part (adjugate over determinant) and the translation rotated back.
+*/
+static bool invertTransform(const float (&m)[3][4], InstanceTransform &inverse)
+{
+	double c00 = double(m[1][1]) * m[2][2] - double(m[1][2]) * m[2][1];
+	double c01 = double(m[1][2]) * m[2][0] - double(m[1][0]) * m[2][2];
+	double c02 = double(m[1][0]) * m[2][1] - double(m[1][1]) * m[2][0];
+
+	double determinant = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+	if (determinant == 0.0) return false;
+
+	double invDeterminant = 1.0 / determinant;
+
+	double r[3][3] = {
+		{ c00, double(m[0][2]) * m[2][1] - double(m[0][1]) * m[2][2], double(m[0][1]) * m[1][2] - double(m[0][2]) * m[1][1] },
+		{ c01, double(m[0][0]) * m[2][2] - double(m[0][2]) * m[2][0], double(m[0][2]) * m[1][0] - double(m[0][0]) * m[1][2] },
+		{ c02, double(m[0][1]) * m[2][0] - double(m[0][0]) * m[2][1], double(m[0][0]) * m[1][1] - double(m[0][1]) * m[1][0] },
+	};
+
+	for (int row = 0; row < 3; row++) {
+		double translation = 0.0;
+		for (int column = 0; column < 3; column++) {
+			inverse.m[row][column] = float(r[row][column] * invDeterminant);
+			translation -= r[row][column] * invDeterminant * m[column][3];
+		}
+		inverse.m[row][3] = float(translation);
+	}
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Build
+//--------------------------------------------------------------------------------------
+
+/**
+* World bounds of every instance are the transformed corners of its mesh bounds, the tree over them uses the binned SAH builder.
+*/
+void Build_Top_Level_BVH(TaskScheduler &scheduler, const vector<const BVH8*> &meshes, const vector<Instance> &instances, TopLevelBVH &tlas)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	tlas.meshes = meshes;
+	tlas.instances = instances;
+	tlas.worldToObject.resize(instances.size());
+	tlas.stats = BVHBuildStats();
+
+	vector<AABB> meshBounds(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++) meshBounds[i] = Get_Bounds(*meshes[i]);
+
+	vector<AABB> bounds(instances.size());
+	std::atomic<bool> valid(true);
+
+	scheduler.ParallelFor(instances.size(), 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const Instance &instance = instances[i];
+
+			if (instance.meshIndex >= meshes.size() || !invertTransform(instance.transform, tlas.worldToObject[i])) {
+				valid = false;
+				continue;
+			}
+
+			const AABB &local = meshBounds[instance.meshIndex];
+			if (local.IsEmpty()) continue;
+
+			for (int corner = 0; corner < 8; corner++) {
+				XMFLOAT3 p = XMFLOAT3((corner & 1) ? local.max.x : local.min.x, (corner & 2) ? local.max.y : local.min.y, (corner & 4) ? local.max.z : local.min.z);
+				bounds[i].Grow(transformPoint(instance.transform, p));
+			}
+		}
+	});
+
+	if (!valid)
+	{
+		throw std::runtime_error("Error: instance references a missing mesh or has a singular transform!");
+	}
+
+	// Instances are the primitives, one per leaf keeps the object space traversals independent
+	BVHBuildInfo info;
+	info.leafSize = 1;
+
+	Build_BVH_Nodes(scheduler, bounds, info, tlas.nodes, tlas.instanceIndices, tlas.stats);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	tlas.stats.buildTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+//--------------------------------------------------------------------------------------
+// Traversal
+//--------------------------------------------------------------------------------------
+
+/**
+* Ordered depth-first traversal of the instance tree, every leaf instance is traced in object space with the current closest T.
+*/
+static bool traverse(const TopLevelBVH &tlas, const Ray &ray, uint32_t instanceInclusionMask, Hit &hit, bool anyHit)
+{
+	if (tlas.nodes.empty()) return false;
+
+	const BVHNode* nodes = tlas.nodes.data();
+	XMFLOAT3 invDirection = SafeInverse(ray.direction);
+	float tMax = ray.tMax;
+	bool found = false;
+
+	if (IntersectAABB(nodes[0].boundsMin, nodes[0].boundsMax, ray.origin, invDirection, ray.tMin, tMax) == FLT_MAX) return false;
+
+	uint32_t stack[BVH_STACK_SIZE];
+	float stackDistances[BVH_STACK_SIZE];
+	int stackSize = 0;
+	uint32_t nodeIndex = 0;
+
+	while (true) {
+		const BVHNode &node = nodes[nodeIndex];
+
+		if (node.IsLeaf()) {
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+				uint32_t instanceIndex = tlas.instanceIndices[i];
+				const Instance &instance = tlas.instances[instanceIndex];
+				if ((instance.mask & instanceInclusionMask & 0xFF) == 0) continue;
+
+				const InstanceTransform &worldToObject = tlas.worldToObject[instanceIndex];
+				Ray objectRay(transformPoint(worldToObject.m, ray.origin), transformVector(worldToObject.m, ray.direction), ray.tMin, tMax);
+
+				Hit objectHit;
+				const BVH8 &mesh = *tlas.meshes[instance.meshIndex];
+				bool intersected = anyHit ? Occluded(mesh, objectRay, objectHit) : Intersect(mesh, objectRay, objectHit);
+				if (!intersected) continue;
+
+				tMax = objectHit.t;
+				hit = objectHit;
+				hit.instanceIndex = instanceIndex;
+				found = true;
+
+				if (anyHit) return true;
+			}
+		} else {
+			uint32_t left = node.leftFirst;
+			uint32_t right = left + 1;
+			float tLeft = IntersectAABB(nodes[left].boundsMin, nodes[left].boundsMax, ray.origin, invDirection, ray.tMin, tMax);
+			float tRight = IntersectAABB(nodes[right].boundsMin, nodes[right].boundsMax, ray.origin, invDirection, ray.tMin, tMax);
+
+			if (tLeft != FLT_MAX && tRight != FLT_MAX) {
+				bool leftFirst = tLeft <= tRight;
+				stack[stackSize] = leftFirst ? right : left;
+				stackDistances[stackSize++] = leftFirst ? tRight : tLeft;
+				nodeIndex = leftFirst ? left : right;
+				continue;
+			}
+
+			if (tLeft != FLT_MAX) { nodeIndex = left; continue; }
+			if (tRight != FLT_MAX) { nodeIndex = right; continue; }
+		}
+
+		do {
+			if (stackSize == 0) return found;
+			stackSize--;
+		} while (stackDistances[stackSize] > tMax);
+
+		nodeIndex = stack[stackSize];
+	}
+}
+
+bool Intersect(const TopLevelBVH &tlas, const Ray &ray, uint32_t instanceInclusionMask, Hit &hit)
+{
+	return traverse(tlas, ray, instanceInclusionMask, hit, false);
+}
+
+bool Occluded(const TopLevelBVH &tlas, const Ray &ray, uint32_t instanceInclusionMask, Hit &hit)
+{
+	return traverse(tlas, ray, instanceInclusionMask, hit, true);
+}
+
+}
@@ -0,0 +1,252 @@
+// RTAO - BVH8 leaf triangles precomputed in SoA packets of 4, 8 or 16 with SIMD intersection kernels
+#include "TrianglePackets.h"
+
+#include <emmintrin.h>
+
+namespace CPURT
+{
+
+//--------------------------------------------------------------------------------------
+// Build
+//--------------------------------------------------------------------------------------
+
+static void packLeaves(const BVH8 &bvh, uint32_t nodeIndex, TrianglePackets &packets)
+{
+	const BVH8Node &node = bvh.nodes[nodeIndex];
+	const size_t width = (size_t)packets.width;
+
+	for (int i = 0; i < BVH8_WIDTH; i++) {
+		uint32_t child = node.children[i];
+		if (child == BVH8_EMPTY_CHILD) continue;
+
+		if (!(child & BVH8_LEAF_FLAG)) {
+			packLeaves(bvh, child, packets);
+			continue;
+		}
+
+		uint32_t first = child & ~BVH8_LEAF_FLAG;
+		uint32_t count = node.counts[i];
+		if (count == 0) continue;
+
+		packets.leafPackets[first] = (uint32_t)packets.GetPacketsCount();
+
+		for (uint32_t begin = 0; begin < count; begin += (uint32_t)width) {
+			size_t base = packets.data.size();
+			packets.data.resize(base + 9 * width);
+			float* planes = &packets.data[base];
+
+			for (size_t lane = 0; lane < width; lane++) {
+				uint32_t triangleIndex = first + min(begin + (uint32_t)lane, count - 1);
+				const Triangle &triangle = bvh.triangles[triangleIndex];
+
+				XMFLOAT3 p1 = triangle.v1, p2 = triangle.v2;
+				if (packets.test == TRIANGLE_TEST_MOLLER_TRUMBORE) {
+					p1 = Sub(triangle.v1, triangle.v0);
+					p2 = Sub(triangle.v2, triangle.v0);
+				}
+
+				const XMFLOAT3 points[3] = { triangle.v0, p1, p2 };
+				for (int point = 0; point < 3; point++) {
+					for (int axis = 0; axis < 3; axis++) planes[(point * 3 + axis) * width + lane] = Component(points[point], axis);
+				}
+
+				packets.primitiveIndices.push_back(bvh.primitiveIndices[triangleIndex]);
+			}
+		}
+	}
+}
+
+void Build_Triangle_Packets(const BVH8 &bvh, int width, TriangleTest test, TrianglePackets &packets)
+{
+	SIMDLevel level = Get_Supported_SIMD_Level();
+
+	if ((width != 4 && width != 8 && width != 16) || level < SIMD_AVX2 || (width == 16 && level < SIMD_AVX512))
+	{
+		throw std::runtime_error("Error: triangle packets of this width are not supported by the CPU!");
+	}
+
+	packets.width = width;
+	packets.test = test;
+	packets.data.clear();
+	packets.primitiveIndices.clear();
+	packets.leafPackets.assign(bvh.triangles.size(), UINT32_MAX);
+
+	if (bvh.nodes.empty()) return;
+
+	packets.data.reserve(bvh.triangles.size() * 9 * 2);
+	packets.primitiveIndices.reserve(bvh.triangles.size() * 2);
+
+	packLeaves(bvh, 0, packets);
+
+	packets.data.shrink_to_fit();
+	packets.primitiveIndices.shrink_to_fit();
+}
+
+const char* Get_Triangle_Test_Name(TriangleTest test)
+{
+	return (test == TRIANGLE_TEST_WATERTIGHT) ? "watertight" : "mollerTrumbore";
+}
+
+//--------------------------------------------------------------------------------------
+// Dispatch
+//--------------------------------------------------------------------------------------
+
+bool Intersect_Triangle_Packets(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	switch (packets.width) {
+	case 16: return Intersect_Packets_AVX512(packets, first, count, ray, tMax, hit, anyHit);
+	case 8: return Intersect_Packets_AVX2(packets, first, count, ray, tMax, hit, anyHit);
+	default: return Intersect_Packets_SSE(packets, first, count, ray, tMax, hit, anyHit);
+	}
+}
+
+bool Intersect(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit)
+{
+	return Intersect_BVH8_Packets_AVX2(bvh, packets, ray, hit);
+}
+
+bool Occluded(const BVH8 &bvh, const TrianglePackets &packets, const Ray &ray, Hit &hit)
+{
+	return Occluded_BVH8_Packets_AVX2(bvh, packets, ray, hit);
+}
+
+//--------------------------------------------------------------------------------------
+// SSE Kernel
+//--------------------------------------------------------------------------------------
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+template <TriangleTest test>
+static bool intersectPackets(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	const int width = 4;
+
+	const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const WatertightRay sheared = GetWatertightRay(ray.direction);
+
+	const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+	const __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	const __m128 tMinV = _mm_set1_ps(ray.tMin);
+
+	bool found = false;
+
+	for (uint32_t packet = first; packet < first + count; packet++) {
+		const float* planes = &packets.data[size_t(packet) * 9 * width];
+		__m128 t, u, v, valid;
+
+		if (test == TRIANGLE_TEST_MOLLER_TRUMBORE) {
+			__m128 v0x = _mm_loadu_ps(planes + 0 * width), v0y = _mm_loadu_ps(planes + 1 * width), v0z = _mm_loadu_ps(planes + 2 * width);
+			__m128 e1x = _mm_loadu_ps(planes + 3 * width), e1y = _mm_loadu_ps(planes + 4 * width), e1z = _mm_loadu_ps(planes + 5 * width);
+			__m128 e2x = _mm_loadu_ps(planes + 6 * width), e2y = _mm_loadu_ps(planes + 7 * width), e2z = _mm_loadu_ps(planes + 8 * width);
+
+			__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+			__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+			__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+			__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			__m128 invDeterminant = _mm_div_ps(one, determinant);
+
+			__m128 sx = _mm_sub_ps(ox, v0x), sy = _mm_sub_ps(oy, v0y), sz = _mm_sub_ps(oz, v0z);
+			u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDeterminant);
+
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDeterminant);
+			t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDeterminant);
+
+			valid = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), determinant), _mm_set1_ps(1e-12f));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+		} else {
+			// Vertices relative to the origin, components permuted into ray space by picking planes
+			const int kx = sheared.kx * width, ky = sheared.ky * width, kz = sheared.kz * width;
+			const __m128 okx = _mm_set1_ps(origin[sheared.kx]), oky = _mm_set1_ps(origin[sheared.ky]), okz = _mm_set1_ps(origin[sheared.kz]);
+			const __m128 shearX = _mm_set1_ps(sheared.sx), shearY = _mm_set1_ps(sheared.sy);
+
+			__m128 az = _mm_sub_ps(_mm_loadu_ps(planes + kz), okz);
+			__m128 bz = _mm_sub_ps(_mm_loadu_ps(planes + 3 * width + kz), okz);
+			__m128 cz = _mm_sub_ps(_mm_loadu_ps(planes + 6 * width + kz), okz);
+			__m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(planes + kx), okx), _mm_mul_ps(shearX, az));
+			__m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(planes + ky), oky), _mm_mul_ps(shearY, az));
+			__m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(planes + 3 * width + kx), okx), _mm_mul_ps(shearX, bz));
+			__m128 by = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(planes + 3 * width + ky), oky), _mm_mul_ps(shearY, bz));
+			__m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(planes + 6 * width + kx), okx), _mm_mul_ps(shearX, cz));
+			__m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(planes + 6 * width + ky), oky), _mm_mul_ps(shearY, cz));
+
+			__m128 e0 = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+			__m128 e1 = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+			__m128 e2 = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+
+			__m128 zeroEdges = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(e0, zero), _mm_cmpeq_ps(e1, zero)), _mm_cmpeq_ps(e2, zero));
+			if (_mm_movemask_ps(zeroEdges)) {
+				float lanes[9][width];
+				_mm_storeu_ps(lanes[0], ax); _mm_storeu_ps(lanes[1], ay); _mm_storeu_ps(lanes[2], bx); _mm_storeu_ps(lanes[3], by);
+				_mm_storeu_ps(lanes[4], cx); _mm_storeu_ps(lanes[5], cy);
+				for (int lane = 0; lane < width; lane++) {
+					double lax = lanes[0][lane], lay = lanes[1][lane], lbx = lanes[2][lane], lby = lanes[3][lane], lcx = lanes[4][lane], lcy = lanes[5][lane];
+					lanes[6][lane] = float(lcx * lby - lcy * lbx);
+					lanes[7][lane] = float(lax * lcy - lay * lcx);
+					lanes[8][lane] = float(lbx * lay - lby * lax);
+				}
+				e0 = _mm_loadu_ps(lanes[6]);
+				e1 = _mm_loadu_ps(lanes[7]);
+				e2 = _mm_loadu_ps(lanes[8]);
+			}
+
+			__m128 negative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(e0, zero), _mm_cmplt_ps(e1, zero)), _mm_cmplt_ps(e2, zero));
+			__m128 positive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(e0, zero), _mm_cmpgt_ps(e1, zero)), _mm_cmpgt_ps(e2, zero));
+			__m128 determinant = _mm_add_ps(_mm_add_ps(e0, e1), e2);
+			__m128 invDeterminant = _mm_div_ps(one, determinant);
+
+			valid = _mm_andnot_ps(_mm_and_ps(negative, positive), _mm_cmpneq_ps(determinant, zero));
+
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e0, az), _mm_mul_ps(e1, bz)), _mm_mul_ps(e2, cz));
+			t = _mm_mul_ps(_mm_mul_ps(distance, _mm_set1_ps(sheared.sz)), invDeterminant);
+			u = _mm_mul_ps(e1, invDeterminant);
+			v = _mm_mul_ps(e2, invDeterminant);
+		}
+
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, tMinV), _mm_cmple_ps(t, _mm_set1_ps(tMax))));
+
+		int mask = _mm_movemask_ps(valid);
+		if (!mask) continue;
+
+		if (!anyHit) {
+			// Lanes with the smallest distance
+			__m128 distances = select(valid, t, _mm_set1_ps(FLT_MAX));
+			__m128 nearest = _mm_min_ps(distances, _mm_shuffle_ps(distances, distances, _MM_SHUFFLE(2, 3, 0, 1)));
+			nearest = _mm_min_ps(nearest, _mm_shuffle_ps(nearest, nearest, _MM_SHUFFLE(1, 0, 3, 2)));
+			mask &= _mm_movemask_ps(_mm_cmpeq_ps(distances, nearest));
+		}
+
+		int lane = 0;
+		while (!(mask & (1 << lane))) lane++;
+
+		float lanes[3][width];
+		_mm_storeu_ps(lanes[0], t);
+		_mm_storeu_ps(lanes[1], u);
+		_mm_storeu_ps(lanes[2], v);
+
+		tMax = lanes[0][lane];
+		hit.t = lanes[0][lane];
+		hit.primitiveIndex = packets.primitiveIndices[size_t(packet) * width + lane];
+		hit.barycentrics = XMFLOAT2(lanes[1][lane], lanes[2][lane]);
+		found = true;
+
+		if (anyHit) break;
+	}
+
+	return found;
+}
+
+bool Intersect_Packets_SSE(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	if (packets.test == TRIANGLE_TEST_WATERTIGHT) return intersectPackets<TRIANGLE_TEST_WATERTIGHT>(packets, first, count, ray, tMax, hit, anyHit);
+	return intersectPackets<TRIANGLE_TEST_MOLLER_TRUMBORE>(packets, first, count, ray, tMax, hit, anyHit);
+}
+
+}
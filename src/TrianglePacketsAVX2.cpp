@@ -0,0 +1,144 @@
+// RTAO - 8-wide triangle packet kernels, written with AVX2 and FMA intrinsics
+#include "TrianglePackets.h"
+
+#include <immintrin.h>
+
+namespace CPURT
+{
+
+template <TriangleTest test>
+static bool intersectPackets(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	const int width = 8;
+
+	const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const WatertightRay sheared = GetWatertightRay(ray.direction);
+
+	const __m256 dx = _mm256_set1_ps(ray.direction.x), dy = _mm256_set1_ps(ray.direction.y), dz = _mm256_set1_ps(ray.direction.z);
+	const __m256 ox = _mm256_set1_ps(ray.origin.x), oy = _mm256_set1_ps(ray.origin.y), oz = _mm256_set1_ps(ray.origin.z);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	const __m256 tMinV = _mm256_set1_ps(ray.tMin);
+
+	bool found = false;
+
+	for (uint32_t packet = first; packet < first + count; packet++) {
+		const float* planes = &packets.data[size_t(packet) * 9 * width];
+		__m256 t, u, v, valid;
+
+		if (test == TRIANGLE_TEST_MOLLER_TRUMBORE) {
+			__m256 v0x = _mm256_loadu_ps(planes + 0 * width), v0y = _mm256_loadu_ps(planes + 1 * width), v0z = _mm256_loadu_ps(planes + 2 * width);
+			__m256 e1x = _mm256_loadu_ps(planes + 3 * width), e1y = _mm256_loadu_ps(planes + 4 * width), e1z = _mm256_loadu_ps(planes + 5 * width);
+			__m256 e2x = _mm256_loadu_ps(planes + 6 * width), e2y = _mm256_loadu_ps(planes + 7 * width), e2z = _mm256_loadu_ps(planes + 8 * width);
+
+			__m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+			__m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+			__m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+			__m256 determinant = _mm256_fmadd_ps(e1x, px, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1z, pz)));
+			__m256 invDeterminant = _mm256_div_ps(one, determinant);
+
+			__m256 sx = _mm256_sub_ps(ox, v0x), sy = _mm256_sub_ps(oy, v0y), sz = _mm256_sub_ps(oz, v0z);
+			u = _mm256_mul_ps(_mm256_fmadd_ps(sx, px, _mm256_fmadd_ps(sy, py, _mm256_mul_ps(sz, pz))), invDeterminant);
+
+			__m256 qx = _mm256_fmsub_ps(sy, e1z, _mm256_mul_ps(sz, e1y));
+			__m256 qy = _mm256_fmsub_ps(sz, e1x, _mm256_mul_ps(sx, e1z));
+			__m256 qz = _mm256_fmsub_ps(sx, e1y, _mm256_mul_ps(sy, e1x));
+			v = _mm256_mul_ps(_mm256_fmadd_ps(dx, qx, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dz, qz))), invDeterminant);
+			t = _mm256_mul_ps(_mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))), invDeterminant);
+
+			valid = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), determinant), _mm256_set1_ps(1e-12f), _CMP_GE_OQ);
+			valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+			valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+		} else {
+			// No FMA below: edge functions of a shared edge must round the same in both triangles
+			const int kx = sheared.kx * width, ky = sheared.ky * width, kz = sheared.kz * width;
+			const __m256 okx = _mm256_set1_ps(origin[sheared.kx]), oky = _mm256_set1_ps(origin[sheared.ky]), okz = _mm256_set1_ps(origin[sheared.kz]);
+			const __m256 shearX = _mm256_set1_ps(sheared.sx), shearY = _mm256_set1_ps(sheared.sy);
+
+			__m256 az = _mm256_sub_ps(_mm256_loadu_ps(planes + kz), okz);
+			__m256 bz = _mm256_sub_ps(_mm256_loadu_ps(planes + 3 * width + kz), okz);
+			__m256 cz = _mm256_sub_ps(_mm256_loadu_ps(planes + 6 * width + kz), okz);
+			__m256 ax = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + kx), okx), _mm256_mul_ps(shearX, az));
+			__m256 ay = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + ky), oky), _mm256_mul_ps(shearY, az));
+			__m256 bx = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + 3 * width + kx), okx), _mm256_mul_ps(shearX, bz));
+			__m256 by = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + 3 * width + ky), oky), _mm256_mul_ps(shearY, bz));
+			__m256 cx = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + 6 * width + kx), okx), _mm256_mul_ps(shearX, cz));
+			__m256 cy = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(planes + 6 * width + ky), oky), _mm256_mul_ps(shearY, cz));
+
+			__m256 e0 = _mm256_sub_ps(_mm256_mul_ps(cx, by), _mm256_mul_ps(cy, bx));
+			__m256 e1 = _mm256_sub_ps(_mm256_mul_ps(ax, cy), _mm256_mul_ps(ay, cx));
+			__m256 e2 = _mm256_sub_ps(_mm256_mul_ps(bx, ay), _mm256_mul_ps(by, ax));
+
+			// Rays exactly through an edge redo the edge functions in double, as IntersectTriangleWatertight does
+			__m256 zeroEdges = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(e0, zero, _CMP_EQ_OQ), _mm256_cmp_ps(e1, zero, _CMP_EQ_OQ)), _mm256_cmp_ps(e2, zero, _CMP_EQ_OQ));
+			if (_mm256_movemask_ps(zeroEdges)) {
+				__m256d axd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(ax)), _mm256_cvtps_pd(_mm256_extractf128_ps(ax, 1)) };
+				__m256d ayd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(ay)), _mm256_cvtps_pd(_mm256_extractf128_ps(ay, 1)) };
+				__m256d bxd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(bx)), _mm256_cvtps_pd(_mm256_extractf128_ps(bx, 1)) };
+				__m256d byd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(by)), _mm256_cvtps_pd(_mm256_extractf128_ps(by, 1)) };
+				__m256d cxd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(cx)), _mm256_cvtps_pd(_mm256_extractf128_ps(cx, 1)) };
+				__m256d cyd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(cy)), _mm256_cvtps_pd(_mm256_extractf128_ps(cy, 1)) };
+
+				__m128 halves[3][2];
+				for (int half = 0; half < 2; half++) {
+					halves[0][half] = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_mul_pd(cxd[half], byd[half]), _mm256_mul_pd(cyd[half], bxd[half])));
+					halves[1][half] = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_mul_pd(axd[half], cyd[half]), _mm256_mul_pd(ayd[half], cxd[half])));
+					halves[2][half] = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_mul_pd(bxd[half], ayd[half]), _mm256_mul_pd(byd[half], axd[half])));
+				}
+				e0 = _mm256_insertf128_ps(_mm256_castps128_ps256(halves[0][0]), halves[0][1], 1);
+				e1 = _mm256_insertf128_ps(_mm256_castps128_ps256(halves[1][0]), halves[1][1], 1);
+				e2 = _mm256_insertf128_ps(_mm256_castps128_ps256(halves[2][0]), halves[2][1], 1);
+			}
+
+			__m256 negative = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(e0, zero, _CMP_LT_OQ), _mm256_cmp_ps(e1, zero, _CMP_LT_OQ)), _mm256_cmp_ps(e2, zero, _CMP_LT_OQ));
+			__m256 positive = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(e0, zero, _CMP_GT_OQ), _mm256_cmp_ps(e1, zero, _CMP_GT_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GT_OQ));
+			__m256 determinant = _mm256_add_ps(_mm256_add_ps(e0, e1), e2);
+			__m256 invDeterminant = _mm256_div_ps(one, determinant);
+
+			valid = _mm256_andnot_ps(_mm256_and_ps(negative, positive), _mm256_cmp_ps(determinant, zero, _CMP_NEQ_OQ));
+
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e0, az), _mm256_mul_ps(e1, bz)), _mm256_mul_ps(e2, cz));
+			t = _mm256_mul_ps(_mm256_mul_ps(distance, _mm256_set1_ps(sheared.sz)), invDeterminant);
+			u = _mm256_mul_ps(e1, invDeterminant);
+			v = _mm256_mul_ps(e2, invDeterminant);
+		}
+
+		valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, tMinV, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LE_OQ)));
+
+		int mask = _mm256_movemask_ps(valid);
+		if (!mask) continue;
+
+		if (!anyHit) {
+			// Lanes with the smallest distance
+			__m256 distances = _mm256_blendv_ps(_mm256_set1_ps(FLT_MAX), t, valid);
+			__m256 nearest = _mm256_min_ps(distances, _mm256_permute_ps(distances, _MM_SHUFFLE(2, 3, 0, 1)));
+			nearest = _mm256_min_ps(nearest, _mm256_permute_ps(nearest, _MM_SHUFFLE(1, 0, 3, 2)));
+			nearest = _mm256_min_ps(nearest, _mm256_permute2f128_ps(nearest, nearest, 0x01));
+			mask &= _mm256_movemask_ps(_mm256_cmp_ps(distances, nearest, _CMP_EQ_OQ));
+		}
+
+		int lane = _tzcnt_u32(mask);
+
+		alignas(32) float lanes[3][width];
+		_mm256_store_ps(lanes[0], t);
+		_mm256_store_ps(lanes[1], u);
+		_mm256_store_ps(lanes[2], v);
+
+		tMax = lanes[0][lane];
+		hit.t = lanes[0][lane];
+		hit.primitiveIndex = packets.primitiveIndices[size_t(packet) * width + lane];
+		hit.barycentrics = XMFLOAT2(lanes[1][lane], lanes[2][lane]);
+		found = true;
+
+		if (anyHit) break;
+	}
+
+	return found;
+}
+
+bool Intersect_Packets_AVX2(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	if (packets.test == TRIANGLE_TEST_WATERTIGHT) return intersectPackets<TRIANGLE_TEST_WATERTIGHT>(packets, first, count, ray, tMax, hit, anyHit);
+	return intersectPackets<TRIANGLE_TEST_MOLLER_TRUMBORE>(packets, first, count, ray, tMax, hit, anyHit);
+}
+
+}
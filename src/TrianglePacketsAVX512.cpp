@@ -0,0 +1,140 @@
+// RTAO - 16-wide triangle packet kernels, written with AVX-512 (F) intrinsics
+#include "TrianglePackets.h"
+
+#include <immintrin.h>
+
+namespace CPURT
+{
+
+/**
+* Same tests as the AVX2 kernel on 16 lanes, lane validity is kept in mask registers.
+*/
+template <TriangleTest test>
+static bool intersectPackets(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	const int width = 16;
+
+	const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const WatertightRay sheared = GetWatertightRay(ray.direction);
+
+	const __m512 dx = _mm512_set1_ps(ray.direction.x), dy = _mm512_set1_ps(ray.direction.y), dz = _mm512_set1_ps(ray.direction.z);
+	const __m512 ox = _mm512_set1_ps(ray.origin.x), oy = _mm512_set1_ps(ray.origin.y), oz = _mm512_set1_ps(ray.origin.z);
+	const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.0f);
+	const __m512 tMinV = _mm512_set1_ps(ray.tMin);
+
+	bool found = false;
+
+	for (uint32_t packet = first; packet < first + count; packet++) {
+		const float* planes = &packets.data[size_t(packet) * 9 * width];
+		__m512 t, u, v;
+		__mmask16 valid;
+
+		if (test == TRIANGLE_TEST_MOLLER_TRUMBORE) {
+			__m512 v0x = _mm512_loadu_ps(planes + 0 * width), v0y = _mm512_loadu_ps(planes + 1 * width), v0z = _mm512_loadu_ps(planes + 2 * width);
+			__m512 e1x = _mm512_loadu_ps(planes + 3 * width), e1y = _mm512_loadu_ps(planes + 4 * width), e1z = _mm512_loadu_ps(planes + 5 * width);
+			__m512 e2x = _mm512_loadu_ps(planes + 6 * width), e2y = _mm512_loadu_ps(planes + 7 * width), e2z = _mm512_loadu_ps(planes + 8 * width);
+
+			__m512 px = _mm512_fmsub_ps(dy, e2z, _mm512_mul_ps(dz, e2y));
+			__m512 py = _mm512_fmsub_ps(dz, e2x, _mm512_mul_ps(dx, e2z));
+			__m512 pz = _mm512_fmsub_ps(dx, e2y, _mm512_mul_ps(dy, e2x));
+			__m512 determinant = _mm512_fmadd_ps(e1x, px, _mm512_fmadd_ps(e1y, py, _mm512_mul_ps(e1z, pz)));
+			__m512 invDeterminant = _mm512_div_ps(one, determinant);
+
+			__m512 sx = _mm512_sub_ps(ox, v0x), sy = _mm512_sub_ps(oy, v0y), sz = _mm512_sub_ps(oz, v0z);
+			u = _mm512_mul_ps(_mm512_fmadd_ps(sx, px, _mm512_fmadd_ps(sy, py, _mm512_mul_ps(sz, pz))), invDeterminant);
+
+			__m512 qx = _mm512_fmsub_ps(sy, e1z, _mm512_mul_ps(sz, e1y));
+			__m512 qy = _mm512_fmsub_ps(sz, e1x, _mm512_mul_ps(sx, e1z));
+			__m512 qz = _mm512_fmsub_ps(sx, e1y, _mm512_mul_ps(sy, e1x));
+			v = _mm512_mul_ps(_mm512_fmadd_ps(dx, qx, _mm512_fmadd_ps(dy, qy, _mm512_mul_ps(dz, qz))), invDeterminant);
+			t = _mm512_mul_ps(_mm512_fmadd_ps(e2x, qx, _mm512_fmadd_ps(e2y, qy, _mm512_mul_ps(e2z, qz))), invDeterminant);
+
+			valid = _mm512_cmp_ps_mask(_mm512_abs_ps(determinant), _mm512_set1_ps(1e-12f), _CMP_GE_OQ);
+			valid = _mm512_mask_cmp_ps_mask(valid, u, zero, _CMP_GE_OQ) & _mm512_mask_cmp_ps_mask(valid, u, one, _CMP_LE_OQ);
+			valid = _mm512_mask_cmp_ps_mask(valid, v, zero, _CMP_GE_OQ) & _mm512_mask_cmp_ps_mask(valid, _mm512_add_ps(u, v), one, _CMP_LE_OQ);
+		} else {
+			// No FMA below: edge functions of a shared edge must round the same in both triangles
+			const int kx = sheared.kx * width, ky = sheared.ky * width, kz = sheared.kz * width;
+			const __m512 okx = _mm512_set1_ps(origin[sheared.kx]), oky = _mm512_set1_ps(origin[sheared.ky]), okz = _mm512_set1_ps(origin[sheared.kz]);
+			const __m512 shearX = _mm512_set1_ps(sheared.sx), shearY = _mm512_set1_ps(sheared.sy);
+
+			__m512 az = _mm512_sub_ps(_mm512_loadu_ps(planes + kz), okz);
+			__m512 bz = _mm512_sub_ps(_mm512_loadu_ps(planes + 3 * width + kz), okz);
+			__m512 cz = _mm512_sub_ps(_mm512_loadu_ps(planes + 6 * width + kz), okz);
+			__m512 ax = _mm512_sub_ps(_mm512_sub_ps(_mm512_loadu_ps(planes + kx), okx), _mm512_mul_ps(shearX, az));
+			__m512 ay = _mm512_sub_ps(_mm512_sub_ps(_mm512_loadu_ps(planes + ky), oky), _mm512_mul_ps(shearY, az));
+			__m512 bx = _mm512_sub_ps(_mm512_sub_ps(_mm512_loadu_ps(planes + 3 * width + kx), okx), _mm512_mul_ps(shearX, bz));
+			__m512 by = _mm512_sub_ps(_mm512_sub_ps(_mm512_loadu_ps(planes + 3 * width + ky), oky), _mm512_mul_ps(shearY, bz));
+			__m512 cx = _mm512_sub_ps(_mm512_sub_ps(_mm512_loadu_ps(planes + 6 * width + kx), okx), _mm512_mul_ps(shearX, cz));
+			__m512 cy = _mm512_sub_ps(_mm512_sub_ps(_mm512_loadu_ps(planes + 6 * width + ky), oky), _mm512_mul_ps(shearY, cz));
+
+			__m512 e0 = _mm512_sub_ps(_mm512_mul_ps(cx, by), _mm512_mul_ps(cy, bx));
+			__m512 e1 = _mm512_sub_ps(_mm512_mul_ps(ax, cy), _mm512_mul_ps(ay, cx));
+			__m512 e2 = _mm512_sub_ps(_mm512_mul_ps(bx, ay), _mm512_mul_ps(by, ax));
+
+			// Rays exactly through an edge redo the edge functions in double, as IntersectTriangleWatertight does
+			__mmask16 zeroEdges = _mm512_cmp_ps_mask(e0, zero, _CMP_EQ_OQ) | _mm512_cmp_ps_mask(e1, zero, _CMP_EQ_OQ) | _mm512_cmp_ps_mask(e2, zero, _CMP_EQ_OQ);
+			if (zeroEdges) {
+				alignas(64) float lanes[9][width];
+				_mm512_store_ps(lanes[0], ax); _mm512_store_ps(lanes[1], ay); _mm512_store_ps(lanes[2], bx);
+				_mm512_store_ps(lanes[3], by); _mm512_store_ps(lanes[4], cx); _mm512_store_ps(lanes[5], cy);
+				for (int lane = 0; lane < width; lane++) {
+					double lax = lanes[0][lane], lay = lanes[1][lane], lbx = lanes[2][lane], lby = lanes[3][lane], lcx = lanes[4][lane], lcy = lanes[5][lane];
+					lanes[6][lane] = float(lcx * lby - lcy * lbx);
+					lanes[7][lane] = float(lax * lcy - lay * lcx);
+					lanes[8][lane] = float(lbx * lay - lby * lax);
+				}
+				e0 = _mm512_load_ps(lanes[6]);
+				e1 = _mm512_load_ps(lanes[7]);
+				e2 = _mm512_load_ps(lanes[8]);
+			}
+
+			__mmask16 negative = _mm512_cmp_ps_mask(e0, zero, _CMP_LT_OQ) | _mm512_cmp_ps_mask(e1, zero, _CMP_LT_OQ) | _mm512_cmp_ps_mask(e2, zero, _CMP_LT_OQ);
+			__mmask16 positive = _mm512_cmp_ps_mask(e0, zero, _CMP_GT_OQ) | _mm512_cmp_ps_mask(e1, zero, _CMP_GT_OQ) | _mm512_cmp_ps_mask(e2, zero, _CMP_GT_OQ);
+			__m512 determinant = _mm512_add_ps(_mm512_add_ps(e0, e1), e2);
+			__m512 invDeterminant = _mm512_div_ps(one, determinant);
+
+			valid = _mm512_cmp_ps_mask(determinant, zero, _CMP_NEQ_OQ) & ~(negative & positive);
+
+			__m512 distance = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e0, az), _mm512_mul_ps(e1, bz)), _mm512_mul_ps(e2, cz));
+			t = _mm512_mul_ps(_mm512_mul_ps(distance, _mm512_set1_ps(sheared.sz)), invDeterminant);
+			u = _mm512_mul_ps(e1, invDeterminant);
+			v = _mm512_mul_ps(e2, invDeterminant);
+		}
+
+		valid = _mm512_mask_cmp_ps_mask(valid, t, tMinV, _CMP_GE_OQ) & _mm512_mask_cmp_ps_mask(valid, t, _mm512_set1_ps(tMax), _CMP_LE_OQ);
+		if (!valid) continue;
+
+		uint32_t mask = valid;
+		if (!anyHit) {
+			// Lanes with the smallest distance
+			float nearest = _mm512_mask_reduce_min_ps(valid, t);
+			mask = _mm512_mask_cmp_ps_mask(valid, t, _mm512_set1_ps(nearest), _CMP_EQ_OQ);
+		}
+
+		int lane = _tzcnt_u32(mask);
+
+		alignas(64) float lanes[3][width];
+		_mm512_store_ps(lanes[0], t);
+		_mm512_store_ps(lanes[1], u);
+		_mm512_store_ps(lanes[2], v);
+
+		tMax = lanes[0][lane];
+		hit.t = lanes[0][lane];
+		hit.primitiveIndex = packets.primitiveIndices[size_t(packet) * width + lane];
+		hit.barycentrics = XMFLOAT2(lanes[1][lane], lanes[2][lane]);
+		found = true;
+
+		if (anyHit) break;
+	}
+
+	return found;
+}
+
+bool Intersect_Packets_AVX512(const TrianglePackets &packets, uint32_t first, uint32_t count, const Ray &ray, float &tMax, Hit &hit, bool anyHit)
+{
+	if (packets.test == TRIANGLE_TEST_WATERTIGHT) return intersectPackets<TRIANGLE_TEST_WATERTIGHT>(packets, first, count, ray, tMax, hit, anyHit);
+	return intersectPackets<TRIANGLE_TEST_MOLLER_TRUMBORE>(packets, first, count, ray, tMax, hit, anyHit);
+}
+
+}
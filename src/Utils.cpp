@@ -107,6 +107,60 @@ HRESULT ParseCommandLine(LPWSTR lpCmdLine, ConfigInfo &config)
 				continue;
 			}
 
+			if (strcmp(str, "-benchmark") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				config.benchmark = str;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-output") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				config.benchmarkOutput = str;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-samples") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				config.sampleSets.push_back(str);
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-triangles") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				config.benchmarkTriangles = atoi(str);
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-threads") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				config.threadsCount = atoi(str);
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-aoRadius") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				config.aoRadius = (float)atof(str);
+				i++;
+				continue;
+			}
+
 			i++;
 		}
 	}
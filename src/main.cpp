@@ -34,6 +34,7 @@
 #include "RTAO.h"
 #include "Gui.h"
 #include "Profiler.h"
+#include "Benchmarks.h"
 
 #ifdef _DEBUG
 #define _CRTDBG_MAP_ALLOC
@@ -181,6 +182,9 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
 		hr = Utils::ParseCommandLine(lpCmdLine, config);
 		if (hr != EXIT_SUCCESS) return hr;
 
+		// Headless benchmarks run without a window and don't need a GPU
+		if (!config.benchmark.empty()) return Benchmarks::Run(config);
+
 		// Initialize
 		DXRApplication app;
 		app.Init(config);